@@ -0,0 +1,45 @@
+// getMore on a tailable, awaitData cursor blocks until something is inserted into the capped
+// collection, or gives up after about 4 seconds
+
+t = db.capped_await_data;
+t.drop();
+db.createCollection( t.getName(), { capped: true, size: 4096 } );
+t.insert( { _id: 0 } );
+db.getLastError();
+
+function awaitDataMetrics() {
+    return db.serverStatus().metrics.cursor.awaitData;
+}
+
+function tail() {
+    return t.find().addOption( DBQuery.Option.tailable ).addOption( DBQuery.Option.awaitData );
+}
+
+// nothing inserted: the getMore times out and comes back empty
+var cursor = tail();
+assert.eq( 0, cursor.next()._id );
+var before = awaitDataMetrics();
+var start = new Date();
+assert( !cursor.hasNext() );
+var elapsed = new Date() - start;
+assert.gte( elapsed, 3000, "awaitData getMore returned early" );
+assert.gt( awaitDataMetrics().timeouts, before.timeouts );
+
+// an insert wakes the blocked getMore
+before = awaitDataMetrics();
+s = startParallelShell( 'sleep(1000); ' +
+                        'db.capped_await_data.insert( { _id: 1, at: new Date() } ); ' +
+                        'db.getLastError();' );
+var doc = null;
+for ( var i = 0; i < 10 && !doc; i++ ) {
+    if ( cursor.hasNext() )
+        doc = cursor.next();
+}
+var received = new Date();
+s();
+
+assert( doc, "tailable cursor never saw the insert" );
+assert.eq( 1, doc._id );
+assert.lt( received - doc.at, 500, "wake up on insert was slow" );
+assert.gt( awaitDataMetrics().wakeups, before.wakeups );
+assert.eq( 0, awaitDataMetrics().waiters );
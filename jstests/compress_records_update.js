@@ -0,0 +1,33 @@
+// Updates that could be made in place, like $inc, have to reach compressed records too
+
+t = db.compress_records_update;
+t.drop();
+assert.commandWorked( db.createCollection( t.getName(), { compressRecords: true } ) );
+t.ensureIndex( { x: 1 } );
+
+var s = new Array( 4001 ).join( "a" );
+t.insert( { _id: 1, n: 0, x: 1, s: s } );
+t.insert( { _id: 2, n: 0, x: 2 } );
+assert.isnull( db.getLastError() );
+
+for ( var i = 1; i <= 5; i++ ) {
+    t.update( { _id: 1 }, { $inc: { n: 1 } } );
+    t.update( { _id: 2 }, { $inc: { n: 1 } } );
+    assert.isnull( db.getLastError() );
+
+    var big = t.findOne( { _id: 1 } );
+    assert.eq( i, big.n );
+    assert.eq( s, big.s );
+    assert.eq( i, t.findOne( { _id: 2 } ).n );
+}
+
+// a no-op is still a no-op
+var res = db.runCommand( { update: t.getName(),
+                           updates: [ { q: { _id: 1 }, u: { $set: { n: 5 } } } ] } );
+assert.commandWorked( res );
+assert.eq( 1, res.n );
+assert.eq( 0, res.nModified );
+
+// the index still finds the updated document
+assert.eq( 5, t.find( { x: 1 } ).hint( { x: 1 } ).next().n );
+assert( t.validate( true ).valid );
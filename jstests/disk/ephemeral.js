@@ -0,0 +1,48 @@
+// Databases named in the ephemeralDatabases parameter live in memory only: they are listed by
+// listDatabases without taking space on disk, and can't be used in a replica set
+
+port = allocatePorts( 1 )[ 0 ];
+
+baseName = "jstests_disk_ephemeral";
+dbpath = MongoRunner.dataPath + baseName;
+ephemeralName = baseName + "_mem";
+
+m = startMongod( "--port", port, "--dbpath", dbpath, "--smallfiles",
+                 "--setParameter", "ephemeralDatabases=" + ephemeralName );
+
+m.getDB( baseName ).foo.insert( { a: 1 } );
+m.getDB( ephemeralName ).foo.insert( { a: 1 } );
+assert.isnull( m.getDB( ephemeralName ).getLastError() );
+assert( m.getDB( ephemeralName ).stats().ephemeral );
+
+var dbs = m.getDB( "admin" ).runCommand( { listDatabases: 1 } ).databases;
+var ephemeral = null;
+var onDisk = null;
+dbs.forEach( function( d ) {
+    if ( d.name == ephemeralName )
+        ephemeral = d;
+    if ( d.name == baseName )
+        onDisk = d;
+} );
+printjson( dbs );
+assert( ephemeral, "ephemeral database not listed" );
+assert( ephemeral.ephemeral );
+assert.eq( 0, ephemeral.sizeOnDisk );
+assert.gt( ephemeral.sizeInMemory, 0 );
+assert( !ephemeral.empty );
+assert( onDisk, "database on disk not listed" );
+assert( !onDisk.ephemeral );
+assert.gt( onDisk.sizeOnDisk, 0 );
+
+files = listFiles( dbpath );
+for ( i in files ) {
+    assert.eq( -1, files[ i ].baseName.indexOf( ephemeralName ), "file for ephemeral database" );
+}
+
+stopMongod( port );
+
+// a replica set member would come back without its ephemeral data after a restart
+assert.neq( 0, runMongoProgram( "mongod", "--port", port, "--dbpath", dbpath, "--smallfiles",
+                                "--replSet", baseName,
+                                "--setParameter", "ephemeralDatabases=" + ephemeralName ),
+            "mongod started with ephemeralDatabases and --replSet" );
@@ -0,0 +1,70 @@
+/* large group commits, whose intent data is copied into the journal buffer by several threads
+   (journalPrepThreads), and which can be prepped while the commit before them is still being
+   written.  runs mongod, kill -9's, recovers, checks every document.
+*/
+
+var testname = "prep_parallel";
+var step = 1;
+
+function log(str) {
+    print("\n" + testname + " step " + step++ + " " + (str || ""));
+}
+
+var path = MongoRunner.dataPath + testname + "dur";
+var nDocs = 120;
+
+function doc(i) {
+    var s = "" + i + "-";
+    while (s.length < 512 * 1024)
+        s += s;
+    return { _id: i, s: s };
+}
+
+function verify(conn) {
+    var coll = conn.getDB("test").foo;
+    assert.eq(nDocs, coll.count(), "count wrong");
+    for (var i = 0; i < nDocs; i += 7) {
+        assert.eq(doc(i).s, coll.findOne({ _id: i }).s, "doc " + i + " differs");
+    }
+}
+
+log("run mongod with --dur");
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                            "--durOptions", /*DurParanoid*/8,
+                            "--setParameter", "journalPrepThreads=4");
+var d = conn.getDB("test");
+assert.eq(4, d.adminCommand({ getParameter: 1, journalPrepThreads: 1 }).journalPrepThreads);
+
+log("work");
+// batches big enough that commits carry well over the parallel copy threshold, and that
+// early commits happen while the journal thread's commit is still writing
+for (var b = 0; b < nDocs; b += 20) {
+    var batch = [];
+    for (var i = b; i < b + 20; i++)
+        batch.push(doc(i));
+    d.foo.insert(batch);
+}
+d.foo.update({}, { $set: { x: 1 } }, false, true);
+var gle = d.runCommand({ getLastError: 1, j: true });
+assert.eq(null, gle.err, "j:true getLastError failed: " + tojson(gle));
+
+var dur = d.serverStatus().dur;
+printjson(dur);
+assert(dur.timeMs.prepLogBufferCopy !== undefined, "no prepLogBufferCopy timing");
+assert(dur.timeMs.journalWriteWait !== undefined, "no journalWriteWait timing");
+verify(conn);
+
+log("kill -9");
+stopMongod(30001, /*signal*/9);
+
+assert(listFiles(path + "/journal/").length > 0, "journal directory is unexpectantly empty after kill");
+
+log("restart mongod and recover");
+conn = startMongodNoReset("--port", 30002, "--dbpath", path, "--dur", "--smallfiles", "--durOptions", 8);
+verify(conn);
+assert.eq(nDocs, conn.getDB("test").foo.count({ x: 1 }), "update lost");
+
+log("stopping mongod 30002");
+stopMongod(30002);
+
+print(testname + " SUCCESS");
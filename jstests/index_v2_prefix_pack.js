@@ -0,0 +1,50 @@
+// A v:2 index bucket stores the key fields all its keys share once, and packing the bucket can
+// lengthen that prefix.  Deleting every key but those of one group leaves buckets whose prefix
+// grows on the next pack; the keys inserted afterwards share less of it and have to be stored
+// against the prefix the bucket ends up with.
+
+t = db.index_v2_prefix_pack;
+
+var a = new Array( 51 ).join( "p" );
+var pad = new Array( 301 ).join( "c" );
+
+[ 3, 5, 10, 20 ].forEach( function( groupSize ) {
+    t.drop();
+    t.ensureIndex( { a: 1, b: 1, c: 1 }, { v: 2 } );
+
+    var n = 2000;
+    for ( var i = 0; i < n; i++ ) {
+        t.insert( { a: a, b: Math.floor( i / groupSize ), c: pad + i } );
+    }
+    assert.isnull( db.getLastError() );
+
+    // keep only the even groups, so the buckets they are in share a longer prefix
+    t.remove( { b: { $mod: [ 2, 1 ] } } );
+    assert.isnull( db.getLastError() );
+
+    // then put keys from the odd groups back between them
+    for ( var i = 0; i < n; i++ ) {
+        var b = Math.floor( i / groupSize );
+        if ( b % 2 == 1 )
+            t.insert( { a: a, b: b, c: pad + "x" + i } );
+    }
+    assert.isnull( db.getLastError() );
+
+    var v = t.validate( true );
+    assert( v.valid, "groupSize " + groupSize + ": " + tojson( v ) );
+
+    var indexed = t.find( { a: a }, { _id: 0, a: 1, b: 1, c: 1 } )
+                   .hint( { a: 1, b: 1, c: 1 } ).toArray();
+    assert.eq( n, indexed.length, "groupSize " + groupSize );
+    for ( var j = 0; j < indexed.length; j++ ) {
+        var doc = indexed[ j ];
+        assert.eq( a, doc.a, "groupSize " + groupSize );
+        var i = parseInt( doc.c.substring( pad.length ).replace( "x", "" ) );
+        assert.eq( Math.floor( i / groupSize ), doc.b, "groupSize " + groupSize );
+        if ( j > 0 ) {
+            var prev = indexed[ j - 1 ];
+            assert( prev.b < doc.b || ( prev.b == doc.b && prev.c < doc.c ),
+                    "out of order: " + tojson( prev ) + " " + tojson( doc ) );
+        }
+    }
+} );
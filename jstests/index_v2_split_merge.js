@@ -0,0 +1,86 @@
+// Splits, merges and rebalances of v:2 index buckets.  The keys share a long leading field, so
+// every bucket carries a prefix; removing ranges of keys empties buckets enough that they are
+// merged with or balanced against a neighbour, which has to recompute the prefix of the result.
+
+t = db.index_v2_split_merge;
+
+var a = new Array( 101 ).join( "p" );
+var pad = new Array( 201 ).join( "c" );
+var n = 3000;
+
+function key( i ) {
+    return pad + ( 100000 + i );
+}
+
+function check( expected, msg ) {
+    var v = t.validate( true );
+    assert( v.valid, msg + ": " + tojson( v ) );
+    assert.eq( expected.length, v.keysPerIndex[ t.getFullName() + ".$a_1_b_1" ], msg );
+
+    var indexed = t.find( { a: a }, { _id: 0, b: 1 } ).hint( { a: 1, b: 1 } ).toArray();
+    assert.eq( expected.length, indexed.length, msg );
+    for ( var j = 0; j < indexed.length; j++ ) {
+        assert.eq( key( expected[ j ] ), indexed[ j ].b, msg + ": position " + j );
+    }
+}
+
+function remaining( keep ) {
+    var r = [];
+    for ( var i = 0; i < n; i++ ) {
+        if ( keep( i ) )
+            r.push( i );
+    }
+    return r;
+}
+
+[ "ascending", "descending", "interleaved" ].forEach( function( order ) {
+    t.drop();
+    t.ensureIndex( { a: 1, b: 1 }, { v: 2 } );
+    t.getIndexes().forEach( function( spec ) {
+        if ( spec.name == "a_1_b_1" )
+            assert.eq( 2, spec.v, tojson( spec ) );
+    } );
+
+    // fill the index in an order that splits buckets at the right end, the left end, and in
+    // the middle
+    for ( var j = 0; j < n; j++ ) {
+        var i = order == "ascending" ? j :
+                order == "descending" ? n - 1 - j :
+                ( j % 2 == 0 ? j / 2 : n - 1 - ( j - 1 ) / 2 );
+        t.insert( { _id: i, a: a, b: key( i ) } );
+    }
+    assert.isnull( db.getLastError() );
+    check( remaining( function( i ) { return true; } ), order + " after inserts" );
+
+    // a contiguous range empties whole buckets, which merge with their neighbours
+    t.remove( { _id: { $gte: 500, $lt: 1500 } } );
+    assert.isnull( db.getLastError() );
+    var inRange = function( i ) { return i < 500 || i >= 1500; };
+    check( remaining( inRange ), order + " after range remove" );
+
+    // thinning out what is left leaves buckets too light to stand alone but too full to merge,
+    // so keys move between siblings
+    t.remove( { _id: { $mod: [ 3, 1 ] } } );
+    assert.isnull( db.getLastError() );
+    var thinned = function( i ) { return inRange( i ) && i % 3 != 1; };
+    check( remaining( thinned ), order + " after thinning" );
+
+    // emptying one side of the tree rebalances the other side into it
+    t.remove( { _id: { $gte: 1500, $lt: 2900 } } );
+    assert.isnull( db.getLastError() );
+    var lopsided = function( i ) { return thinned( i ) && ( i < 1500 || i >= 2900 ); };
+    check( remaining( lopsided ), order + " after one-sided remove" );
+
+    // refill the emptied ranges, splitting the merged buckets again
+    for ( var i = 500; i < 2900; i++ ) {
+        if ( !lopsided( i ) )
+            t.insert( { _id: i, a: a, b: key( i ) } );
+    }
+    assert.isnull( db.getLastError() );
+    check( remaining( function( i ) { return true; } ), order + " after refill" );
+
+    // and remove everything, which collapses the tree down to its root
+    t.remove( {} );
+    assert.isnull( db.getLastError() );
+    check( [], order + " after removing everything" );
+} );
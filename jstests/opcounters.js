@@ -22,6 +22,12 @@ var opCounters;
 
 t.drop();
 
+// Every counter is a number.
+opCounters = db.serverStatus().opcounters;
+[ "insert", "query", "update", "delete", "getmore", "command" ].forEach( function( f ) {
+    assert.eq( "number", typeof opCounters[ f ], f + ": " + tojson( opCounters ) );
+} );
+
 // Single insert, no error.
 opCounters = db.serverStatus().opcounters;
 t.insert({_id:0});
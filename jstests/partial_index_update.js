@@ -0,0 +1,39 @@
+// An update that changes only a field the filter of a partial index looks at, not any key, still
+// moves the document into or out of the index
+
+t = db.partial_index_update;
+t.drop();
+
+t.ensureIndex( { x: 1 }, { partialFilterExpression: { priority: { $gt: 5 } } } );
+assert.isnull( db.getLastError() );
+
+t.insert( { _id: 1, x: 1, priority: 5 } );
+t.insert( { _id: 2, x: 2, priority: 9 } );
+
+function indexed() {
+    return t.find( { x: { $gte: 0 }, priority: { $gt: 5 } }, { _id: 1 } )
+            .hint( { x: 1 } ).sort( { x: 1 } ).toArray().map( function( d ) { return d._id; } );
+}
+
+function check( expected ) {
+    assert.eq( expected, indexed() );
+    var v = t.validate( true );
+    assert( v.valid, tojson( v ) );
+}
+
+check( [ 2 ] );
+
+// into the index
+t.update( { _id: 1 }, { $inc: { priority: 1 } } );
+assert.isnull( db.getLastError() );
+check( [ 1, 2 ] );
+
+// out of it
+t.update( { _id: 2 }, { $inc: { priority: -4 } } );
+assert.isnull( db.getLastError() );
+check( [ 1 ] );
+
+// a change to neither the key nor the filter leaves the index alone
+t.update( { _id: 1 }, { $set: { other: 1 } } );
+assert.isnull( db.getLastError() );
+check( [ 1 ] );
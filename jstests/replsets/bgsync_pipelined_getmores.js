@@ -0,0 +1,45 @@
+/**
+ * A secondary catching up on a long run of big oplog entries gets full-sized batches, and asks
+ * for each next batch before it has queued the one it just got, so the fetches overlap.
+ */
+var rt = new ReplSetTest( { name : "bgsync_pipelined_getmores" , nodes: 2, oplogSize: 100 } );
+rt.startSet();
+rt.initiate();
+rt.awaitSecondaryNodes();
+
+var primary = rt.getPrimary();
+var secondary = rt.getSecondary();
+var testDB = primary.getDB( "test" );
+
+testDB.a.insert( {} );
+testDB.getLastError( 2 );
+
+// let the secondary fall behind by a few batches' worth
+rt.stop( secondary );
+
+var filler = new Array( 10 * 1024 ).join( "x" );
+var n = 3000;
+for ( var i = 0; i < n; i++ ) {
+    testDB.a.insert( { _id: i, s: filler } );
+}
+assert.isnull( testDB.getLastError() );
+
+rt.restart( secondary );
+rt.awaitSecondaryNodes();
+secondary = rt.getSecondary();
+testDB.getLastError( 2, 5 * 60 * 1000 );
+
+var repl = secondary.getDB( "test" ).serverStatus().metrics.repl;
+printjson( repl );
+assert.gt( repl.network.pipelinedGetmores, 0, "no getmore was sent ahead of queueing" );
+assert.gt( repl.network.getmores.num, 1, "catch up took a single batch" );
+assert( repl.buffer.fetcherWaits.num >= 0, "fetcherWaits missing" );
+assert( repl.buffer.applierWaits.num >= 0, "applierWaits missing" );
+
+// and every op in the pipelined batches was applied, once
+secondary.setSlaveOk();
+var coll = secondary.getDB( "test" ).a;
+assert.eq( n + 1, coll.count() );
+assert.eq( n, coll.find( { _id: { $gte: 0, $lt: n } } ).itcount() );
+
+rt.stopSet();
@@ -55,6 +55,17 @@ assert( cur.next() , "T4" );
 sleep( 24000 )
 assert.throws( function(){ cur.next(); } , null , "T5" )
 after = db.runCommand( { "cursorInfo" : 1 , "setTimeout" : 10000 } ) // 10 seconds
+
+// the per-stripe counts add up to the totals
+var stripeSharded = 0;
+var stripeRefs = 0;
+after.stripes.forEach( function( stripe ) {
+    stripeSharded += stripe.sharded;
+    stripeRefs += stripe.refs;
+    assert.lte( stripe.contended, stripe.acquisitions, "contended" );
+} );
+assert.eq( after.sharded, stripeSharded, "stripe sharded" );
+assert.eq( after.refs, stripeRefs, "stripe refs" );
 gc(); gc()
 
 s.stop()
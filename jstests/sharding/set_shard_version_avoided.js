@@ -0,0 +1,40 @@
+// Tests that mongos doesn't resend setShardVersion to a shard whose version didn't change when
+// the chunk manager is reloaded for a split on another shard
+
+var st = new ShardingTest( { shards : 2, mongos : 1 } )
+// Stop balancer, it'll interfere
+st.stopBalancer()
+
+var config = st.s.getDB( "config" )
+var admin = st.s.getDB( "admin" )
+var coll = st.s.getCollection( "foo.bar" )
+
+admin.runCommand({ enableSharding : coll.getDB() + "" })
+admin.runCommand({ shardCollection : coll + "", key : { _id : 1 } })
+
+var primary = config.databases.findOne({ _id : coll.getDB() + "" }).primary
+var notPrimary = null
+config.shards.find().forEach( function( doc ){ if( doc._id != primary ) notPrimary = doc._id } )
+
+// Two chunks, one on each shard
+assert( admin.runCommand({ split : coll + "", middle : { _id : 0 } }).ok )
+assert( admin.runCommand({ moveChunk : coll + "", find : { _id : 0 }, to : notPrimary }).ok )
+
+for( var i = -100; i < 100; i++ ) coll.insert({ _id : i })
+assert.eq( null, coll.getDB().getLastError() )
+assert.eq( 200, coll.find().itcount() )
+
+var avoided = function(){
+    return st.s.getDB( "admin" ).serverStatus().metrics.sharding.setShardVersion.avoided
+}
+var before = avoided()
+
+// Only the primary's version changes, connections to the other shard keep theirs
+assert( admin.runCommand({ split : coll + "", middle : { _id : -50 } }).ok )
+assert.eq( 200, coll.find().itcount() )
+assert.eq( 100, coll.find({ _id : { $gte : 0 } }).itcount() )
+
+printjson( st.s.getDB( "admin" ).serverStatus().metrics.sharding )
+assert.gt( avoided(), before )
+
+st.stop()
@@ -0,0 +1,86 @@
+// counter.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects
+*    for all of the code used other than as permitted herein. If you modify
+*    file(s) with this exception, you may extend this exception to your
+*    version of the file(s), but you are not obligated to do so. If you do not
+*    wish to do so, delete this exception statement from your version. If you
+*    delete this exception statement from all source files in the program,
+*    then also delete it in the license file.
+*/
+
+#include "mongo/base/counter.h"
+
+#if !defined(MONGO_HAVE___THREAD) && !defined(MONGO_HAVE___DECLSPEC_THREAD)
+#if defined(_WIN32)
+#include "mongo/platform/windows_basic.h"
+#else
+#include <pthread.h>
+#endif
+#include "third_party/murmurhash3/MurmurHash3.h"
+#endif
+
+namespace mongo {
+
+    namespace {
+
+#if defined(MONGO_HAVE___THREAD) || defined(MONGO_HAVE___DECLSPEC_THREAD)
+
+        AtomicUInt32 nextStripe;
+
+#if defined(MONGO_HAVE___THREAD)
+        __thread
+#else
+        __declspec( thread )
+#endif
+        size_t myStripe; // stripe + 1, 0 until assigned
+
+        inline size_t getStripe() {
+            if ( !myStripe )
+                myStripe = ( nextStripe.fetchAndAdd(1) % StripedCounter64::kStripes ) + 1;
+            return myStripe - 1;
+        }
+
+#else
+
+        // Without cheap thread locals, hash the calling thread's id: stable for the life of the
+        // thread, though threads spread over the stripes less evenly than round robin.
+        inline size_t getStripe() {
+#if defined(_WIN32)
+            DWORD id = GetCurrentThreadId();
+#else
+            pthread_t id = pthread_self();
+#endif
+            uint32_t h;
+            MurmurHash3_x86_32( &id, sizeof( id ), 0, &h );
+            return h % StripedCounter64::kStripes;
+        }
+
+#endif
+
+    } // namespace
+
+    size_t StripedCounter64::threadStripe() {
+        return getStripe();
+    }
+
+} // namespace mongo
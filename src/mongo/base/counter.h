@@ -30,6 +30,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include "mongo/platform/atomic_word.h"
 #include "mongo/platform/cstdint.h"
 
@@ -57,4 +59,57 @@ namespace mongo {
     private:
         AtomicInt64 _counter;
     };
+
+    /**
+     * A 64bit counter for paths that every connection thread hits on every operation.
+     *
+     * Counter64 keeps its value in one word, so cores incrementing it concurrently keep
+     * stealing the same cache line from each other.  StripedCounter64 spreads increments over
+     * kStripes slots, each on its own cache line, with every thread always using the same slot.
+     * get() adds the slots up, so reading is comparatively slow and only meant for reporting.
+     *
+     * Values read while other threads are incrementing are not a consistent snapshot, but
+     * every completed increment is reflected.
+     */
+    class StripedCounter64 {
+    public:
+        /** Atomically increment the calling thread's stripe. */
+        void increment( uint64_t n = 1 ) { _stripes[threadStripe()].value.addAndFetch(n); }
+
+        /** Atomically decrement the calling thread's stripe. */
+        void decrement( uint64_t n = 1 ) { _stripes[threadStripe()].value.subtractAndFetch(n); }
+
+        /** Return the current value, summed across stripes */
+        long long get() const {
+            long long total = 0;
+            for ( size_t i = 0; i < kStripes; i++ )
+                total += _stripes[i].value.load();
+            return total;
+        }
+
+        operator long long() const { return get(); }
+
+        /** Zero the counter.  Increments racing with this may or may not be lost. */
+        void reset() {
+            for ( size_t i = 0; i < kStripes; i++ )
+                _stripes[i].value.store(0);
+        }
+
+        static const size_t kStripes = 64;
+
+        /**
+         * The stripe, in [0, kStripes), used by the calling thread.  Threads are assigned
+         * stripes round robin the first time they ask.  Exposed for other per thread
+         * sharded structures.
+         */
+        static size_t threadStripe();
+
+    private:
+        struct Stripe {
+            AtomicInt64 value;
+            char pad[64 - sizeof(AtomicInt64)]; // one cache line each
+        };
+
+        Stripe _stripes[kStripes];
+    };
 }
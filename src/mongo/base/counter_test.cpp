@@ -42,5 +42,24 @@ namespace mongo {
             ASSERT_EQUALS(static_cast<long long>(c), 0);
         }
 
+        TEST( StripedCounterTest, Test1 ) {
+            StripedCounter64 c;
+            ASSERT_EQUALS(c.get(), 0);
+            c.increment();
+            ASSERT_EQUALS(c.get(), 1);
+            c.increment(10);
+            ASSERT_EQUALS(c.get(), 11);
+            c.decrement(12);
+            ASSERT_EQUALS(static_cast<long long>(c), -1);
+            c.reset();
+            ASSERT_EQUALS(c.get(), 0);
+        }
+
+        TEST( StripedCounterTest, ThreadStripeIsStable ) {
+            size_t stripe = StripedCounter64::threadStripe();
+            ASSERT_LESS_THAN(stripe, StripedCounter64::kStripes);
+            ASSERT_EQUALS(stripe, StripedCounter64::threadStripe());
+        }
+
     }  // namespace
 }  // namespace mongo
@@ -16,7 +16,7 @@
  */
 
 #include <cstring>
-#include <deque>
+#include <vector>
 
 #include "mongo/bson/bson_validate.h"
 #include "mongo/bson/oid.h"
@@ -59,10 +59,25 @@ namespace mongo {
             }
 
             Status readCString( StringData* out ) {
-                const void* x = memchr( _buffer + _position, 0, _maxLength - _position );
+                const char* start = _buffer + _position;
+                const uint64_t available = _maxLength - _position;
+
+                // Field names are mostly a few bytes long, too short for memchr() to pay for
+                // its call and setup, so look at the first few bytes inline.
+                const uint64_t shortScan = available < 16 ? available : 16;
+                const char* x = NULL;
+                for ( uint64_t i = 0; i < shortScan; i++ ) {
+                    if ( start[i] == 0 ) {
+                        x = start + i;
+                        break;
+                    }
+                }
+                if ( !x && available > shortScan )
+                    x = static_cast<const char*>( memchr( start + shortScan, 0,
+                                                          available - shortScan ) );
                 if ( !x )
                     return makeError("no end of c-string", _idElem);
-                uint64_t len = static_cast<uint64_t>( static_cast<const char*>(x) - ( _buffer + _position ) );
+                uint64_t len = static_cast<uint64_t>( x - start );
 
                 StringData data( _buffer + _position, len );
                 _position += len + 1;
@@ -122,118 +137,145 @@ namespace mongo {
             BSONElement _idElem;
         };
 
-        struct ValidationState {
-            enum State {
-                BeginObj = 1,
-                WithinObj,
-                EndObj,
-                BeginCodeWScope,
-                EndCodeWScope,
-                Done
-            };
+        /**
+         * How each type is validated, looked up by type byte rather than switched on since this
+         * runs for every element of every document received with objcheck on.
+         */
+        enum TypeClass {
+            InvalidType = 0,
+            EndOfObject,
+            FixedSize,          // TypeInfo::fixedSize bytes of payload
+            StringType,         // int32 length, bytes, NUL
+            DBRefType,
+            RegExType,
+            BinDataType,
+            CodeWScopeType,
+            ObjectType
         };
 
-        class ValidationObjectFrame {
-        public:
-            int startPosition() const { return _startPosition & ~(1 << 31); }
-            bool isCodeWithScope() const { return _startPosition & (1 << 31); }
+        struct TypeInfo {
+            unsigned char typeClass;
+            unsigned char fixedSize;
+        };
 
-            void setStartPosition(int pos) {
-                _startPosition = (_startPosition & (1 << 31)) | (pos & ~(1 << 31));
-            }
-            void setIsCodeWithScope(bool isCodeWithScope) {
-                if (isCodeWithScope) {
-                    _startPosition |= 1 << 31;
-                }
-                else {
-                    _startPosition &= ~(1 << 31);
-                }
-            }
+        // indexed by type byte, EOO through JSTypeMax.  MinKey and MaxKey are checked separately.
+        const TypeInfo typeInfo[] = {
+            { EndOfObject, 0 },     // EOO
+            { FixedSize, 8 },       // NumberDouble
+            { StringType, 0 },      // String
+            { ObjectType, 0 },      // Object
+            { ObjectType, 0 },      // Array
+            { BinDataType, 0 },     // BinData
+            { FixedSize, 0 },       // Undefined
+            { FixedSize, 12 },      // jstOID
+            { FixedSize, 1 },       // Bool
+            { FixedSize, 8 },       // Date
+            { FixedSize, 0 },       // jstNULL
+            { RegExType, 0 },       // RegEx
+            { DBRefType, 0 },       // DBRef
+            { StringType, 0 },      // Code
+            { StringType, 0 },      // Symbol
+            { CodeWScopeType, 0 },  // CodeWScope
+            { FixedSize, 4 },       // NumberInt
+            { FixedSize, 8 },       // Timestamp
+            { FixedSize, 8 },       // NumberLong
+        };
 
+        inline TypeInfo getTypeInfo( signed char type ) {
+            if ( type >= 0 && type <= JSTypeMax )
+                return typeInfo[static_cast<int>(type)];
+            TypeInfo info = { InvalidType, 0 };
+            if ( type == MinKey || type == MaxKey )
+                info.typeClass = FixedSize;
+            return info;
+        }
+
+        struct ValidationObjectFrame {
+            uint64_t startPosition;
             int expectedSize;
-        private:
-            int _startPosition;
+            bool isCodeWithScope;
         };
 
         /**
-         * WARNING: only pass in a non-EOO idElem if it has been fully validated already!
+         * Stack of the objects being validated.  Nearly all documents are shallow, so the first
+         * levels live inline and validating doesn't allocate.
          */
-        Status validateElementInfo(Buffer* buffer,
-                                   ValidationState::State* nextState,
-                                   BSONElement idElem) {
-            Status status = Status::OK();
+        class FrameStack {
+        public:
+            FrameStack() : _size( 0 ) { }
 
-            signed char type;
-            if ( !buffer->readNumber<signed char>(&type) )
-                return makeError("invalid bson", idElem);
+            ValidationObjectFrame& push( uint64_t startPosition, bool isCodeWithScope ) {
+                ValidationObjectFrame* frame;
+                if ( _size < kInlineFrames ) {
+                    frame = &_inline[_size];
+                }
+                else {
+                    _overflow.push_back( ValidationObjectFrame() );
+                    frame = &_overflow.back();
+                }
+                _size++;
+                frame->startPosition = startPosition;
+                frame->isCodeWithScope = isCodeWithScope;
+                return *frame;
+            }
 
-            if ( type == EOO ) {
-                *nextState = ValidationState::EndObj;
-                return Status::OK();
+            void pop() {
+                _size--;
+                if ( _size >= kInlineFrames )
+                    _overflow.pop_back();
             }
 
-            StringData name;
-            status = buffer->readCString( &name );
-            if ( !status.isOK() )
-                return status;
+            ValidationObjectFrame& back() {
+                return _size > kInlineFrames ? _overflow.back() : _inline[_size - 1];
+            }
 
-            switch ( type ) {
-            case MinKey:
-            case MaxKey:
-            case jstNULL:
-            case Undefined:
-                return Status::OK();
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
 
-            case jstOID:
-                if ( !buffer->skip( sizeof(OID) ) )
-                    return makeError("invalid bson", idElem);
-                return Status::OK();
+        private:
+            static const size_t kInlineFrames = 32;
+            ValidationObjectFrame _inline[kInlineFrames];
+            std::vector<ValidationObjectFrame> _overflow;
+            size_t _size;
+        };
 
-            case NumberInt:
-                if ( !buffer->skip( sizeof(int32_t) ) )
-                    return makeError("invalid bson", idElem);
-                return Status::OK();
+        /**
+         * Reads the size of an object starting at the current position and pushes its frame.
+         */
+        Status beginObject( Buffer* buffer, FrameStack* frames, BSONElement idElem ) {
+            ValidationObjectFrame& frame = frames->push( buffer->position(), false );
+            if ( !buffer->readNumber<int>( &frame.expectedSize ) )
+                return makeError("bson size is larger than buffer size", idElem);
+            return Status::OK();
+        }
 
-            case Bool:
-                if ( !buffer->skip( sizeof(int8_t) ) )
-                    return makeError("invalid bson", idElem);
-                return Status::OK();
+        /**
+         * WARNING: only pass in a non-EOO idElem if it has been fully validated already!
+         */
+        Status validateElementValue( Buffer* buffer,
+                                     FrameStack* frames,
+                                     TypeInfo info,
+                                     BSONElement idElem ) {
+            Status status = Status::OK();
 
+            switch ( info.typeClass ) {
+            case StringType:
+                return buffer->readUTF8String( NULL );
 
-            case NumberDouble:
-            case NumberLong:
-            case Timestamp:
-            case Date:
-                if ( !buffer->skip( sizeof(int64_t) ) )
-                    return makeError("invalid bson", idElem);
-                return Status::OK();
-
-            case DBRef:
+            case DBRefType:
                 status = buffer->readUTF8String( NULL );
                 if ( !status.isOK() )
                     return status;
                 buffer->skip( sizeof(OID) );
                 return Status::OK();
 
-            case RegEx:
-                status = buffer->readCString( NULL );
-                if ( !status.isOK() )
-                    return status;
+            case RegExType:
                 status = buffer->readCString( NULL );
                 if ( !status.isOK() )
                     return status;
+                return buffer->readCString( NULL );
 
-                return Status::OK();
-
-            case Code:
-            case Symbol:
-            case String:
-                status = buffer->readUTF8String( NULL );
-                if ( !status.isOK() )
-                    return status;
-                return Status::OK();
-
-            case BinData: {
+            case BinDataType: {
                 int sz;
                 if ( !buffer->readNumber<int>( &sz ) )
                     return makeError("invalid bson", idElem);
@@ -241,13 +283,19 @@ namespace mongo {
                     return makeError("invalid bson", idElem);
                 return Status::OK();
             }
-            case CodeWScope:
-                *nextState = ValidationState::BeginCodeWScope;
-                return Status::OK();
-            case Object:
-            case Array:
-                *nextState = ValidationState::BeginObj;
-                return Status::OK();
+
+            case CodeWScopeType: {
+                ValidationObjectFrame& frame = frames->push( buffer->position(), true );
+                if ( !buffer->readNumber<int>( &frame.expectedSize ) )
+                    return makeError("invalid bson CodeWScope size", idElem);
+                status = buffer->readUTF8String( NULL );
+                if ( !status.isOK() )
+                    return status;
+                return beginObject( buffer, frames, idElem );
+            }
+
+            case ObjectType:
+                return beginObject( buffer, frames, idElem );
 
             default:
                 return makeError("invalid bson type", idElem);
@@ -255,97 +303,72 @@ namespace mongo {
         }
 
         Status validateBSONIterative(Buffer* buffer) {
-            std::deque<ValidationObjectFrame> frames;
-            ValidationObjectFrame* curr = NULL;
-            ValidationState::State state = ValidationState::BeginObj;
+            FrameStack frames;
 
             uint64_t idElemStartPos = 0; // will become idElem once validated
             BSONElement idElem;
 
-            while (state != ValidationState::Done) {
-                switch (state) {
-                case ValidationState::BeginObj:
-                    frames.push_back(ValidationObjectFrame());
-                    curr = &frames.back();
-                    curr->setStartPosition(buffer->position());
-                    curr->setIsCodeWithScope(false);
-                    if (!buffer->readNumber<int>(&curr->expectedSize)) {
-                        return makeError("bson size is larger than buffer size", idElem);
-                    }
-                    state = ValidationState::WithinObj;
-                    // fall through
-                case ValidationState::WithinObj: {
-                    const bool atTopLevel = frames.size() == 1;
-                    // check if we've finished validating idElem and are at start of next element.
-                    if (atTopLevel && idElemStartPos) {
-                        idElem = BSONElement(buffer->getBasePtr() + idElemStartPos);
-                        buffer->setIdElem(idElem);
-                        idElemStartPos = 0;
-                    }
+            Status status = beginObject( buffer, &frames, idElem );
+            if ( !status.isOK() )
+                return status;
 
-                    const uint64_t elemStartPos = buffer->position();
-                    ValidationState::State nextState = state;
-                    Status status = validateElementInfo(buffer, &nextState, idElem);
-                    if (!status.isOK())
-                        return status;
+            while ( !frames.empty() ) {
+                const bool atTopLevel = frames.size() == 1;
+                // check if we've finished validating idElem and are at start of next element.
+                if (atTopLevel && idElemStartPos) {
+                    idElem = BSONElement(buffer->getBasePtr() + idElemStartPos);
+                    buffer->setIdElem(idElem);
+                    idElemStartPos = 0;
+                }
 
-                    // we've already validated that fieldname is safe to access as long as we aren't
-                    // at the end of the object, since EOO doesn't have a fieldname.
-                    if (nextState != ValidationState::EndObj && idElem.eoo() && atTopLevel) {
-                        if (strcmp(buffer->getBasePtr() + elemStartPos + 1/*type*/, "_id") == 0) {
-                            idElemStartPos = elemStartPos;
-                        }
-                    }
+                const uint64_t elemStartPos = buffer->position();
 
-                    state = nextState;
-                    break;
-                }
-                case ValidationState::EndObj: {
-                    int actualLength = buffer->position() - curr->startPosition();
+                signed char type;
+                if ( !buffer->readNumber<signed char>(&type) )
+                    return makeError("invalid bson", idElem);
+
+                const TypeInfo info = getTypeInfo( type );
+
+                if ( info.typeClass == EndOfObject ) {
+                    ValidationObjectFrame* curr = &frames.back();
+                    int actualLength = buffer->position() - curr->startPosition;
                     if ( actualLength != curr->expectedSize ) {
                         return makeError("bson length doesn't match what we found", idElem);
                     }
-                    frames.pop_back();
-                    if (frames.empty()) {
-                        state = ValidationState::Done;
-                    }
-                    else {
+                    frames.pop();
+
+                    if ( !frames.empty() && frames.back().isCodeWithScope ) {
                         curr = &frames.back();
-                        if (curr->isCodeWithScope())
-                            state = ValidationState::EndCodeWScope;
-                        else
-                            state = ValidationState::WithinObj;
+                        actualLength = buffer->position() - curr->startPosition;
+                        if ( actualLength != curr->expectedSize ) {
+                            return makeError("bson length for CodeWScope doesn't match what we found",
+                                             idElem);
+                        }
+                        frames.pop();
+                        if ( frames.empty() )
+                            return makeError("unnested CodeWScope", idElem);
                     }
-                    break;
+                    continue;
+                }
+
+                StringData name;
+                status = buffer->readCString( &name );
+                if ( !status.isOK() )
+                    return status;
+
+                if ( info.typeClass == FixedSize ) {
+                    // the common case, so kept out of validateElementValue()
+                    if ( info.fixedSize && !buffer->skip( info.fixedSize ) )
+                        return makeError("invalid bson", idElem);
                 }
-                case ValidationState::BeginCodeWScope: {
-                    frames.push_back(ValidationObjectFrame());
-                    curr = &frames.back();
-                    curr->setStartPosition(buffer->position());
-                    curr->setIsCodeWithScope(true);
-                    if ( !buffer->readNumber<int>( &curr->expectedSize ) )
-                        return makeError("invalid bson CodeWScope size", idElem);
-                    Status status = buffer->readUTF8String( NULL );
+                else {
+                    status = validateElementValue( buffer, &frames, info, idElem );
                     if ( !status.isOK() )
                         return status;
-                    state = ValidationState::BeginObj;
-                    break;
                 }
-                case ValidationState::EndCodeWScope: {
-                    int actualLength = buffer->position() - curr->startPosition();
-                    if ( actualLength != curr->expectedSize ) {
-                        return makeError("bson length for CodeWScope doesn't match what we found",
-                                         idElem);
-                    }
-                    frames.pop_back();
-                    if (frames.empty())
-                        return makeError("unnested CodeWScope", idElem);
-                    curr = &frames.back();
-                    state = ValidationState::WithinObj;
-                    break;
-                }
-                case ValidationState::Done:
-                    break;
+
+                if ( atTopLevel && idElem.eoo() && name == "_id" ) {
+                    idElemStartPos = elemStartPos;
                 }
             }
 
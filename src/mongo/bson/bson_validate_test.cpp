@@ -273,4 +273,74 @@ namespace {
         ASSERT_NOT_OK(status);
         ASSERT_EQUALS(status.reason(), "not null terminated string in object with unknown _id");
     }
+
+    TEST(BSONValidateFast, DeeplyNested) {
+        // deeper than the frames kept inline by the validator, alternating objects and arrays
+        BSONObj x = BSON( "x" << 1 );
+        for ( int i = 0; i < 100; i++ ) {
+            if ( i % 2 )
+                x = BSON( "a" << BSON_ARRAY( x ) );
+            else
+                x = BSON( "a" << x );
+        }
+        ASSERT_OK( validateBSON( x.objdata(), x.objsize() ) );
+        ASSERT_NOT_OK( validateBSON( x.objdata(), x.objsize() - 1 ) );
+
+        BSONObj mine = x.copy();
+        char* data = const_cast<char*>( mine.objdata() );
+        data[ mine.objsize() - 2 ] = NumberDouble; // the EOO closing the last array
+        ASSERT_NOT_OK( validateBSON( mine.objdata(), mine.objsize() ) );
+    }
+
+    TEST(BSONValidateFast, FieldNameLengths) {
+        // field names on both sides of the inline scan for the terminator
+        for ( int len = 1; len < 40; len++ ) {
+            std::string name( len, 'f' );
+            BSONObj x = BSON( name << 1 << "_id" << 2 << name + "x" << "str" );
+            ASSERT_OK( validateBSON( x.objdata(), x.objsize() ) );
+
+            // drop the final EOO and the terminators after it can't be found
+            BufBuilder bb;
+            bb.appendNum( 0 );
+            bb.appendChar( NumberInt );
+            bb.appendStr( name, /*withNUL*/false );
+            *reinterpret_cast<int*>( bb.buf() ) = bb.len();
+            ASSERT_NOT_OK( validateBSON( bb.buf(), bb.len() ) );
+        }
+    }
+
+    TEST(BSONValidateFast, CodeWScope) {
+        BSONObjBuilder b;
+        b.appendCodeWScope( "c", "function() { return x; }", BSON( "x" << 1 << "y" << BSON( "z" << 2 ) ) );
+        b.append( "after", 1 );
+        BSONObj x = b.obj();
+        ASSERT_OK( validateBSON( x.objdata(), x.objsize() ) );
+
+        // every truncation is invalid
+        for ( int len = 5; len < x.objsize(); len++ ) {
+            ASSERT_NOT_OK( validateBSON( x.objdata(), len ) );
+        }
+    }
+
+    TEST(BSONValidateFast, MinMaxKey) {
+        BSONObjBuilder b;
+        b.appendMinKey( "min" );
+        b.appendMaxKey( "max" );
+        b.append( "_id" , 3 );
+        BSONObj x = b.obj();
+        ASSERT_OK( validateBSON( x.objdata(), x.objsize() ) );
+    }
+
+    TEST(BSONValidateFast, InvalidType) {
+        BufBuilder bb;
+        BSONObjBuilder ob(bb);
+        ob.append("_id", 1);
+        bb.appendChar(JSTypeMax + 1);
+        bb.appendStr("bad", /*withNUL*/true);
+        const BSONObj x = ob.done();
+        const Status status = validateBSON(x.objdata(), x.objsize());
+        ASSERT_NOT_OK(status);
+        ASSERT_EQUALS(status.reason(), "invalid bson type in object with _id: 1");
+    }
 }
+
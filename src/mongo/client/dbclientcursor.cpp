@@ -158,6 +158,32 @@ namespace mongo {
         }
     }
 
+    void DBClientCursor::sendMore() {
+        verify( cursorId );
+        verify( !haveLimit );
+        verify( _client );
+
+        BufBuilder b;
+        b.appendNum(opts);
+        b.appendStr(ns);
+        b.appendNum(nextBatchSize());
+        b.appendNum(cursorId);
+
+        Message toSend;
+        toSend.setData(dbGetMore, b.buf(), b.len());
+        _client->say( toSend );
+    }
+
+    void DBClientCursor::receiveMore() {
+        verify( batch.pos == batch.nReturned && _putBack.empty() );
+        auto_ptr<Message> response(new Message());
+        if (!_client->recv(*response)) {
+            uasserted(17391, "recv failed while receiving pipelined getMore");
+        }
+        batch.m = response;
+        dataReceived();
+    }
+
     /** with QueryOption_Exhaust, the server just blasts data at us (marked at end with cursorid==0). */
     void DBClientCursor::exhaustReceiveMore() {
         verify( cursorId && batch.pos == batch.nReturned );
@@ -58,6 +58,15 @@ namespace mongo {
         int objsLeftInBatch() const { _assertIfNull(); return _putBack.size() + batch.nReturned - batch.pos; }
         bool moreInCurrentBatch() { return objsLeftInBatch() > 0; }
 
+        /**
+         * more() split in two so a getMore can be in flight while the current batch is being
+         * processed.  sendMore() issues the getMore for the next batch; receiveMore() reads its
+         * reply and may only be called once the current batch has been consumed.  Nothing else
+         * may be sent on the connection in between.  Not for use with a limit.
+         */
+        void sendMore();
+        void receiveMore();
+
         /** next
            @return next object in the result cursor.
            on an error at the remote server, you will get back:
@@ -30,15 +30,17 @@
 #endif
 
 #include "mongo/client/dbclientcursor.h"
-
-#ifndef MIN
-#define MIN(a,b) ( (a) < (b) ? (a) : (b) )
-#endif
+#include "mongo/util/md5.hpp"
 
 
 namespace mongo {
 
     const unsigned DEFAULT_CHUNK_SIZE = 256 * 1024;
+    const unsigned DEFAULT_PIPELINE_DEPTH = 16;
+
+    // An insert message holding more than this is sent even if it has fewer than
+    // getPipelineDepth() chunks, to stay well under the maximum message size.
+    const size_t MAX_CHUNK_BATCH_BYTES = 16 * 1024 * 1024;
 
     GridFSChunk::GridFSChunk( BSONObj o ) {
         _data = o;
@@ -57,6 +59,7 @@ namespace mongo {
         _filesNS = dbName + "." + prefix + ".files";
         _chunksNS = dbName + "." + prefix + ".chunks";
         _chunkSize = DEFAULT_CHUNK_SIZE;
+        _pipelineDepth = DEFAULT_PIPELINE_DEPTH;
 
         client.ensureIndex( _filesNS , BSON( "filename" << 1 ) );
         client.ensureIndex( _chunksNS , BSON( "files_id" << 1 << "n" << 1 ) , /*unique=*/true );
@@ -75,24 +78,19 @@ namespace mongo {
         return _chunkSize;
     }
 
-    BSONObj GridFS::storeFile( const char* data , size_t length , const string& remoteName , const string& contentType) {
-        char const * const end = data + length;
-
-        OID id;
-        id.init();
-        BSONObj idObj = BSON("_id" << id);
-
-        int chunkNumber = 0;
-        while (data < end) {
-            int chunkLen = MIN(_chunkSize, (unsigned)(end-data));
-            GridFSChunk c(idObj, chunkNumber, data, chunkLen);
-            _client.insert( _chunksNS.c_str() , c._data );
+    void GridFS::setPipelineDepth(unsigned int depth) {
+        massert( 17402 , "invalid pipeline depth is specified", (depth != 0 ));
+        _pipelineDepth = depth;
+    }
 
-            chunkNumber++;
-            data += chunkLen;
-        }
+    unsigned int GridFS::getPipelineDepth() const {
+        return _pipelineDepth;
+    }
 
-        return insertFile(remoteName, id, length, contentType);
+    BSONObj GridFS::storeFile( const char* data , size_t length , const string& remoteName , const string& contentType) {
+        GridFileBuilder builder( this );
+        builder.appendChunk( data , length );
+        return builder.buildFile( remoteName , contentType );
     }
 
 
@@ -106,40 +104,26 @@ namespace mongo {
             fd = fopen( fileName.c_str() , "rb" );
         uassert( 10013 , "error opening file", fd);
 
-        OID id;
-        id.init();
-        BSONObj idObj = BSON("_id" << id);
-
-        int chunkNumber = 0;
-        gridfs_offset length = 0;
-        while (!feof(fd)) {
-            //boost::scoped_array<char>buf (new char[_chunkSize+1]);
-            char * buf = new char[_chunkSize+1];
-            char* bufPos = buf;//.get();
-            unsigned int chunkLen = 0; // how much in the chunk now
-            while(chunkLen != _chunkSize && !feof(fd)) {
-                int readLen = fread(bufPos, 1, _chunkSize - chunkLen, fd);
-                chunkLen += readLen;
-                bufPos += readLen;
-
-                verify(chunkLen <= _chunkSize);
+        GridFileBuilder builder( this );
+        boost::scoped_array<char> buf( new char[_chunkSize] );
+        while ( !feof( fd ) ) {
+            size_t readLen = fread( buf.get() , 1 , _chunkSize , fd );
+            if ( ferror( fd ) ) {
+                if ( fd != stdin )
+                    fclose( fd );
+                uasserted( 17403 , str::stream() << "error reading file: " << fileName );
             }
-
-            GridFSChunk c(idObj, chunkNumber, buf, chunkLen);
-            _client.insert( _chunksNS.c_str() , c._data );
-
-            length += chunkLen;
-            chunkNumber++;
-            delete[] buf;
+            builder.appendChunk( buf.get() , readLen );
         }
 
         if (fd != stdin)
             fclose( fd );
 
-        return insertFile((remoteName.empty() ? fileName : remoteName), id, length, contentType);
+        return builder.buildFile( remoteName.empty() ? fileName : remoteName , contentType );
     }
 
-    BSONObj GridFS::insertFile(const string& name, const OID& id, gridfs_offset length, const string& contentType) {
+    BSONObj GridFS::insertFile(const string& name, const OID& id, gridfs_offset length,
+                               const string& md5, const string& contentType) {
         // Wait for any pending writebacks to finish
         BSONObj errObj = _client.getLastErrorDetailed();
         uassert( 16428,
@@ -147,16 +131,12 @@ namespace mongo {
                                << ", error: " << errObj,
                  DBClientWithCommands::getLastErrorString(errObj) == "" );
 
-        BSONObj res;
-        if ( ! _client.runCommand( _dbName.c_str() , BSON( "filemd5" << id << "root" << _prefix ) , res ) )
-            throw UserException( 9008 , "filemd5 failed" );
-
         BSONObjBuilder file;
         file << "_id" << id
              << "filename" << name
              << "chunkSize" << _chunkSize
              << "uploadDate" << DATENOW
-             << "md5" << res["md5"]
+             << "md5" << md5
              ;
 
         if (length < 1024*1024*1024) { // 2^30
@@ -175,6 +155,95 @@ namespace mongo {
         return ret;
     }
 
+    GridFileBuilder::GridFileBuilder( GridFS* grid )
+        : _grid( grid ),
+          _pendingData( new char[grid->_chunkSize] ),
+          _pendingDataSize( 0 ),
+          _chunkNumber( 0 ),
+          _length( 0 ),
+          _done( false ) {
+        _fileId.init();
+        _fileIdObj = BSON( "_id" << _fileId );
+        md5_init( &_md5 );
+    }
+
+    GridFileBuilder::~GridFileBuilder() {
+    }
+
+    void GridFileBuilder::appendChunk( const char* data , size_t length ) {
+        uassert( 17404 , "file already built" , !_done );
+
+        const unsigned int chunkSize = _grid->_chunkSize;
+        _length += length;
+
+        while ( length > 0 ) {
+            if ( _pendingDataSize == 0 && length >= chunkSize ) {
+                // whole chunks go straight from the caller's buffer
+                md5_append( &_md5 , reinterpret_cast<const md5_byte_t*>( data ) , chunkSize );
+                _queueChunk( data , chunkSize );
+                data += chunkSize;
+                length -= chunkSize;
+                continue;
+            }
+
+            size_t toCopy = std::min( static_cast<size_t>( chunkSize - _pendingDataSize ) , length );
+            memcpy( _pendingData.get() + _pendingDataSize , data , toCopy );
+            _pendingDataSize += toCopy;
+            data += toCopy;
+            length -= toCopy;
+
+            if ( _pendingDataSize == chunkSize ) {
+                md5_append( &_md5 , reinterpret_cast<const md5_byte_t*>( _pendingData.get() ) ,
+                            _pendingDataSize );
+                _queueChunk( _pendingData.get() , _pendingDataSize );
+                _pendingDataSize = 0;
+            }
+        }
+    }
+
+    BSONObj GridFileBuilder::buildFile( const string& remoteName , const string& contentType ) {
+        uassert( 17405 , "file already built" , !_done );
+        _done = true;
+
+        if ( _pendingDataSize > 0 ) {
+            md5_append( &_md5 , reinterpret_cast<const md5_byte_t*>( _pendingData.get() ) ,
+                        _pendingDataSize );
+            _queueChunk( _pendingData.get() , _pendingDataSize );
+            _pendingDataSize = 0;
+        }
+        _flushChunks();
+
+        md5digest digest;
+        md5_finish( &_md5 , digest );
+
+        return _grid->insertFile( remoteName , _fileId , _length , digestToString( digest ) ,
+                                  contentType );
+    }
+
+    void GridFileBuilder::_queueChunk( const char* data , int length ) {
+        GridFSChunk c( _fileIdObj , _chunkNumber++ , data , length );
+        _chunks.push_back( c._data );
+
+        if ( _chunks.size() >= _grid->_pipelineDepth ||
+             _chunks.size() * _grid->_chunkSize >= MAX_CHUNK_BATCH_BYTES ) {
+            _flushChunks();
+        }
+    }
+
+    void GridFileBuilder::_flushChunks() {
+        if ( _chunks.empty() )
+            return;
+        // getLastError only reports the connection's last operation, so a batch that failed
+        // would go unnoticed once the next one is sent: check each batch before moving on.
+        _grid->_client.insert( _grid->_chunksNS , _chunks );
+        BSONObj errObj = _grid->_client.getLastErrorDetailed();
+        uassert( 17414,
+                 str::stream() << "Error storing GridFS chunks for file: " << _fileId
+                               << ", error: " << errObj,
+                 DBClientWithCommands::getLastErrorString( errObj ) == "" );
+        _chunks.clear();
+    }
+
     void GridFS::removeFile( const string& fileName ) {
         auto_ptr<DBClientCursor> files = _client.query( _filesNS , BSON( "filename" << fileName ) );
         while (files->more()) {
@@ -229,18 +298,53 @@ namespace mongo {
 
     gridfs_offset GridFile::write( ostream & out ) const {
         _exists();
+        return writeRange( out , 0 , getContentLength() );
+    }
+
+    gridfs_offset GridFile::writeRange( ostream & out , gridfs_offset offset ,
+                                        gridfs_offset length ) const {
+        _exists();
 
-        const int num = getNumChunks();
+        const gridfs_offset contentLength = getContentLength();
+        if ( offset >= contentLength || length == 0 )
+            return 0;
+        length = std::min( length , contentLength - offset );
 
-        for ( int i=0; i<num; i++ ) {
-            GridFSChunk c = getChunk( i );
+        const gridfs_offset chunkSize = getChunkSize();
+        const int firstChunk = static_cast<int>( offset / chunkSize );
+        const int lastChunk = static_cast<int>( ( offset + length - 1 ) / chunkSize );
+
+        BSONObjBuilder b;
+        b.appendAs( _obj["_id"] , "files_id" );
+        b.append( "n" , BSON( "$gte" << firstChunk << "$lte" << lastChunk ) );
+
+        auto_ptr<DBClientCursor> cursor =
+            _grid->_client.query( _grid->_chunksNS , Query( b.obj() ).sort( "n" ) ,
+                                  0 , 0 , 0 , 0 , _grid->_pipelineDepth );
+        uassert( 17406 , "couldn't query GridFS chunks" , cursor.get() );
+
+        const gridfs_offset end = offset + length;
+        int expected = firstChunk;
+        while ( cursor->more() ) {
+            GridFSChunk c( cursor->nextSafe() );
+            const int n = c._data["n"].numberInt();
+            uassert( 17407 , str::stream() << "chunk " << expected << " is missing" ,
+                     n == expected );
 
             int len;
             const char * data = c.data( len );
-            out.write( data , len );
+            const gridfs_offset chunkStart = n * chunkSize;
+            const gridfs_offset from = std::max( offset , chunkStart ) - chunkStart;
+            const gridfs_offset to = std::min( end , chunkStart + len ) - chunkStart;
+            if ( to > from )
+                out.write( data + from , to - from );
+
+            expected++;
         }
+        uassert( 17408 , str::stream() << "chunk " << expected << " is missing" ,
+                 expected == lastChunk + 1 );
 
-        return getContentLength();
+        return length;
     }
 
     gridfs_offset GridFile::write( const string& where ) const {
@@ -17,10 +17,14 @@
 
 #pragma once
 
+#include <boost/scoped_array.hpp>
+
+#include "mongo/base/disallow_copying.h"
 #include "mongo/bson/bsonelement.h"
 #include "mongo/bson/bsonobj.h"
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/client/export_macros.h"
+#include "mongo/util/md5.h"
 
 namespace mongo {
 
@@ -28,6 +32,7 @@ namespace mongo {
 
     class GridFS;
     class GridFile;
+    class GridFileBuilder;
 
     class MONGO_CLIENT_API GridFSChunk {
     public:
@@ -47,6 +52,8 @@ namespace mongo {
     private:
         BSONObj _data;
         friend class GridFS;
+        friend class GridFile;
+        friend class GridFileBuilder;
     };
 
 
@@ -71,6 +78,15 @@ namespace mongo {
 
         unsigned int getChunkSize() const;
 
+        /**
+         * @param depth - how many chunks are sent in one insert message, or asked for in one
+         *                cursor batch when reading.  Deeper pipelines need fewer round trips
+         *                but buffer more chunks in memory.
+         */
+        void setPipelineDepth(unsigned int depth);
+
+        unsigned int getPipelineDepth() const;
+
         /**
          * puts the file reference by fileName into the db
          * @param fileName local filename relative to process
@@ -127,11 +143,63 @@ namespace mongo {
         string _filesNS;
         string _chunksNS;
         unsigned int _chunkSize;
+        unsigned int _pipelineDepth;
 
         // insert fileobject. All chunks must be in DB.
-        BSONObj insertFile(const string& name, const OID& id, gridfs_offset length, const string& contentType);
+        BSONObj insertFile(const string& name, const OID& id, gridfs_offset length,
+                           const string& md5, const string& contentType);
 
         friend class GridFile;
+        friend class GridFileBuilder;
+    };
+
+    /**
+     * Streams a file of unknown length into GridFS.  Data is cut into chunks as it arrives,
+     * up to getPipelineDepth() chunks go out in each insert, each insert is checked with
+     * getLastError before the next, and the MD5 is computed on the way through so the server
+     * doesn't have to read the file back.
+     *
+     *   GridFileBuilder builder( &grid );
+     *   while ( ... ) builder.appendChunk( buf , len );
+     *   BSONObj file = builder.buildFile( "name" );
+     */
+    class MONGO_CLIENT_API GridFileBuilder {
+        MONGO_DISALLOW_COPYING( GridFileBuilder );
+    public:
+        GridFileBuilder( GridFS* grid );
+        ~GridFileBuilder();
+
+        /**
+         * Appends 'length' bytes to the file.  Any amount may be passed; it need not line up
+         * with the chunk size.
+         */
+        void appendChunk( const char* data , size_t length );
+
+        /**
+         * Writes the remaining chunks and the file object, and returns the file object.  The
+         * builder can't be used afterwards.
+         */
+        BSONObj buildFile( const string& remoteName , const string& contentType="" );
+
+    private:
+        void _queueChunk( const char* data , int length );
+        void _flushChunks();
+
+        GridFS* _grid;
+        OID _fileId;
+        BSONObj _fileIdObj;
+
+        // the part of the current chunk seen so far
+        boost::scoped_array<char> _pendingData;
+        unsigned int _pendingDataSize;
+
+        // chunks built but not yet sent
+        vector<BSONObj> _chunks;
+
+        int _chunkNumber;
+        gridfs_offset _length;
+        md5_state_t _md5;
+        bool _done;
     };
 
     /**
@@ -188,6 +256,14 @@ namespace mongo {
          */
         gridfs_offset write( ostream & out ) const;
 
+        /**
+         * write 'length' bytes of the file starting at 'offset' to the output stream.  Only
+         * the chunks covering the range are fetched, getPipelineDepth() of them at a time.
+         * @return the number of bytes written, less than 'length' if the file ends first
+         */
+        gridfs_offset writeRange( ostream & out , gridfs_offset offset ,
+                                  gridfs_offset length ) const;
+
         /**
            write the file to this filename
          */
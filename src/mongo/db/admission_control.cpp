@@ -0,0 +1,316 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/db/admission_control.h"
+
+#include <boost/thread/tss.hpp>
+#include <cstdlib>
+
+#include "mongo/db/commands.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/dbmessage.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/namespace_string.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/message.h"
+
+namespace mongo {
+
+    namespace {
+
+        PriorityTicketHolder readPool( 0 );
+        PriorityTicketHolder writePool( 0 );
+
+        class AdmissionTicketsParameter : public ServerParameter {
+        public:
+            AdmissionTicketsParameter( const std::string& name, PriorityTicketHolder* holder )
+                : ServerParameter( ServerParameterSet::getGlobal(), name ),
+                  _holder( holder ) {
+            }
+
+            virtual void append( BSONObjBuilder& b, const string& name ) {
+                b.append( name, _holder->outof() );
+            }
+
+            virtual Status set( const BSONElement& newValueElement ) {
+                if ( !newValueElement.isNumber() ) {
+                    return Status( ErrorCodes::BadValue,
+                                   str::stream() << name() << " has to be a number" );
+                }
+                return _set( newValueElement.numberInt() );
+            }
+
+            virtual Status setFromString( const string& str ) {
+                return _set( atoi( str.c_str() ) );
+            }
+
+        private:
+            Status _set( int tickets ) {
+                if ( tickets < 0 ) {
+                    return Status( ErrorCodes::BadValue,
+                                   str::stream() << name() << " has to be >= 0 (0 is unlimited)" );
+                }
+                _holder->resize( tickets );
+                return Status::OK();
+            }
+
+            PriorityTicketHolder* _holder;
+        };
+
+        AdmissionTicketsParameter readTicketsParameter( "admissionControlReadTickets",
+                                                        &readPool );
+        AdmissionTicketsParameter writeTicketsParameter( "admissionControlWriteTickets",
+                                                         &writePool );
+
+        const int kDefaultReservedPriorityTickets = 4;
+
+        /** How many tickets in each pool only the priority queue may take. */
+        class ReservedPriorityTicketsParameter : public ServerParameter {
+        public:
+            ReservedPriorityTicketsParameter()
+                : ServerParameter( ServerParameterSet::getGlobal(),
+                                   "admissionControlReservedPriorityTickets" ) {
+                _set( kDefaultReservedPriorityTickets );
+            }
+
+            virtual void append( BSONObjBuilder& b, const string& name ) {
+                b.append( name, readPool.reserved() );
+            }
+
+            virtual Status set( const BSONElement& newValueElement ) {
+                if ( !newValueElement.isNumber() ) {
+                    return Status( ErrorCodes::BadValue,
+                                   str::stream() << name() << " has to be a number" );
+                }
+                return _set( newValueElement.numberInt() );
+            }
+
+            virtual Status setFromString( const string& str ) {
+                return _set( atoi( str.c_str() ) );
+            }
+
+        private:
+            Status _set( int reserved ) {
+                if ( reserved < 0 ) {
+                    return Status( ErrorCodes::BadValue,
+                                   str::stream() << name() << " has to be >= 0" );
+                }
+                readPool.setReserved( reserved );
+                writePool.setReserved( reserved );
+                return Status::OK();
+            }
+        } reservedPriorityTicketsParameter;
+
+        // Replication and monitoring commands, which are cheap and shouldn't queue behind
+        // client load.  Anything else sent to admin.$cmd is treated like any other command.
+        const char* const priorityCommands[] = {
+            "replSetHeartbeat",
+            "replSetUpdatePosition",
+            "replSetGetStatus",
+            "handshake",
+            "isMaster",
+            "ismaster",
+            "ping",
+            "serverStatus",
+        };
+
+        bool isPriorityCommand( const StringData& name ) {
+            for ( size_t i = 0; i < sizeof( priorityCommands ) / sizeof( priorityCommands[0] );
+                  i++ ) {
+                if ( name == priorityCommands[i] )
+                    return true;
+            }
+            return false;
+        }
+
+        /** The command object of a query against $cmd, unwrapping a {$query: ...} wrapper. */
+        BSONObj commandObject( const BSONObj& query ) {
+            BSONElement e = query.firstElement();
+            if ( e.type() == Object && ( e.fieldName()[0] == '$'
+                                         ? str::equals( "query", e.fieldName() + 1 )
+                                         : str::equals( "query", e.fieldName() ) ) ) {
+                return e.embeddedObject();
+            }
+            return query;
+        }
+
+        /** Whether the ns is a collection's oplog, read by secondaries to replicate. */
+        bool isOplog( const StringData& ns ) {
+            return ns.startsWith( "local.oplog." );
+        }
+
+        void appendPoolStats( BSONObjBuilder& b, const char* name, const PriorityTicketHolder& h ) {
+            PriorityTicketHolder::Stats stats = h.getStats();
+            BSONObjBuilder bb( b.subobjStart( name ) );
+            bb.append( "totalTickets" , stats.outof );
+            bb.append( "out" , stats.used );
+            {
+                BSONObjBuilder q( bb.subobjStart( "queued" ) );
+                q.append( "normal" , stats.queued[PriorityTicketHolder::NORMAL] );
+                q.append( "priority" , stats.queued[PriorityTicketHolder::HIGH] );
+                q.done();
+            }
+            {
+                BSONObjBuilder w( bb.subobjStart( "waits" ) );
+                w.appendNumber( "normal" , stats.waits[PriorityTicketHolder::NORMAL] );
+                w.appendNumber( "priority" , stats.waits[PriorityTicketHolder::HIGH] );
+                w.done();
+            }
+            {
+                BSONObjBuilder w( bb.subobjStart( "waitMicros" ) );
+                w.appendNumber( "normal" , stats.waitMicros[PriorityTicketHolder::NORMAL] );
+                w.appendNumber( "priority" , stats.waitMicros[PriorityTicketHolder::HIGH] );
+                w.done();
+            }
+            bb.done();
+        }
+
+        class AdmissionControlServerStatus : public ServerStatusSection {
+        public:
+            AdmissionControlServerStatus() : ServerStatusSection( "admissionControl" ) { }
+            virtual bool includeByDefault() const { return true; }
+
+            BSONObj generateSection( const BSONElement& configElement ) const {
+                BSONObjBuilder b;
+                AdmissionControl::appendStats( b );
+                return b.obj();
+            }
+        } admissionControlServerStatus;
+
+    } // namespace
+
+    PriorityTicketHolder& AdmissionControl::pool( Pool which ) {
+        return which == WRITE ? writePool : readPool;
+    }
+
+    bool AdmissionControl::classify( const Message& m,
+                                     Pool* which,
+                                     PriorityTicketHolder::Priority* priority ) {
+        *priority = PriorityTicketHolder::NORMAL;
+
+        int op = m.operation();
+        switch ( op ) {
+        case dbQuery:
+        case dbGetMore:
+            *which = READ;
+            break;
+        case dbInsert:
+        case dbUpdate:
+        case dbDelete:
+            *which = WRITE;
+            return true;
+        default:
+            // killCursors and the like only release resources
+            return false;
+        }
+
+        DbMessage d( m );
+        const StringData ns( d.getns() );
+
+        // Oplog reads by secondaries go in the priority queue.
+        if ( isOplog( ns ) ) {
+            *priority = PriorityTicketHolder::HIGH;
+            return true;
+        }
+
+        // Not validated yet, so it may not even have a '.'.
+        if ( op != dbQuery || !ns.endsWith( ".$cmd" ) )
+            return true;
+
+        // Commands come in as queries, so look at which command it is.  The ones that have to
+        // run on a primary are the ones that write.
+        QueryMessage q( d );
+        BSONObj cmdObj = commandObject( q.query );
+        if ( cmdObj.isEmpty() )
+            return true;
+        StringData name = cmdObj.firstElementFieldName();
+
+        Command* c = Command::findCommand( name.toString() );
+        if ( c && !c->slaveOk() )
+            *which = WRITE;
+
+        if ( nsToDatabaseSubstring( ns ) == "admin" && isPriorityCommand( name ) )
+            *priority = PriorityTicketHolder::HIGH;
+
+        return true;
+    }
+
+    void AdmissionControl::appendStats( BSONObjBuilder& b ) {
+        appendPoolStats( b, "read", readPool );
+        appendPoolStats( b, "write", writePool );
+    }
+
+    namespace {
+        // The ticket held by the current thread's top-level request, if any.
+        void noCleanup( ScopedAdmission* ) {}
+        boost::thread_specific_ptr<ScopedAdmission> currentAdmission( noCleanup );
+    }
+
+    ScopedAdmission::ScopedAdmission( AdmissionControl::Pool which,
+                                      PriorityTicketHolder::Priority priority )
+        : _holder( NULL ),
+          _priority( priority ),
+          _released( false ) {
+        PriorityTicketHolder& holder = AdmissionControl::pool( which );
+        // An op started while the pool was unlimited isn't counted against it if the pool is
+        // resized while it runs.
+        if ( holder.outof() <= 0 )
+            return;
+        holder.waitForTicket( priority );
+        _holder = &holder;
+        currentAdmission.reset( this );
+    }
+
+    ScopedAdmission::~ScopedAdmission() {
+        if ( !_holder )
+            return;
+        currentAdmission.reset( NULL );
+        if ( !_released )
+            _holder->release();
+    }
+
+    AdmissionReleaser::AdmissionReleaser() : _admission( currentAdmission.get() ) {
+        if ( !_admission || _admission->_released ) {
+            _admission = NULL;
+            return;
+        }
+        _admission->_holder->release();
+        _admission->_released = true;
+    }
+
+    AdmissionReleaser::~AdmissionReleaser() {
+        if ( !_admission )
+            return;
+        // Back in the queue behind whoever arrived while we were waiting.
+        _admission->_holder->waitForTicket( _admission->_priority );
+        _admission->_released = false;
+    }
+
+} // namespace mongo
@@ -0,0 +1,103 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#pragma once
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/util/concurrency/ticketholder.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+    class Message;
+
+    /**
+     * Limits how many client operations run at once, with separate pools for reads and writes
+     * so a burst of one can't use up the server's capacity for the other.
+     *
+     * Each pool queues its waiters in arrival order, with a priority queue in front for
+     * replication and monitoring traffic, so it isn't stuck behind a backlog of heavy queries.
+     * A few tickets in each pool are kept for the priority queue.
+     *
+     * Both pools are unlimited by default; their sizes are the admissionControlReadTickets and
+     * admissionControlWriteTickets server parameters, and the number kept for the priority
+     * queue is admissionControlReservedPriorityTickets.
+     */
+    class AdmissionControl {
+    public:
+        enum Pool { READ = 0, WRITE = 1 };
+
+        static PriorityTicketHolder& pool( Pool which );
+
+        /**
+         * Decides which pool and priority a request received from a client uses.  Returns
+         * false for requests that don't need a ticket.
+         */
+        static bool classify( const Message& m,
+                              Pool* which,
+                              PriorityTicketHolder::Priority* priority );
+
+        static void appendStats( BSONObjBuilder& b );
+    };
+
+    /**
+     * Holds a ticket from one of the admission control pools while in scope.  Takes nothing if
+     * the pool is unlimited.
+     */
+    class ScopedAdmission {
+        MONGO_DISALLOW_COPYING(ScopedAdmission);
+    public:
+        ScopedAdmission( AdmissionControl::Pool which, PriorityTicketHolder::Priority priority );
+        ~ScopedAdmission();
+
+    private:
+        friend class AdmissionReleaser;
+
+        PriorityTicketHolder* _holder; // NULL if no ticket was taken
+        PriorityTicketHolder::Priority _priority;
+        bool _released;
+    };
+
+    /**
+     * Gives back the current thread's admission ticket while in scope and waits for it again
+     * on the way out.  For operations about to block on something other than the server's
+     * capacity, like awaitData getMores and write concern waits, so they don't keep others
+     * out while they sleep.  Does nothing if the thread holds no ticket.
+     */
+    class AdmissionReleaser {
+        MONGO_DISALLOW_COPYING(AdmissionReleaser);
+    public:
+        AdmissionReleaser();
+        ~AdmissionReleaser();
+
+    private:
+        ScopedAdmission* _admission; // NULL if there was nothing to give back
+    };
+
+} // namespace mongo
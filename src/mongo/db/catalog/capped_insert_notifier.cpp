@@ -0,0 +1,125 @@
+// capped_insert_notifier.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include "mongo/db/catalog/capped_insert_notifier.h"
+
+#include "mongo/base/counter.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    CappedInsertNotifier cappedInsertNotifier;
+
+    // Number of getMores currently blocked waiting for a capped insert.
+    static Counter64 awaitDataWaiters;
+    static ServerStatusMetricField<Counter64> displayAwaitDataWaiters( "cursor.awaitData.waiters",
+                                                                       &awaitDataWaiters );
+    // Waits that ended because of an insert, and those that ran out of time.
+    static Counter64 awaitDataWakeups;
+    static ServerStatusMetricField<Counter64> displayAwaitDataWakeups( "cursor.awaitData.wakeups",
+                                                                       &awaitDataWakeups );
+    static Counter64 awaitDataTimeouts;
+    static ServerStatusMetricField<Counter64> displayAwaitDataTimeouts(
+                                                    "cursor.awaitData.timeouts",
+                                                    &awaitDataTimeouts );
+    // Total time between an insert being signalled and a waiter observing it.  Divide by
+    // wakeups for the average wake up latency.
+    static Counter64 awaitDataWakeupMicros;
+    static ServerStatusMetricField<Counter64> displayAwaitDataWakeupMicros(
+                                                    "cursor.awaitData.wakeupLatencyMicros",
+                                                    &awaitDataWakeupMicros );
+
+    CappedInsertNotifier::CappedInsertNotifier()
+        : _mutex( "CappedInsertNotifier" ) {
+    }
+
+    CappedInsertNotifier::Version CappedInsertNotifier::getVersion( const StringData& ns ) {
+        mutex::scoped_lock lk( _mutex );
+        Waitable*& w = _waitables[ns.toString()];
+        if ( !w )
+            w = new Waitable();
+        return w->version;
+    }
+
+    void CappedInsertNotifier::notifyOfInsert( const StringData& ns ) {
+        mutex::scoped_lock lk( _mutex );
+        WaitableMap::iterator it = _waitables.find( ns.toString() );
+        if ( it == _waitables.end() )
+            return;
+
+        Waitable* w = it->second;
+        w->version++;
+        if ( w->waiters == 0 )
+            return;
+
+        w->lastNotifyMicros = curTimeMicros64();
+        w->cond.notify_all();
+    }
+
+    bool CappedInsertNotifier::waitForInsert( const StringData& ns,
+                                              Version prevVersion,
+                                              int millis ) {
+        mutex::scoped_lock lk( _mutex );
+        Waitable*& w = _waitables[ns.toString()];
+        if ( !w )
+            w = new Waitable();
+
+        if ( w->version != prevVersion )
+            return true;
+
+        w->waiters++;
+        awaitDataWaiters.increment();
+
+        boost::xtime deadline = incxtimemillis( millis );
+        bool notified = true;
+        while ( w->version == prevVersion ) {
+            if ( !w->cond.timed_wait( lk.boost(), deadline ) ) {
+                notified = w->version != prevVersion;
+                break;
+            }
+        }
+
+        w->waiters--;
+        awaitDataWaiters.decrement();
+
+        if ( notified ) {
+            awaitDataWakeups.increment();
+            unsigned long long now = curTimeMicros64();
+            if ( now > w->lastNotifyMicros )
+                awaitDataWakeupMicros.increment( now - w->lastNotifyMicros );
+        }
+        else {
+            awaitDataTimeouts.increment();
+        }
+        return notified;
+    }
+
+} // namespace mongo
@@ -0,0 +1,98 @@
+// capped_insert_notifier.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <boost/thread/condition.hpp>
+#include <map>
+#include <string>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/string_data.h"
+#include "mongo/platform/cstdint.h"
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    /**
+     * Lets getMore on a tailable, awaitData cursor block until something is inserted into the
+     * capped collection it is reading, rather than polling the collection with short sleeps.
+     *
+     * Each namespace has a version which is bumped by every insert.  A waiter must read the
+     * version *before* it looks at the cursor for new data, and then pass that version to
+     * waitForInsert() if nothing was found; an insert landing in between is never missed.
+     *
+     * Entries are keyed by namespace rather than hung off Collection, because waiters sleep
+     * without any lock held and the Collection may be dropped underneath them.
+     */
+    class CappedInsertNotifier {
+        MONGO_DISALLOW_COPYING(CappedInsertNotifier);
+    public:
+        typedef uint64_t Version;
+
+        CappedInsertNotifier();
+
+        /**
+         * Returns the current insert version for 'ns'.
+         */
+        Version getVersion( const StringData& ns );
+
+        /**
+         * Called after a document has been inserted into the capped collection 'ns'.  Cheap
+         * when nobody has ever waited on 'ns'.
+         */
+        void notifyOfInsert( const StringData& ns );
+
+        /**
+         * Blocks until the version of 'ns' differs from 'prevVersion' or 'millis' elapse.
+         * @return true if woken by an insert, false on timeout.
+         */
+        bool waitForInsert( const StringData& ns, Version prevVersion, int millis );
+
+    private:
+        struct Waitable {
+            Waitable() : version( 0 ), lastNotifyMicros( 0 ), waiters( 0 ) {}
+
+            Version version;
+            unsigned long long lastNotifyMicros;
+            int waiters;
+            boost::condition cond;
+        };
+
+        typedef std::map<std::string, Waitable*> WaitableMap;
+
+        // Entries are never removed; there is one per capped namespace ever tailed.
+        mongo::mutex _mutex;
+        WaitableMap _waitables;
+    };
+
+    extern CappedInsertNotifier cappedInsertNotifier;
+
+} // namespace mongo
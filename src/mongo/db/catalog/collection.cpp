@@ -32,6 +32,7 @@
 
 #include "mongo/base/counter.h"
 #include "mongo/base/owned_pointer_map.h"
+#include "mongo/db/catalog/capped_insert_notifier.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/curop.h"
@@ -154,6 +155,9 @@ namespace mongo {
         if ( !loc.isOK() )
             return loc;
 
+        if ( _details->isCapped() )
+            cappedInsertNotifier.notifyOfInsert( _ns.ns() );
+
         return StatusWith<DiskLoc>( loc );
     }
 
@@ -175,6 +179,8 @@ namespace mongo {
         StatusWith<DiskLoc> status = _insertDocument( docToInsert, enforceQuota );
         if ( status.isOK() ) {
             _details->paddingFits();
+            if ( _details->isCapped() )
+                cappedInsertNotifier.notifyOfInsert( _ns.ns() );
         }
 
         return status;
@@ -244,10 +250,56 @@ namespace mongo {
     Counter64 moveCounter;
     ServerStatusMetricField<Counter64> moveCounterDisplay( "record.moves", &moveCounter );
 
+    // Updates that rewrote the record where it was, and how many bytes those rewrites journaled.
+    static Counter64 rewriteCounter;
+    static ServerStatusMetricField<Counter64> rewriteCounterDisplay( "record.rewrites",
+                                                                     &rewriteCounter );
+    static Counter64 rewriteBytesCounter;
+    static ServerStatusMetricField<Counter64> rewriteBytesCounterDisplay( "record.rewriteBytes",
+                                                                          &rewriteBytesCounter );
+
+    namespace {
+        /**
+         * Overwrites objOld, stored in 'rec', with objNew which must fit in the record. Only the
+         * size header and the bytes from the first difference onwards are declared to the
+         * journal, so growing a field near the end of a document doesn't journal all of it.
+         * @return the number of bytes declared.
+         */
+        int rewriteRecord( Record* rec, const BSONObj& objOld, const BSONObj& objNew ) {
+            char* const target = rec->data();
+            const char* const source = objNew.objdata();
+            const int newSize = objNew.objsize();
+            const int common = std::min( objOld.objsize(), newSize );
+            int journaled = 0;
+
+            // The leading int32 is the object size, which changes whenever the document grows.
+            if ( memcmp( target, source, sizeof(int) ) != 0 ) {
+                memcpy( getDur().writingPtr( target, sizeof(int) ), source, sizeof(int) );
+                journaled += sizeof(int);
+            }
+
+            int start = sizeof(int);
+            const int chunk = 64;
+            while ( start + chunk <= common && memcmp( target + start, source + start, chunk ) == 0 )
+                start += chunk;
+            while ( start < common && target[start] == source[start] )
+                start++;
+
+            if ( start < newSize ) {
+                const int len = newSize - start;
+                memcpy( getDur().writingPtr( target + start, len ), source + start, len );
+                journaled += len;
+            }
+
+            return journaled;
+        }
+    }
+
     StatusWith<DiskLoc> Collection::updateDocument( const DiskLoc& oldLocation,
                                                     const BSONObj& objNew,
                                                     bool enforceQuota,
-                                                    OpDebug* debug ) {
+                                                    OpDebug* debug,
+                                                    bool indexesAffected ) {
 
         Record* oldRecord = getExtentManager()->recordFor( oldLocation );
         BSONObj objOld = BSONObj::make( oldRecord );
@@ -269,12 +321,23 @@ namespace mongo {
                 return StatusWith<DiskLoc>( s );
         }
 
+        std::string compressedNew;
+        const bool compressNew =
+            _recordStore.compressRecord( objNew.objdata(), objNew.objsize(), &compressedNew );
+        const int storedSize = compressNew ? static_cast<int>( compressedNew.size() )
+                                           : objNew.objsize();
+        const bool fits = oldRecord->netLength() >= storedSize;
+
+        // A document that stays put with no indexed field changed has the same keys and
+        // DiskLoc as before, so there is nothing to do in the indexes.
+        const bool updateIndexes = indexesAffected || !fits;
+
         /* duplicate key check. we descend the btree twice - once for this check, and once for the actual inserts, further
            below.  that is suboptimal, but it's pretty complicated to do it the other way without rollbacks...
         */
         OwnedPointerMap<IndexDescriptor*,UpdateTicket> updateTickets;
         IndexCatalog::IndexIterator ii = _indexCatalog.getIndexIterator( true );
-        while ( ii.more() ) {
+        while ( updateIndexes && ii.more() ) {
             IndexDescriptor* descriptor = ii.next();
             IndexAccessMethod* iam = _indexCatalog.getIndex( descriptor );
 
@@ -291,7 +354,7 @@ namespace mongo {
             }
         }
 
-        if ( oldRecord->netLength() < objNew.objsize() ) {
+        if ( !fits ) {
             // doesn't fit, have to move to new location
 
             if ( _details->isCapped() )
@@ -337,7 +400,7 @@ namespace mongo {
             debug->keyUpdates = 0;
 
         ii = _indexCatalog.getIndexIterator( true );
-        while ( ii.more() ) {
+        while ( updateIndexes && ii.more() ) {
             IndexDescriptor* descriptor = ii.next();
             IndexAccessMethod* iam = _indexCatalog.getIndex( descriptor );
 
@@ -353,8 +416,16 @@ namespace mongo {
         ClientCursor::invalidateDocument(_ns.ns(), _details, oldLocation, INVALIDATION_MUTATION);
 
         //  update in place
-        int sz = objNew.objsize();
-        memcpy(getDur().writingPtr(oldRecord->data(), sz), objNew.objdata(), sz);
+        rewriteCounter.increment();
+        if ( compressNew || oldRecord->isCompressed() ) {
+            // compressed data differs from the first changed byte on, no point diffing it
+            const char* data = compressNew ? compressedNew.data() : objNew.objdata();
+            rewriteBytesCounter.increment( _recordStore.overwriteRecord( oldLocation, data,
+                                                                         storedSize ) );
+        }
+        else {
+            rewriteBytesCounter.increment( rewriteRecord( oldRecord, objOld, objNew ) );
+        }
 
         return StatusWith<DiskLoc>( oldLocation );
     }
@@ -99,6 +99,20 @@ namespace mongo {
         long long corruptDocuments;
     };
 
+    struct CompactStepStats {
+        CompactStepStats() {
+            recordsMoved = 0;
+            bytesMoved = 0;
+            extentFreed = false;
+            done = false;
+        }
+
+        long long recordsMoved;
+        long long bytesMoved;
+        bool extentFreed;
+        bool done; // nothing left before the stop extent
+    };
+
     /**
      * this is NOT safe through a yield right now
      * not sure if it will be, or what yet
@@ -159,14 +173,18 @@ namespace mongo {
 
         /**
          * updates the document @ oldLocation with newDoc
-         * if the document fits in the old space, it is put there
+         * if the document fits in the old space, it is put there, journaling only the bytes
+         * from the first difference onwards
          * if not, it is moved
+         * @param indexesAffected pass false only if no indexed field can differ between the old
+         *        and new documents; index maintenance is then skipped unless the doc moves
          * @return the post update location of the doc (may or may not be the same as oldLocation)
          */
         StatusWith<DiskLoc> updateDocument( const DiskLoc& oldLocation,
                                             const BSONObj& newDoc,
                                             bool enforceQuota,
-                                            OpDebug* debug );
+                                            OpDebug* debug,
+                                            bool indexesAffected = true );
 
         int64_t storageSize( int* numExtents = NULL, BSONArrayBuilder* extentInfo = NULL ) const;
 
@@ -174,6 +192,25 @@ namespace mongo {
 
         StatusWith<CompactStats> compact( const CompactOptions* options );
 
+        /**
+         * One step of an online compaction.  Moves records out of the first extent into space
+         * further along the collection until 'maxBytes' have been moved, and frees the extent
+         * once it is empty.  Indexes are updated as each record moves, and open cursors see the
+         * move as a deletion.  Only needs the database write lock for the step itself.
+         * Sets 'done' without moving anything once the first extent is 'stopExtent'.
+         */
+        StatusWith<CompactStepStats> compactStep( const CompactOptions* options,
+                                                  const DiskLoc& stopExtent,
+                                                  long long maxBytes );
+
+        /**
+         * Puts the free space in the extents an online compaction hadn't finished draining back
+         * on the deleted lists, so that stopping before 'stopExtent' is reached doesn't leak it.
+         * The compaction can still be resumed afterwards.
+         * @return the number of deleted records added
+         */
+        int abandonCompactSteps( const DiskLoc& stopExtent );
+
         // -----------
 
 
@@ -30,7 +30,10 @@
 
 #include "mongo/db/catalog/collection_info_cache.h"
 
+#include <boost/scoped_ptr.hpp>
+
 #include "mongo/db/d_concurrency.h"
+#include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 #include "mongo/db/structure/catalog/namespace_details-inl.h"
 #include "mongo/db/query/plan_cache.h"
@@ -57,6 +60,16 @@ namespace mongo {
         // admin hints should persist throughout life of collection
     }
 
+    namespace {
+        /** Adds every path 'expr' looks at. */
+        void addFilterPaths( const MatchExpression* expr, IndexPathSet* paths ) {
+            if ( !expr->path().empty() )
+                paths->addPath( expr->path() );
+            for ( size_t i = 0; i < expr->numChildren(); i++ )
+                addFilterPaths( expr->getChild( i ), paths );
+        }
+    }
+
     void CollectionInfoCache::computeIndexKeys() {
         DEV Lock::assertWriteLocked( _collection->ns().ns() );
 
@@ -64,12 +77,24 @@ namespace mongo {
 
         NamespaceDetails::IndexIterator i = _collection->details()->ii( true );
         while( i.more() ) {
-            BSONObj key = i.next().keyPattern();
+            IndexDetails& id = i.next();
+            BSONObj key = id.keyPattern();
             BSONObjIterator j( key );
             while ( j.more() ) {
                 BSONElement e = j.next();
                 _indexedPaths.addPath( e.fieldName() );
             }
+
+            // a change to a path the filter of a partial index looks at can move the document
+            // into or out of the index, even if no key changes
+            BSONElement filter = id.info.obj()["partialFilterExpression"];
+            if ( filter.isABSONObj() ) {
+                // the filter was checked when the index was created
+                StatusWithMatchExpression parsed = MatchExpressionParser::parse( filter.Obj() );
+                massert( 17413, "bad partialFilterExpression", parsed.isOK() );
+                boost::scoped_ptr<MatchExpression> expr( parsed.getValue() );
+                addFilterPaths( expr.get(), &_indexedPaths );
+            }
         }
 
         _keysComputed = true;
@@ -40,6 +40,7 @@
 #include "mongo/db/background.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/catalog/database_holder.h"
+#include "mongo/db/commands/dbhash.h"
 #include "mongo/db/dbhelpers.h"
 #include "mongo/db/structure/catalog/index_details.h"
 #include "mongo/db/instance.h"
@@ -65,6 +66,10 @@ namespace mongo {
 
         for ( CollectionMap::const_iterator i = _collections.begin(); i != _collections.end(); ++i )
             delete i->second;
+
+        delete reinterpret_cast<const CollectionMap*>( _collectionSnapshot.load() );
+        for ( size_t i = 0; i < _retiredCollections.size(); i++ )
+            delete _retiredCollections[i];
     }
 
     Status Database::validateDBName( const StringData& dbname ) {
@@ -110,7 +115,9 @@ namespace mongo {
           _namespacesName(_name + ".system.namespaces"),
           _indexesName(_name + ".system.indexes"),
           _extentFreelistName( _name + ".$freelist" ),
-          _collectionLock( "Database::_collectionLock" )
+          _collectionLock( "Database::_collectionLock" ),
+          _retiredCollectionEntries( 0 ),
+          _collectionSnapshotStale( false )
     {
         Status status = validateDBName( _name );
         if ( !status.isOK() ) {
@@ -324,6 +331,7 @@ namespace mongo {
         Status s = _dropNS( fullns );
 
         _clearCollectionCache( fullns ); // we want to do this always
+        wipeDbHashCache( fullns );
 
         if ( !s.isOK() )
             return s;
@@ -358,18 +366,41 @@ namespace mongo {
         if ( it == _collections.end() )
             return;
 
-        delete it->second;
+        Collection* collection = it->second;
         _collections.erase( it );
+        // readers must not find it in the snapshot once it is gone
+        _publishCollections_inlock();
+        delete collection;
+    }
+
+    void Database::_publishCollections_inlock() {
+        uintptr_t old = _collectionSnapshot.swap(
+            reinterpret_cast<uintptr_t>( new CollectionMap( _collections ) ) );
+        if ( old ) {
+            const CollectionMap* oldMap = reinterpret_cast<const CollectionMap*>( old );
+            _retiredCollections.push_back( oldMap );
+            _retiredCollectionEntries += oldMap->size();
+        }
+        _collectionSnapshotStale = false;
+
+        if ( Lock::isWriteLocked( _name ) ) {
+            // readers of this database's collections hold at least its read lock, so none
+            // can still be looking at a retired map
+            for ( size_t i = 0; i < _retiredCollections.size(); i++ )
+                delete _retiredCollections[i];
+            _retiredCollections.clear();
+            _retiredCollectionEntries = 0;
+        }
     }
 
     Collection* Database::getCollection( const StringData& ns ) {
         verify( _name == nsToDatabaseSubstring( ns ) );
 
-        scoped_lock lk( _collectionLock );
-
-        CollectionMap::const_iterator it = _collections.find( ns );
-        if ( it != _collections.end() ) {
-            if ( it->second ) {
+        const CollectionMap* snapshot =
+            reinterpret_cast<const CollectionMap*>( _collectionSnapshot.load() );
+        if ( snapshot ) {
+            CollectionMap::const_iterator it = snapshot->find( ns );
+            if ( it != snapshot->end() && it->second ) {
                 DEV {
                     NamespaceDetails* details = _namespaceIndex.details( ns );
                     if ( details != it->second->_details ) {
@@ -383,13 +414,30 @@ namespace mongo {
             }
         }
 
-        NamespaceDetails* details = _namespaceIndex.details( ns );
-        if ( !details ) {
-            return NULL;
+        scoped_lock lk( _collectionLock );
+
+        Collection* c = NULL;
+        CollectionMap::const_iterator it = _collections.find( ns );
+        if ( it != _collections.end() && it->second ) {
+            c = it->second;
+        }
+        else {
+            NamespaceDetails* details = _namespaceIndex.details( ns );
+            if ( !details ) {
+                return NULL;
+            }
+
+            c = new Collection( ns, details, this );
+            _collections[ns] = c;
+            _collectionSnapshotStale = true;
+        }
+
+        if ( _collectionSnapshotStale &&
+             ( _retiredCollectionEntries <= _collections.size() ||
+               Lock::isWriteLocked( _name ) ) ) {
+            _publishCollections_inlock();
         }
 
-        Collection* c = new Collection( ns, details, this );
-        _collections[ns] = c;
         return c;
     }
 
@@ -34,6 +34,8 @@
 #include "mongo/db/storage/extent_manager.h"
 #include "mongo/db/storage/record.h"
 #include "mongo/db/storage_options.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/cstdint.h"
 #include "mongo/util/string_map.h"
 
 namespace mongo {
@@ -222,6 +224,20 @@ namespace mongo {
         CollectionMap _collections;
         mutex _collectionLock;
 
+        // getCollection() looks here first without taking _collectionLock.  It is an immutable
+        // copy of _collections, replaced by _publishCollections_inlock().  Replaced copies are
+        // kept in _retiredCollections until we next hold this database's write lock, when no
+        // reader can be using them.  To bound that garbage, collections first seen under a read
+        // lock stop being published once it grows past the size of the map; they stay in
+        // _collections only until a write lock comes along.
+        AtomicWord<uintptr_t> _collectionSnapshot; // const CollectionMap*, NULL when empty
+        std::vector<const CollectionMap*> _retiredCollections;
+        size_t _retiredCollectionEntries;
+        bool _collectionSnapshotStale;
+
+        /** Caller holds _collectionLock. */
+        void _publishCollections_inlock();
+
         friend class Collection;
         friend class NamespaceDetails;
         friend class IndexDetails;
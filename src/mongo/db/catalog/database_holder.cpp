@@ -78,18 +78,49 @@ namespace mongo {
             verify( m[dbname] == 0 );
             m[dbname] = db;
             _size++;
+            _publish_inlock();
         }
 
         return db;
     }
 
+    DatabaseHolder::~DatabaseHolder() {
+        delete reinterpret_cast<const Snapshot*>( _snapshot.load() );
+        for ( size_t i = 0; i < _retired.size(); i++ )
+            delete _retired[i];
+    }
+
+    void DatabaseHolder::_publish_inlock() {
+        Snapshot* snapshot = new Snapshot();
+        for ( Paths::const_iterator i = _paths.begin(); i != _paths.end(); ++i ) {
+            for ( DBs::const_iterator j = i->second.begin(); j != i->second.end(); ++j ) {
+                (*snapshot)[j->first].push_back( j->second );
+            }
+        }
+
+        uintptr_t old = _snapshot.swap( reinterpret_cast<uintptr_t>( snapshot ) );
+        if ( old )
+            _retired.push_back( reinterpret_cast<const Snapshot*>( old ) );
+
+        if ( Lock::isW() ) {
+            // nobody can be reading an old snapshot
+            for ( size_t i = 0; i < _retired.size(); i++ )
+                delete _retired[i];
+            _retired.clear();
+        }
+    }
+
     bool DatabaseHolder::closeAll( const string& path , BSONObjBuilder& result , bool force ) {
         log() << "DatabaseHolder::closeAll path:" << path << endl;
         verify( Lock::isW() );
         getDur().commitNow(); // bad things happen if we close a DB with outstanding writes
 
-        map<string,Database*>& m = _paths[path];
-        _size -= m.size();
+        map<string,Database*> m;
+        {
+            SimpleMutex::scoped_lock lk(_m);
+            m = _paths[path];
+            _size -= m.size();
+        }
 
         set< string > dbs;
         for ( map<string,Database*>::iterator i = m.begin(); i != m.end(); i++ ) {
@@ -30,35 +30,44 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/namespace_string.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/cstdint.h"
+#include "mongo/util/string_map.h"
 
 namespace mongo { 
 
     /**
      * path + dbname -> Database
+     *
+     * Every operation looks its Database up here, so lookups don't take _m.  Writers, which
+     * hold _m, keep _paths up to date and publish an immutable copy of it that readers use.
+     * A replaced copy can't be freed while a reader may still be walking it; that is certain
+     * only under the global write lock, which excludes every reader, so until then it waits
+     * in _retired.  Database objects themselves are only destroyed under that lock anyway.
      */
     class DatabaseHolder {
         typedef map<string,Database*> DBs;
         typedef map<string,DBs> Paths;
-        // todo: we want something faster than this if called a lot:
-        mutable SimpleMutex _m;
+
+        /** dbname -> the Database with that name under each path */
+        typedef StringMap< std::vector<Database*> > Snapshot;
+
+        mutable SimpleMutex _m; // held by writers
         Paths _paths;
         int _size;
+        AtomicWord<uintptr_t> _snapshot; // const Snapshot*, NULL when empty
+        std::vector<const Snapshot*> _retired;
+
     public:
         DatabaseHolder() : _m("dbholder"),_size(0) { }
+        ~DatabaseHolder();
 
         bool __isLoaded( const string& ns , const string& path ) const {
-            SimpleMutex::scoped_lock lk(_m);
-            Paths::const_iterator x = _paths.find( path );
-            if ( x == _paths.end() )
-                return false;
-            const DBs& m = x->second;
-
-            string db = _todb( ns );
-
-            DBs::const_iterator it = m.find(db);
-            return it != m.end();
+            return _find( _todb( ns ) , path ) != NULL;
         }
         // must be write locked as otherwise isLoaded could go false->true on you 
         // in the background and you might not expect that.
@@ -68,26 +77,24 @@ namespace mongo {
         }
 
         Database * get( const string& ns , const string& path ) const {
-            SimpleMutex::scoped_lock lk(_m);
             Lock::assertAtLeastReadLocked(ns);
-            Paths::const_iterator x = _paths.find( path );
-            if ( x == _paths.end() )
-                return 0;
-            const DBs& m = x->second;
-            string db = _todb( ns );
-            DBs::const_iterator it = m.find(db);
-            if ( it != m.end() )
-                return it->second;
-            return 0;
+            Database* db = _find( nsToDatabaseSubstring( ns ) , path );
+            if ( !db ) {
+                // only names that were valid ever make it into the map, so just check on a miss
+                _todb( ns );
+            }
+            return db;
         }
 
         Database* getOrCreate( const string& ns , const string& path , bool& justCreated );
 
         void erase( const string& ns , const string& path ) {
-            SimpleMutex::scoped_lock lk(_m);
+            SimpleMutex::scoped_lock lk(_m); // for _paths, and held across _publish_inlock()
+            // W excludes every reader, so the snapshot replaced below is freed right away
             verify( Lock::isW() );
             DBs& m = _paths[path];
             _size -= (int)m.erase( _todb( ns ) );
+            _publish_inlock();
         }
 
         /** @param force - force close even if something underway - use at shutdown */
@@ -111,6 +118,24 @@ namespace mongo {
         }
 
     private:
+        Database* _find( const StringData& db , const string& path ) const {
+            const Snapshot* snapshot = reinterpret_cast<const Snapshot*>( _snapshot.load() );
+            if ( !snapshot )
+                return 0;
+            Snapshot::const_iterator it = snapshot->find( db );
+            if ( it == snapshot->end() )
+                return 0;
+            const std::vector<Database*>& dbs = it->second;
+            for ( size_t i = 0; i < dbs.size(); i++ ) {
+                if ( dbs[i]->path() == path )
+                    return dbs[i];
+            }
+            return 0;
+        }
+
+        /** Replaces the snapshot with a copy of _paths.  Caller holds _m. */
+        void _publish_inlock();
+
         static string _todb( const string& ns ) {
             string d = __todb( ns );
             uassert( 13280 , (string)"invalid db name: " + ns , NamespaceString::validDBName( d ) );
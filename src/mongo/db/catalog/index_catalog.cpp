@@ -54,6 +54,8 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/jsobjmanipulator.h"
 #include "mongo/db/keypattern.h"
+#include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/repl/rs.h" // this is ugly
@@ -73,6 +75,34 @@ namespace mongo {
 
     const BSONObj IndexCatalog::_idObj = BSON( "_id" << 1 );
 
+    /**
+     * A partial index filter may only be a conjunction of simple predicates, which is what the
+     * query planner knows how to prove a query implies.
+     */
+    static Status checkPartialFilter( const MatchExpression* expr ) {
+        switch ( expr->matchType() ) {
+        case MatchExpression::AND:
+            for ( size_t i = 0; i < expr->numChildren(); i++ ) {
+                Status s = checkPartialFilter( expr->getChild( i ) );
+                if ( !s.isOK() )
+                    return s;
+            }
+            return Status::OK();
+        case MatchExpression::EQ:
+        case MatchExpression::LT:
+        case MatchExpression::LTE:
+        case MatchExpression::GT:
+        case MatchExpression::GTE:
+        case MatchExpression::EXISTS:
+        case MatchExpression::TYPE_OPERATOR:
+            return Status::OK();
+        default:
+            return Status( ErrorCodes::CannotCreateIndex,
+                           str::stream() << "unsupported expression in partialFilterExpression: "
+                                         << expr->toString() );
+        }
+    }
+
     // -------------
 
     IndexCatalog::IndexCatalog( Collection* collection, NamespaceDetails* details )
@@ -597,6 +627,32 @@ namespace mongo {
             }
         }
 
+        BSONElement filterElement = spec["partialFilterExpression"];
+        if ( !filterElement.eoo() ) {
+            if ( filterElement.type() != Object )
+                return Status( ErrorCodes::CannotCreateIndex,
+                               "partialFilterExpression must be an object" );
+
+            if ( IndexDetails::isIdIndexPattern( key ) )
+                return Status( ErrorCodes::CannotCreateIndex,
+                               "the _id index cannot be a partial index" );
+
+            if ( spec["sparse"].trueValue() )
+                return Status( ErrorCodes::CannotCreateIndex,
+                               "cannot mix partialFilterExpression and sparse options" );
+
+            StatusWithMatchExpression parsed = MatchExpressionParser::parse( filterElement.Obj() );
+            if ( !parsed.isOK() )
+                return Status( ErrorCodes::CannotCreateIndex,
+                               str::stream() << "bad partialFilterExpression: "
+                                             << parsed.getStatus().reason() );
+
+            boost::scoped_ptr<MatchExpression> filter( parsed.getValue() );
+            Status status = checkPartialFilter( filter.get() );
+            if ( !status.isOK() )
+                return status;
+        }
+
         if ( _collection->isCapped() && spec["dropDups"].trueValue() ) {
             return Status( ErrorCodes::CannotCreateIndex,
                            str::stream() << "Cannot create an index with dropDups=true on a "
@@ -943,6 +999,12 @@ namespace mongo {
         return entry->isMultikey();
     }
 
+    const MatchExpression* IndexCatalog::getFilterExpression( const IndexDescriptor* idx ) const {
+        const IndexCatalogEntry* entry = _entries.find( idx );
+        invariant( entry );
+        return entry->getFilterExpression();
+    }
+
 
     // ---------------------------
 
@@ -1050,6 +1112,10 @@ namespace mongo {
             if ( !keyPattern.isPrefixOf( desc->keyPattern() ) )
                 continue;
 
+            // Callers walk every document through the index, which a partial index can't do.
+            if ( desc->isPartial() )
+                continue;
+
             if( !desc->isMultikey() )
                 return desc;
 
@@ -1258,7 +1324,7 @@ namespace mongo {
             // note (one day) we may be able to fresh build less versions than we can use
             // isASupportedIndexVersionNumber() is what we can use
             uassert(14803, str::stream() << "this version of mongod cannot build new indexes of version number " << vv, 
-                    vv == 0 || vv == 1);
+                    vv == 0 || vv == 1 || vv == 2);
             v = (int) vv;
         }
         // idea is to put things we use a lot earlier
@@ -47,6 +47,7 @@ namespace mongo {
     class IndexAccessMethod;
     class BtreeAccessMethod;
     class BtreeBasedAccessMethod;
+    class MatchExpression;
 
     /**
      * how many: 1 per Collection
@@ -91,7 +92,7 @@ namespace mongo {
 
         /* Returns the index entry for the first index whose prefix contains
          * 'keyPattern'. If 'requireSingleKey' is true, skip indices that contain
-         * array attributes. Otherwise, returns NULL.
+         * array attributes. Partial indexes are never returned. Otherwise, returns NULL.
          */
         IndexDescriptor* findIndexByPrefix( const BSONObj &keyPattern,
                                             bool requireSingleKey ) const;
@@ -164,6 +165,9 @@ namespace mongo {
 
         bool isMultikey( const IndexDescriptor* idex );
 
+        // NULL unless 'idx' is a partial index; owned by the catalog
+        const MatchExpression* getFilterExpression( const IndexDescriptor* idx ) const;
+
         // --- these probably become private?
 
 
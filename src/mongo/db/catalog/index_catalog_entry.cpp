@@ -32,6 +32,8 @@
 
 #include "mongo/db/index/index_access_method.h"
 #include "mongo/db/index/index_descriptor.h"
+#include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_parser.h"
 
 namespace mongo {
 
@@ -46,6 +48,18 @@ namespace mongo {
           _ordering( Ordering::make( descriptor->keyPattern() ) ),
           _isReady( false ) {
         _descriptor->_cachedEntry = this;
+
+        if ( _descriptor->isPartial() ) {
+            // The filter was checked when the index was created.
+            StatusWithMatchExpression parsed =
+                MatchExpressionParser::parse( _descriptor->partialFilterExpression() );
+            massert( 17401,
+                     str::stream() << "bad partialFilterExpression on index "
+                                   << _descriptor->indexName() << ": "
+                                   << parsed.getStatus().toString(),
+                     parsed.isOK() );
+            _filterExpression.reset( parsed.getValue() );
+        }
     }
 
     IndexCatalogEntry::~IndexCatalogEntry() {
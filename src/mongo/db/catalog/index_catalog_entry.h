@@ -32,6 +32,8 @@
 
 #include <string>
 
+#include <boost/scoped_ptr.hpp>
+
 #include "mongo/base/owned_pointer_vector.h"
 #include "mongo/bson/ordering.h"
 #include "mongo/db/diskloc.h"
@@ -42,6 +44,7 @@ namespace mongo {
     class IndexDescriptor;
     class RecordStore;
     class IndexAccessMethod;
+    class MatchExpression;
 
     class IndexCatalogEntry {
         MONGO_DISALLOW_COPYING( IndexCatalogEntry );
@@ -71,6 +74,11 @@ namespace mongo {
 
         const Ordering& ordering() const { return _ordering; }
 
+        /**
+         * The documents a partial index holds must match this.  NULL for other indexes.
+         */
+        const MatchExpression* getFilterExpression() const { return _filterExpression.get(); }
+
         /// ---------------------
 
         const DiskLoc& head() const;
@@ -110,6 +118,7 @@ namespace mongo {
         // cached stuff
 
         Ordering _ordering; // TODO: this might be b-tree specific
+        boost::scoped_ptr<MatchExpression> _filterExpression; // parsed from the descriptor
         bool _isReady; // cache of NamespaceDetails info
         DiskLoc _head; // cache of IndexDetails
         bool _isMultikey; // cache of NamespaceDetails info
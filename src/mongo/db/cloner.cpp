@@ -39,6 +39,7 @@
 #include "mongo/db/cloner.h"
 #include "mongo/db/commands.h"
 #include "mongo/db/commands/copydb.h"
+#include "mongo/db/commands/dbhash.h"
 #include "mongo/db/commands/rename_collection.h"
 #include "mongo/db/db.h"
 #include "mongo/db/dbhelpers.h"
@@ -181,6 +182,8 @@ namespace mongo {
                 uassertStatusOK( loc.getStatus() );
                 if ( logForRepl )
                     logOp("i", to_collection, js);
+                else
+                    wipeDbHashCache( to_collection );
 
                 getDur().commitIfNeeded();
 
@@ -28,6 +28,7 @@
 *    it in the license file.
 */
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -39,16 +40,125 @@
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/d_concurrency.h"
 #include "mongo/db/curop-inl.h"
+#include "mongo/db/dbhelpers.h"
 #include "mongo/db/index_builder.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/db/ops/delete.h"
+#include "mongo/db/structure/catalog/namespace_details.h"
+#include "mongo/db/storage/extent.h"
+#include "mongo/util/timer.h"
 
 namespace mongo {
 
     // from repl/rs.cpp
     bool isCurrentlyAReplSetPrimary();
 
+    namespace {
+
+        // one document per online compaction, so it can pick up where it left off
+        const char kCompactProgressNS[] = "local.compact.progress";
+
+        // each online step holds the write lock for at most this many bytes of moves
+        const long long kOnlineStepBytes = 1024 * 1024;
+
+        mongo::mutex onlineCompactionsMutex("onlineCompactions");
+        std::set<std::string> onlineCompactions;
+
+        /**
+         * Claims 'ns' for an online compaction for as long as it is in scope.
+         */
+        class OnlineCompactionClaim {
+        public:
+            OnlineCompactionClaim( const std::string& ns ) : _ns( ns ) {
+                scoped_lock lk( onlineCompactionsMutex );
+                _claimed = onlineCompactions.insert( ns ).second;
+            }
+
+            ~OnlineCompactionClaim() {
+                if ( !_claimed )
+                    return;
+                scoped_lock lk( onlineCompactionsMutex );
+                onlineCompactions.erase( _ns );
+            }
+
+            bool claimed() const { return _claimed; }
+
+        private:
+            std::string _ns;
+            bool _claimed;
+        };
+
+        bool isExtentOf( Collection* collection, const DiskLoc& extentLoc ) {
+            for ( DiskLoc L = collection->details()->firstExtent(); !L.isNull(); L = L.ext()->xnext ) {
+                if ( L == extentLoc )
+                    return true;
+            }
+            return false;
+        }
+
+        BSONObj loadProgress( const std::string& ns ) {
+            Lock::DBRead lk( kCompactProgressNS );
+            Client::Context ctx( kCompactProgressNS );
+            BSONObj progress;
+            if ( !Helpers::findOne( kCompactProgressNS, BSON( "_id" << ns ), progress ) )
+                return BSONObj();
+            return progress.getOwned();
+        }
+
+        void saveProgress( const BSONObj& progress ) {
+            Lock::DBWrite lk( kCompactProgressNS );
+            Client::Context ctx( kCompactProgressNS );
+            Helpers::upsert( kCompactProgressNS, progress );
+        }
+
+        void clearProgress( const std::string& ns ) {
+            Lock::DBWrite lk( kCompactProgressNS );
+            Client::Context ctx( kCompactProgressNS );
+            deleteObjects( kCompactProgressNS, BSON( "_id" << ns ), true );
+        }
+
+        /**
+         * Gives back the free space in the extents an online compaction of 'ns' was still
+         * draining if it stops early, unless dismissed once the compaction has finished.
+         */
+        class AbandonedStepsReclaimer {
+        public:
+            AbandonedStepsReclaimer( const NamespaceString& ns, const DiskLoc& stopExtent )
+                : _ns( ns ), _stopExtent( stopExtent ), _dismissed( false ) {
+            }
+
+            ~AbandonedStepsReclaimer() {
+                if ( _dismissed )
+                    return;
+                try {
+                    Lock::DBWrite lk( _ns.ns() );
+                    Client::Context ctx( _ns );
+                    Collection* collection = ctx.db()->getCollection( _ns.ns() );
+                    if ( !collection || !isExtentOf( collection, _stopExtent ) )
+                        return;
+                    int n = collection->abandonCompactSteps( _stopExtent );
+                    log() << "compact " << _ns << " online stopped early, returned " << n
+                          << " free regions to the deleted lists";
+                }
+                catch ( DBException& e ) {
+                    warning() << "compact " << _ns << " online stopped early and could not "
+                              << "reclaim its free space, a later online compact will: "
+                              << e.toString();
+                }
+            }
+
+            void dismiss() { _dismissed = true; }
+
+        private:
+            NamespaceString _ns;
+            DiskLoc _stopExtent;
+            bool _dismissed;
+        };
+
+    }
+
     class CompactCmd : public Command {
     public:
         virtual LockType locktype() const { return NONE; }
@@ -65,11 +175,15 @@ namespace mongo {
         }
         virtual void help( stringstream& help ) const {
             help << "compact collection\n"
-                "warning: this operation blocks the server and is slow. you can cancel with cancelOp()\n"
+                "warning: this operation holds the database write lock until it is done, and is slow. you can cancel with cancelOp()\n"
+                "  with online:true the lock is only held for short steps, and yielded in between\n"
                 "{ compact : <collection_name>, [force:<bool>], [validate:<bool>],\n"
-                "  [paddingFactor:<num>], [paddingBytes:<num>] }\n"
+                "  [paddingFactor:<num>], [paddingBytes:<num>], [online:<bool>], [maxBytesPerSec:<num>] }\n"
                 "  force - allows to run on a replica set primary\n"
-                "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (defaults to true in this version)\n";
+                "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (defaults to true in this version)\n"
+                "  online - move records a little at a time, yielding the lock in between, instead of rebuilding\n"
+                "           the collection in one go. indexes are kept, and an interrupted run resumes where it stopped\n"
+                "  maxBytesPerSec - with online, limits how fast records are moved (default unlimited)\n";
         }
         CompactCmd() : Command("compact") { }
 
@@ -90,6 +204,8 @@ namespace mongo {
                 return false;
             }
 
+            const bool online = cmdObj["online"].trueValue();
+
             if( isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) {
                 errmsg = "will not run compact on an active replica set primary as this is a slow blocking operation. use force:true to force";
                 return false;
@@ -141,6 +257,17 @@ namespace mongo {
             if ( cmdObj.hasElement("validate") )
                 compactOptions.validateDocuments = cmdObj["validate"].trueValue();
 
+            if ( online ) {
+                long long maxBytesPerSec = 0;
+                if ( cmdObj.hasElement("maxBytesPerSec") ) {
+                    maxBytesPerSec = cmdObj["maxBytesPerSec"].numberLong();
+                    if ( maxBytesPerSec <= 0 ) {
+                        errmsg = "invalid maxBytesPerSec";
+                        return false;
+                    }
+                }
+                return runOnline( ns, compactOptions, maxBytesPerSec, errmsg, result );
+            }
 
             Lock::DBWrite lk(ns.ns());
             BackgroundOperation::assertNoBgOpInProgForNs(ns.ns());
@@ -174,6 +301,143 @@ namespace mongo {
 
             return true;
         }
+
+    private:
+        /**
+         * Compacts 'ns' in short steps under the database write lock, oldest extent first,
+         * until every extent that existed when the compaction started has been emptied and
+         * freed.  Progress is kept in local.compact.progress between steps, so a later run
+         * after an interruption or restart carries on with the same set of extents.
+         */
+        bool runOnline( const NamespaceString& ns, const CompactOptions& compactOptions,
+                        long long maxBytesPerSec, string& errmsg, BSONObjBuilder& result ) {
+
+            OnlineCompactionClaim claim( ns.ns() );
+            if ( !claim.claimed() ) {
+                errmsg = "an online compact of this collection is already running";
+                return false;
+            }
+
+            const long long stepBytes = maxBytesPerSec > 0 ?
+                std::min( kOnlineStepBytes, maxBytesPerSec ) : kOnlineStepBytes;
+
+            BSONObj saved = loadProgress( ns.ns() );
+
+            DiskLoc stopExtent;
+            bool resumed = false;
+            {
+                Lock::DBWrite lk(ns.ns());
+                Client::Context ctx(ns);
+
+                Collection* collection = ctx.db()->getCollection(ns.ns());
+                if( ! collection ) {
+                    errmsg = "namespace does not exist";
+                    return false;
+                }
+
+                if ( collection->isCapped() ) {
+                    errmsg = "cannot compact a capped collection";
+                    return false;
+                }
+
+                // only trust a saved stop extent that still belongs to this collection; the
+                // collection may have been dropped and recreated since
+                if ( saved["stopExtent"].isABSONObj() ) {
+                    BSONObj loc = saved["stopExtent"].Obj();
+                    DiskLoc savedStop( loc["file"].numberInt(), loc["offset"].numberInt() );
+                    if ( isExtentOf( collection, savedStop ) ) {
+                        stopExtent = savedStop;
+                        resumed = true;
+                    }
+                }
+
+                if ( !resumed )
+                    stopExtent = collection->details()->lastExtent();
+            }
+
+            long long extentsFreed = resumed ? saved["extentsFreed"].numberLong() : 0;
+            long long recordsMoved = resumed ? saved["recordsMoved"].numberLong() : 0;
+            long long bytesMoved = resumed ? saved["bytesMoved"].numberLong() : 0;
+
+            log() << "compact " << ns << " online begin" << ( resumed ? " (resuming)" : "" )
+                  << ", options: " << compactOptions.toString()
+                  << " maxBytesPerSec: " << maxBytesPerSec;
+
+            if ( !resumed ) {
+                saveProgress( BSON( "_id" << ns.ns()
+                                    << "stopExtent" << stopExtent.toBSONObj()
+                                    << "extentsFreed" << extentsFreed
+                                    << "recordsMoved" << recordsMoved
+                                    << "bytesMoved" << bytesMoved ) );
+            }
+
+            AbandonedStepsReclaimer reclaimer( ns, stopExtent );
+
+            Timer t;
+            long long bytesThisRun = 0;
+            while ( true ) {
+                killCurrentOp.checkForInterrupt();
+
+                CompactStepStats step;
+                {
+                    Lock::DBWrite lk(ns.ns());
+                    BackgroundOperation::assertNoBgOpInProgForNs(ns.ns());
+                    Client::Context ctx(ns);
+
+                    Collection* collection = ctx.db()->getCollection(ns.ns());
+                    if( ! collection ) {
+                        errmsg = "namespace dropped during compact";
+                        return false;
+                    }
+
+                    if ( !isExtentOf( collection, stopExtent ) ) {
+                        errmsg = "collection was rebuilt during compact";
+                        return false;
+                    }
+
+                    StatusWith<CompactStepStats> status =
+                        collection->compactStep( &compactOptions, stopExtent, stepBytes );
+                    if ( !status.isOK() )
+                        return appendCommandStatus( result, status.getStatus() );
+                    step = status.getValue();
+                }
+
+                if ( step.done )
+                    break;
+
+                recordsMoved += step.recordsMoved;
+                bytesMoved += step.bytesMoved;
+                bytesThisRun += step.bytesMoved;
+
+                if ( step.extentFreed ) {
+                    extentsFreed++;
+                    saveProgress( BSON( "_id" << ns.ns()
+                                        << "stopExtent" << stopExtent.toBSONObj()
+                                        << "extentsFreed" << extentsFreed
+                                        << "recordsMoved" << recordsMoved
+                                        << "bytesMoved" << bytesMoved ) );
+                }
+
+                if ( maxBytesPerSec > 0 ) {
+                    long long dueMicros = bytesThisRun * 1000000 / maxBytesPerSec;
+                    long long elapsedMicros = static_cast<long long>( t.micros() );
+                    if ( dueMicros > elapsedMicros )
+                        sleepmicros( dueMicros - elapsedMicros );
+                }
+            }
+
+            reclaimer.dismiss();
+            clearProgress( ns.ns() );
+
+            log() << "compact " << ns << " online end, freed " << extentsFreed << " extents, moved "
+                  << recordsMoved << " documents (" << bytesMoved / 1000000.0 << "MB)";
+
+            result.append( "extentsFreed", extentsFreed );
+            result.append( "recordsMoved", recordsMoved );
+            result.append( "bytesMoved", bytesMoved );
+            result.appendBool( "resumed", resumed );
+            return true;
+        }
     };
     static CompactCmd compactCmd;
 
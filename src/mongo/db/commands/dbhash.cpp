@@ -30,10 +30,18 @@
 
 #include "mongo/db/commands/dbhash.h"
 
+#include <algorithm>
+#include <cstdio>
+
+#include "third_party/murmurhash3/MurmurHash3.h"
+
 #include "mongo/db/client.h"
 #include "mongo/db/commands.h"
+#include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
+#include "mongo/db/namespace_string.h"
 #include "mongo/db/query/internal_plans.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/util/md5.hpp"
 #include "mongo/util/timer.h"
 
@@ -41,6 +49,83 @@ namespace mongo {
 
     DBHashCmd dbhashCmd;
 
+    namespace {
+
+        int dbHashThreads = 4;
+
+        class ExportedDBHashThreadsParameter : public ExportedServerParameter<int> {
+        public:
+            ExportedDBHashThreadsParameter() :
+                ExportedServerParameter<int>( ServerParameterSet::getGlobal(),
+                                              "dbHashThreads",
+                                              &dbHashThreads,
+                                              true,
+                                              false ) {}
+
+            virtual Status validate( const int& potentialNewValue ) {
+                if ( potentialNewValue < 1 || potentialNewValue > 64 ) {
+                    return Status( ErrorCodes::BadValue,
+                                   "dbHashThreads must be between 1 and 64" );
+                }
+                return Status::OK();
+            }
+        } exportedDBHashThreadsParam;
+
+        AtomicUInt32 dbHashWorkerId;
+
+        // About one document in 1024 ends an incremental hash range.
+        const uint32_t kRangeBoundaryMask = 1023;
+
+        bool isRangeBoundary( const BSONElement& id ) {
+            uint32_t h;
+            MurmurHash3_x86_32( id.value(), id.valuesize(), id.type(), &h );
+            return ( h & kRangeBoundaryMask ) == 0;
+        }
+
+        /**
+         * Order sensitive digest of a sequence of documents.  md5 is the default; murmur3 hashes
+         * each document with MurmurHash3 and folds the results together, which is much cheaper
+         * per byte.  The two never produce the same digest for a collection.
+         */
+        class DocumentHasher {
+        public:
+            explicit DocumentHasher( bool murmur ) : _murmur( murmur ) {
+                md5_init( &_md5 );
+                _acc[0] = _acc[1] = 0;
+            }
+
+            void append( const BSONObj& doc ) {
+                if ( !_murmur ) {
+                    md5_append( &_md5, (const md5_byte_t*)doc.objdata(), doc.objsize() );
+                    return;
+                }
+                uint64_t h[2];
+                MurmurHash3_x64_128( doc.objdata(), doc.objsize(), 0, h );
+                // multiply after mixing each document in, so reordering changes the result
+                _acc[0] = ( _acc[0] ^ h[0] ) * 0x9E3779B97F4A7C15ULL;
+                _acc[1] = ( _acc[1] ^ h[1] ) * 0xC2B2AE3D27D4EB4FULL;
+            }
+
+            string finish() {
+                if ( !_murmur ) {
+                    md5digest d;
+                    md5_finish( &_md5, d );
+                    return digestToString( d );
+                }
+                char buf[33];
+                snprintf( buf, sizeof( buf ), "%016llx%016llx",
+                          static_cast<unsigned long long>( _acc[0] ),
+                          static_cast<unsigned long long>( _acc[1] ) );
+                return buf;
+            }
+
+        private:
+            bool _murmur;
+            md5_state_t _md5;
+            uint64_t _acc[2];
+        };
+
+    }  // namespace
 
     void logOpForDbHash( const char* opstr,
                          const char* ns,
@@ -48,14 +133,60 @@ namespace mongo {
                          BSONObj* patt,
                          const BSONObj* fullObj,
                          bool forMigrateCleanup ) {
-        dbhashCmd.wipeCacheForCollection( ns );
+        if ( *opstr == 'c' ) {
+            // commands can drop, rename or rewrite any collection in the database
+            wipeDbHashCache( ns );
+            return;
+        }
+
+        BSONElement id = patt ? patt->getField( "_id" ) : obj.getField( "_id" );
+        if ( id.eoo() )
+            dbhashCmd.wipeCacheForCollection( ns );
+        else
+            dbhashCmd.wipeCacheForDocument( ns, id );
+    }
+
+    void wipeDbHashCache( const StringData& ns ) {
+        if ( ns.empty() ) {
+            dbhashCmd.wipeAllCaches();
+            return;
+        }
+        size_t dot = ns.find( '.' );
+        if ( dot == string::npos || ns.substr( dot + 1 ) == "$cmd" )
+            dbhashCmd.wipeCacheForDatabase( ns.substr( 0, dot ) );
+        else
+            dbhashCmd.wipeCacheForCollection( ns );
     }
 
     // ----
 
+    struct DBHashCmd::HashJob {
+        HashJob() : fromCache( false ), rangesReused( 0 ), rangesRehashed( 0 ) {}
+
+        string fullCollectionName;
+        string hash;
+        bool fromCache;
+        long long rangesReused;
+        long long rangesRehashed;
+        string error;
+    };
+
+    struct DBHashCmd::HashBatch {
+        HashBatch() : murmur( false ), incremental( false ), remaining( 0 ), m( "dbHashBatch" ) {}
+
+        bool murmur;
+        bool incremental;
+
+        int remaining;  // jobs still running on the worker pool, guarded by m
+        mongo::mutex m;
+        boost::condition done;
+    };
+
     DBHashCmd::DBHashCmd()
         : Command( "dbHash", false, "dbhash" ),
-          _cachedHashedMutex( "_cachedHashedMutex" ){
+          _cachedHashedMutex( "_cachedHashedMutex" ),
+          _workers( NULL ),
+          _workersMutex( "dbHashWorkers" ) {
     }
 
     void DBHashCmd::addRequiredPrivileges(const std::string& dbname,
@@ -66,26 +197,32 @@ namespace mongo {
         out->push_back(Privilege(ResourcePattern::forDatabaseName(dbname), actions));
     }
 
-    string DBHashCmd::hashCollection( const string& fullCollectionName, bool* fromCache ) {
-
-        scoped_ptr<scoped_lock> cachedHashedLock;
-
-        if ( isCachable( fullCollectionName ) ) {
-            cachedHashedLock.reset( new scoped_lock( _cachedHashedMutex ) );
-            string hash = _cachedHashed[fullCollectionName];
-            if ( hash.size() > 0 ) {
-                *fromCache = true;
-                return hash;
+    void DBHashCmd::hashCollection( const HashBatch& batch, HashJob* job ) {
+        const string& fullCollectionName = job->fullCollectionName;
+
+        bool cachable = isCachable( fullCollectionName ) && !batch.murmur && !batch.incremental;
+        if ( cachable ) {
+            scoped_lock lk( _cachedHashedMutex );
+            map<string,string>::const_iterator i = _cachedHashed.find( fullCollectionName );
+            if ( i != _cachedHashed.end() ) {
+                job->hash = i->second;
+                job->fromCache = true;
+                return;
             }
         }
 
-        *fromCache = false;
         Collection* collection = cc().database()->getCollection( fullCollectionName );
         if ( !collection )
-            return "";
+            return;
 
         IndexDescriptor* desc = collection->getIndexCatalog()->findIdIndex();
 
+        // capped collections drop old documents without logging them, so can't be cached
+        if ( desc && batch.incremental && !collection->isCapped() ) {
+            job->hash = hashCollectionIncremental( collection, desc, batch.murmur, job );
+            return;
+        }
+
         auto_ptr<Runner> runner;
         if ( desc ) {
             runner.reset(InternalPlanner::indexScan(collection,
@@ -101,32 +238,176 @@ namespace mongo {
         }
         else {
             log() << "can't find _id index for: " << fullCollectionName << endl;
-            return "no _id _index";
+            job->hash = "no _id _index";
+            return;
         }
 
-        md5_state_t st;
-        md5_init(&st);
+        DocumentHasher hasher( batch.murmur );
 
         long long n = 0;
         Runner::RunnerState state;
         BSONObj c;
         verify(NULL != runner.get());
         while (Runner::RUNNER_ADVANCED == (state = runner->getNext(&c, NULL))) {
-            md5_append( &st , (const md5_byte_t*)c.objdata() , c.objsize() );
+            hasher.append( c );
             n++;
         }
         if (Runner::RUNNER_EOF != state) {
             warning() << "error while hashing, db dropped? ns=" << fullCollectionName << endl;
         }
+        job->hash = hasher.finish();
+
+        if ( cachable ) {
+            scoped_lock lk( _cachedHashedMutex );
+            _cachedHashed[fullCollectionName] = job->hash;
+        }
+    }
+
+    string DBHashCmd::hashCollectionIncremental( Collection* collection,
+                                                 const IndexDescriptor* idIndex,
+                                                 bool murmur,
+                                                 HashJob* job ) {
+        const string& ns = job->fullCollectionName;
+
+        RangeCacheShard& shard = rangeCacheShard( ns );
+
+        vector<HashRange> cached;
+        {
+            scoped_lock lk( shard.m );
+            map<string,RangeCache>::const_iterator i = shard.caches.find( ns );
+            if ( i != shard.caches.end() && i->second.murmur == murmur )
+                cached = i->second.ranges;
+        }
+        if ( cached.empty() ) {
+            // a single dirty tail range covers the whole collection
+            cached.push_back( HashRange() );
+        }
+
+        vector<HashRange> ranges;
+        BSONObj after;  // last _id already accounted for, empty before the first range
+        size_t next = 0;
+        while ( next < cached.size() ) {
+            if ( !cached[next].dirty ) {
+                ranges.push_back( cached[next] );
+                after = cached[next].end;
+                next++;
+                job->rangesReused++;
+                continue;
+            }
+
+            // Rehash from just past 'after' until a new boundary lines up with the end of a
+            // cached range that is followed by a clean one, or to the end of the collection.
+            auto_ptr<Runner> runner( InternalPlanner::indexScan( collection,
+                                                                 idIndex,
+                                                                 after,
+                                                                 BSONObj(),
+                                                                 false,
+                                                                 InternalPlanner::FORWARD,
+                                                                 InternalPlanner::IXSCAN_FETCH ) );
+            DocumentHasher hasher( murmur );
+            HashRange range;
+            bool first = true;
+            bool resynced = false;
+            Runner::RunnerState state;
+            BSONObj doc;
+            while ( Runner::RUNNER_ADVANCED == ( state = runner->getNext( &doc, NULL ) ) ) {
+                BSONElement id = doc["_id"];
+                if ( first ) {
+                    first = false;
+                    // the scan starts at 'after' inclusive
+                    if ( !after.isEmpty() && after.firstElement().woCompare( id, false ) == 0 )
+                        continue;
+                }
+
+                hasher.append( doc );
+                range.numDocs++;
+                if ( !isRangeBoundary( id ) )
+                    continue;
+
+                range.end = id.wrap( "" );
+                range.digest = hasher.finish();
+                range.dirty = false;
+                ranges.push_back( range );
+                job->rangesRehashed++;
+
+                bool aligned = false;
+                while ( next < cached.size() - 1 ) {
+                    int cmp = cached[next].end.woCompare( range.end, BSONObj(), false );
+                    if ( cmp > 0 )
+                        break;
+                    aligned = cmp == 0;
+                    next++;
+                }
+
+                hasher = DocumentHasher( murmur );
+                range = HashRange();
+
+                if ( aligned && !cached[next].dirty ) {
+                    after = ranges.back().end;
+                    resynced = true;
+                    break;
+                }
+            }
+            if ( resynced )
+                continue;
+
+            if ( Runner::RUNNER_EOF != state ) {
+                warning() << "error while hashing, db dropped? ns=" << ns << endl;
+            }
+            range.digest = hasher.finish();
+            range.dirty = false;
+            ranges.push_back( range );
+            job->rangesRehashed++;
+            next = cached.size();
+        }
+
+        md5_state_t st;
+        md5_init( &st );
+        for ( vector<HashRange>::const_iterator i = ranges.begin(); i != ranges.end(); ++i ) {
+            md5_append( &st, (const md5_byte_t*)i->digest.c_str(), i->digest.size() );
+        }
         md5digest d;
-        md5_finish(&st, d);
-        string hash = digestToString( d );
+        md5_finish( &st, d );
+
+        {
+            scoped_lock lk( shard.m );
+            RangeCache& entry = shard.caches[ns];
+            entry.murmur = murmur;
+            entry.ranges.swap( ranges );
+            shard.size.store( shard.caches.size() );
+        }
 
-        if ( cachedHashedLock.get() ) {
-            _cachedHashed[fullCollectionName] = hash;
+        return digestToString( d );
+    }
+
+    void DBHashCmd::runJob( HashBatch* batch, HashJob* job ) {
+        // Only do this once per thread
+        if ( !ClientBasic::getCurrent() ) {
+            string threadName = str::stream() << "dbHash worker " << dbHashWorkerId.addAndFetch( 1 );
+            Client::initThread( threadName.c_str() );
         }
 
-        return hash;
+        try {
+            Client::ReadContext ctx( job->fullCollectionName );
+            hashCollection( *batch, job );
+        }
+        catch ( const DBException& e ) {
+            job->error = e.toString();
+        }
+        catch ( const std::exception& e ) {
+            job->error = e.what();
+        }
+
+        scoped_lock lk( batch->m );
+        if ( --batch->remaining == 0 )
+            batch->done.notify_one();
+    }
+
+    threadpool::ThreadPool* DBHashCmd::workerPool() {
+        scoped_lock lk( _workersMutex );
+        if ( !_workers )
+            _workers = new threadpool::ThreadPool( dbHashThreads );
+        return _workers;
     }
 
     bool DBHashCmd::run(const string& dbname , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
@@ -145,8 +426,23 @@ namespace mongo {
             }
         }
 
+        HashBatch batch;
+        BSONElement algorithm = cmdObj["hashAlgorithm"];
+        if ( !algorithm.eoo() ) {
+            if ( algorithm.type() != String ||
+                 ( algorithm.String() != "md5" && algorithm.String() != "murmur3" ) ) {
+                errmsg = "hashAlgorithm must be \"md5\" or \"murmur3\"";
+                return false;
+            }
+            batch.murmur = algorithm.String() == "murmur3";
+        }
+        batch.incremental = cmdObj["incremental"].trueValue();
+        bool parallel = cmdObj["parallel"].trueValue();
+
+        scoped_ptr<Client::ReadContext> ctx( new Client::ReadContext( dbname ) );
+
         list<string> colls;
-        Database* db = cc().database();
+        Database* db = ctx->ctx().db();
         if ( db )
             db->namespaceIndex().getNamespaces( colls );
         colls.sort();
@@ -154,12 +450,7 @@ namespace mongo {
         result.appendNumber( "numCollections" , (long long)colls.size() );
         result.append( "host" , prettyHostName() );
 
-        md5_state_t globalState;
-        md5_init(&globalState);
-
-        vector<string> cached;
-
-        BSONObjBuilder bb( result.subobjStart( "collections" ) );
+        vector<HashJob> jobs;
         for ( list<string>::iterator i=colls.begin(); i != colls.end(); i++ ) {
             string fullCollectionName = *i;
             if ( fullCollectionName.size() -1 <= dbname.size() ) {
@@ -175,14 +466,54 @@ namespace mongo {
                  desiredCollections.count( shortCollectionName ) == 0 )
                 continue;
 
-            bool fromCache = false;
-            string hash = hashCollection( fullCollectionName, &fromCache );
+            jobs.push_back( HashJob() );
+            jobs.back().fullCollectionName = fullCollectionName;
+        }
 
-            bb.append( shortCollectionName, hash );
+        if ( parallel && dbHashThreads > 1 && jobs.size() > 1 ) {
+            // Each worker read locks the database for just its own collection, so writes can
+            // land between collections and the result isn't a single consistent snapshot.
+            ctx.reset();
 
-            md5_append( &globalState , (const md5_byte_t*)hash.c_str() , hash.size() );
-            if ( fromCache )
-                cached.push_back( fullCollectionName );
+            threadpool::ThreadPool* pool = workerPool();
+            batch.remaining = jobs.size();
+            for ( size_t i = 0; i < jobs.size(); i++ ) {
+                pool->schedule( &DBHashCmd::runJob, this, &batch, &jobs[i] );
+            }
+
+            scoped_lock lk( batch.m );
+            while ( batch.remaining > 0 )
+                batch.done.wait( lk.boost() );
+        }
+        else {
+            for ( size_t i = 0; i < jobs.size(); i++ ) {
+                hashCollection( batch, &jobs[i] );
+            }
+        }
+
+        md5_state_t globalState;
+        md5_init(&globalState);
+
+        vector<string> cached;
+        long long rangesReused = 0;
+        long long rangesRehashed = 0;
+
+        BSONObjBuilder bb( result.subobjStart( "collections" ) );
+        for ( size_t i = 0; i < jobs.size(); i++ ) {
+            const HashJob& job = jobs[i];
+            if ( !job.error.empty() ) {
+                errmsg = str::stream() << "error hashing " << job.fullCollectionName << ": "
+                                       << job.error;
+                return false;
+            }
+
+            bb.append( job.fullCollectionName.substr( dbname.size() + 1 ), job.hash );
+
+            md5_append( &globalState , (const md5_byte_t*)job.hash.c_str() , job.hash.size() );
+            if ( job.fromCache )
+                cached.push_back( job.fullCollectionName );
+            rangesReused += job.rangesReused;
+            rangesRehashed += job.rangesRehashed;
         }
         bb.done();
 
@@ -195,18 +526,102 @@ namespace mongo {
 
         result.append( "fromCache", cached );
 
+        if ( !algorithm.eoo() )
+            result.append( "hashAlgorithm", batch.murmur ? "murmur3" : "md5" );
+        if ( batch.incremental ) {
+            result.append( "incremental", BSON( "rangesReused" << rangesReused <<
+                                                "rangesRehashed" << rangesRehashed ) );
+        }
+
         return 1;
     }
 
     void DBHashCmd::wipeCacheForCollection( const StringData& ns ) {
-        if ( !isCachable( ns ) )
+        if ( isCachable( ns ) ) {
+            scoped_lock lk( _cachedHashedMutex );
+            _cachedHashed.erase( ns.toString() );
+        }
+
+        RangeCacheShard& shard = rangeCacheShard( ns );
+        if ( shard.size.load() == 0 )
             return;
-        scoped_lock lk( _cachedHashedMutex );
-        _cachedHashed.erase( ns.toString() );
+        scoped_lock lk( shard.m );
+        shard.caches.erase( ns.toString() );
+        shard.size.store( shard.caches.size() );
+    }
+
+    bool DBHashCmd::rangeEndsBefore( const HashRange& range, const BSONObj& key ) {
+        return range.end.woCompare( key, BSONObj(), false ) < 0;
+    }
+
+    void DBHashCmd::wipeCacheForDocument( const StringData& ns, const BSONElement& id ) {
+        if ( isCachable( ns ) ) {
+            scoped_lock lk( _cachedHashedMutex );
+            _cachedHashed.erase( ns.toString() );
+        }
+
+        RangeCacheShard& shard = rangeCacheShard( ns );
+        if ( shard.size.load() == 0 )
+            return;
+        scoped_lock lk( shard.m );
+        map<string,RangeCache>::iterator i = shard.caches.find( ns.toString() );
+        if ( i == shard.caches.end() )
+            return;
+
+        // the tail range is unbounded, so only the ones before it need searching
+        vector<HashRange>& ranges = i->second.ranges;
+        vector<HashRange>::iterator range = std::lower_bound( ranges.begin(),
+                                                              ranges.end() - 1,
+                                                              id.wrap( "" ),
+                                                              rangeEndsBefore );
+        range->dirty = true;
+    }
+
+    void DBHashCmd::wipeCacheForDatabase( const StringData& dbname ) {
+        string prefix = dbname.toString() + ".";
+        {
+            scoped_lock lk( _cachedHashedMutex );
+            for ( map<string,string>::iterator i = _cachedHashed.lower_bound( prefix );
+                  i != _cachedHashed.end() && StringData( i->first ).startsWith( prefix ); ) {
+                _cachedHashed.erase( i++ );
+            }
+        }
+
+        for ( int s = 0; s < kRangeCacheShards; s++ ) {
+            RangeCacheShard& shard = _rangeCacheShards[s];
+            if ( shard.size.load() == 0 )
+                continue;
+            scoped_lock lk( shard.m );
+            for ( map<string,RangeCache>::iterator i = shard.caches.lower_bound( prefix );
+                  i != shard.caches.end() && StringData( i->first ).startsWith( prefix ); ) {
+                shard.caches.erase( i++ );
+            }
+            shard.size.store( shard.caches.size() );
+        }
+    }
+
+    void DBHashCmd::wipeAllCaches() {
+        {
+            scoped_lock lk( _cachedHashedMutex );
+            _cachedHashed.clear();
+        }
+
+        for ( int s = 0; s < kRangeCacheShards; s++ ) {
+            RangeCacheShard& shard = _rangeCacheShards[s];
+            scoped_lock lk( shard.m );
+            shard.caches.clear();
+            shard.size.store( 0 );
+        }
     }
 
     bool DBHashCmd::isCachable( const StringData& ns ) const {
         return ns.startsWith( "config." );
     }
 
+    DBHashCmd::RangeCacheShard& DBHashCmd::rangeCacheShard( const StringData& ns ) {
+        uint32_t h;
+        MurmurHash3_x86_32( ns.rawData(), ns.size(), 0, &h );
+        return _rangeCacheShards[h % kRangeCacheShards];
+    }
+
 }
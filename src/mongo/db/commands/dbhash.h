@@ -31,9 +31,14 @@
 #pragma once
 
 #include "mongo/db/commands.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
 
+    class Collection;
+    class IndexDescriptor;
+
     void logOpForDbHash( const char* opstr,
                          const char* ns,
                          const BSONObj& obj,
@@ -41,12 +46,20 @@ namespace mongo {
                          const BSONObj* fullObj,
                          bool forMigrateCleanup );
 
+    /**
+     * Drops cached dbhash state for writes that don't go through logOp.  'ns' may be a
+     * collection, a database name (or its $cmd namespace) for every collection in it, or empty
+     * for everything.
+     */
+    void wipeDbHashCache( const StringData& ns );
+
     class DBHashCmd : public Command {
     public:
         DBHashCmd();
 
         virtual bool slaveOk() const { return true; }
-        virtual LockType locktype() const { return READ; }
+        // read locks the database itself, or one collection at a time per worker when parallel
+        virtual LockType locktype() const { return NONE; }
         virtual void addRequiredPrivileges(const std::string& dbname,
                                            const BSONObj& cmdObj,
                                            std::vector<Privilege>* out);
@@ -55,15 +68,80 @@ namespace mongo {
 
         void wipeCacheForCollection( const StringData& ns );
 
+        /** Marks the cached range holding the document with _id 'id' as needing a rehash. */
+        void wipeCacheForDocument( const StringData& ns, const BSONElement& id );
+
+        void wipeCacheForDatabase( const StringData& dbname );
+
+        void wipeAllCaches();
+
     private:
 
+        /**
+         * A run of documents in _id order, ending with a document whose _id hashes to a range
+         * boundary.  Boundaries depend only on the _ids, so every member of a replica set
+         * splits a collection the same way.
+         */
+        struct HashRange {
+            HashRange() : numDocs( 0 ), dirty( true ) {}
+
+            BSONObj end;      // {"": _id} of the last document, empty for the tail range
+            string digest;
+            long long numDocs;
+            bool dirty;
+        };
+
+        struct RangeCache {
+            RangeCache() : murmur( false ) {}
+
+            bool murmur;
+            vector<HashRange> ranges;  // in _id order, the last one is always the tail
+        };
+
+        /**
+         * Range caches are spread over several shards by namespace, so writes to different
+         * collections don't all serialize on one mutex.  'size' is readable without the mutex,
+         * so writes to a shard with nothing cached don't lock at all.
+         */
+        struct RangeCacheShard {
+            RangeCacheShard() : m( "dbHashRangeCache" ) {}
+
+            mongo::mutex m;
+            map<string,RangeCache> caches;
+            AtomicUInt32 size;
+        };
+
+        enum { kRangeCacheShards = 32 };
+
+        struct HashJob;
+        struct HashBatch;
+
         bool isCachable( const StringData& ns ) const;
 
-        string hashCollection( const string& fullCollectionName, bool* fromCache );
+        RangeCacheShard& rangeCacheShard( const StringData& ns );
+
+        static bool rangeEndsBefore( const HashRange& range, const BSONObj& key );
+
+        /** Hashes one collection; the caller holds a read lock on its database. */
+        void hashCollection( const HashBatch& batch, HashJob* job );
+
+        string hashCollectionIncremental( Collection* collection,
+                                          const IndexDescriptor* idIndex,
+                                          bool murmur,
+                                          HashJob* job );
+
+        void runJob( HashBatch* batch, HashJob* job );
+
+        threadpool::ThreadPool* workerPool();
 
         map<string,string> _cachedHashed;
         mutex _cachedHashedMutex;
 
+        RangeCacheShard _rangeCacheShards[kRangeCacheShards];
+
+        threadpool::ThreadPool* _workers;  // created on first use, never deleted
+        mutex _workersMutex;
+
     };
 
 }
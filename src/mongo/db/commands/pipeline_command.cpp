@@ -115,6 +115,7 @@ namespace {
 
     private:
         boost::optional<BSONObj> getNextBson() {
+            BlockArena::Scope arenaScope(_pipeline->getArena());
             if (boost::optional<Document> next = _pipeline->output()->getNext()) {
                 if (_includeMetaData) {
                     return next->toBsonWithMetaData();
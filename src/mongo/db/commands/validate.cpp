@@ -28,17 +28,302 @@
  *    it in the license file.
  */
 
+#include <algorithm>
+
 #include "mongo/db/commands.h"
+#include "mongo/db/curop.h"
+#include "mongo/db/index/index_access_method.h"
+#include "mongo/db/index/index_cursor.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/query/runner.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/storage/extent.h"
+#include "mongo/db/structure/btree/btree.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
 
+    namespace {
+
+        int validateThreads = 4;
+
+        class ExportedValidateThreadsParameter : public ExportedServerParameter<int> {
+        public:
+            ExportedValidateThreadsParameter() :
+                ExportedServerParameter<int>( ServerParameterSet::getGlobal(),
+                                              "validateThreads",
+                                              &validateThreads,
+                                              true,
+                                              false ) {}
+
+            virtual Status validate( const int& potentialNewValue ) {
+                if ( potentialNewValue < 1 || potentialNewValue > 64 ) {
+                    return Status( ErrorCodes::BadValue,
+                                   "validateThreads must be between 1 and 64" );
+                }
+                return Status::OK();
+            }
+        } exportedValidateThreadsParam;
+
+        mongo::mutex validatePoolMutex( "validatePool" );
+        threadpool::ThreadPool* validatePool = NULL; // created on first use, never deleted
+
+        threadpool::ThreadPool* getValidatePool() {
+            scoped_lock lk( validatePoolMutex );
+            if ( !validatePool )
+                validatePool = new threadpool::ThreadPool( validateThreads );
+            return validatePool;
+        }
+
+        AtomicUInt32 validateWorkerId;
+
+        // only this many deleted records are remembered for the records-in-deleted-list check
+        const size_t kMaxDeletedToCheck = 1000000;
+
+        inline uint64_t hashLoc( const DiskLoc& loc ) {
+            uint64_t h = ( static_cast<uint64_t>( static_cast<uint32_t>( loc.a() ) ) << 32 )
+                         | static_cast<uint32_t>( loc.getOfs() );
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /**
+         * Index entries pointing at records, as a count and an order independent sum of the
+         * hashed record locations.  Tallied once from the documents' generated keys and once
+         * from the index itself, the two agree unless an entry is missing, extra or points at
+         * the wrong record.
+         */
+        struct KeyTally {
+            KeyTally() : keys( 0 ), locSum( 0 ) {}
+
+            void add( const DiskLoc& loc, size_t n ) {
+                keys += n;
+                locSum += n * hashLoc( loc );
+            }
+
+            void add( const KeyTally& other ) {
+                keys += other.keys;
+                locSum += other.locSum;
+            }
+
+            bool operator==( const KeyTally& other ) const {
+                return keys == other.keys && locSum == other.locSum;
+            }
+
+            long long keys;
+            uint64_t locSum;
+        };
+
+        /** Shared by every extent scan of one validate. */
+        struct RecordScanBatch {
+            RecordScanBatch() : full( false ), deleted( NULL ), remaining( 0 ),
+                                m( "validateBatch" ) {}
+
+            bool full;
+            vector<IndexAccessMethod*> indexes;  // to generate keys for, empty for no cross-check
+            vector<int> keyMax;                  // parallel to indexes
+            const vector<DiskLoc>* deleted;      // sorted, NULL when not checking
+
+            AtomicUInt64 recordsScanned;
+            AtomicUInt32 cancelled;
+
+            int remaining;  // scans still queued or running on the pool, guarded by m
+            mongo::mutex m;
+            boost::condition done;
+        };
+
+        /** The records of one extent, scanned on its own. */
+        struct ExtentScan {
+            ExtentScan() : extent( NULL ), n( 0 ), nInvalid( 0 ), nQuantizedSize( 0 ),
+                           nPowerOf2QuantizedSize( 0 ), len( 0 ), nlen( 0 ), bsonLen( 0 ),
+                           inDeletedList( 0 ) {}
+
+            DiskLoc extentLoc;
+            Extent* extent;
+
+            long long n;
+            long long nInvalid;
+            long long nQuantizedSize;
+            long long nPowerOf2QuantizedSize;
+            long long len;
+            long long nlen;
+            long long bsonLen;
+            long long inDeletedList;
+            vector<KeyTally> tallies;  // parallel to RecordScanBatch::indexes
+            vector<KeyTally> oversized;  // the part of 'tallies' that may be too large to index
+            vector<string> errors;
+        };
+
+        /**
+         * Walks the records of one extent.  Touches nothing but the extent's own mapped memory,
+         * so it can run on a thread without the database lock while the validating thread holds
+         * it.
+         */
+        void scanExtent( const string& ns, RecordScanBatch* batch, ExtentScan* scan ) {
+            Extent* e = scan->extent;
+            const DiskLoc& extentLoc = scan->extentLoc;
+            scan->tallies.resize( batch->indexes.size() );
+            scan->oversized.resize( batch->indexes.size() );
+
+            const int maxRecords = e->length / Record::HeaderSize;
+            int k = 0;
+            DiskLoc loc = e->firstRecord;
+            BSONObjSet keys;
+            while ( !loc.isNull() ) {
+                if ( !loc.sameFile( extentLoc ) ||
+                     loc.getOfs() <= extentLoc.getOfs() ||
+                     loc.getOfs() >= extentLoc.getOfs() + e->length ||
+                     ++k > maxRecords ) {
+                    scan->errors.push_back( str::stream() << "bad record pointer "
+                                            << loc.toString() << " in extent "
+                                            << extentLoc.toString() );
+                    return;
+                }
+
+                Record* r = e->getRecord( loc );
+                scan->n++;
+                scan->len += r->lengthWithHeaders();
+                scan->nlen += r->netLength();
+
+                if ( r->lengthWithHeaders() ==
+                        NamespaceDetails::quantizeAllocationSpace( r->lengthWithHeaders() ) ) {
+                    ++scan->nQuantizedSize;
+                }
+                // See SERVER-8311 for why this is checked against lengthWithHeaders() - 1.
+                if ( r->lengthWithHeaders() ==
+                        NamespaceDetails::quantizePowerOf2AllocationSpace
+                            ( r->lengthWithHeaders() - 1 ) ) {
+                    ++scan->nPowerOf2QuantizedSize;
+                }
+
+                if ( batch->deleted &&
+                     std::binary_search( batch->deleted->begin(), batch->deleted->end(), loc ) ) {
+                    scan->inDeletedList++;
+                }
+
+                if ( batch->full ) {
+                    BSONObj obj = BSONObj::make( r );
+                    const Status status = validateBSON( obj.objdata(), obj.objsize() );
+                    if ( !status.isOK() ) {
+                        scan->nInvalid++;
+                        log() << "Invalid bson detected in " << ns << ": " << status.reason();
+                    }
+                    else {
+                        scan->bsonLen += obj.objsize();
+                        for ( size_t i = 0; i < batch->indexes.size(); i++ ) {
+                            keys.clear();
+                            batch->indexes[i]->getIndexedKeys( obj, &keys );
+                            scan->tallies[i].add( loc, keys.size() );
+                            for ( BSONObjSet::const_iterator k = keys.begin(); k != keys.end();
+                                  ++k ) {
+                                if ( k->objsize() > batch->keyMax[i] )
+                                    scan->oversized[i].add( loc, 1 );
+                            }
+                        }
+                    }
+                }
+
+                if ( ( scan->n & 1023 ) == 0 ) {
+                    batch->recordsScanned.fetchAndAdd( 1024 );
+                    if ( batch->cancelled.load() )
+                        return;
+                }
+
+                int next = r->nextOfs();
+                if ( next == DiskLoc::NullOfs )
+                    break;
+                loc = DiskLoc( loc.a(), next );
+            }
+            batch->recordsScanned.fetchAndAdd( scan->n & 1023 );
+        }
+
+        /** Tallies every entry of an index, for comparison with the keys its documents generate. */
+        void tallyIndex( IndexAccessMethod* iam, KeyTally* tally ) {
+            IndexCursor* raw;
+            uassertStatusOK( iam->newCursor( &raw ) );
+            scoped_ptr<IndexCursor> cursor( raw );
+            uassertStatusOK( cursor->seek( BSONObj() ) );
+            for ( ; !cursor->isEOF(); cursor->next() ) {
+                tally->add( cursor->getValue(), 1 );
+                RARELY killCurrentOp.checkForInterrupt();
+            }
+        }
+
+        void runExtentScan( const string& ns, RecordScanBatch* batch, ExtentScan* scan ) {
+            // Only do this once per thread
+            if ( !ClientBasic::getCurrent() ) {
+                string threadName = str::stream() << "validate worker "
+                                                  << validateWorkerId.addAndFetch( 1 );
+                Client::initThread( threadName.c_str() );
+            }
+
+            if ( !batch->cancelled.load() ) {
+                try {
+                    scanExtent( ns, batch, scan );
+                }
+                catch ( const std::exception& e ) {
+                    scan->errors.push_back( str::stream() << "exception scanning extent "
+                                            << scan->extentLoc.toString() << ": " << e.what() );
+                }
+            }
+
+            scoped_lock lk( batch->m );
+            if ( --batch->remaining == 0 )
+                batch->done.notify_one();
+        }
+
+        /**
+         * Waits for every scheduled extent scan on the way out of scope, cancelling the ones
+         * not yet finished if we are leaving early; they read through pointers that are only
+         * valid while this thread holds the database lock.
+         */
+        class ExtentScanWaiter : boost::noncopyable {
+        public:
+            explicit ExtentScanWaiter( RecordScanBatch* batch ) : _batch( batch ) {}
+
+            ~ExtentScanWaiter() {
+                _batch->cancelled.store( 1 );
+                scoped_lock lk( _batch->m );
+                while ( _batch->remaining > 0 )
+                    _batch->done.wait( lk.boost() );
+            }
+
+            /** Waits for the scans to finish, reporting progress on 'pm' as they go. */
+            void waitWithProgress( ProgressMeterHolder& pm ) {
+                unsigned long long reported = 0;
+                while ( true ) {
+                    killCurrentOp.checkForInterrupt();
+
+                    unsigned long long scanned = _batch->recordsScanned.load();
+                    if ( scanned > reported ) {
+                        pm.hit( static_cast<int>( scanned - reported ) );
+                        reported = scanned;
+                    }
+
+                    scoped_lock lk( _batch->m );
+                    if ( _batch->remaining == 0 )
+                        return;
+                    _batch->done.timed_wait( lk.boost(), boost::posix_time::milliseconds( 100 ) );
+                    if ( _batch->remaining == 0 )
+                        return;
+                }
+            }
+
+        private:
+            RecordScanBatch* _batch;
+        };
+
+    }  // namespace
+
     class ValidateCmd : public Command {
     public:
         ValidateCmd() : Command( "validate" ) {}
@@ -48,7 +333,7 @@ namespace mongo {
         }
 
         virtual void help(stringstream& h) const { h << "Validate contents of a namespace by scanning its data structures for correctness.  Slow.\n"
-                                                        "Add full:true option to do a more thorough check"; }
+                                                        "Add full:true option to do a more thorough check, including that every index holds exactly the keys its documents generate"; }
 
         virtual LockType locktype() const { return READ; }
         virtual void addRequiredPrivileges(const std::string& dbname,
@@ -97,6 +382,7 @@ namespace mongo {
 
             bool valid = true;
             BSONArrayBuilder errors; // explanation(s) for why valid = false
+            BSONArrayBuilder warnings; // problems that don't make the collection invalid
             if ( collection->isCapped() ){
                 result.append("capped", nsd->isCapped());
                 result.appendNumber("max", nsd->maxCappedDocs());
@@ -115,6 +401,7 @@ namespace mongo {
 
             BSONArrayBuilder extentData;
             int extentCount = 0;
+            vector<DiskLoc> extentLocs;
             try {
 
                 if ( !nsd->firstExtent().isNull() ) {
@@ -125,6 +412,7 @@ namespace mongo {
                 DiskLoc extentDiskLoc = nsd->firstExtent();
                 while (!extentDiskLoc.isNull()) {
                     Extent* thisExtent = extentDiskLoc.ext();
+                    extentLocs.push_back(extentDiskLoc);
                     if (full) {
                         extentData << thisExtent->dump();
                     }
@@ -215,99 +503,9 @@ namespace mongo {
                     valid = false;
                 }
 
-                set<DiskLoc> recs;
-                if( scanData ) {
-                    int n = 0;
-                    int nInvalid = 0;
-                    long long nQuantizedSize = 0;
-                    long long nPowerOf2QuantizedSize = 0;
-                    long long len = 0;
-                    long long nlen = 0;
-                    long long bsonLen = 0;
-                    int outOfOrder = 0;
-                    DiskLoc cl_last;
-
-                    DiskLoc cl;
-                    Runner::RunnerState state;
-                    auto_ptr<Runner> runner(InternalPlanner::collectionScan(ns));
-                    while (Runner::RUNNER_ADVANCED == (state = runner->getNext(NULL, &cl))) {
-                        n++;
-
-                        if ( n < 1000000 )
-                            recs.insert(cl);
-                        if ( nsd->isCapped() ) {
-                            if ( cl < cl_last )
-                                outOfOrder++;
-                            cl_last = cl;
-                        }
-
-                        Record *r = cl.rec();
-                        len += r->lengthWithHeaders();
-                        nlen += r->netLength();
-                        
-                        if ( r->lengthWithHeaders() ==
-                                NamespaceDetails::quantizeAllocationSpace
-                                    ( r->lengthWithHeaders() ) ) {
-                            // Count the number of records having a size consistent with
-                            // the quantizeAllocationSpace quantization implementation.
-                            ++nQuantizedSize;
-                        }
-
-                        if ( r->lengthWithHeaders() ==
-                                NamespaceDetails::quantizePowerOf2AllocationSpace
-                                    ( r->lengthWithHeaders() - 1 ) ) {
-                            // Count the number of records having a size consistent with the
-                            // quantizePowerOf2AllocationSpace quantization implementation.
-                            // Because of SERVER-8311, power of 2 quantization is not idempotent and
-                            // r->lengthWithHeaders() - 1 must be checked instead of the record
-                            // length itself.
-                            ++nPowerOf2QuantizedSize;
-                        }
-
-                        if (full){
-                            BSONObj obj = BSONObj::make(r);
-                            const Status status = validateBSON(obj.objdata(), obj.objsize());
-                            if (!status.isOK()) {
-                                valid = false;
-                                if (nInvalid == 0) // only log once;
-                                    errors << "invalid bson object detected (see logs for more info)";
-
-                                nInvalid++;
-                                log() << "Invalid bson detected in " << ns
-                                      << ": " << status.reason();
-                            }
-                            else {
-                                bsonLen += obj.objsize();
-                            }
-                        }
-                    }
-                    if (Runner::RUNNER_EOF != state) {
-                        // TODO: more descriptive logging.
-                        warning() << "Internal error while reading collection " << ns << endl;
-                    }
-                    if ( nsd->isCapped() && !nsd->capLooped() ) {
-                        result.append("cappedOutOfOrder", outOfOrder);
-                        if ( outOfOrder > 1 ) {
-                            valid = false;
-                            errors << "too many out of order records";
-                        }
-                    }
-                    result.append("objectsFound", n);
-
-                    if (full) {
-                        result.append("invalidObjects", nInvalid);
-                    }
-
-                    result.appendNumber("nQuantizedSize", nQuantizedSize);
-                    result.appendNumber("nPowerOf2QuantizedSize", nPowerOf2QuantizedSize);
-                    result.appendNumber("bytesWithHeaders", len);
-                    result.appendNumber("bytesWithoutHeaders", nlen);
-
-                    if (full) {
-                        result.appendNumber("bytesBson", bsonLen);
-                    }
-                }
-
+                // The deleted lists are walked first so the record scan can look for records
+                // that are also on them.
+                vector<DiskLoc> deletedLocs;
                 BSONArrayBuilder deletedListArray;
                 for ( int i = 0; i < Buckets; i++ ) {
                     deletedListArray << nsd->deletedListEntry(i).isNull();
@@ -316,14 +514,13 @@ namespace mongo {
                 int ndel = 0;
                 long long delSize = 0;
                 BSONArrayBuilder delBucketSizes;
-                int incorrect = 0;
                 for ( int i = 0; i < Buckets; i++ ) {
                     DiskLoc loc = nsd->deletedListEntry(i);
                     try {
                         int k = 0;
                         while ( !loc.isNull() ) {
-                            if ( recs.count(loc) )
-                                incorrect++;
+                            if ( scanData && deletedLocs.size() < kMaxDeletedToCheck )
+                                deletedLocs.push_back( loc );
                             ndel++;
 
                             if ( loc.questionable() ) {
@@ -356,23 +553,56 @@ namespace mongo {
                         valid = false;
                     }
                 }
-                result.appendNumber("deletedCount", ndel);
-                result.appendNumber("deletedSize", delSize);
-                if ( full ) {
-                    result << "delBucketSizes" << delBucketSizes.arr();
+                std::sort( deletedLocs.begin(), deletedLocs.end() );
+
+                // Records are scanned an extent at a time on the validate pool while this thread,
+                // which holds the lock the scans rely on, walks the indexes.  With full:true the
+                // scans also generate every document's index keys to cross check the indexes.
+                IndexCatalog* indexCatalog = collection->getIndexCatalog();
+                RecordScanBatch batch;
+                vector<IndexDescriptor*> crossChecked; // parallel to batch.indexes
+                vector<ExtentScan> scans;
+                if ( scanData ) {
+                    batch.full = full;
+                    batch.deleted = &deletedLocs;
+                    if ( full ) {
+                        IndexCatalog::IndexIterator i = indexCatalog->getIndexIterator(false);
+                        while ( i.more() ) {
+                            IndexDescriptor* descriptor = i.next();
+                            crossChecked.push_back( descriptor );
+                            batch.indexes.push_back( indexCatalog->getIndex( descriptor ) );
+                            // a key's stored form is never larger than its BSON
+                            batch.keyMax.push_back( descriptor->version() == 0 ?
+                                                    BtreeData_V0::KeyMax : BtreeData_V1::KeyMax );
+                        }
+                    }
+
+                    scans.resize( extentLocs.size() );
+                    for ( size_t i = 0; i < extentLocs.size(); i++ ) {
+                        scans[i].extentLoc = extentLocs[i];
+                        scans[i].extent = extentLocs[i].ext();
+                    }
                 }
 
-                if ( incorrect ) {
-                    errors << (BSONObjBuilder::numStr(incorrect) + " records from datafile are in deleted list");
-                    valid = false;
+                ExtentScanWaiter waiter( &batch );
+                const bool parallel = validateThreads > 1 && scans.size() > 1;
+                if ( parallel ) {
+                    threadpool::ThreadPool* pool = getValidatePool();
+                    batch.remaining = scans.size();
+                    for ( size_t i = 0; i < scans.size(); i++ ) {
+                        pool->schedule( runExtentScan, ns, &batch, &scans[i] );
+                    }
                 }
 
+                int nIndexes = indexCatalog->numIndexesReady();
+                BSONObjBuilder indexes; // not using subObjStart to be exception safe
+                vector<KeyTally> indexTallies( batch.indexes.size() );
+                bool indexesWalked = false;
                 int idxn = 0;
                 try  {
-                    IndexCatalog* indexCatalog = collection->getIndexCatalog();
-
-                    result.append("nIndexes", indexCatalog->numIndexesReady() );
-                    BSONObjBuilder indexes; // not using subObjStart to be exception safe
+                    ProgressMeterHolder pm( cc().curop()->setMessage( "validate: walking indexes",
+                                                                      "Validate: Indexes Walked",
+                                                                      nIndexes ) );
                     IndexCatalog::IndexIterator i = indexCatalog->getIndexIterator(false);
                     while( i.more() ) {
                         IndexDescriptor* descriptor = i.next();
@@ -384,15 +614,161 @@ namespace mongo {
                         iam->validate(&keys);
                         indexes.appendNumber(descriptor->indexNamespace(),
                                              static_cast<long long>(keys));
+
+                        if ( idxn < static_cast<int>( indexTallies.size() ) ) {
+                            tallyIndex( iam, &indexTallies[idxn] );
+                        }
                         idxn++;
+                        pm.hit();
                     }
-                    result.append("keysPerIndex", indexes.done());
+                    indexesWalked = true;
                 }
                 catch (...) {
                     errors << ("exception during index validate idxn " + BSONObjBuilder::numStr(idxn));
                     valid=false;
                 }
 
+                if ( scanData ) {
+                    ProgressMeterHolder pm( cc().curop()->setMessage( "validate: scanning records",
+                                                                      "Validate: Records Scanned",
+                                                                      nsd->numRecords() ) );
+                    if ( parallel ) {
+                        waiter.waitWithProgress( pm );
+                    }
+                    else {
+                        for ( size_t i = 0; i < scans.size(); i++ ) {
+                            scanExtent( ns, &batch, &scans[i] );
+                            pm.hit( static_cast<int>( scans[i].n ) );
+                            killCurrentOp.checkForInterrupt();
+                        }
+                    }
+                }
+
+                bool recordsScanned = true;
+                long long incorrect = 0;
+                if( scanData ) {
+                    long long n = 0;
+                    long long nInvalid = 0;
+                    long long nQuantizedSize = 0;
+                    long long nPowerOf2QuantizedSize = 0;
+                    long long len = 0;
+                    long long nlen = 0;
+                    long long bsonLen = 0;
+                    for ( size_t i = 0; i < scans.size(); i++ ) {
+                        const ExtentScan& scan = scans[i];
+                        n += scan.n;
+                        nInvalid += scan.nInvalid;
+                        nQuantizedSize += scan.nQuantizedSize;
+                        nPowerOf2QuantizedSize += scan.nPowerOf2QuantizedSize;
+                        len += scan.len;
+                        nlen += scan.nlen;
+                        bsonLen += scan.bsonLen;
+                        incorrect += scan.inDeletedList;
+                        for ( size_t j = 0; j < scan.errors.size(); j++ ) {
+                            errors << scan.errors[j];
+                            valid = false;
+                            recordsScanned = false;
+                        }
+                    }
+
+                    if ( nInvalid > 0 ) {
+                        errors << "invalid bson object detected (see logs for more info)";
+                        valid = false;
+                    }
+
+                    if ( nsd->isCapped() && !nsd->capLooped() ) {
+                        // only the order of the record locations is needed here
+                        int outOfOrder = 0;
+                        DiskLoc cl_last;
+                        DiskLoc cl;
+                        Runner::RunnerState state;
+                        auto_ptr<Runner> runner(InternalPlanner::collectionScan(ns));
+                        while (Runner::RUNNER_ADVANCED == (state = runner->getNext(NULL, &cl))) {
+                            if ( cl < cl_last )
+                                outOfOrder++;
+                            cl_last = cl;
+                        }
+                        if (Runner::RUNNER_EOF != state) {
+                            // TODO: more descriptive logging.
+                            warning() << "Internal error while reading collection " << ns << endl;
+                        }
+                        result.append("cappedOutOfOrder", outOfOrder);
+                        if ( outOfOrder > 1 ) {
+                            valid = false;
+                            errors << "too many out of order records";
+                        }
+                    }
+                    result.appendNumber("objectsFound", n);
+
+                    if (full) {
+                        result.appendNumber("invalidObjects", nInvalid);
+                    }
+
+                    result.appendNumber("nQuantizedSize", nQuantizedSize);
+                    result.appendNumber("nPowerOf2QuantizedSize", nPowerOf2QuantizedSize);
+                    result.appendNumber("bytesWithHeaders", len);
+                    result.appendNumber("bytesWithoutHeaders", nlen);
+
+                    if (full) {
+                        result.appendNumber("bytesBson", bsonLen);
+                    }
+
+                    if ( nInvalid > 0 )
+                        recordsScanned = false;
+                }
+
+                result.appendNumber("deletedCount", ndel);
+                result.appendNumber("deletedSize", delSize);
+                if ( full ) {
+                    result << "delBucketSizes" << delBucketSizes.arr();
+                }
+
+                if ( incorrect ) {
+                    errors << (BSONObjBuilder::numStr(incorrect) + " records from datafile are in deleted list");
+                    valid = false;
+                }
+
+                result.append("nIndexes", nIndexes);
+                if ( indexesWalked ) {
+                    result.append("keysPerIndex", indexes.done());
+                }
+
+                if ( indexesWalked && recordsScanned ) {
+                    for ( size_t i = 0; i < indexTallies.size(); i++ ) {
+                        KeyTally fromRecords;
+                        KeyTally oversized;
+                        for ( size_t j = 0; j < scans.size(); j++ ) {
+                            fromRecords.add( scans[j].tallies[i] );
+                            oversized.add( scans[j].oversized[i] );
+                        }
+                        if ( fromRecords == indexTallies[i] )
+                            continue;
+
+                        // Keys too large to index are skipped rather than refused when not
+                        // primary, so their absence alone doesn't make the index invalid.
+                        if ( indexTallies[i].keys < fromRecords.keys &&
+                             indexTallies[i].keys >= fromRecords.keys - oversized.keys ) {
+                            warnings << string( str::stream()
+                                                << "index " << crossChecked[i]->indexNamespace()
+                                                << " has " << indexTallies[i].keys
+                                                << " entries but its documents generate "
+                                                << fromRecords.keys << " keys, "
+                                                << oversized.keys
+                                                << " of which may be too large to index" );
+                            continue;
+                        }
+
+                        string err( str::stream() << "index " << crossChecked[i]->indexNamespace()
+                                                  << " has " << indexTallies[i].keys
+                                                  << " entries but its documents generate "
+                                                  << fromRecords.keys << " keys"
+                                                  << ( fromRecords.keys == indexTallies[i].keys ?
+                                                       ", pointing at different records" : "" ) );
+                        errors << err;
+                        valid = false;
+                    }
+                }
+
             }
             catch (AssertionException) {
                 errors << "exception during validate";
@@ -401,6 +777,8 @@ namespace mongo {
 
             result.appendBool("valid", valid);
             result.append("errors", errors.arr());
+            if ( warnings.arrSize() > 0 )
+                result.append("warnings", warnings.arr());
 
             if ( !full ){
                 result.append("warning", "Some checks omitted for speed. use {full:true} option to do more thorough scan.");
@@ -68,6 +68,7 @@
 #include "mongo/db/startup_warnings.h"
 #include "mongo/db/stats/counters.h"
 #include "mongo/db/stats/snapshots.h"
+#include "mongo/db/storage/ephemeral_storage.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/db/ttl.h"
 #include "mongo/platform/process_id.h"
@@ -670,6 +671,11 @@ namespace mongo {
                     boost::filesystem::exists(storageGlobalParams.repairpath));
         }
 
+        // a restarted member would come back with its ephemeral databases empty, which the
+        // rest of the set can't tell from lost data
+        uassert(17412, "ephemeralDatabases can't be used with --replSet",
+                !EphemeralStorage::enabled() || !replSettings.usingReplSets());
+
         // TODO check non-journal subdirs if using directory-per-db
         checkReadAhead(storageGlobalParams.dbpath);
 
@@ -67,6 +67,7 @@
 #include "mongo/db/query/query_planner.h"
 #include "mongo/db/repl/is_master.h"
 #include "mongo/db/repl/oplog.h"
+#include "mongo/db/storage/ephemeral_storage.h"
 #include "mongo/db/write_concern.h"
 #include "mongo/s/d_logic.h"
 #include "mongo/s/d_writeback.h"
@@ -600,6 +601,11 @@ namespace mongo {
             set<string> seen;
             boost::intmax_t totalSize = 0;
             for ( vector< string >::iterator i = dbNames.begin(); i != dbNames.end(); ++i ) {
+                // files left in the dbpath by an ephemeral database's name aren't that
+                // database, which is listed below if it is open
+                if ( EphemeralStorage::isEphemeralDatabase( *i ) )
+                    continue;
+
                 BSONObjBuilder b;
                 b.append( "name", *i );
 
@@ -633,11 +639,21 @@ namespace mongo {
 
                 BSONObjBuilder b;
                 b.append( "name" , name );
-                b.append( "sizeOnDisk" , (double)1.0 );
 
                 {
                     Client::ReadContext ctx( name );
-                    b.appendBool( "empty", ctx.ctx().db()->isEmpty() );
+                    Database* db = ctx.ctx().db();
+                    if ( db->getExtentManager().isEphemeral() ) {
+                        // nothing of it is on disk
+                        b.append( "sizeOnDisk", 0.0 );
+                        b.append( "sizeInMemory",
+                                  (double)( db->fileSize() + db->namespaceIndex().fileLength() ) );
+                        b.appendBool( "ephemeral", true );
+                    }
+                    else {
+                        b.append( "sizeOnDisk" , (double)1.0 );
+                    }
+                    b.appendBool( "empty", db->isEmpty() );
                 }
 
                 dbInfos.push_back( b.obj() );
@@ -1054,6 +1070,11 @@ namespace mongo {
             result.append( "paddingFactor" , nsd->paddingFactor() );
             result.append( "systemFlags" , nsd->systemFlags() );
             result.append( "userFlags" , nsd->userFlags() );
+            if ( nsd->isUserFlagSet( NamespaceDetails::Flag_CompressRecords ) ||
+                 nsd->logicalDataSize() != nsd->dataSize() ) {
+                result.appendNumber( "logicalSize" , nsd->logicalDataSize() / scale );
+                result.appendNumber( "storedSize" , nsd->dataSize() / scale );
+            }
 
             BSONObjBuilder indexSizes;
             result.appendNumber( "totalIndexSize" , getIndexSizeForCollection(dbname, ns, &indexSizes, scale) / scale );
@@ -1081,6 +1102,7 @@ namespace mongo {
             help << 
                 "Sets collection options.\n"
                 "Example: { collMod: 'foo', usePowerOf2Sizes:true }\n"
+                "Example: { collMod: 'foo', compressRecords:true }\n"
                 "Example: { collMod: 'foo', index: {keyPattern: {a: 1}, expireAfterSeconds: 600} }";
         }
         virtual void addRequiredPrivileges(const std::string& dbname,
@@ -1126,6 +1148,28 @@ namespace mongo {
                         result.appendBool( "usePowerOf2Sizes_new", newPowerOf2 );
                     }
                 }
+                else if ( str::equals( "compressRecords", e.fieldName() ) ) {
+                    bool oldCompress = nsd->isUserFlagSet(NamespaceDetails::Flag_CompressRecords);
+                    bool newCompress = e.trueValue();
+
+                    if ( newCompress && nsd->isCapped() ) {
+                        errmsg = "capped collections cannot compress records";
+                        ok = false;
+                        continue;
+                    }
+
+                    if ( oldCompress != newCompress ) {
+                        // only affects documents written from now on; existing records are
+                        // read either way
+                        result.appendBool( "compressRecords_old", oldCompress );
+
+                        newCompress ? nsd->setUserFlag( NamespaceDetails::Flag_CompressRecords ) :
+                                      nsd->clearUserFlag( NamespaceDetails::Flag_CompressRecords );
+                        nsd->syncUserFlags( ns ); // must keep system.namespaces up-to-date
+
+                        result.appendBool( "compressRecords_new", newCompress );
+                    }
+                }
                 else if ( str::equals( "index", e.fieldName() ) ) {
                     BSONObj indexObj = e.Obj();
                     BSONObj keyPattern = indexObj.getObjectField( "keyPattern" );
@@ -1262,6 +1306,8 @@ namespace mongo {
             result.appendNumber( "fileSize" , d->fileSize() / scale );
             if( d )
                 result.appendNumber( "nsSizeMB", (int) d->namespaceIndex().fileLength() / 1024 / 1024 );
+            if( d && d->getExtentManager().isEphemeral() )
+                result.appendBool( "ephemeral", true );
 
             BSONObjBuilder dataFileVersion( result.subobjStart( "dataFileVersion" ) );
             if ( d && !d->isEmpty() ) {
@@ -57,11 +57,13 @@
        PREPLOGBUFFER()
      READLOCK mmmutex
        commitJob.reset()
+     LOCK journalWriteMutex              // waits for the previous commit's writes, if still underway
+     UNLOCK groupCommitMutex             // now the next commit can prep, into the other log buffer
      UNLOCK dbMutex                      // now other threads can write
        WRITETOJOURNAL()
        WRITETODATAFILES()
+     UNLOCK journalWriteMutex
      UNLOCK mmmutex
-     UNLOCK groupCommitMutex
 
    every Nth groupCommit, at the end, we REMAPPRIVATEVIEW() at the end of the work. because of
    that we are in W lock for that groupCommit, which is nonideal of course.
@@ -157,9 +159,17 @@ namespace mongo {
                        "compression" << _journaledBytes / (_uncompressedBytes+1.0) <<
                        "commitsInWriteLock" << _commitsInWriteLock <<
                        "earlyCommits" << _earlyCommits << 
+                       "writeIntents" <<
+                       BSON( "declared" << (long long) _intentsDeclared <<
+                             "merged" << (long long) _intentsMerged <<
+                             "journaledRanges" << (long long) _intentRanges <<
+                             "journaledMB" << _intentBytes / 1000000.0
+                           ) <<
                        "timeMs" <<
                        BSON( "dt" << _dtMillis <<
                              "prepLogBuffer" << (unsigned) (_prepLogBufferMicros/1000) <<
+                             "prepLogBufferCopy" << (unsigned) (_prepLogBufferCopyMicros/1000) <<
+                             "journalWriteWait" << (unsigned) (_journalWriteWaitMicros/1000) <<
                              "writeToJournal" << (unsigned) (_writeToJournalMicros/1000) <<
                              "writeToDataFiles" << (unsigned) (_writeToDataFilesMicros/1000) <<
                              "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000)
@@ -558,14 +568,42 @@ namespace mongo {
             stats.curr->_remapPrivateViewMicros += t.micros();
         }
 
-        // this is a pseudo-local variable in the groupcommit functions 
+        // these are pseudo-local variables in the groupcommit functions 
         // below.  however we don't truly do that so that we don't have to 
-        // reallocate, and more importantly regrow it, on every single commit.
-        static AlignedBuilder __theBuilder(4 * 1024 * 1024);
+        // reallocate, and more importantly regrow them, on every single commit.
+        // there are two so that a commit can prep while the one before it is 
+        // still being written to the journal.
+        static AlignedBuilder __theBuilder0(4 * 1024 * 1024);
+        static AlignedBuilder __theBuilder1(4 * 1024 * 1024);
+
+        /** the log buffer for the commit about to be prepped.  call in groupCommitMutex.
+            at most one commit is in its write stage while the next one preps (the next
+            can't release groupCommitMutex until it has the journalWriteMutex), so the 
+            builder handed out here is never one still being written from.
+        */
+        static AlignedBuilder& nextLogBuffer() {
+            static bool odd;
+            commitJob.groupCommitMutex.dassertLocked();
+            odd = !odd;
+            return odd ? __theBuilder1 : __theBuilder0;
+        }
+
+        /** the write stage of a group commit.  construct in groupCommitMutex, once the 
+            commit is prepped; if the previous commit is still writing we wait for it here.
+        */
+        class WriteStage : boost::noncopyable {
+        public:
+            WriteStage() {
+                commitJob.groupCommitMutex.dassertLocked();
+                Timer t;
+                commitJob.journalWriteMutex.lock();
+                stats.curr->_journalWriteWaitMicros += t.micros();
+            }
+            ~WriteStage() { commitJob.journalWriteMutex.unlock(); }
+        };
 
         static bool _groupCommitWithLimitedLocks() {
             unspoolWriteIntents(); // in case we were doing some writing ourself (likely impossible with limitedlocks version)
-            AlignedBuilder &ab = __theBuilder;
 
             verify( ! Lock::isLocked() );
 
@@ -575,16 +613,19 @@ namespace mongo {
             // not super critical, but likely 'correct'.  todo.
             scoped_ptr<Lock::GlobalRead> lk1( new Lock::GlobalRead() );
 
-            SimpleMutex::scoped_lock lk2(commitJob.groupCommitMutex);
+            scoped_ptr<SimpleMutex::scoped_lock> lk2( new SimpleMutex::scoped_lock(commitJob.groupCommitMutex) );
 
             commitJob.commitingBegin(); // increments the commit epoch for getlasterror j:true
 
             if( !commitJob.hasWritten() ) {
-                // getlasterror request could have came after the data was already committed
+                // getlasterror request could have came after the data was already committed.
+                // the previous commit may still be writing it though.
+                WriteStage w;
                 commitJob.committingNotifyCommitted();
                 return true;
             }
 
+            AlignedBuilder &ab = nextLogBuffer();
             JSectHeader h;
             // need to be in readlock (writes excluded) for this as write intent stuctures point into 
             // the private mmap for their actual data.  i suppose we could lock individual databases 
@@ -595,9 +636,15 @@ namespace mongo {
             LockMongoFilesShared lk3;
 
             unsigned abLen = ab.len();
+            NotifyAll::When commitNumber = commitJob.commitNumber();
             commitJob.committingReset(); // must be reset before allowing anyone to write
             DEV verify( !commitJob.hasWritten() );
 
+            WriteStage w;
+
+            // let the next commit prep (into the other log buffer) while we write this one.
+            lk2.reset();
+
             // release the readlock -- allowing others to now write while we are writing to the journal (etc.)
             lk1.reset();
 
@@ -608,7 +655,7 @@ namespace mongo {
 
             // data is now in the journal, which is sufficient for acknowledging getLastError.
             // (ok to crash after that)
-            commitJob.committingNotifyCommitted();
+            commitJob.committingNotifyCommitted(commitNumber);
 
             // note the higher-up-the-chain locking of filesLockedFsync is important here, 
             // as we are not in Lock::GlobalRead anymore. private view readers won't see 
@@ -657,8 +704,6 @@ namespace mongo {
             unspoolWriteIntents(); // in case we were doing some writing ourself
 
             {
-                AlignedBuilder &ab = __theBuilder;
-
                 // we need to make sure two group commits aren't running at the same time
                 // (and we are only read locked in the dbMutex, so it could happen -- while 
                 // there is only one dur thread, "early commits" can be done by other threads)
@@ -668,15 +713,21 @@ namespace mongo {
 
                 if( !commitJob.hasWritten() ) {
                     // getlasterror request could have came after the data was already committed
+                    WriteStage w;
                     commitJob.committingNotifyCommitted();
                 }
                 else {
+                    AlignedBuilder &ab = nextLogBuffer();
                     JSectHeader h;
                     PREPLOGBUFFER(h,ab);
 
+                    // a commit from the limited locks path may still be writing; our prep above
+                    // overlapped with that, but our writes must follow its.
+                    //
                     // todo : write to the journal outside locks, as this write can be slow.
                     //        however, be careful then about remapprivateview as that cannot be done 
                     //        if new writes are then pending in the private maps.
+                    WriteStage w;
                     WRITETOJOURNAL(h, ab);
 
                     // data is now in the journal, which is sufficient for acknowledging getLastError.
@@ -907,6 +958,7 @@ namespace mongo {
             // (dbMutex) locks. This line waits for that to complete if already underway.
             {
                 SimpleMutex::scoped_lock lk(commitJob.groupCommitMutex);
+                SimpleMutex::scoped_lock lk2(commitJob.journalWriteMutex);
             }
 
             commitNow();
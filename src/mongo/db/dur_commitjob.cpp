@@ -34,6 +34,7 @@
 
 #include "mongo/db/client.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/storage/ephemeral_storage.h"
 #include "mongo/db/taskqueue.h"
 #include "mongo/util/concurrency/threadlocal.h"
 #include "mongo/util/stacktrace.h"
@@ -61,6 +62,7 @@ namespace mongo {
             }
 
             intents.push_back( x );
+            nDeclared++;
 #if( CHECK_SPOOLING )
             nSpooled++;
 #endif
@@ -72,6 +74,10 @@ namespace mongo {
             for( unsigned j = 0; j < intents.size(); j++ ) {
                 commitJob.note(intents[j].start(), intents[j].length());
             }
+            commitJob._intentsDeclared += nDeclared;
+            commitJob._intentsMerged += nCondensed;
+            nDeclared = 0;
+            nCondensed = 0;
 
 #if( CHECK_SPOOLING )
             nSpooled.signedAdd( -1 * static_cast<int>(intents.size()) );
@@ -91,6 +97,7 @@ namespace mongo {
                     intents.erase( intents.begin() + x + 1 );
                     x--;
                     didAnything = true;
+                    nCondensed++;
 #if( CHECK_SPOOLING )
                     nSpooled.signedAdd(-1);
 #endif
@@ -137,6 +144,8 @@ namespace mongo {
         /** we batch up our write intents so that we do not have to synchronize too often */
         void DurableImpl::declareWriteIntent(void *p, unsigned len) {
             cc().writeHappened();
+            if ( EphemeralStorage::contains(p) )
+                return; // nothing to journal, and no view to remap
             MemoryMappedFile::makeWritable(p, len);
             ThreadLocalIntents *t = tlIntents.getMake();
             t->push(WriteIntent(p,len));
@@ -155,6 +164,37 @@ namespace mongo {
             dassert(contains(other));
         }
 
+        unsigned WriteIntentRanges::add(void* p, unsigned len) {
+            char* start = static_cast<char*>(p);
+            char* end = start + len;
+            unsigned merged = 0;
+
+            // the range starting at or before 'start' is the only earlier one that can touch us
+            Ranges::iterator i = _ranges.upper_bound(start);
+            if( i != _ranges.begin() ) {
+                Ranges::iterator prev = i;
+                --prev;
+                if( prev->second >= start ) {
+                    if( prev->second >= end )
+                        return 1; // already covered
+                    start = prev->first;
+                    i = prev;
+                }
+            }
+
+            // absorb every range that starts inside or right at the end of the new one
+            while( i != _ranges.end() && i->first <= end ) {
+                end = max(end, i->second);
+                _bytes -= i->second - i->first;
+                _ranges.erase(i++);
+                merged++;
+            }
+
+            _ranges.insert(i, make_pair(start, end));
+            _bytes += end - start;
+            return merged;
+        }
+
         void IntentsAndDurOps::clear() {
             assertLockedForCommitting();
             commitJob.groupCommitMutex.dassertLocked();
@@ -200,15 +240,20 @@ namespace mongo {
             _intentsAndDurOps.clear();
             privateMapBytes += _bytes;
             _bytes = 0;
+            _intentsDeclared = 0;
+            _intentsMerged = 0;
             _nSinceCommitIfNeededCall = 0;
         }
 
         CommitJob::CommitJob() : 
             groupCommitMutex("groupCommit"),
+            journalWriteMutex("journalWrite"),
             _hasWritten(false)
         { 
             _commitNumber = 0;
             _bytes = 0;
+            _intentsDeclared = 0;
+            _intentsMerged = 0;
             _nSinceCommitIfNeededCall = 0;
         }
 
@@ -249,7 +294,7 @@ namespace mongo {
 #endif
 
                 // remember intent. we will journal it in a bit
-                _intentsAndDurOps.insertWriteIntent(p, len);
+                _intentsMerged += _intentsAndDurOps.insertWriteIntent(p, len);
 
                 {
                     // a bit over conservative in counting pagebytes used
@@ -287,6 +332,10 @@ namespace mongo {
                     }
                 }
             }
+            else {
+                // the Already cache saw this exact region
+                _intentsMerged++;
+            }
         }
 
     }
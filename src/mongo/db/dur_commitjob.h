@@ -97,19 +97,50 @@ namespace mongo {
             pair<void*,int> nodes[N];
         };
 
+        /** The regions to journal in the current group commit as disjoint ranges in address
+            order.  Overlapping and adjacent intents are merged as they are added, so the commit
+            has nothing left to sort and journals each range with a single entry.
+        */
+        class WriteIntentRanges : boost::noncopyable {
+            typedef std::map<char*, char*> Ranges; // start -> end
+        public:
+            typedef Ranges::const_iterator const_iterator;
+
+            WriteIntentRanges() : _bytes(0) { }
+
+            /** @return the number of ranges already held that the region overlapped or touched,
+                        and that are now one range with it
+            */
+            unsigned add(void* p, unsigned len);
+            void clear() { _ranges.clear(); _bytes = 0; }
+
+            bool empty() const { return _ranges.empty(); }
+            size_t size() const { return _ranges.size(); }
+            /** bytes covered by all the ranges */
+            size_t bytes() const { return _bytes; }
+
+            const_iterator begin() const { return _ranges.begin(); }
+            const_iterator end() const { return _ranges.end(); }
+        private:
+            Ranges _ranges;
+            size_t _bytes;
+        };
+
         /** our record of pending/uncommitted write intents */
         class IntentsAndDurOps : boost::noncopyable {
         public:
-            vector<WriteIntent> _intents;
+            WriteIntentRanges _intents;
             Already<127> _alreadyNoted;
             vector< shared_ptr<DurOp> > _durOps; // all the ops other than basic writes
 
             /** reset the IntentsAndDurOps structure (empties all the above) */
             void clear();
 
-            void insertWriteIntent(void* p, int len) {
-                _intents.push_back(WriteIntent(p,len));
+            /** @return the number of intents already noted that this one was merged with */
+            unsigned insertWriteIntent(void* p, int len) {
+                unsigned merged = _intents.add(p, len);
                 wassert( _intents.size() < 2000000 );
+                return merged;
             }
             #if defined(DEBUG_WRITE_INTENT)
             map<void*,int> _debug;
@@ -120,9 +151,11 @@ namespace mongo {
         class ThreadLocalIntents {
             enum { N = 21 };
             std::vector<dur::WriteIntent> intents;
+            unsigned nDeclared;  // since the last unspool
+            unsigned nCondensed; // of those, how many condense() merged away
             bool condense();
         public:
-            ThreadLocalIntents() : intents(N) { intents.clear(); }
+            ThreadLocalIntents() : intents(N), nDeclared(0), nCondensed(0) { intents.clear(); }
             ~ThreadLocalIntents();
             void _unspool();
             void unspool();
@@ -148,6 +181,14 @@ namespace mongo {
 
         public:
             SimpleMutex groupCommitMutex;
+
+            /** held for the write stage (WRITETOJOURNAL, WRITETODATAFILES) of a group commit.
+                acquired while still in groupCommitMutex, so commits are written in the order they
+                were prepped; the next commit can then prep while this one is being written.
+                lock order: groupCommitMutex, then journalWriteMutex.
+            */
+            SimpleMutex journalWriteMutex;
+
             CommitJob();
 
             /** note an operation other than a "basic write". threadsafe (locks in the impl) */
@@ -170,8 +211,19 @@ namespace mongo {
             /** the commit code calls this when data reaches the journal (on disk) */
             void committingNotifyCommitted() { 
                 groupCommitMutex.dassertLocked();
+                journalWriteMutex.dassertLocked();
                 _notify.notifyAll(_commitNumber); 
             }
+            /** for a commit whose write stage outlives its hold on groupCommitMutex: remember
+                commitNumber() when prepping and pass it in once the data is in the journal */
+            NotifyAll::When commitNumber() const {
+                groupCommitMutex.dassertLocked();
+                return _commitNumber;
+            }
+            void committingNotifyCommitted(NotifyAll::When commitNumber) {
+                journalWriteMutex.dassertLocked();
+                _notify.notifyAll(commitNumber);
+            }
             /** we use the commitjob object over and over, calling reset() rather than reconstructing */
             void committingReset() {
                 groupCommitMutex.dassertLocked();
@@ -182,21 +234,26 @@ namespace mongo {
             /** we check how much written and if it is getting to be a lot, we commit sooner. */
             size_t bytes() const { return _bytes; }
 
-            /** used in prepbasicwrites. sorted so that overlapping and duplicate items 
-             * can be merged.  we sort here so the caller receives something they must 
-             * keep const from their pov. */
-            const vector<WriteIntent>& getIntentsSorted() {
+            /** used in prepbasicwrites.  already sorted with overlapping, adjacent and
+             * duplicate items merged. */
+            const WriteIntentRanges& getIntents() const {
                 groupCommitMutex.dassertLocked();
-                sort(_intentsAndDurOps._intents.begin(), _intentsAndDurOps._intents.end());
                 return _intentsAndDurOps._intents;
             }
 
+            /** write intents declared since the last commit, and how many of them were merged
+             * into another rather than needing a journal entry of their own. */
+            unsigned long long intentsDeclared() const { return _intentsDeclared; }
+            unsigned long long intentsMerged() const { return _intentsMerged; }
+
             bool _hasWritten;
 
         private:
             NotifyAll::When _commitNumber;
             IntentsAndDurOps _intentsAndDurOps;
             size_t _bytes;
+            unsigned long long _intentsDeclared;
+            unsigned long long _intentsMerged;
         public:
             NotifyAll _notify;                  // for getlasterror fsync:true acknowledgements
             unsigned _nSinceCommitIfNeededCall; // for asserts and debugging
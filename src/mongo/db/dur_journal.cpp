@@ -724,6 +724,10 @@ namespace mongo {
         */
         void WRITETOJOURNAL(JSectHeader h, AlignedBuilder& uncompressed) {
             Timer t;
+            // the previous commit may have rotated to a new journal file after this section was 
+            // prepped.  sections are written in order (journalWriteMutex), so the file current 
+            // now is the one this section will land in.
+            h.fileId = j.curFileId();
             j.journal(h, uncompressed);
             stats.curr->_writeToJournalMicros += t.micros();
         }
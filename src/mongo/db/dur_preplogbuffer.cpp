@@ -43,8 +43,10 @@
 #include "mongo/db/dur_journal.h"
 #include "mongo/db/dur_journalimpl.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/server.h"
 #include "mongo/util/alignedbuilder.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/mongoutils/hash.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/stacktrace.h"
@@ -59,6 +61,43 @@ namespace mongo {
 
         RelativePath local = RelativePath::fromRelativePath("local");
 
+        /** threads copying intent data into the log buffer for a large commit, including the
+            committing thread.  1 copies everything on the committing thread. */
+        static int journalPrepThreads = 4;
+
+        class ExportedJournalPrepThreadsParameter : public ExportedServerParameter<int> {
+        public:
+            ExportedJournalPrepThreadsParameter() :
+                ExportedServerParameter<int>( ServerParameterSet::getGlobal(),
+                                              "journalPrepThreads",
+                                              &journalPrepThreads,
+                                              true,
+                                              false ) {}
+
+            virtual Status validate( const int& potentialNewValue ) {
+                if ( potentialNewValue < 1 || potentialNewValue > 32 ) {
+                    return Status( ErrorCodes::BadValue,
+                                   "journalPrepThreads must be between 1 and 32" );
+                }
+                return Status::OK();
+            }
+        } exportedJournalPrepThreadsParam;
+
+        /** below this much intent data a commit's copy is done on the committing thread alone, 
+            and no helper gets less than ParallelCopyMinChunk of it. */
+        static const size_t ParallelCopyMinBytes = 8 * 1024 * 1024;
+        static const size_t ParallelCopyMinChunk = 2 * 1024 * 1024;
+
+        /** intent data to be copied into the log buffer once its layout is done (the buffer 
+            may move while it grows, so we hold offsets rather than pointers into it) */
+        struct PendingCopy {
+            PendingCopy(unsigned o, const char *s, unsigned l) : ofs(o), src(s), len(l) { }
+            unsigned ofs;
+            const char *src;
+            unsigned len;
+        };
+        typedef vector<PendingCopy> PendingCopies;
+
         static DurableMappedFile* findMMF_inlock(void *ptr, size_t &ofs) {
             DurableMappedFile *f = privateViews.find_inlock(ptr, ofs);
             if( f == 0 ) {
@@ -71,8 +110,10 @@ namespace mongo {
             return f;
         }
 
-        /** put the basic write operation into the buffer (bb) to be journaled */
-        static void prepBasicWrite_inlock(AlignedBuilder&bb, const WriteIntent *i, RelativePath& lastDbPath) {
+        /** put the basic write operation into the buffer (bb) to be journaled.  space is reserved 
+            for the data itself, which is noted in copies to be filled in by copyIntents() */
+        static void prepBasicWrite_inlock(AlignedBuilder&bb, const WriteIntent *i, RelativePath& lastDbPath,
+                                          PendingCopies& copies) {
             size_t ofs = 1;
             DurableMappedFile *mmf = findMMF_inlock(i->start(), /*out*/ofs);
 
@@ -111,7 +152,9 @@ namespace mongo {
 #if defined(_EXPERIMENTAL)
             i->ofsInJournalBuffer = bb.len();
 #endif
-            bb.appendBuf(i->start(), e.len);
+            if( e.len ) {
+                copies.push_back( PendingCopy((unsigned) bb.skip(e.len), (const char *) i->start(), e.len) );
+            }
 
             if (unlikely(e.len != (unsigned)i->length())) {
                 log() << "journal info splitting prepBasicWrite at boundary" << endl;
@@ -122,15 +165,79 @@ namespace mongo {
                 // mappings, but better to be safe.
 
                 WriteIntent next ((char*)i->start() + e.len, i->length() - e.len);
-                prepBasicWrite_inlock(bb, &next, lastDbPath);
+                prepBasicWrite_inlock(bb, &next, lastDbPath, copies);
+            }
+        }
+
+        static void copyIntentsChunk(char *buf, const PendingCopies *chunk) {
+            for( PendingCopies::const_iterator c = chunk->begin(); c != chunk->end(); ++c ) {
+                memcpy(buf + c->ofs, c->src, c->len);
+            }
+        }
+
+        static ThreadPool* copyIntentsPool() {
+            // only used from within groupCommitMutex
+            static ThreadPool *pool = 0;
+            if( pool == 0 )
+                pool = new ThreadPool(journalPrepThreads - 1);
+            return pool;
+        }
+
+        /** fill in the intent data for the entries laid out in bb.  for a large commit the copy 
+            is split into runs of about equal size, and all but the last handed to helper threads.
+            caller holds privateViews._mutex so the views we are copying from stay mapped.
+        */
+        static void copyIntents(AlignedBuilder& bb, const PendingCopies& copies, size_t bytes) {
+            Timer t;
+            char *buf = bb.atOfs(0); // no more growing now, so stable
+
+            size_t nChunks = 1;
+            if( journalPrepThreads > 1 && bytes >= ParallelCopyMinBytes ) {
+                nChunks = min((size_t) journalPrepThreads, bytes / ParallelCopyMinChunk);
             }
+
+            if( nChunks <= 1 ) {
+                copyIntentsChunk(buf, &copies);
+            }
+            else {
+                // a single large intent may straddle chunks, in which case it is split
+                vector<PendingCopies> chunks(nChunks);
+                const size_t perChunk = (bytes + nChunks - 1) / nChunks;
+                size_t n = 0;
+                size_t inChunk = 0;
+                for( PendingCopies::const_iterator c = copies.begin(); c != copies.end(); ++c ) {
+                    PendingCopy rest = *c;
+                    while( rest.len ) {
+                        if( inChunk == perChunk && n + 1 < nChunks ) {
+                            n++;
+                            inChunk = 0;
+                        }
+                        unsigned len = (unsigned) min((size_t) rest.len, perChunk - inChunk);
+                        if( n + 1 == nChunks )
+                            len = rest.len; // the last chunk takes whatever rounding left over
+                        chunks[n].push_back( PendingCopy(rest.ofs, rest.src, len) );
+                        inChunk += len;
+                        rest.ofs += len;
+                        rest.src += len;
+                        rest.len -= len;
+                    }
+                }
+
+                ThreadPool *pool = copyIntentsPool();
+                for( size_t x = 0; x + 1 < nChunks; x++ ) {
+                    pool->schedule(&copyIntentsChunk, buf, &chunks[x]);
+                }
+                copyIntentsChunk(buf, &chunks[nChunks - 1]);
+                pool->join();
+            }
+
+            stats.curr->_prepLogBufferCopyMicros += t.micros();
         }
 
         void assertNothingSpooled();
 
-        /** basic write ops / write intents.  note there is no particular order to these : if we have
-            two writes to the same location during the group commit interval, it is likely
-            (although not assured) that it is journaled here once.
+        /** basic write ops / write intents.  two writes to the same location during the group
+            commit interval are journaled here once.
         */
         static void prepBasicWrites(AlignedBuilder& bb) {
             scoped_lock lk(privateViews._mutex());
@@ -140,23 +247,23 @@ namespace mongo {
             RelativePath lastDbPath;
 
             assertNothingSpooled();
-            const vector<WriteIntent>& _intents = commitJob.getIntentsSorted();
-            verify( !_intents.empty() );
-
-            WriteIntent last;
-            for( vector<WriteIntent>::const_iterator i = _intents.begin(); i != _intents.end(); i++ ) { 
-                if( i->start() < last.end() ) { 
-                    // overlaps
-                    last.absorb(*i);
-                }
-                else { 
-                    // discontinuous
-                    if( i != _intents.begin() )
-                        prepBasicWrite_inlock(bb, &last, lastDbPath);
-                    last = *i;
-                }
+            const WriteIntentRanges& intents = commitJob.getIntents();
+            verify( !intents.empty() );
+
+            // overlapping and adjacent intents were merged when they were noted.  lay out all the
+            // entries first, then copy their data in one pass.
+            PendingCopies copies;
+            copies.reserve(intents.size());
+            for( WriteIntentRanges::const_iterator i = intents.begin(); i != intents.end(); ++i ) {
+                WriteIntent w(i->first, i->second - i->first);
+                prepBasicWrite_inlock(bb, &w, lastDbPath, copies);
             }
-            prepBasicWrite_inlock(bb, &last, lastDbPath);
+            copyIntents(bb, copies, intents.bytes());
+
+            stats.curr->_intentsDeclared += commitJob.intentsDeclared();
+            stats.curr->_intentsMerged += commitJob.intentsMerged();
+            stats.curr->_intentRanges += intents.size();
+            stats.curr->_intentBytes += intents.bytes();
         }
 
         static void resetLogBuffer(/*out*/JSectHeader& h, AlignedBuilder& bb) {
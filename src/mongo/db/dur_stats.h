@@ -52,6 +52,8 @@ namespace mongo {
                 unsigned long long _writeToDataFilesBytes;
 
                 unsigned long long _prepLogBufferMicros;
+                unsigned long long _prepLogBufferCopyMicros; // of the above, copying intent data
+                unsigned long long _journalWriteWaitMicros; // prepped, waiting on the prior commit's write stage
                 unsigned long long _writeToJournalMicros;
                 unsigned long long _writeToDataFilesMicros;
                 unsigned long long _remapPrivateViewMicros;
@@ -63,6 +65,13 @@ namespace mongo {
                 // - data being written faster than the normal group commit interval
                 unsigned _commitsInWriteLock;
 
+                // write intents declared, those merged into another intent, and the ranges and
+                // bytes of data finally journaled for them
+                unsigned long long _intentsDeclared;
+                unsigned long long _intentsMerged;
+                unsigned long long _intentRanges;
+                unsigned long long _intentBytes;
+
                 unsigned _dtMillis;
             };
             S *curr;
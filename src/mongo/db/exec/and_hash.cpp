@@ -26,6 +26,7 @@
  *    it in the license file.
  */
 
+
 #include "mongo/db/exec/and_hash.h"
 
 #include "mongo/db/exec/and_common-inl.h"
@@ -34,9 +35,30 @@
 
 namespace mongo {
 
-    AndHashStage::AndHashStage(WorkingSet* ws, const MatchExpression* filter)
+    namespace {
+
+        // Below this many entries the table is small enough to stay in cache and the filter
+        // would only add work.
+        const size_t kMinEntriesForFilter = 16 * 1024;
+
+        size_t getMemUsage(const WorkingSetMember* member) {
+            size_t usage = sizeof(WorkingSetMember)
+                           + member->keyData.size() * sizeof(IndexKeyDatum);
+            if (WorkingSetMember::OWNED_OBJ == member->state) {
+                usage += member->obj.objsize();
+            }
+            return usage;
+        }
+
+    }  // namespace
+
+    AndHashStage::AndHashStage(WorkingSet* ws,
+                               const MatchExpression* filter,
+                               size_t maxMemUsage)
         : _ws(ws),
           _filter(filter),
+          _memUsage(0),
+          _maxMemUsage(maxMemUsage),
           _hashingChildren(true),
           _currentChild(0) {}
 
@@ -62,6 +84,10 @@ namespace mongo {
     PlanStage::StageState AndHashStage::work(WorkingSetID* out) {
         ++_commonStats.works;
 
+        // The table outgrew its budget.  This can only happen while hashing, before anything is
+        // returned; the runners keep a backup plan without an AND_HASH for that case.
+        if (memUsage() > _maxMemUsage) { return PlanStage::FAILURE; }
+
         if (isEOF()) { return PlanStage::IS_EOF; }
 
         // An AND is either reading the first child into the hash table, probing against the hash
@@ -109,8 +135,16 @@ namespace mongo {
             return PlanStage::NEED_TIME;
         }
 
-        DataMap::iterator it = _dataMap.find(member->loc);
-        if (_dataMap.end() == it) {
+        WorkingSetID hashID;
+        if (!_dataMap.mightContain(member->loc)) {
+            ++_specificStats.filterRejects;
+            hashID = WorkingSet::INVALID_ID;
+        }
+        else if (!_dataMap.erase(member->loc, &hashID)) {
+            hashID = WorkingSet::INVALID_ID;
+        }
+
+        if (WorkingSet::INVALID_ID == hashID) {
             // Child's output wasn't in every previous child.  Throw it out.
             _ws->free(*out);
             ++_commonStats.needTime;
@@ -119,10 +153,8 @@ namespace mongo {
         else {
             // Child's output was in every previous child.  Merge any key data in
             // the child's output and free the child's just-outputted WSM.
-            WorkingSetID hashID = it->second;
-            _dataMap.erase(it);
-
             WorkingSetMember* olderMember = _ws->get(hashID);
+            _memUsage -= getMemUsage(olderMember);
             AndCommon::mergeFrom(olderMember, *member);
             _ws->free(*out);
 
@@ -158,9 +190,9 @@ namespace mongo {
             }
 
             verify(member->hasLoc());
-            verify(_dataMap.end() == _dataMap.find(member->loc));
+            verify(_dataMap.insert(member->loc, id));
+            _memUsage += getMemUsage(member);
 
-            _dataMap[member->loc] = id;
             ++_commonStats.needTime;
             return PlanStage::NEED_TIME;
         }
@@ -176,6 +208,7 @@ namespace mongo {
 
             ++_commonStats.needTime;
             _specificStats.mapAfterChild.push_back(_dataMap.size());
+            tableComplete();
 
             return PlanStage::NEED_TIME;
         }
@@ -209,14 +242,20 @@ namespace mongo {
             }
 
             verify(member->hasLoc());
-            if (_dataMap.end() == _dataMap.find(member->loc)) {
+            WorkingSetID hashID;
+            if (!_dataMap.mightContain(member->loc)) {
+                // Ignore.  It's not in any previous child.
+                ++_specificStats.filterRejects;
+            }
+            else if (!_dataMap.markSeen(member->loc, &hashID)) {
                 // Ignore.  It's not in any previous child.
             }
             else {
                 // We have a hit.  Copy data into the WSM we already have.
-                _seenMap.insert(member->loc);
-                WorkingSetMember* olderMember = _ws->get(_dataMap[member->loc]);
+                WorkingSetMember* olderMember = _ws->get(hashID);
+                _memUsage -= getMemUsage(olderMember);
                 AndCommon::mergeFrom(olderMember, *member);
+                _memUsage += getMemUsage(olderMember);
             }
             _ws->free(id);
             ++_commonStats.needTime;
@@ -226,22 +265,16 @@ namespace mongo {
             // Finished with a child.
             ++_currentChild;
 
-            // Keep elements of _dataMap that are in _seenMap.
-            DataMap::iterator it = _dataMap.begin();
-            while (it != _dataMap.end()) {
-                if (_seenMap.end() == _seenMap.find(it->first)) {
-                    DataMap::iterator toErase = it;
-                    ++it;
-                    _ws->free(toErase->second);
-                    _dataMap.erase(toErase);
-                }
-                else { ++it; }
+            // Keep elements of _dataMap that this child has seen.
+            std::vector<WorkingSetID> dropped;
+            _dataMap.retainSeen(&dropped);
+            for (size_t i = 0; i < dropped.size(); ++i) {
+                _memUsage -= getMemUsage(_ws->get(dropped[i]));
+                _ws->free(dropped[i]);
             }
 
             _specificStats.mapAfterChild.push_back(_dataMap.size());
 
-            _seenMap.clear();
-
             // _dataMap is now the intersection of the first _currentChild nodes.
 
             // If we have nothing to AND with after finishing any child, stop.
@@ -250,6 +283,8 @@ namespace mongo {
                 return PlanStage::IS_EOF;
             }
 
+            tableComplete();
+
             // We've finished scanning all children.  Return results with the next call to work().
             if (_currentChild == _children.size()) {
                 _hashingChildren = false;
@@ -271,6 +306,14 @@ namespace mongo {
         }
     }
 
+    void AndHashStage::tableComplete() {
+        // Nearly everything the remaining children produce misses in an intersection, so a
+        // filter in front of a large table saves a cache miss per probe.
+        if (_dataMap.size() >= kMinEntriesForFilter) {
+            _dataMap.buildFilter();
+        }
+    }
+
     void AndHashStage::prepareToYield() {
         ++_commonStats.yields;
 
@@ -296,17 +339,14 @@ namespace mongo {
             _children[i]->invalidate(dl, type);
         }
 
-        _seenMap.erase(dl);
-
         // If it's a deletion, we have to forget about the DiskLoc, and since the AND-ing is by
         // DiskLoc we can't continue processing it even with the object.
         //
         // If it's a mutation the predicates implied by the AND-ing may no longer be true.
         //
         // So, we flag and try to pick it up later.
-        DataMap::iterator it = _dataMap.find(dl);
-        if (_dataMap.end() != it) {
-            WorkingSetID id = it->second;
+        WorkingSetID id;
+        if (_dataMap.erase(dl, &id)) {
             WorkingSetMember* member = _ws->get(id);
             verify(member->loc == dl);
 
@@ -317,20 +357,22 @@ namespace mongo {
                 ++_specificStats.flaggedButPassed;
             }
 
+            _memUsage -= getMemUsage(member);
+
             // The loc is about to be invalidated.  Fetch it and clear the loc.
             WorkingSetCommon::fetchAndInvalidateLoc(member);
 
             // Add the WSID to the to-be-reviewed list in the WS.
             _ws->flagForReview(id);
-
-            // And don't return it from this stage.
-            _dataMap.erase(it);
         }
     }
 
     PlanStageStats* AndHashStage::getStats() {
         _commonStats.isEOF = isEOF();
 
+        _specificStats.memUsage = memUsage();
+        _specificStats.memLimit = _maxMemUsage;
+
         auto_ptr<PlanStageStats> ret(new PlanStageStats(_commonStats, STAGE_AND_HASH));
         ret->specific.reset(new AndHashStats(_specificStats));
         for (size_t i = 0; i < _children.size(); ++i) {
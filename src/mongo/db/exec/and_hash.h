@@ -33,9 +33,9 @@
 
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/db/exec/disk_loc_table.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/matcher/expression.h"
-#include "mongo/platform/unordered_set.h"
 
 namespace mongo {
 
@@ -49,10 +49,16 @@ namespace mongo {
      * is fetched and added to the WorkingSet as "flagged for further review."  Because this stage
      * operates with DiskLocs, we are unable to evaluate the AND for the invalidated DiskLoc, and it
      * must be fully matched later.
+     *
+     * The hash table is bounded by 'maxMemUsage'.  If the children produce more than that the
+     * stage fails, which drops this plan in favor of the other candidates rather than letting
+     * the intersection consume unbounded memory.
      */
     class AndHashStage : public PlanStage {
     public:
-        AndHashStage(WorkingSet* ws, const MatchExpression* filter);
+        AndHashStage(WorkingSet* ws,
+                     const MatchExpression* filter,
+                     size_t maxMemUsage = kDefaultMaxMemUsageBytes);
         virtual ~AndHashStage();
 
         void addChild(PlanStage* child);
@@ -66,10 +72,19 @@ namespace mongo {
 
         virtual PlanStageStats* getStats();
 
+        static const size_t kDefaultMaxMemUsageBytes = 32 * 1024 * 1024;
+
     private:
         StageState readFirstChild(WorkingSetID* out);
         StageState hashOtherChildren(WorkingSetID* out);
 
+        // Called once the table stops growing: builds its bloom filter if it is big enough to
+        // be worth it.
+        void tableComplete();
+
+        // Memory held by the table and the WSMs in it.
+        size_t memUsage() const { return _memUsage + _dataMap.memUsage(); }
+
         // Not owned by us.
         WorkingSet* _ws;
 
@@ -81,13 +96,14 @@ namespace mongo {
 
         // _dataMap is filled out by the first child and probed by subsequent children.  This is the
         // hash table that we create by intersecting _children and probe with the last child.
-        typedef unordered_map<DiskLoc, WorkingSetID, DiskLoc::Hasher> DataMap;
-        DataMap _dataMap;
+        // While _hashingChildren, each entry's seen bit records whether the current child has
+        // produced it.
+        DiskLocTable _dataMap;
+
+        // Bytes used by the WSMs referenced from _dataMap.
+        size_t _memUsage;
 
-        // Keeps track of what elements from _dataMap subsequent children have seen.
-        // Only used while _hashingChildren.
-        typedef unordered_set<DiskLoc, DiskLoc::Hasher> SeenMap;
-        SeenMap _seenMap;
+        const size_t _maxMemUsage;
 
         // True if we're still intersecting _children[0..._children.size()-1].
         bool _hashingChildren;
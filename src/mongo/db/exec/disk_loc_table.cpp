@@ -0,0 +1,233 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/exec/disk_loc_table.h"
+
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+    namespace {
+
+        const size_t kMinCapacity = 16;
+
+        // Number of bits set per entry in the bloom filter, and bits of filter per entry.  With
+        // 8 bits per entry and 3 probes about 3% of absent DiskLocs get past the filter.
+        const int kFilterProbes = 3;
+        const size_t kFilterBitsPerEntry = 8;
+
+        /**
+         * DiskLoc::Hasher xors the two halves, which leaves neighbouring records in neighbouring
+         * slots and clusters badly under linear probing, so mix all the bits.
+         */
+        inline uint64_t hashLoc(const DiskLoc& loc) {
+            uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(loc.a())) << 32)
+                         | static_cast<uint32_t>(loc.getOfs());
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /** Smallest power of two capacity keeping 'entries' under a 70% load factor. */
+        size_t capacityFor(size_t entries) {
+            size_t capacity = kMinCapacity;
+            while (capacity * 7 < entries * 10) {
+                capacity *= 2;
+            }
+            return capacity;
+        }
+
+    }  // namespace
+
+    DiskLocTable::DiskLocTable()
+        : _slots(kMinCapacity),
+          _seen(kMinCapacity, false),
+          _mask(kMinCapacity - 1),
+          _size(0),
+          _filterMask(0) { }
+
+    size_t DiskLocTable::_findSlot(const DiskLoc& loc) const {
+        size_t pos = static_cast<size_t>(hashLoc(loc)) & _mask;
+        while (!_slots[pos].loc.isNull() && _slots[pos].loc != loc) {
+            pos = (pos + 1) & _mask;
+        }
+        return pos;
+    }
+
+    bool DiskLocTable::insert(const DiskLoc& loc, WorkingSetID id) {
+        verify(!loc.isNull());
+
+        if ((_size + 1) * 10 > _slots.size() * 7) {
+            _rehash(_slots.size() * 2);
+        }
+
+        size_t pos = _findSlot(loc);
+        if (!_slots[pos].loc.isNull()) {
+            return false;
+        }
+
+        _slots[pos].loc = loc;
+        _slots[pos].id = id;
+        _seen[pos] = false;
+        ++_size;
+        _filter.clear();
+        return true;
+    }
+
+    bool DiskLocTable::markSeen(const DiskLoc& loc, WorkingSetID* id) {
+        size_t pos = _findSlot(loc);
+        if (_slots[pos].loc.isNull()) {
+            return false;
+        }
+        _seen[pos] = true;
+        *id = _slots[pos].id;
+        return true;
+    }
+
+    bool DiskLocTable::erase(const DiskLoc& loc, WorkingSetID* id) {
+        size_t hole = _findSlot(loc);
+        if (_slots[hole].loc.isNull()) {
+            return false;
+        }
+        *id = _slots[hole].id;
+
+        // Backward shift deletion: pull later members of the probe run into the hole unless
+        // that would move them in front of their home slot.  Keeps lookups tombstone free.
+        size_t pos = hole;
+        for (;;) {
+            pos = (pos + 1) & _mask;
+            if (_slots[pos].loc.isNull()) {
+                break;
+            }
+            size_t home = static_cast<size_t>(hashLoc(_slots[pos].loc)) & _mask;
+            bool homeInRun = (hole <= pos) ? (hole < home && home <= pos)
+                                           : (hole < home || home <= pos);
+            if (homeInRun) {
+                continue;
+            }
+            _slots[hole] = _slots[pos];
+            _seen[hole] = _seen[pos];
+            hole = pos;
+        }
+
+        _slots[hole].loc = DiskLoc();
+        _seen[hole] = false;
+        --_size;
+        return true;
+    }
+
+    void DiskLocTable::retainSeen(std::vector<WorkingSetID>* dropped) {
+        std::vector<Slot> old;
+        old.swap(_slots);
+        std::vector<bool> oldSeen;
+        oldSeen.swap(_seen);
+
+        size_t survivors = 0;
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (old[i].loc.isNull()) { continue; }
+            if (oldSeen[i]) { ++survivors; }
+            else { dropped->push_back(old[i].id); }
+        }
+
+        size_t capacity = capacityFor(survivors);
+        _slots.assign(capacity, Slot());
+        _seen.assign(capacity, false);
+        _mask = capacity - 1;
+        _size = 0;
+        _filter.clear();
+
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (old[i].loc.isNull() || !oldSeen[i]) { continue; }
+            _slots[_findSlot(old[i].loc)] = old[i];
+            ++_size;
+        }
+    }
+
+    void DiskLocTable::_rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(_slots);
+        std::vector<bool> oldSeen;
+        oldSeen.swap(_seen);
+
+        _slots.assign(capacity, Slot());
+        _seen.assign(capacity, false);
+        _mask = capacity - 1;
+
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (old[i].loc.isNull()) { continue; }
+            size_t pos = _findSlot(old[i].loc);
+            _slots[pos] = old[i];
+            _seen[pos] = oldSeen[i];
+        }
+    }
+
+    void DiskLocTable::buildFilter() {
+        size_t bits = 64;
+        while (bits < _size * kFilterBitsPerEntry) {
+            bits *= 2;
+        }
+        _filter.assign(bits / 64, 0);
+        _filterMask = bits - 1;
+
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            if (_slots[i].loc.isNull()) { continue; }
+            uint64_t h = hashLoc(_slots[i].loc);
+            // Double hashing; the upper half is independent of the bits picking the slot.
+            uint64_t step = (h >> 32) | 1;
+            for (int probe = 0; probe < kFilterProbes; ++probe) {
+                size_t bit = static_cast<size_t>(h + probe * step) & _filterMask;
+                _filter[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+    }
+
+    bool DiskLocTable::mightContain(const DiskLoc& loc) const {
+        if (_filter.empty()) {
+            return true;
+        }
+        uint64_t h = hashLoc(loc);
+        uint64_t step = (h >> 32) | 1;
+        for (int probe = 0; probe < kFilterProbes; ++probe) {
+            size_t bit = static_cast<size_t>(h + probe * step) & _filterMask;
+            if (0 == (_filter[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t DiskLocTable::memUsage() const {
+        return _slots.capacity() * sizeof(Slot)
+               + _seen.capacity() / 8
+               + _filter.capacity() * sizeof(uint64_t);
+    }
+
+}  // namespace mongo
@@ -0,0 +1,120 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/diskloc.h"
+#include "mongo/db/exec/working_set.h"
+#include "mongo/platform/cstdint.h"
+
+namespace mongo {
+
+    /**
+     * A hash table from DiskLoc to WorkingSetID, used by AndHashStage to hold the intersection of
+     * the children read so far.
+     *
+     * Entries are 16 bytes stored inline in a single linearly probed array, rather than one heap
+     * node per entry.  Each entry also carries a 'seen' bit so a child can mark the DiskLocs it
+     * produced without building a second set.
+     *
+     * Once the table has stopped growing a bloom filter can be built over it.  mightContain()
+     * then rejects most absent DiskLocs while touching only the filter, which is a fraction of
+     * the size of the table and far more likely to be in cache.
+     */
+    class DiskLocTable {
+        MONGO_DISALLOW_COPYING(DiskLocTable);
+    public:
+        DiskLocTable();
+
+        size_t size() const { return _size; }
+        bool empty() const { return 0 == _size; }
+
+        /**
+         * Maps 'loc', which must not be null, to 'id'.  Returns false and changes nothing if
+         * 'loc' is already present.  Discards the bloom filter.
+         */
+        bool insert(const DiskLoc& loc, WorkingSetID id);
+
+        /**
+         * Returns the id mapped to 'loc' in '*id' and sets the entry's seen bit.  Returns false
+         * if 'loc' is not present.
+         */
+        bool markSeen(const DiskLoc& loc, WorkingSetID* id);
+
+        /**
+         * Removes 'loc', returning its id in '*id'.  Returns false if 'loc' is not present.
+         */
+        bool erase(const DiskLoc& loc, WorkingSetID* id);
+
+        /**
+         * Removes every entry whose seen bit is not set, appending their ids to 'dropped', and
+         * clears the seen bit of the survivors.  The table is resized to fit what is left.
+         */
+        void retainSeen(std::vector<WorkingSetID>* dropped);
+
+        /**
+         * Builds a bloom filter over the current contents, about one byte per entry.
+         */
+        void buildFilter();
+
+        /**
+         * False only if 'loc' is certainly not in the table.  Always true without a filter.
+         */
+        bool mightContain(const DiskLoc& loc) const;
+
+        bool hasFilter() const { return !_filter.empty(); }
+
+        /**
+         * Bytes used by the table and the filter, not counting the WorkingSetMembers.
+         */
+        size_t memUsage() const;
+
+    private:
+        struct Slot {
+            DiskLoc loc;        // null when the slot is empty
+            WorkingSetID id;
+        };
+
+        /** Returns the slot holding 'loc' or the empty slot where it would go. */
+        size_t _findSlot(const DiskLoc& loc) const;
+
+        void _rehash(size_t capacity);
+
+        std::vector<Slot> _slots;
+        std::vector<bool> _seen;
+        size_t _mask;
+        size_t _size;
+
+        std::vector<uint64_t> _filter;
+        size_t _filterMask;  // in bits
+    };
+
+}  // namespace mongo
@@ -0,0 +1,168 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/**
+ * This file contains tests for mongo/db/exec/disk_loc_table.cpp
+ */
+
+#include <map>
+#include <vector>
+
+#include "mongo/db/exec/disk_loc_table.h"
+#include "mongo/unittest/unittest.h"
+
+using namespace mongo;
+
+namespace {
+
+    TEST(DiskLocTableTest, InsertAndFind) {
+        DiskLocTable table;
+        ASSERT_TRUE(table.empty());
+
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_TRUE(table.insert(DiskLoc(i % 3, i * 16), i));
+        }
+        ASSERT_EQUALS(1000U, table.size());
+        ASSERT_FALSE(table.insert(DiskLoc(1, 16), 99));
+
+        WorkingSetID id;
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_TRUE(table.markSeen(DiskLoc(i % 3, i * 16), &id));
+            ASSERT_EQUALS(WorkingSetID(i), id);
+        }
+        ASSERT_FALSE(table.markSeen(DiskLoc(5, 16), &id));
+    }
+
+    TEST(DiskLocTableTest, EraseKeepsOtherEntriesReachable) {
+        DiskLocTable table;
+        for (int i = 0; i < 5000; ++i) {
+            table.insert(DiskLoc(0, i * 8), i);
+        }
+
+        WorkingSetID id;
+        for (int i = 0; i < 5000; i += 2) {
+            ASSERT_TRUE(table.erase(DiskLoc(0, i * 8), &id));
+            ASSERT_EQUALS(WorkingSetID(i), id);
+        }
+        ASSERT_FALSE(table.erase(DiskLoc(0, 0), &id));
+        ASSERT_EQUALS(2500U, table.size());
+
+        for (int i = 0; i < 5000; ++i) {
+            ASSERT_EQUALS(i % 2 == 1, table.markSeen(DiskLoc(0, i * 8), &id));
+        }
+    }
+
+    TEST(DiskLocTableTest, RetainSeen) {
+        DiskLocTable table;
+        for (int i = 0; i < 100; ++i) {
+            table.insert(DiskLoc(1, i * 8), i);
+        }
+
+        WorkingSetID id;
+        for (int i = 0; i < 100; i += 10) {
+            ASSERT_TRUE(table.markSeen(DiskLoc(1, i * 8), &id));
+        }
+        size_t before = table.memUsage();
+
+        std::vector<WorkingSetID> dropped;
+        table.retainSeen(&dropped);
+        ASSERT_EQUALS(10U, table.size());
+        ASSERT_EQUALS(90U, dropped.size());
+        ASSERT_LESS_THAN(table.memUsage(), before);
+
+        // Seen bits are reset, so retaining again with nothing seen empties the table.
+        dropped.clear();
+        table.retainSeen(&dropped);
+        ASSERT_TRUE(table.empty());
+        ASSERT_EQUALS(10U, dropped.size());
+    }
+
+    TEST(DiskLocTableTest, FilterHasNoFalseNegatives) {
+        DiskLocTable table;
+        ASSERT_TRUE(table.mightContain(DiskLoc(0, 8)));
+
+        for (int i = 0; i < 20000; ++i) {
+            table.insert(DiskLoc(2, i * 64), i);
+        }
+        table.buildFilter();
+        ASSERT_TRUE(table.hasFilter());
+
+        for (int i = 0; i < 20000; ++i) {
+            ASSERT_TRUE(table.mightContain(DiskLoc(2, i * 64)));
+        }
+
+        int falsePositives = 0;
+        for (int i = 0; i < 20000; ++i) {
+            if (table.mightContain(DiskLoc(3, i * 64))) {
+                ++falsePositives;
+            }
+        }
+        // About 3% expected; leave plenty of slack.
+        ASSERT_LESS_THAN(falsePositives, 2000);
+
+        // Inserting invalidates the filter.
+        table.insert(DiskLoc(3, 0), 0);
+        ASSERT_FALSE(table.hasFilter());
+    }
+
+    TEST(DiskLocTableTest, MatchesReference) {
+        DiskLocTable table;
+        std::map<DiskLoc, WorkingSetID> reference;
+
+        unsigned seed = 12345;
+        for (int i = 0; i < 20000; ++i) {
+            seed = seed * 1103515245 + 12345;
+            DiskLoc loc((seed >> 8) % 4, ((seed >> 12) % 512) * 8);
+            WorkingSetID id;
+            if (seed % 3 == 0) {
+                bool erased = table.erase(loc, &id);
+                ASSERT_EQUALS(reference.count(loc) == 1, erased);
+                if (erased) {
+                    ASSERT_EQUALS(reference[loc], id);
+                    reference.erase(loc);
+                }
+            }
+            else {
+                bool inserted = table.insert(loc, i);
+                ASSERT_EQUALS(reference.count(loc) == 0, inserted);
+                if (inserted) {
+                    reference[loc] = i;
+                }
+            }
+            ASSERT_EQUALS(reference.size(), table.size());
+        }
+
+        WorkingSetID id;
+        for (std::map<DiskLoc, WorkingSetID>::const_iterator it = reference.begin();
+             it != reference.end(); ++it) {
+            ASSERT_TRUE(table.markSeen(it->first, &id));
+            ASSERT_EQUALS(it->second, id);
+        }
+    }
+
+}  // namespace
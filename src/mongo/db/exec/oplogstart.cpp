@@ -30,15 +30,67 @@
 
 #include "mongo/db/pdfile.h"
 #include "mongo/db/storage/extent.h"
+#include "mongo/util/concurrency/mutex.h"
 
 namespace mongo {
 
+    namespace {
+
+        /**
+         * The extents of each capped collection in xnext order, so that searching them doesn't
+         * start by reading every extent header.  Capped collections never gain or lose extents,
+         * so a list stays good until the collection is dropped.  Lists are checked against the
+         * NamespaceDetails before use, and each extent against its header when it is probed.
+         */
+        class ExtentListCache {
+        public:
+            ExtentListCache() : _mutex("OplogStartExtentListCache") { }
+
+            void get(const string& ns, NamespaceDetails* nsd, vector<DiskLoc>* out) {
+                {
+                    mutex::scoped_lock lk(_mutex);
+                    ListMap::const_iterator it = _lists.find(ns);
+                    if (it != _lists.end()
+                        && !it->second.empty()
+                        && it->second.front() == nsd->firstExtent()
+                        && it->second.back() == nsd->lastExtent()) {
+                        *out = it->second;
+                        return;
+                    }
+                }
+
+                out->clear();
+                for (DiskLoc ext = nsd->firstExtent(); !ext.isNull(); ext = ext.ext()->xnext) {
+                    out->push_back(ext);
+                }
+
+                mutex::scoped_lock lk(_mutex);
+                _lists[ns] = *out;
+            }
+
+            void invalidate(const string& ns) {
+                mutex::scoped_lock lk(_mutex);
+                _lists.erase(ns);
+            }
+
+        private:
+            typedef map<string, vector<DiskLoc> > ListMap;
+
+            mongo::mutex _mutex;
+            ListMap _lists;
+        };
+
+        ExtentListCache extentListCache;
+
+    }  // namespace
+
     // Does not take ownership.
     OplogStart::OplogStart(const string& ns, MatchExpression* filter, WorkingSet* ws)
         : _needInit(true),
           _backwardsScanning(false),
           _extentHopping(false),
           _done(false),
+          _extentSearched(false),
           _workingSet(ws),
           _ns(ns),
           _filter(filter) { }
@@ -54,6 +106,12 @@ namespace mongo {
             _cs.reset(new CollectionScan(params, _workingSet, NULL));
             _nsd = nsdetails(_ns.c_str());
             _needInit = false;
+
+            StageState state = searchExtents(out);
+            if (PlanStage::NEED_TIME != state) {
+                return state;
+            }
+
             _backwardsScanning = true;
             _timer.reset();
         }
@@ -99,6 +157,97 @@ namespace mongo {
         return PlanStage::NEED_TIME;
     }
 
+    PlanStage::StageState OplogStart::searchExtents(WorkingSetID* out) {
+        vector<DiskLoc> extents;
+        extentListCache.get(_ns, _nsd, &extents);
+        if (extents.size() < static_cast<size_t>(_minExtentsForSearch)) {
+            return PlanStage::NEED_TIME;
+        }
+
+        // Position 'pos' in oldest to newest order.  Once the collection has looped, the oldest
+        // data is in the extent after capExtent and the newest is at the front of capExtent,
+        // starting at capFirstNewRecord.  The stale tail of capExtent counts as the beginning,
+        // as it does for extent hopping.
+        const bool looped = _nsd->capLooped();
+        const size_t n = extents.size();
+        size_t capIndex = 0;
+        if (looped) {
+            capIndex = std::find(extents.begin(), extents.end(), _nsd->capExtent())
+                       - extents.begin();
+            if (capIndex == n) {
+                extentListCache.invalidate(_ns);
+                return PlanStage::NEED_TIME;
+            }
+        }
+
+        // Finds the last position whose first record doesn't match.  Timestamps increase with
+        // position, so every non empty position after it matches.
+        int found = -1;
+        bool matchAfterFound = false;
+        size_t lo = 0;
+        size_t hi = n;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+
+            // Move forward over empty extents.
+            size_t pos = mid;
+            DiskLoc first;
+            for (; pos < hi; ++pos) {
+                if (looped && pos == n - 1) {
+                    first = _nsd->capFirstNewRecord();
+                }
+                else {
+                    const DiskLoc& extLoc = extents[looped ? (capIndex + 1 + pos) % n : pos];
+                    Extent* e = extLoc.ext();
+                    if (!e->isOk() || e->myLoc != extLoc) {
+                        // The collection was dropped and recreated under us.
+                        extentListCache.invalidate(_ns);
+                        return PlanStage::NEED_TIME;
+                    }
+                    first = e->firstRecord;
+                }
+                if (!first.isNull()) { break; }
+            }
+
+            if (pos == hi) {
+                hi = mid;
+            }
+            else if (_filter->matchesBSON(first.obj())) {
+                matchAfterFound = true;
+                hi = mid;
+            }
+            else {
+                found = pos;
+                _curloc = first;
+                lo = pos + 1;
+            }
+        }
+
+        _extentSearched = true;
+
+        if (-1 == found) {
+            // Even the oldest document matches.  Read everything.
+            _done = true;
+            return PlanStage::IS_EOF;
+        }
+
+        if (!matchAfterFound) {
+            // The start is in the newest extent.  Scanning backwards from the end finds it
+            // exactly, rather than starting at the top of the extent.
+            _curloc = DiskLoc();
+            return PlanStage::NEED_TIME;
+        }
+
+        _done = true;
+        WorkingSetID id = _workingSet->allocate();
+        WorkingSetMember* member = _workingSet->get(id);
+        member->loc = _curloc;
+        member->obj = member->loc.obj();
+        member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+        *out = id;
+        return PlanStage::ADVANCED;
+    }
+
     void OplogStart::switchToExtentHopping() {
         // Transition from backwards scanning to extent hopping.
         _backwardsScanning = false;
@@ -219,4 +368,6 @@ namespace mongo {
 
     int OplogStart::_backwardsScanTime = 5;
 
+    int OplogStart::_minExtentsForSearch = 8;
+
 }  // namespace mongo
@@ -55,6 +55,12 @@ namespace mongo {
      * inserted before documents in a subsequent extent.  As such we can skip through entire extents
      * looking only at the first document.
      *
+     * On an oplog with many extents, hopping back one extent at a time still touches every
+     * extent between the newest one and the one we want.  So before scanning we binary search
+     * the extents, ordered oldest to newest, on the timestamp of their first document.  If the
+     * answer is in the newest extent we go on to scan backwards as above; otherwise we return
+     * the first document of the extent found, just as extent hopping would have.
+     *
      * Why is this a stage?  Because we want to yield, and we want to be notified of DiskLoc
      * invalidations.  :(
      */
@@ -78,12 +84,21 @@ namespace mongo {
         void setBackwardsScanTime(int newTime) { _backwardsScanTime = newTime; }
         bool isExtentHopping() { return _extentHopping; }
         bool isBackwardsScanning() { return _backwardsScanning; }
+        bool didExtentSearch() { return _extentSearched; }
+        static void setMinExtentsForSearch(int n) { _minExtentsForSearch = n; }
     private:
         // Copied verbatim.
         static DiskLoc prevExtentFirstLoc(NamespaceDetails* nsd, const DiskLoc& rec);
 
         StageState workBackwardsScan(WorkingSetID* out);
 
+        /**
+         * Binary searches the extents.  Returns ADVANCED with the start in *out, IS_EOF if the
+         * whole collection must be read, or NEED_TIME if the start is in the newest extent (or
+         * the collection has too few extents to bother) and we should scan backwards.
+         */
+        StageState searchExtents(WorkingSetID* out);
+
         void switchToExtentHopping();
 
         StageState workExtentHopping(WorkingSetID* out);
@@ -107,6 +122,9 @@ namespace mongo {
         // Our final state: done.
         bool _done;
 
+        // Did init binary search the extents?
+        bool _extentSearched;
+
         NamespaceDetails* _nsd;
 
         // We only go backwards via a collscan for a few seconds.
@@ -120,6 +138,9 @@ namespace mongo {
         MatchExpression* _filter;
 
         static int _backwardsScanTime;
+
+        // Collections with fewer extents than this are hopped through instead of searched.
+        static int _minExtentsForSearch;
     };
 
 }  // namespace mongo
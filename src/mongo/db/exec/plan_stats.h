@@ -110,7 +110,10 @@ namespace mongo {
 
     struct AndHashStats : public SpecificStats {
         AndHashStats() : flaggedButPassed(0),
-                         flaggedInProgress(0) { }
+                         flaggedInProgress(0),
+                         filterRejects(0),
+                         memUsage(0),
+                         memLimit(0) { }
 
         virtual ~AndHashStats() { }
 
@@ -128,6 +131,14 @@ namespace mongo {
 
         // mapAfterChild[mapAfterChild.size() - 1] WSMswere match tested.
         // commonstats.advanced is how many passed.
+
+        // How many DiskLocs from the probing children were discarded by the bloom filter
+        // without a hash table lookup?
+        size_t filterRejects;
+
+        // Bytes used by the hash table and the WSMs in it, and the most it may use.
+        size_t memUsage;
+        size_t memLimit;
     };
 
     struct AndSortedStats : public SpecificStats {
@@ -37,6 +37,7 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/keypattern.h"
 #include "mongo/db/kill_current_op.h"
+#include "mongo/db/matcher/expression.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/pdfile_private.h"
 #include "mongo/db/repl/rs.h"
@@ -46,12 +47,21 @@
 namespace mongo {
 
     BtreeBasedAccessMethod::BtreeBasedAccessMethod(IndexCatalogEntry* btreeState)
-        : _btreeState(btreeState), _descriptor(btreeState->descriptor()) {
+        : _btreeState(btreeState),
+          _descriptor(btreeState->descriptor()),
+          _filterExpression(btreeState->getFilterExpression()) {
 
-        verify(0 == _descriptor->version() || 1 == _descriptor->version());
+        verify(IndexDetails::isASupportedIndexVersionNumber(_descriptor->version()));
         _interface = BtreeInterface::interfaces[_descriptor->version()];
     }
 
+    void BtreeBasedAccessMethod::getIndexedKeys(const BSONObj& obj, BSONObjSet* keys) {
+        if (NULL != _filterExpression && !_filterExpression->matchesBSON(obj)) {
+            return;
+        }
+        getKeys(obj, keys);
+    }
+
     // Find the keys for obj, put them in the tree pointing to loc
     Status BtreeBasedAccessMethod::insert(const BSONObj& obj, const DiskLoc& loc,
             const InsertDeleteOptions& options, int64_t* numInserted) {
@@ -60,7 +70,7 @@ namespace mongo {
 
         BSONObjSet keys;
         // Delegate to the subclass.
-        getKeys(obj, &keys);
+        getIndexedKeys(obj, &keys);
 
         Status ret = Status::OK();
 
@@ -132,7 +142,7 @@ namespace mongo {
         const InsertDeleteOptions &options, int64_t* numDeleted) {
 
         BSONObjSet keys;
-        getKeys(obj, &keys);
+        getIndexedKeys(obj, &keys);
         *numDeleted = 0;
 
         for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
@@ -180,6 +190,9 @@ namespace mongo {
         else if ( 1 == _descriptor->version() ) {
             newHead = BtreeBucket<V1>::addBucket( _btreeState );
         }
+        else if ( 2 == _descriptor->version() ) {
+            newHead = BtreeBucket<V2>::addBucket( _btreeState );
+        }
         else {
             return Status( ErrorCodes::InternalError, "invalid index number" );
         }
@@ -190,7 +203,7 @@ namespace mongo {
 
     Status BtreeBasedAccessMethod::touch(const BSONObj& obj) {
         BSONObjSet keys;
-        getKeys(obj, &keys);
+        getIndexedKeys(obj, &keys);
 
         for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
             int unusedPos;
@@ -222,6 +235,11 @@ namespace mongo {
                                                                      _btreeState->head(),
                                                                      key );
         }
+        if ( 2 == _descriptor->version() ) {
+            return BtreeBucket<V2>::asVersion( record )->findSingle( _btreeState,
+                                                                     _btreeState->head(),
+                                                                     key );
+        }
         verify( 0 );
     }
 
@@ -240,8 +258,8 @@ namespace mongo {
         BtreeBasedPrivateUpdateData *data = new BtreeBasedPrivateUpdateData();
         status->_indexSpecificUpdateData.reset(data);
 
-        getKeys(from, &data->oldKeys);
-        getKeys(to, &data->newKeys);
+        getIndexedKeys(from, &data->oldKeys);
+        getIndexedKeys(to, &data->newKeys);
         data->loc = record;
         data->dupsAllowed = options.dupsAllowed;
 
@@ -319,7 +337,7 @@ namespace mongo {
                               const InsertDeleteOptions& options,
                               int64_t* numInserted) {
             BSONObjSet keys;
-            _real->getKeys(obj, &keys);
+            _real->getIndexedKeys(obj, &keys);
             _phase1.addKeys(keys, loc, false);
             if ( numInserted )
                 *numInserted += keys.size();
@@ -372,6 +390,10 @@ namespace mongo {
             return _notAllowed();
         }
 
+        virtual void getIndexedKeys(const BSONObj& obj, BSONObjSet* keys) {
+            _real->getIndexedKeys(obj, keys);
+        }
+
         // -------
 
         template< class V >
@@ -499,7 +521,8 @@ namespace mongo {
         if ( 0 == version ) {
             return new BtreeExternalSortComparisonV0( keyPattern );
         }
-        else if ( 1 == version ) {
+        else if ( 1 == version || 2 == version ) {
+            // v:2 keys are KeyV1 keys stored prefix compressed, so they sort the same
             return new BtreeExternalSortComparisonV1( keyPattern );
         }
         verify( 0 );
@@ -549,6 +572,8 @@ namespace mongo {
             bulk->commit<V0>( dupsToDrop, cc().curop(), mayInterrupt );
         else if ( _descriptor->version() == 1 )
             bulk->commit<V1>( dupsToDrop, cc().curop(), mayInterrupt );
+        else if ( _descriptor->version() == 2 )
+            bulk->commit<V2>( dupsToDrop, cc().curop(), mayInterrupt );
         else
             return Status( ErrorCodes::InternalError, "bad btree version" );
 
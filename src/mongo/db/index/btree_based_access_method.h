@@ -42,6 +42,7 @@ namespace mongo {
 
     class BtreeBulk;
     class ExternalSortComparison;
+    class MatchExpression;
 
     /**
      * Any access method that is Btree based subclasses from this.
@@ -93,6 +94,12 @@ namespace mongo {
 
         virtual Status validate(int64_t* numKeys);
 
+        /**
+         * The keys 'obj' has in this index: those from getKeys, or none if this is a partial
+         * index and 'obj' does not match its filter.
+         */
+        virtual void getIndexedKeys(const BSONObj& obj, BSONObjSet* keys);
+
         // XXX: consider migrating callers to use IndexCursor instead
         virtual DiskLoc findSingle( const BSONObj& key );
 
@@ -111,6 +118,7 @@ namespace mongo {
 
         IndexCatalogEntry* _btreeState; // owned by IndexCatalogEntry
         const IndexDescriptor* _descriptor;
+        const MatchExpression* _filterExpression; // owned by IndexCatalogEntry, NULL if not partial
 
         // There are 2 types of Btree disk formats.  We put them both behind one interface.
         BtreeInterface* _interface;
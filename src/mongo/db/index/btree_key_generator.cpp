@@ -27,16 +27,81 @@
 */
 
 #include "mongo/db/index/btree_key_generator.h"
+
+#include <algorithm>
+#include <boost/thread/tss.hpp>
+#include <cctype>
+#include <cstring>
+
 #include "mongo/util/mongoutils/str.h"
 
 namespace mongo {
 
+    namespace {
+
+        /** Orders offsets into a key buffer the way BSONObjSet orders the keys themselves. */
+        class KeyOffsetLess {
+        public:
+            explicit KeyOffsetLess(const char* base) : _base(base) { }
+            bool operator()(int l, int r) const {
+                return BSONObj(_base + l).woCompare(BSONObj(_base + r)) < 0;
+            }
+        private:
+            const char* _base;
+        };
+
+        /** Scratch space for addArrayElementKeys, kept per thread between calls. */
+        struct KeyArena {
+            KeyArena() : buf(512) { }
+
+            BufBuilder buf;
+            vector<int> offsets;
+        };
+
+        boost::thread_specific_ptr<KeyArena> keyArena;
+
+        KeyArena& getKeyArena() {
+            KeyArena* arena = keyArena.get();
+            if (!arena) {
+                arena = new KeyArena();
+                keyArena.reset(arena);
+            }
+            // don't hold on to the space a huge array needed
+            arena->buf.reset(64 * 1024);
+            arena->offsets.clear();
+            return *arena;
+        }
+
+        bool isNumeric(const StringData& part) {
+            for (size_t i = 0; i < part.size(); ++i) {
+                if (!isdigit(static_cast<unsigned char>(part[i])))
+                    return false;
+            }
+            return !part.empty();
+        }
+
+    }  // namespace
+
     // Used in scanandorder.cpp to inforatively error when we try to sort keys with parallel arrays.
     const int BtreeKeyGenerator::ParallelArraysCode = 10088;
 
     BtreeKeyGenerator::BtreeKeyGenerator(vector<const char*> fieldNames, vector<BSONElement> fixed, 
                                          bool isSparse)
-        : _fieldNames(fieldNames), _isSparse(isSparse), _fixed(fixed) {
+        : _fieldNames(fieldNames), _isSparse(isSparse), _arrayFastPath(true), _fixed(fixed) {
+
+        for (size_t i = 0; i < fieldNames.size(); ++i) {
+            _fieldParts.push_back(vector<StringData>());
+            const char* part = fieldNames[i];
+            while (true) {
+                const char* dot = strchr(part, '.');
+                if (!dot) {
+                    _fieldParts.back().push_back(StringData(part));
+                    break;
+                }
+                _fieldParts.back().push_back(StringData(part, dot - part));
+                part = dot + 1;
+            }
+        }
 
         BSONObjBuilder nullKeyBuilder;
         for (size_t i = 0; i < fieldNames.size(); ++i) {
@@ -60,6 +125,123 @@ namespace mongo {
         }
     }
 
+    BSONElement BtreeKeyGenerator::getFieldDottedOrArray(const BSONObj& obj, unsigned field,
+                                                         const char*& name) const {
+        const vector<StringData>& parts = _fieldParts[field];
+        size_t k = 0;
+        while (k < parts.size() && parts[k].rawData() != name) {
+            ++k;
+        }
+        if (k == parts.size()) {
+            // not at a component boundary, which the callers never ask for
+            return obj.getFieldDottedOrArray(name);
+        }
+
+        BSONObj current = obj;
+        for (;; ++k) {
+            BSONElement sub = current.getField(parts[k]);
+            const bool last = k + 1 == parts.size();
+            name = last ? parts[k].rawData() + parts[k].size() : parts[k + 1].rawData();
+
+            if (sub.eoo())
+                return BSONElement();
+            else if (sub.type() == Array || last)
+                return sub;
+            else if (sub.type() != Object)
+                return BSONElement();
+            current = sub.embeddedObject();
+        }
+    }
+
+    bool BtreeKeyGenerator::addArrayElementKeys(const vector<const char*>& fieldNames,
+                                                const vector<BSONElement>& fixed,
+                                                const vector<unsigned>& arrIdxs,
+                                                const BSONObj& arr,
+                                                unsigned numNotFound,
+                                                BSONObjSet* keys) const {
+        if (!_arrayFastPath) {
+            return false;
+        }
+
+        KeyArena& arena = getKeyArena();
+
+        // A numeric component could name a position in 'arr' rather than a field of its
+        // members, which only the recursive expansion sorts out.
+        for (size_t a = 0; a < arrIdxs.size(); ++a) {
+            const unsigned j = arrIdxs[a];
+            if (*fieldNames[j] == '\0')
+                continue;
+            const vector<StringData>& parts = _fieldParts[j];
+            size_t k = 0;
+            while (k < parts.size() && parts[k].rawData() != fieldNames[j]) {
+                ++k;
+            }
+            if (k == parts.size() || isNumeric(parts[k])) {
+                return false;
+            }
+        }
+
+        BSONObjIterator i(arr);
+        while (i.more()) {
+            BSONElement elt = i.next();
+            BSONObj member = elt.type() == Object ? elt.embeddedObject() : BSONObj();
+
+            const int offset = arena.buf.len();
+            unsigned notFound = numNotFound;
+            BSONObjBuilder b(arena.buf);
+            size_t next = 0;
+            for (unsigned j = 0; j < fixed.size(); ++j) {
+                if (next == arrIdxs.size() || arrIdxs[next] != j) {
+                    b.appendAs(fixed[j], "");
+                    continue;
+                }
+                ++next;
+
+                if (*fieldNames[j] == '\0') {
+                    b.appendAs(elt, "");
+                    continue;
+                }
+
+                const char* name = fieldNames[j];
+                BSONElement e = getFieldDottedOrArray(member, j, name);
+                if (e.eoo()) {
+                    b.appendNull("");
+                    ++notFound;
+                }
+                else if (e.type() == Array) {
+                    return false;
+                }
+                else {
+                    b.appendAs(e, "");
+                }
+            }
+            b.doneFast();
+
+            if (_isSparse && notFound == fieldNames.size()) {
+                arena.buf.setlen(offset);
+                continue;
+            }
+            arena.offsets.push_back(offset);
+        }
+
+        // The arena may have moved while growing, so only look at it once it is complete.
+        // Stable, so of several equal keys (1 and 1.0, say) the first member's is kept.
+        const char* base = arena.buf.buf();
+        vector<int>& offsets = arena.offsets;
+        std::stable_sort(offsets.begin(), offsets.end(), KeyOffsetLess(base));
+
+        for (size_t k = 0; k < offsets.size(); ++k) {
+            BSONObj key(base + offsets[k]);
+            if (k > 0 && key.woCompare(BSONObj(base + offsets[k - 1])) == 0) {
+                continue;
+            }
+            // Ascending, so the end() hint makes this constant time unless 'keys' already holds
+            // larger keys from another branch of the document.
+            keys->insert(keys->end(), key.getOwned());
+        }
+        return true;
+    }
+
     static void assertParallelArrays( const char *first, const char *second ) {
         stringstream ss;
         ss << "cannot index parallel arrays [" << first << "] [" << second << "]";
@@ -80,7 +262,7 @@ namespace mongo {
             if ( *fieldNames[ i ] == '\0' )
                 continue;
 
-            BSONElement e = obj.getFieldDottedOrArray( fieldNames[ i ] );
+            BSONElement e = getFieldDottedOrArray( obj, i, fieldNames[ i ] );
 
             if ( e.eoo() ) {
                 e = _nullElt; // no matching field
@@ -133,8 +315,14 @@ namespace mongo {
             }
             else {
                 // terminal array element to expand, so generate all keys
-                BSONObjIterator i( arrElt.embeddedObject() );
-                if ( i.more() ) {
+                BSONObj arr = arrElt.embeddedObject();
+                if ( arr.isEmpty() ) {
+                    if ( fixed.size() > 1 )
+                        insertArrayNull = true;
+                }
+                else if ( !addArrayElementKeys( fieldNames, fixed, vector<unsigned>( 1, arrIdx ),
+                                                arr, numNotFound, keys ) ) {
+                    BSONObjIterator i( arr );
                     while( i.more() ) {
                         BSONObjBuilder b(_sizeTracker);
                         for( unsigned j = 0; j < fixed.size(); ++j ) {
@@ -146,9 +334,6 @@ namespace mongo {
                         keys->insert( b.obj() );
                     }
                 }
-                else if ( fixed.size() > 1 ) {
-                    insertArrayNull = true;
-                }
             }
         }
         else {
@@ -198,9 +383,10 @@ namespace mongo {
     }
 
     BSONElement BtreeKeyGeneratorV1::extractNextElement(const BSONObj &obj, const BSONObj &arr,
-                                                        const char *&field,
+                                                        unsigned fieldIdx, const char *&field,
                                                         bool &arrayNestedArray) const {
-        string firstField = mongoutils::str::before( field, '.' );
+        const char* dot = strchr( field, '.' );
+        StringData firstField( field, dot ? dot - field : strlen( field ) );
         bool haveObjField = !obj.getField( firstField ).eoo();
         BSONElement arrField = arr.getField( firstField );
         bool haveArrField = !arrField.eoo();
@@ -216,13 +402,13 @@ namespace mongo {
 
         arrayNestedArray = false;
         if ( haveObjField ) {
-            return obj.getFieldDottedOrArray( field );
+            return getFieldDottedOrArray( obj, fieldIdx, field );
         }
         else if ( haveArrField ) {
             if ( arrField.type() == Array ) {
                 arrayNestedArray = true;
             }
-            return arr.getFieldDottedOrArray( field );
+            return getFieldDottedOrArray( arr, fieldIdx, field );
         }
         return BSONElement();
     }
@@ -232,10 +418,10 @@ namespace mongo {
                                                   const BSONElement &arrEntry, BSONObjSet *keys,
                                                   unsigned numNotFound,
                                                   const BSONElement &arrObjElt,
-                                                  const set<unsigned> &arrIdxs,
+                                                  const vector<unsigned> &arrIdxs,
                                                   bool mayExpandArrayUnembedded) const {
         // set up any terminal array values
-        for( set<unsigned>::const_iterator j = arrIdxs.begin(); j != arrIdxs.end(); ++j ) {
+        for( vector<unsigned>::const_iterator j = arrIdxs.begin(); j != arrIdxs.end(); ++j ) {
             if ( *fieldNames[ *j ] == '\0' ) {
                 fixed[ *j ] = mayExpandArrayUnembedded ? arrEntry : arrObjElt;
             }
@@ -259,7 +445,7 @@ namespace mongo {
                                                    BSONObjSet *keys, unsigned numNotFound,
                                                    const BSONObj &array) const {
         BSONElement arrElt;
-        set<unsigned> arrIdxs;
+        vector<unsigned> arrIdxs;
         bool mayExpandArrayUnembedded = true;
         for( unsigned i = 0; i < fieldNames.size(); ++i ) {
             if ( *fieldNames[ i ] == '\0' ) {
@@ -268,7 +454,7 @@ namespace mongo {
 
             bool arrayNestedArray;
             // Extract element matching fieldName[ i ] from object xor array.
-            BSONElement e = extractNextElement( obj, array, fieldNames[ i ], arrayNestedArray );
+            BSONElement e = extractNextElement( obj, array, i, fieldNames[ i ], arrayNestedArray );
 
             if ( e.eoo() ) {
                 // if field not present, set to null
@@ -278,7 +464,7 @@ namespace mongo {
                 numNotFound++;
             }
             else if ( e.type() == Array ) {
-                arrIdxs.insert( i );
+                arrIdxs.push_back( i );
                 if ( arrElt.eoo() ) {
                     // we only expand arrays on a single path -- track the path here
                     arrElt = e;
@@ -313,6 +499,11 @@ namespace mongo {
             _getKeysArrEltFixed(fieldNames, fixed, _undefinedElt, keys, numNotFound, arrElt,
                                 arrIdxs, true );
         }
+        else if ( mayExpandArrayUnembedded &&
+                  addArrayElementKeys( fieldNames, fixed, arrIdxs, arrElt.embeddedObject(),
+                                       numNotFound, keys ) ) {
+            // The members' keys were built directly, without recursing per member.
+        }
         else {
             // Non empty array that can be expanded, so generate a key for each member.
             BSONObj arrObj = arrElt.embeddedObject();
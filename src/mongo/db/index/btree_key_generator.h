@@ -45,6 +45,13 @@ namespace mongo {
 
         void getKeys(const BSONObj &obj, BSONObjSet *keys) const;
 
+        /**
+         * When off, arrays are always expanded by recursing once per member, as before the
+         * direct path in addArrayElementKeys existed.  On by default; perftests turns it off to
+         * compare the two.
+         */
+        void setArrayFastPath(bool enabled) { _arrayFastPath = enabled; }
+
         static const int ParallelArraysCode;
 
     protected:
@@ -55,11 +62,36 @@ namespace mongo {
         BSONObj _nullObj;     // only used for _nullElt
         BSONElement _nullElt; // jstNull
         BSONSizeTracker _sizeTracker;
+        bool _arrayFastPath;
+
+        /**
+         * BSONObj::getFieldDottedOrArray for the rest of index field 'field', which 'name' points
+         * into, using the components split off when the generator was built.
+         */
+        BSONElement getFieldDottedOrArray(const BSONObj& obj, unsigned field,
+                                          const char*& name) const;
+
+        /**
+         * Adds one key per element of 'arr' to 'keys': 'fixed' with each component listed in
+         * 'arrIdxs' (ascending) replaced by that element, or by what the rest of its path in
+         * 'fieldNames' finds inside the element.  The keys are built side by side in a per
+         * thread buffer and stably sorted and deduplicated there, so 'keys' sees each distinct
+         * key once, in order, and equal keys resolve to the first member as if inserted one at a
+         * time.  Returns false without adding anything when an element would need the recursive
+         * expansion: a further array or a numeric component on the rest of a path.
+         */
+        bool addArrayElementKeys(const vector<const char*>& fieldNames,
+                                 const vector<BSONElement>& fixed,
+                                 const vector<unsigned>& arrIdxs,
+                                 const BSONObj& arr,
+                                 unsigned numNotFound,
+                                 BSONObjSet* keys) const;
     private:
         // We have V0 and V1.  Sigh.
         virtual void getKeysImpl(vector<const char*> fieldNames, vector<BSONElement> fixed,
                                  const BSONObj &obj, BSONObjSet *keys) const = 0;
         vector<BSONElement> _fixed;
+        vector< vector<StringData> > _fieldParts;  // _fieldNames split on '.'
     };
 
     class BtreeKeyGeneratorV0 : public BtreeKeyGenerator {
@@ -100,12 +132,12 @@ namespace mongo {
          * @param arrayNestedArray - set if the returned element is an array nested directly
                                      within arr.
          */
-        BSONElement extractNextElement(const BSONObj &obj, const BSONObj &arr, const char *&field,
-                                       bool &arrayNestedArray ) const;
+        BSONElement extractNextElement(const BSONObj &obj, const BSONObj &arr, unsigned fieldIdx,
+                                       const char *&field, bool &arrayNestedArray ) const;
         void _getKeysArrEltFixed(vector<const char*> &fieldNames, vector<BSONElement> &fixed,
                                  const BSONElement &arrEntry, BSONObjSet *keys,
                                  unsigned numNotFound, const BSONElement &arrObjElt,
-                                 const set<unsigned> &arrIdxs, bool mayExpandArrayUnembedded) const;
+                                 const vector<unsigned> &arrIdxs, bool mayExpandArrayUnembedded) const;
         
         BSONObj _undefinedObj;
         BSONElement _undefinedElt;
@@ -139,6 +139,12 @@ namespace mongo {
          */
         virtual Status validate(int64_t* numKeys) = 0;
 
+        /**
+         * Fill 'keys' with the keys this index holds for 'obj'.  Reads neither the index nor the
+         * collection, so validate can call it from threads that don't hold the database lock.
+         */
+        virtual void getIndexedKeys(const BSONObj& obj, BSONObjSet* keys) = 0;
+
         //
         // Bulk operations support
         //
@@ -66,6 +66,7 @@ namespace mongo {
               _parentNS(infoObj.getStringField("ns")),
               _isIdIndex(IndexDetails::isIdIndexPattern( _keyPattern )),
               _sparse(infoObj["sparse"].trueValue()),
+              _partial(infoObj["partialFilterExpression"].isABSONObj()),
               _dropDups(infoObj["dropDups"].trueValue()),
               _unique( _isIdIndex || infoObj["unique"].trueValue() ),
               _cachedEntry( NULL )
@@ -126,6 +127,14 @@ namespace mongo {
         // Is this index sparse?
         bool isSparse() const { return _sparse; }
 
+        // Does this index only hold the documents matching a filter?
+        bool isPartial() const { return _partial; }
+
+        // The filter of a partial index, empty otherwise.
+        BSONObj partialFilterExpression() const {
+            return _infoObj.getObjectField("partialFilterExpression");
+        }
+
         // Is this index multikey?
         bool isMultikey() const { _checkOk(); return _collection->getIndexCatalog()->isMultikey( this ); }
 
@@ -178,6 +187,7 @@ namespace mongo {
         string _indexNamespace;
         bool _isIdIndex;
         bool _sparse;
+        bool _partial;
         bool _dropDups;
         bool _unique;
         int _version;
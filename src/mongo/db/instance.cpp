@@ -41,11 +41,13 @@
 
 #include "mongo/base/status.h"
 #include "mongo/bson/util/atomic_int.h"
+#include "mongo/db/admission_control.h"
 #include "mongo/db/audit.h"
 #include "mongo/db/auth/action_type.h"
 #include "mongo/db/auth/authorization_manager.h"
 #include "mongo/db/auth/authorization_session.h"
 #include "mongo/db/background.h"
+#include "mongo/db/catalog/capped_insert_notifier.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/commands/fsync.h"
 #include "mongo/db/d_concurrency.h"
@@ -404,6 +406,7 @@ namespace mongo {
         }
         
         auto_ptr<CurOp> nestedOp;
+        auto_ptr<ScopedAdmission> admission;
         CurOp* currentOpP = c.curop();
         if ( currentOpP->active() ) {
             nestedOp.reset( new CurOp( &c , currentOpP ) );
@@ -411,6 +414,12 @@ namespace mongo {
         }
         else {
             c.newTopLevelRequest();
+
+            // Nested requests run on behalf of an operation that already holds a ticket.
+            AdmissionControl::Pool pool;
+            PriorityTicketHolder::Priority priority;
+            if ( AdmissionControl::classify( m, &pool, &priority ) )
+                admission.reset( new ScopedAdmission( pool, priority ) );
         }
 
         CurOp& currentOp = *currentOpP;
@@ -740,7 +749,10 @@ namespace mongo {
         int pass = 0;
         bool exhaust = false;
         QueryResult* msgdata = 0;
-        OpTime last;
+        // Once a tailable, awaitData cursor has come back empty we block on inserts into its
+        // capped collection rather than polling it.
+        bool awaitingData = false;
+        CappedInsertNotifier::Version insertVersion = 0;
         while( 1 ) {
             bool isCursorAuthorized = false;
             try {
@@ -756,14 +768,12 @@ namespace mongo {
                     while (MONGO_FAIL_POINT(rsStopGetMore)) {
                         sleepmillis(0);
                     }
+                }
 
-                    if (pass == 0) {
-                        mutex::scoped_lock lk(OpTime::m);
-                        last = OpTime::getLast(lk);
-                    }
-                    else {
-                        last.waitForDifferent(1000/*ms*/);
-                    }
+                // Must be read before looking at the cursor so that an insert racing with
+                // newGetMore() still wakes us below.
+                if (awaitingData) {
+                    insertVersion = cappedInsertNotifier.getVersion(ns);
                 }
 
                 msgdata = newGetMore(ns,
@@ -795,21 +805,25 @@ namespace mongo {
                 if ( ! timer ) {
                     timer.reset( new Timer() );
                 }
-                else {
-                    if ( timer->seconds() >= 4 ) {
-                        // after about 4 seconds, return. pass stops at 1000 normally.
-                        // we want to return occasionally so slave can checkpoint.
-                        pass = 10000;
-                    }
+
+                const int remainingMillis = 4000 - timer->millis();
+                if ( remainingMillis <= 0 ) {
+                    // after about 4 seconds, return. pass stops at 1000 normally.
+                    // we want to return occasionally so slave can checkpoint.
+                    pass = 10000;
+                }
+                else if ( awaitingData ) {
+                    // Don't hold an admission ticket while idle.
+                    AdmissionReleaser releaser;
+                    // Wake at least once a second to notice shutdown and killOp.
+                    cappedInsertNotifier.waitForInsert( ns,
+                                                        insertVersion,
+                                                        std::min( remainingMillis, 1000 ) );
                 }
+                awaitingData = true;
                 pass++;
-                if (debug)
-                    sleepmillis(20);
-                else
-                    sleepmillis(2);
-                
-                // note: the 1100 is beacuse of the waitForDifferent above
-                // should eventually clean this up a bit
+
+                // note: the 1100 is because of the waitForInsert above
                 curop.setExpectedLatencyMs( 1100 + timer->millis() );
                 
                 continue;
@@ -1233,6 +1247,8 @@ namespace {
         // block the dur thread from doing any work for the rest of the run
         LOG(2) << "shutdown: groupCommitMutex" << endl;
         SimpleMutex::scoped_lock lk(dur::commitJob.groupCommitMutex);
+        // and let a commit that is already writing finish first
+        SimpleMutex::scoped_lock lk2(dur::commitJob.journalWriteMutex);
 
 #ifdef _WIN32
         // Windows Service Controller wants to be told when we are down,
@@ -30,6 +30,7 @@
 
 #include "mongo/db/client.h"
 #include "mongo/db/clientcursor.h"
+#include "mongo/db/commands/dbhash.h"
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 #include "mongo/db/query/get_runner.h"
@@ -103,7 +104,7 @@ namespace mongo {
             // TODO: do we want to buffer docs and delete them in a group rather than
             // saving/restoring state repeatedly?
             runner->saveState();
-            collection->deleteDocument(rloc, false, false, logop ? &toDelete : NULL );
+            collection->deleteDocument(rloc, false, false, &toDelete);
             runner->restoreState();
 
             nDeleted++;
@@ -117,6 +118,10 @@ namespace mongo {
                     logOp("d", nsForLogOp.c_str(), toDelete, 0, &replJustOne);
                 }
             }
+            else {
+                // Unlogged deletes still change what dbhash sees.
+                logOpForDbHash("d", nsForLogOp.c_str(), toDelete, NULL, NULL, false);
+            }
 
             if (justOne) {
                 break;
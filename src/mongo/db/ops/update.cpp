@@ -37,8 +37,11 @@
 #include "mongo/bson/mutable/algorithm.h"
 #include "mongo/bson/mutable/damage_vector.h"
 #include "mongo/bson/mutable/document.h"
+#include "mongo/base/counter.h"
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/db/clientcursor.h"
+#include "mongo/db/commands/dbhash.h"
+#include "mongo/db/commands/server_status.h"
 #include "mongo/db/index_set.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 #include "mongo/db/ops/update_driver.h"
@@ -62,6 +65,12 @@ namespace mongo {
         const char idFieldName[] = "_id";
         const FieldRef idFieldRef(idFieldName);
 
+        // Updates applied as damages directly to the stored record; see record.rewrites and
+        // record.moves in collection.cpp for the other two outcomes.
+        Counter64 inPlaceUpdateCounter;
+        ServerStatusMetricField<Counter64> inPlaceUpdateCounterDisplay("record.inPlaceUpdates",
+                                                                       &inPlaceUpdateCounter);
+
         // TODO: Make this a function on NamespaceString, or make it cleaner.
         inline void validateUpdate(const char* ns ,
                                    const BSONObj& updateobj,
@@ -671,6 +680,15 @@ namespace mongo {
             // Save state before making changes
             runner->saveState();
 
+            // The damages can't be applied to a compressed record: oldObj is a decompressed
+            // copy of it. And a collection that compresses stores changed documents compressed
+            // when it pays. Either way a real change goes through the collection instead.
+            if (inPlace && !damages.empty() &&
+                (loc.rec()->isCompressed() ||
+                 collection->details()->isUserFlagSet(NamespaceDetails::Flag_CompressRecords))) {
+                inPlace = false;
+            }
+
             if (inPlace && !driver->modsAffectIndices()) {
 
                 // If a set of modifiers were all no-ops, we are still 'in place', but there is
@@ -697,17 +715,25 @@ namespace mongo {
                     }
                     docWasModified = true;
                     opDebug->fastmod = true;
+                    inPlaceUpdateCounter.increment();
                 }
                 newObj = oldObj;
             }
             else {
 
-                // The updates were not in place. Apply them through the file manager.
+                // The updates were not in place. Apply them through the file manager. If no
+                // indexed field changed (which we can only know when the lifecycle gave the
+                // driver the indexed paths) and the document still fits, the collection can
+                // rewrite the record without touching any index.
+                const bool indexesAffected = !lifecycle
+                                             || driver->isDocReplacement()
+                                             || driver->modsAffectIndices();
                 newObj = doc.getObject();
                 StatusWith<DiskLoc> res = collection->updateDocument(loc,
                                                                      newObj,
                                                                      true,
-                                                                     opDebug);
+                                                                     opDebug,
+                                                                     indexesAffected);
                 uassertStatusOK(res.getStatus());
                 DiskLoc newLoc = res.getValue();
 
@@ -735,6 +761,10 @@ namespace mongo {
                           NULL, request.isFromMigration(), &newObj);
                 }
             }
+            else if (docWasModified) {
+                // Unlogged writes still change what dbhash sees.
+                logOpForDbHash("u", nsString.ns().c_str(), newObj, NULL, NULL, false);
+            }
 
             // Only record doc modifications if they wrote (exclude no-ops)
             if (docWasModified)
@@ -855,6 +885,9 @@ namespace mongo {
             logOp("i", nsString.ns().c_str(), newObj,
                    NULL, NULL, request.isFromMigration(), &newObj);
         }
+        else {
+            logOpForDbHash("i", nsString.ns().c_str(), newObj, NULL, NULL, false);
+        }
 
         opDebug->nupdated = 1;
         return UpdateResult(false /* updated a non existing document */,
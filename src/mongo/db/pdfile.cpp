@@ -54,6 +54,7 @@ _ disallow system* manipulations from the database.
 #include "mongo/db/structure/btree/btree.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/cloner.h"
+#include "mongo/db/commands/dbhash.h"
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/curop-inl.h"
 #include "mongo/db/db.h"
@@ -204,6 +205,9 @@ namespace mongo {
             }
         }
 
+        uassert( 17397, "capped collections cannot compress records",
+                 !( newCapped && options["compressRecords"].trueValue() ) );
+
 
         collection = db->createCollection( ns,
                                            options["capped"].trueValue(),
@@ -277,6 +281,11 @@ namespace mongo {
         if ( mx > 0 )
             d->setMaxCappedDocs( mx );
 
+        // once collMod has synced "flags" they say whether records are compressed
+        if ( options["compressRecords"].trueValue() && options["flags"].eoo() ) {
+            d->setUserFlag( NamespaceDetails::Flag_CompressRecords );
+        }
+
         if ( options["flags"].numberInt() ) {
             d->replaceUserFlags( options["flags"].numberInt() );
         }
@@ -420,6 +429,7 @@ namespace mongo {
         d = 0; // d is now deleted
 
         _deleteDataFiles( db.c_str() );
+        wipeDbHashCache( db );
     }
 
     typedef boost::filesystem::path Path;
@@ -535,6 +545,12 @@ namespace mongo {
         verify( cc().database()->name() == dbName );
         verify(cc().database()->path() == storageGlobalParams.dbpath);
 
+        if ( cc().database()->getExtentManager().isEphemeral() ) {
+            // the copy would be made in files, and the original is gone once closed
+            errmsg = "cannot repair an ephemeral database";
+            return false;
+        }
+
         BackgroundOperation::assertNoBgOpInProgForDb(dbName);
 
         getDur().syncDataAndTruncateJournal(); // Must be done before and after repair
@@ -90,6 +90,8 @@ namespace mongo {
     BOOST_STATIC_ASSERT( 16 == sizeof(DeletedRecord) );
 
     inline BSONObj BSONObj::make(const Record* r ) {
+        if ( r->isCompressed() )
+            return r->uncompressedObj();
         return BSONObj( r->data() );
     }
 
@@ -40,29 +40,41 @@ namespace mongo {
     using namespace mongoutils;
 
     Position DocumentStorage::findField(StringData requested) const {
-        int reqSize = requested.size(); // get size calculation out of the way if needed
+        if (_numFields >= HASH_TAB_MIN)
+            return findField(requested, hashKey(requested));
 
-        if (_numFields >= HASH_TAB_MIN) { // hash lookup
-            const unsigned bucket = bucketForKey(requested);
+        return findFieldLinear(requested);
+    }
 
-            Position pos = _hashTab[bucket];
-            while (pos.found()) {
-                const ValueElement& elem = getField(pos);
-                if (elem.nameLen == reqSize
-                    && memcmp(requested.rawData(), elem._name, reqSize) == 0) {
-                    return pos;
-                }
+    Position DocumentStorage::findField(StringData requested, unsigned hash) const {
+        if (_numFields < HASH_TAB_MIN)
+            return findFieldLinear(requested);
+
+        int reqSize = requested.size(); // get size calculation out of the way if needed
 
-                // possible collision
-                pos = elem.nextCollision;
+        Position pos = _hashTab[hash & _hashTabMask];
+        while (pos.found()) {
+            const ValueElement& elem = getField(pos);
+            if (elem.nameLen == reqSize
+                && memcmp(requested.rawData(), elem._name, reqSize) == 0) {
+                return pos;
             }
+
+            // possible collision
+            pos = elem.nextCollision;
         }
-        else { // linear scan
-            for (DocumentStorageIterator it = iteratorAll(); !it.atEnd(); it.advance()) {
-                if (it->nameLen == reqSize
-                    && memcmp(requested.rawData(), it->_name, reqSize) == 0) {
-                    return it.position();
-                }
+
+        // if we got here, there's no such field
+        return Position();
+    }
+
+    Position DocumentStorage::findFieldLinear(StringData requested) const {
+        int reqSize = requested.size(); // get size calculation out of the way if needed
+
+        for (DocumentStorageIterator it = iteratorAll(); !it.atEnd(); it.advance()) {
+            if (it->nameLen == reqSize
+                && memcmp(requested.rawData(), it->_name, reqSize) == 0) {
+                return it.position();
             }
         }
 
@@ -142,13 +154,13 @@ namespace mongo {
         uassert(16490, "Tried to make oversized document",
                 capacity <= size_t(BufferMaxSize));
 
-        boost::scoped_array<char> oldBuf(_buffer);
-        _buffer = new char[capacity];
+        char* const oldBuf = _buffer;
+        _buffer = static_cast<char*>(BlockArena::allocate(capacity));
         _bufferEnd = _buffer + capacity - hashTabBytes();
 
         if (!firstAlloc) {
             // This just copies the elements
-            memcpy(_buffer, oldBuf.get(), _usedBytes);
+            memcpy(_buffer, oldBuf, _usedBytes);
 
             if (_numFields >= HASH_TAB_MIN) {
                 // if we were hashing, deal with the hash table
@@ -157,10 +169,12 @@ namespace mongo {
                 }
                 else {
                     // no rehash needed so just slide table down to new position
-                    memcpy(_hashTab, oldBuf.get() + oldCapacity, hashTabBytes());
+                    memcpy(_hashTab, oldBuf + oldCapacity, hashTabBytes());
                 }
             }
         }
+
+        BlockArena::free(oldBuf);
     }
 
     void DocumentStorage::reserveFields(size_t expectedFields) {
@@ -177,7 +191,7 @@ namespace mongo {
         uassert(16491, "Tried to make oversized document",
                 newSize <= size_t(BufferMaxSize));
 
-        _buffer = new char[newSize + hashTabBytes()];
+        _buffer = static_cast<char*>(BlockArena::allocate(newSize + hashTabBytes()));
         _bufferEnd = _buffer + newSize;
     }
 
@@ -187,7 +201,7 @@ namespace mongo {
         // Make a copy of the buffer.
         // It is very important that the positions of each field are the same after cloning.
         const size_t bufferBytes = (_bufferEnd + hashTabBytes()) - _buffer;
-        out->_buffer = new char[bufferBytes];
+        out->_buffer = static_cast<char*>(BlockArena::allocate(bufferBytes));
         out->_bufferEnd = out->_buffer + (_bufferEnd - _buffer);
         memcpy(out->_buffer, _buffer, bufferBytes);
 
@@ -207,11 +221,11 @@ namespace mongo {
     }
 
     DocumentStorage::~DocumentStorage() {
-        boost::scoped_array<char> deleteBufferAtScopeEnd (_buffer);
-
         for (DocumentStorageIterator it = iteratorAll(); !it.atEnd(); it.advance()) {
             it->val.~Value(); // explicit destructor call
         }
+
+        BlockArena::free(_buffer);
     }
 
     Document::Document(const BSONObj& bson) {
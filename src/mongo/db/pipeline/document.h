@@ -77,6 +77,11 @@ namespace mongo {
         const Value operator[] (StringData key) const { return getField(key); }
         const Value getField(StringData key) const { return storage().getField(key); }
 
+        /// Same as getField(key), but with 'hash' precomputed by DocumentStorage::hashKey(key).
+        const Value getField(StringData key, unsigned hash) const {
+            return storage().getField(key, hash);
+        }
+
         /// Look up a field by Position. See positionOf and getNestedField.
         const Value operator[] (Position pos) const { return getField(pos); }
         const Value getField(Position pos) const { return storage().getField(pos).val; }
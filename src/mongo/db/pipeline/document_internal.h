@@ -30,6 +30,7 @@
 
 #include <third_party/murmurhash3/MurmurHash3.h>
 
+#include "mongo/util/block_arena.h"
 #include "mongo/util/intrusive_counter.h"
 #include "mongo/db/pipeline/value.h"
 
@@ -171,6 +172,10 @@ namespace mongo {
         {}
         ~DocumentStorage();
 
+        // Both the DocumentStorage and its _buffer come from the pipeline's arena, if any.
+        void* operator new(size_t bytes) { return BlockArena::allocate(bytes); }
+        void operator delete(void* ptr) { BlockArena::free(ptr); }
+
         static const DocumentStorage& emptyDoc() {
             static const char emptyBytes[sizeof(DocumentStorage)] = {0};
             return *reinterpret_cast<const DocumentStorage*>(emptyBytes);
@@ -190,6 +195,9 @@ namespace mongo {
         /// Returns the position of the named field (may be missing) or Position()
         Position findField(StringData name) const;
 
+        /// Same as findField(name), but with 'hash' == hashKey(name) computed by the caller.
+        Position findField(StringData name, unsigned hash) const;
+
         // Document uses these
         const ValueElement& getField(Position pos) const {
             verify(pos.found());
@@ -201,6 +209,12 @@ namespace mongo {
                 return Value();
             return getField(pos).val;
         }
+        Value getField(StringData name, unsigned hash) const {
+            Position pos = findField(name, hash);
+            if (!pos.found())
+                return Value();
+            return getField(pos).val;
+        }
 
         // MutableDocument uses these
         ValueElement& getField(Position pos) {
@@ -249,6 +263,17 @@ namespace mongo {
             }
         }
 
+        /**
+         * The hash used to look up 'name' in the field hash table. Callers that look up the
+         * same name in many documents can compute this once and use findField(name, hash).
+         */
+        static unsigned hashKey(StringData name) {
+            // TODO consider FNV-1a once we have a better benchmark corpus
+            unsigned out;
+            MurmurHash3_x86_32(name.rawData(), name.size(), 0, &out);
+            return out;
+        }
+
         bool hasTextScore() const { return _hasTextScore; }
         double getTextScore() const { return _textScore; }
         void setTextScore(double score) {
@@ -277,17 +302,13 @@ namespace mongo {
         /// Initialize empty hash table
         void hashTabInit() { memset(_hashTab, -1, hashTabBytes()); }
 
-        static unsigned hashKey(StringData name) {
-            // TODO consider FNV-1a once we have a better benchmark corpus
-            unsigned out;
-            MurmurHash3_x86_32(name.rawData(), name.size(), 0, &out);
-            return out;
-        }
-
         unsigned bucketForKey(StringData name) const {
             return hashKey(name) & _hashTabMask;
         }
 
+        /// findField() for documents too small to have a hash table
+        Position findFieldLinear(StringData name) const;
+
         /// Adds all fields to the hash table
         void rehash() {
             hashTabInit();
@@ -35,7 +35,9 @@
 #include "mongo/db/pipeline/document_source.h"
 #include "mongo/db/pipeline/expression.h"
 #include "mongo/db/pipeline/expression_context.h"
+#include "mongo/db/pipeline/expression_program.h"
 #include "mongo/db/pipeline/value.h"
+#include "mongo/util/block_arena.h"
 
 namespace mongo {
     const char DocumentSourceGroup::groupName[] = "$group";
@@ -122,10 +124,10 @@ namespace mongo {
     }
 
     void DocumentSourceGroup::optimize() {
-        pIdExpression = pIdExpression->optimize();
+        pIdExpression = ExpressionProgram::compile(pIdExpression->optimize());
 
         for (size_t i = 0; i < vFieldName.size(); i++) {
-             vpExpression[i] = vpExpression[i]->optimize();
+             vpExpression[i] = ExpressionProgram::compile(vpExpression[i]->optimize());
         }
     }
 
@@ -361,7 +363,11 @@ namespace mongo {
 
         // This loop consumes all input from pSource and buckets it based on pIdExpression.
         while (boost::optional<Document> input = pSource->getNext()) {
-            if (memoryUsageBytes > _maxMemoryUsageBytes) {
+            // our Values keep the pipeline arena's blocks around them alive, so what is left
+            // unused in those blocks counts too
+            if (!groups.empty()
+                    && memoryUsageBytes + BlockArena::currentOverheadBytes()
+                        > size_t(_maxMemoryUsageBytes)) {
                 uassert(16945, "Exceeded memory limit for $group, but didn't allow external sort",
                         _extSortAllowed);
                 sortedFiles.push_back(spill());
@@ -95,6 +95,7 @@ namespace mongo {
     void DocumentSourceProject::optimize() {
         intrusive_ptr<Expression> pE(pEO->optimize());
         pEO = dynamic_pointer_cast<ExpressionObject>(pE);
+        pEO->compileFields();
     }
 
     Value DocumentSourceProject::serialize(bool explain) const {
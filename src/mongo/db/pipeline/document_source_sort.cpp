@@ -35,6 +35,7 @@
 #include "db/pipeline/expression.h"
 #include "db/pipeline/expression_context.h"
 #include "db/pipeline/value.h"
+#include "mongo/util/block_arena.h"
 
 namespace mongo {
     const char DocumentSourceSort::sortName[] = "$sort";
@@ -208,6 +209,8 @@ namespace mongo {
             opts.limit = limitSrc->getLimit();
 
         opts.maxMemoryUsageBytes = 100*1024*1024;
+        // documents held by the sorter keep the pipeline arena's blocks around them alive
+        opts.extraMemoryUsage = &BlockArena::currentOverheadBytes;
         if (pExpCtx->extSortAllowed && !pExpCtx->inRouter) {
             opts.extSortAllowed = true;
             opts.tempDir = pExpCtx->tempDir;
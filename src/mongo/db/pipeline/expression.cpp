@@ -40,6 +40,7 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/pipeline/document.h"
 #include "mongo/db/pipeline/expression_context.h"
+#include "mongo/db/pipeline/expression_program.h"
 #include "mongo/db/pipeline/value.h"
 #include "mongo/util/string_map.h"
 #include "mongo/util/mongoutils/str.h"
@@ -371,69 +372,95 @@ namespace {
         }
     }
 
-    /* ------------------------- ExpressionAdd ----------------------------- */
-
-    Value ExpressionAdd::evaluateInternal(Variables* vars) const {
+    void Expression::compile(ExpressionProgram* program) const {
+        program->pushEval(this);
+    }
 
-        /*
-          We'll try to return the narrowest possible result value.  To do that
-          without creating intermediate Values, do the arithmetic for double
-          and integral types in parallel, tracking the current narrowest
-          type.
-         */
-        double doubleTotal = 0;
-        long long longTotal = 0;
-        BSONType totalType = NumberInt;
-        bool haveDate = false;
+    /* ------------------------- ExpressionAdd ----------------------------- */
 
-        const size_t n = vpOperand.size();
-        for (size_t i = 0; i < n; ++i) {
-            Value val = vpOperand[i]->evaluateInternal(vars);
+    /*
+      We'll try to return the narrowest possible result value.  To do that
+      without creating intermediate Values, do the arithmetic for double
+      and integral types in parallel, tracking the current narrowest
+      type.
+     */
+    ExpressionAdd::Total::Total()
+        : _doubleTotal(0)
+        , _longTotal(0)
+        , _totalType(NumberInt)
+        , _haveDate(false)
+    {}
 
-            if (val.numeric()) {
-                totalType = Value::getWidestNumeric(totalType, val.getType());
+    bool ExpressionAdd::Total::add(const Value& val) {
+        if (val.numeric()) {
+            _totalType = Value::getWidestNumeric(_totalType, val.getType());
 
-                doubleTotal += val.coerceToDouble();
-                longTotal += val.coerceToLong();
-            }
-            else if (val.getType() == Date) {
-                uassert(16612, "only one Date allowed in an $add expression",
-                        !haveDate);
-                haveDate = true;
+            _doubleTotal += val.coerceToDouble();
+            _longTotal += val.coerceToLong();
+        }
+        else if (val.getType() == Date) {
+            uassert(16612, "only one Date allowed in an $add expression",
+                    !_haveDate);
+            _haveDate = true;
 
-                // We don't manipulate totalType here.
+            // We don't manipulate totalType here.
 
-                longTotal += val.getDate();
-                doubleTotal += val.getDate();
-            }
-            else if (val.nullish()) {
-                return Value(BSONNULL);
-            }
-            else {
-                uasserted(16554, str::stream() << "$add only supports numeric or date types, not "
-                                               << typeName(val.getType()));
-            }
+            _longTotal += val.getDate();
+            _doubleTotal += val.getDate();
+        }
+        else if (val.nullish()) {
+            return false;
+        }
+        else {
+            uasserted(16554, str::stream() << "$add only supports numeric or date types, not "
+                                           << typeName(val.getType()));
         }
+        return true;
+    }
 
-        if (haveDate) {
-            if (totalType == NumberDouble)
-                longTotal = static_cast<long long>(doubleTotal);
+    Value ExpressionAdd::Total::getValue() const {
+        if (_haveDate) {
+            long long longTotal = _longTotal;
+            if (_totalType == NumberDouble)
+                longTotal = static_cast<long long>(_doubleTotal);
             return Value(Date_t(longTotal));
         }
-        else if (totalType == NumberLong) {
-            return Value(longTotal);
+        else if (_totalType == NumberLong) {
+            return Value(_longTotal);
         }
-        else if (totalType == NumberDouble) {
-            return Value(doubleTotal);
+        else if (_totalType == NumberDouble) {
+            return Value(_doubleTotal);
         }
-        else if (totalType == NumberInt) {
-            return Value::createIntOrLong(longTotal);
+        else if (_totalType == NumberInt) {
+            return Value::createIntOrLong(_longTotal);
         }
         else {
             massert(16417, "$add resulted in a non-numeric type", false);
         }
     }
 
+    Value ExpressionAdd::evaluateInternal(Variables* vars) const {
+        Total total;
+        const size_t n = vpOperand.size();
+        for (size_t i = 0; i < n; ++i) {
+            if (!total.add(vpOperand[i]->evaluateInternal(vars)))
+                return Value(BSONNULL);
+        }
+        return total.getValue();
+    }
+
+    void ExpressionAdd::compile(ExpressionProgram* program) const {
+        vector<size_t> nullJumps;
+        program->emit(ExpressionProgram::SUM_BEGIN);
+        for (size_t i = 0; i < vpOperand.size(); ++i) {
+            vpOperand[i]->compile(program);
+            nullJumps.push_back(program->emitJump(ExpressionProgram::SUM_ADD));
+        }
+        program->emit(ExpressionProgram::SUM_END);
+        for (size_t i = 0; i < nullJumps.size(); ++i)
+            program->bind(nullJumps[i]);
+    }
+
     REGISTER_EXPRESSION("$add", ExpressionAdd::parse);
     const char *ExpressionAdd::getOpName() const {
         return "$add";
@@ -530,6 +557,17 @@ namespace {
         return Value(true);
     }
 
+    void ExpressionAnd::compile(ExpressionProgram* program) const {
+        vector<size_t> falseJumps;
+        for (size_t i = 0; i < vpOperand.size(); ++i) {
+            vpOperand[i]->compile(program);
+            falseJumps.push_back(program->emitJump(ExpressionProgram::AND_TEST));
+        }
+        program->pushConstant(Value(true));
+        for (size_t i = 0; i < falseJumps.size(); ++i)
+            program->bind(falseJumps[i]);
+    }
+
     REGISTER_EXPRESSION("$and", ExpressionAnd::parse);
     const char *ExpressionAnd::getOpName() const {
         return "$and";
@@ -599,6 +637,11 @@ namespace {
         return Value(false);
     }
 
+    void ExpressionCoerceToBool::compile(ExpressionProgram* program) const {
+        pExpression->compile(program);
+        program->emit(ExpressionProgram::TO_BOOL);
+    }
+
     Value ExpressionCoerceToBool::serialize(bool explain) const {
         // When not explaining, serialize to an $and expression. When parsed, the $and expression
         // will be optimized back into a ExpressionCoerceToBool.
@@ -662,7 +705,16 @@ namespace {
     Value ExpressionCompare::evaluateInternal(Variables* vars) const {
         Value pLeft(vpOperand[0]->evaluateInternal(vars));
         Value pRight(vpOperand[1]->evaluateInternal(vars));
+        return compare(cmpOp, pLeft, pRight);
+    }
+
+    void ExpressionCompare::compile(ExpressionProgram* program) const {
+        vpOperand[0]->compile(program);
+        vpOperand[1]->compile(program);
+        program->emit(ExpressionProgram::COMPARE, cmpOp);
+    }
 
+    Value ExpressionCompare::compare(CmpOp cmpOp, const Value& pLeft, const Value& pRight) {
         int cmp = Value::compare(pLeft, pRight);
 
         // Make cmp one of 1, 0, or -1.
@@ -719,6 +771,16 @@ namespace {
         return vpOperand[idx]->evaluateInternal(vars);
     }
 
+    void ExpressionCond::compile(ExpressionProgram* program) const {
+        vpOperand[0]->compile(program);
+        const size_t toElse = program->emitJump(ExpressionProgram::JUMP_IF_FALSE);
+        vpOperand[1]->compile(program);
+        const size_t toEnd = program->emitJump(ExpressionProgram::JUMP);
+        program->bind(toElse);
+        vpOperand[2]->compile(program);
+        program->bind(toEnd);
+    }
+
     intrusive_ptr<Expression> ExpressionCond::parse(
             BSONElement expr,
             const VariablesParseState& vps) {
@@ -790,6 +852,10 @@ namespace {
         return pValue;
     }
 
+    void ExpressionConstant::compile(ExpressionProgram* program) const {
+        program->pushConstant(pValue);
+    }
+
     Value ExpressionConstant::serialize(bool explain) const {
         return serializeConstant(pValue);
     }
@@ -893,6 +959,13 @@ namespace {
         return intrusive_ptr<Expression>(this);
     }
 
+    void ExpressionObject::compileFields() {
+        for (FieldMap::iterator it(_expressions.begin()); it!=_expressions.end(); ++it) {
+            if (it->second)
+                it->second = ExpressionProgram::compile(it->second);
+        }
+    }
+
     bool ExpressionObject::isSimple() {
         for (FieldMap::iterator it(_expressions.begin()); it!=_expressions.end(); ++it) {
             if (it->second && !it->second->isSimple())
@@ -1204,7 +1277,12 @@ namespace {
         , _baseVar(_fieldPath.getFieldName(0) == "CURRENT" ? CURRENT :
                    _fieldPath.getFieldName(0) == "ROOT" ?    ROOT :
                                                              OTHER)
-    {}
+    {
+        _fieldHashes.reserve(_fieldPath.getPathLength());
+        for (size_t i = 0; i < _fieldPath.getPathLength(); i++) {
+            _fieldHashes.push_back(DocumentStorage::hashKey(_fieldPath.getFieldName(i)));
+        }
+    }
 
     intrusive_ptr<Expression> ExpressionFieldPath::optimize() {
         /* nothing can be done for these */
@@ -1245,10 +1323,10 @@ namespace {
 
         /* if we've hit the end of the path, stop */
         if (index == _fieldPath.getPathLength() - 1)
-            return input[_fieldPath.getFieldName(index)];
+            return input.getField(_fieldPath.getFieldName(index), _fieldHashes[index]);
 
         // Try to dive deeper
-        const Value val = input[_fieldPath.getFieldName(index)];
+        const Value val = input.getField(_fieldPath.getFieldName(index), _fieldHashes[index]);
         switch (val.getType()) {
         case Object:
             return evaluatePath(index+1, val.getDocument());
@@ -1278,6 +1356,10 @@ namespace {
         }
     }
 
+    void ExpressionFieldPath::compile(ExpressionProgram* program) const {
+        program->pushFieldPath(this);
+    }
+
     Value ExpressionFieldPath::serialize(bool explain) const {
         if (_fieldPath.getFieldName(0) == "CURRENT" && _fieldPath.getPathLength() > 1) {
             // use short form for "$$CURRENT.foo" but not just "$$CURRENT"
@@ -1630,46 +1712,68 @@ namespace {
 
     /* ------------------------- ExpressionMultiply ----------------------------- */
 
-    Value ExpressionMultiply::evaluateInternal(Variables* vars) const {
-        /*
-          We'll try to return the narrowest possible result value.  To do that
-          without creating intermediate Values, do the arithmetic for double
-          and integral types in parallel, tracking the current narrowest
-          type.
-         */
-        double doubleProduct = 1;
-        long long longProduct = 1;
-        BSONType productType = NumberInt;
-
-        const size_t n = vpOperand.size();
-        for(size_t i = 0; i < n; ++i) {
-            Value val = vpOperand[i]->evaluateInternal(vars);
+    /*
+      We'll try to return the narrowest possible result value.  To do that
+      without creating intermediate Values, do the arithmetic for double
+      and integral types in parallel, tracking the current narrowest
+      type.
+     */
+    ExpressionMultiply::Product::Product()
+        : _doubleProduct(1)
+        , _longProduct(1)
+        , _productType(NumberInt)
+    {}
 
-            if (val.numeric()) {
-                productType = Value::getWidestNumeric(productType, val.getType());
+    bool ExpressionMultiply::Product::multiply(const Value& val) {
+        if (val.numeric()) {
+            _productType = Value::getWidestNumeric(_productType, val.getType());
 
-                doubleProduct *= val.coerceToDouble();
-                longProduct *= val.coerceToLong();
-            }
-            else if (val.nullish()) {
-                return Value(BSONNULL);
-            }
-            else {
-                uasserted(16555, str::stream() << "$multiply only supports numeric types, not "
-                                               << typeName(val.getType()));
-            }
+            _doubleProduct *= val.coerceToDouble();
+            _longProduct *= val.coerceToLong();
+        }
+        else if (val.nullish()) {
+            return false;
         }
+        else {
+            uasserted(16555, str::stream() << "$multiply only supports numeric types, not "
+                                           << typeName(val.getType()));
+        }
+        return true;
+    }
 
-        if (productType == NumberDouble)
-            return Value(doubleProduct);
-        else if (productType == NumberLong)
-            return Value(longProduct);
-        else if (productType == NumberInt)
-            return Value::createIntOrLong(longProduct);
+    Value ExpressionMultiply::Product::getValue() const {
+        if (_productType == NumberDouble)
+            return Value(_doubleProduct);
+        else if (_productType == NumberLong)
+            return Value(_longProduct);
+        else if (_productType == NumberInt)
+            return Value::createIntOrLong(_longProduct);
         else
             massert(16418, "$multiply resulted in a non-numeric type", false);
     }
 
+    Value ExpressionMultiply::evaluateInternal(Variables* vars) const {
+        Product product;
+        const size_t n = vpOperand.size();
+        for(size_t i = 0; i < n; ++i) {
+            if (!product.multiply(vpOperand[i]->evaluateInternal(vars)))
+                return Value(BSONNULL);
+        }
+        return product.getValue();
+    }
+
+    void ExpressionMultiply::compile(ExpressionProgram* program) const {
+        vector<size_t> nullJumps;
+        program->emit(ExpressionProgram::PRODUCT_BEGIN);
+        for (size_t i = 0; i < vpOperand.size(); ++i) {
+            vpOperand[i]->compile(program);
+            nullJumps.push_back(program->emitJump(ExpressionProgram::PRODUCT_MULTIPLY));
+        }
+        program->emit(ExpressionProgram::PRODUCT_END);
+        for (size_t i = 0; i < nullJumps.size(); ++i)
+            program->bind(nullJumps[i]);
+    }
+
     REGISTER_EXPRESSION("$multiply", ExpressionMultiply::parse);
     const char *ExpressionMultiply::getOpName() const {
         return "$multiply";
@@ -1812,6 +1916,11 @@ namespace {
         return Value(!b);
     }
 
+    void ExpressionNot::compile(ExpressionProgram* program) const {
+        vpOperand[0]->compile(program);
+        program->emit(ExpressionProgram::NOT);
+    }
+
     REGISTER_EXPRESSION("$not", ExpressionNot::parse);
     const char *ExpressionNot::getOpName() const {
         return "$not";
@@ -1830,6 +1939,17 @@ namespace {
         return Value(false);
     }
 
+    void ExpressionOr::compile(ExpressionProgram* program) const {
+        vector<size_t> trueJumps;
+        for (size_t i = 0; i < vpOperand.size(); ++i) {
+            vpOperand[i]->compile(program);
+            trueJumps.push_back(program->emitJump(ExpressionProgram::OR_TEST));
+        }
+        program->pushConstant(Value(false));
+        for (size_t i = 0; i < trueJumps.size(); ++i)
+            program->bind(trueJumps[i]);
+    }
+
     intrusive_ptr<Expression> ExpressionOr::optimize() {
         /* optimize the disjunction as much as possible */
         intrusive_ptr<Expression> pE(ExpressionNary::optimize());
@@ -2222,7 +2342,16 @@ namespace {
     Value ExpressionSubtract::evaluateInternal(Variables* vars) const {
         Value lhs = vpOperand[0]->evaluateInternal(vars);
         Value rhs = vpOperand[1]->evaluateInternal(vars);
-            
+        return subtract(lhs, rhs);
+    }
+
+    void ExpressionSubtract::compile(ExpressionProgram* program) const {
+        vpOperand[0]->compile(program);
+        vpOperand[1]->compile(program);
+        program->emit(ExpressionProgram::SUBTRACT);
+    }
+
+    Value ExpressionSubtract::subtract(const Value& lhs, const Value& rhs) {
         BSONType diffType = Value::getWidestNumeric(rhs.getType(), lhs.getType());
 
         if (diffType == NumberDouble) {
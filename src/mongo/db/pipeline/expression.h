@@ -43,6 +43,7 @@ namespace mongo {
     class BSONElement;
     class BSONObjBuilder;
     class DocumentSource;
+    class ExpressionProgram;
 
     // TODO: Look into merging with ExpressionContext and possibly ObjectCtx.
     /// The state used as input and working space for Expressions.
@@ -202,6 +203,14 @@ namespace mongo {
          */
         Value evaluate(Variables* vars) const { return evaluateInternal(vars); }
 
+        /**
+         * Append instructions computing this expression to 'program'.  See ExpressionProgram.
+         *
+         * The default evaluates the whole subtree with one call to evaluateInternal().  Operators
+         * common in $project and $group keys override this to lay out their operands inline.
+         */
+        virtual void compile(ExpressionProgram* program) const;
+
         /*
           Utility class for parseObject() below.
 
@@ -363,8 +372,26 @@ namespace mongo {
     public:
         // virtuals from Expression
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
         virtual bool isAssociativeAndCommutative() const { return true; }
+
+        /// The running total of an $add, operand by operand.
+        class Total {
+        public:
+            Total();
+
+            /// Adds 'val'. Returns false if it is nullish, which makes the whole $add null.
+            bool add(const Value& val);
+
+            Value getValue() const;
+
+        private:
+            double _doubleTotal;
+            long long _longTotal;
+            BSONType _totalType;
+            bool _haveDate;
+        };
     };
 
 
@@ -381,6 +408,7 @@ namespace mongo {
         // virtuals from Expression
         virtual intrusive_ptr<Expression> optimize();
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
         virtual bool isAssociativeAndCommutative() const { return true; }
     };
@@ -400,6 +428,7 @@ namespace mongo {
         virtual intrusive_ptr<Expression> optimize();
         virtual void addDependencies(set<string>& deps, vector<string>* path=NULL) const;
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual Value serialize(bool explain) const;
 
         static intrusive_ptr<ExpressionCoerceToBool> create(
@@ -431,6 +460,7 @@ namespace mongo {
 
         // virtuals from ExpressionNary
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
 
         static intrusive_ptr<Expression> parse(
@@ -438,6 +468,9 @@ namespace mongo {
             const VariablesParseState& vps,
             CmpOp cmpOp);
 
+        /// The result of comparing 'left' to 'right' with 'cmpOp'.
+        static Value compare(CmpOp cmpOp, const Value& left, const Value& right);
+
         ExpressionCompare(CmpOp cmpOp);
 
     private:
@@ -458,6 +491,7 @@ namespace mongo {
     public:
         // virtuals from ExpressionNary
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
 
         static intrusive_ptr<Expression> parse(
@@ -472,6 +506,7 @@ namespace mongo {
         virtual intrusive_ptr<Expression> optimize();
         virtual void addDependencies(set<string>& deps, vector<string>* path=NULL) const;
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
         virtual Value serialize(bool explain) const;
 
@@ -532,6 +567,7 @@ namespace mongo {
         virtual intrusive_ptr<Expression> optimize();
         virtual void addDependencies(set<string>& deps, vector<string>* path=NULL) const;
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual Value serialize(bool explain) const;
 
         /*
@@ -587,6 +623,10 @@ namespace mongo {
         const FieldPath _fieldPath;
         const Variables::Id _variable;
         const BaseVar _baseVar; // TODO remove
+
+        // DocumentStorage::hashKey() of each path component, resolved once at parse time so
+        // lookups in every input document can skip hashing the field name.
+        vector<unsigned> _fieldHashes;
     };
 
 
@@ -703,8 +743,25 @@ namespace mongo {
     public:
         // virtuals from Expression
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
         virtual bool isAssociativeAndCommutative() const { return true; }
+
+        /// The running product of a $multiply, operand by operand.
+        class Product {
+        public:
+            Product();
+
+            /// Multiplies by 'val'. Returns false if it is nullish, which makes the result null.
+            bool multiply(const Value& val);
+
+            Value getValue() const;
+
+        private:
+            double _doubleProduct;
+            long long _longProduct;
+            BSONType _productType;
+        };
     };
 
 
@@ -720,6 +777,7 @@ namespace mongo {
     public:
         // virtuals from ExpressionNary
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
     };
 
@@ -737,6 +795,13 @@ namespace mongo {
         /// like evaluate(), but return a Document instead of a Value-wrapped Document.
         Document evaluateDocument(Variables* vars) const;
 
+        /**
+         * Replace each computed field with its ExpressionProgram::compile()d form.  Nested
+         * ExpressionObjects are compiled in place rather than wrapped, since addToDocument()
+         * merges them into subdocuments of the input.
+         */
+        void compileFields();
+
         /** Evaluates with inclusions and adds results to passed in Mutable document
          *
          *  @param output the MutableDocument to add the evaluated expressions to
@@ -839,6 +904,7 @@ namespace mongo {
         // virtuals from Expression
         virtual intrusive_ptr<Expression> optimize();
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
         virtual bool isAssociativeAndCommutative() const { return true; }
     };
@@ -927,7 +993,11 @@ namespace mongo {
     public:
         // virtuals from ExpressionNary
         virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
         virtual const char *getOpName() const;
+
+        /// The result of 'lhs' - 'rhs'.
+        static Value subtract(const Value& lhs, const Value& rhs);
     };
 
 
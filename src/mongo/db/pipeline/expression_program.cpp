@@ -0,0 +1,285 @@
+/**
+ * Copyright (C) 2014 MongoDB Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, the copyright holders give permission to link the
+ * code of portions of this program with the OpenSSL library under certain
+ * conditions as described in each individual source file and distribute
+ * linked combinations including the program with the OpenSSL library. You
+ * must comply with the GNU Affero General Public License in all respects
+ * for all of the code used other than as permitted herein. If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so. If you do not
+ * wish to do so, delete this exception statement from your version. If you
+ * delete this exception statement from all source files in the program,
+ * then also delete it in the license file.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pipeline/expression_program.h"
+
+#include "mongo/db/server_parameters.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalAggregationCompileExpressions, bool, true);
+
+    intrusive_ptr<Expression> ExpressionProgram::compile(const intrusive_ptr<Expression>& expr) {
+        if (!internalAggregationCompileExpressions)
+            return expr;
+
+        if (ExpressionObject* object = dynamic_cast<ExpressionObject*>(expr.get())) {
+            object->compileFields();
+            return expr;
+        }
+
+        // optimize() may run more than once on a pipeline
+        if (dynamic_cast<ExpressionCompiled*>(expr.get()))
+            return expr;
+
+        intrusive_ptr<ExpressionCompiled> compiled(new ExpressionCompiled(expr));
+        const ExpressionProgram& program = compiled->getProgram();
+
+        // A one instruction program makes the same single call the tree would.
+        if (!program.ok() || program.size() <= 1)
+            return expr;
+
+        return compiled;
+    }
+
+    ExpressionProgram::ExpressionProgram()
+        : _depth(0)
+        , _sumDepth(0)
+        , _productDepth(0)
+        , _ok(true)
+    {}
+
+    void ExpressionProgram::adjustDepth(int values, int sums, int products) {
+        _depth += values;
+        _sumDepth += sums;
+        _productDepth += products;
+        if (_depth > kMaxStackDepth
+                || _sumDepth > kMaxAccumulatorDepth
+                || _productDepth > kMaxAccumulatorDepth)
+            _ok = false;
+    }
+
+    void ExpressionProgram::pushConstant(const Value& value) {
+        _constants.push_back(value);
+        emit(PUSH_CONSTANT, _constants.size() - 1);
+    }
+
+    void ExpressionProgram::pushFieldPath(const ExpressionFieldPath* expr) {
+        _expressions.push_back(expr);
+        emit(PUSH_FIELD_PATH, _expressions.size() - 1);
+    }
+
+    void ExpressionProgram::pushEval(const Expression* expr) {
+        _expressions.push_back(expr);
+        emit(PUSH_EVAL, _expressions.size() - 1);
+    }
+
+    void ExpressionProgram::emit(OpCode op, unsigned arg) {
+        Instruction instruction = { op, arg };
+        _code.push_back(instruction);
+
+        switch (op) {
+        case PUSH_CONSTANT:
+        case PUSH_FIELD_PATH:
+        case PUSH_EVAL:        adjustDepth(1, 0, 0); break;
+        case SUM_BEGIN:        adjustDepth(0, 1, 0); break;
+        case SUM_END:          adjustDepth(1, -1, 0); break;
+        case PRODUCT_BEGIN:    adjustDepth(0, 0, 1); break;
+        case PRODUCT_END:      adjustDepth(1, 0, -1); break;
+        case SUBTRACT:
+        case COMPARE:          adjustDepth(-1, 0, 0); break;
+        case TO_BOOL:
+        case NOT:              break;
+        default:
+            verify(false); // jumps go through emitJump()
+        }
+    }
+
+    size_t ExpressionProgram::emitJump(OpCode op) {
+        Label label = { _code.size(), _depth, _sumDepth, _productDepth };
+        int fallThrough = 0;
+
+        switch (op) {
+        case JUMP:
+            break;
+        case JUMP_IF_FALSE:
+            label.depth--;
+            fallThrough = -1;
+            break;
+        case SUM_ADD:
+            label.sumDepth--;
+            fallThrough = -1;
+            break;
+        case PRODUCT_MULTIPLY:
+            label.productDepth--;
+            fallThrough = -1;
+            break;
+        case AND_TEST:
+        case OR_TEST:
+            fallThrough = -1;
+            break;
+        default:
+            verify(false);
+        }
+
+        Instruction instruction = { op, 0 };
+        _code.push_back(instruction);
+        _labels.push_back(label);
+        adjustDepth(fallThrough, 0, 0);
+        return _labels.size() - 1;
+    }
+
+    void ExpressionProgram::bind(size_t label) {
+        const Label& target = _labels[label];
+        _code[target.instruction].arg = _code.size();
+
+        // Code after an unconditional JUMP is only reached through its labels, so the depths at
+        // the target are the ones recorded on the jumping path.
+        _depth = target.depth;
+        _sumDepth = target.sumDepth;
+        _productDepth = target.productDepth;
+    }
+
+    Value ExpressionProgram::run(Variables* vars) const {
+        Value stack[kMaxStackDepth];
+        ExpressionAdd::Total sums[kMaxAccumulatorDepth];
+        ExpressionMultiply::Product products[kMaxAccumulatorDepth];
+        int sp = 0;
+        int sumSp = 0;
+        int productSp = 0;
+
+        const Instruction* const code = &_code[0];
+        const size_t n = _code.size();
+        size_t pc = 0;
+        while (pc < n) {
+            const Instruction& instruction = code[pc++];
+            switch (instruction.op) {
+            case PUSH_CONSTANT:
+                stack[sp++] = _constants[instruction.arg];
+                break;
+            case PUSH_FIELD_PATH:
+                // qualified, so this is a direct rather than a virtual call
+                stack[sp++] = static_cast<const ExpressionFieldPath*>(_expressions[instruction.arg])
+                                  ->ExpressionFieldPath::evaluateInternal(vars);
+                break;
+            case PUSH_EVAL:
+                stack[sp++] = _expressions[instruction.arg]->evaluateInternal(vars);
+                break;
+
+            case SUM_BEGIN:
+                sums[sumSp++] = ExpressionAdd::Total();
+                break;
+            case SUM_ADD:
+                sp--;
+                if (!sums[sumSp - 1].add(stack[sp])) {
+                    sumSp--;
+                    stack[sp++] = Value(BSONNULL);
+                    pc = instruction.arg;
+                }
+                break;
+            case SUM_END:
+                stack[sp++] = sums[--sumSp].getValue();
+                break;
+
+            case PRODUCT_BEGIN:
+                products[productSp++] = ExpressionMultiply::Product();
+                break;
+            case PRODUCT_MULTIPLY:
+                sp--;
+                if (!products[productSp - 1].multiply(stack[sp])) {
+                    productSp--;
+                    stack[sp++] = Value(BSONNULL);
+                    pc = instruction.arg;
+                }
+                break;
+            case PRODUCT_END:
+                stack[sp++] = products[--productSp].getValue();
+                break;
+
+            case SUBTRACT:
+                sp--;
+                stack[sp - 1] = ExpressionSubtract::subtract(stack[sp - 1], stack[sp]);
+                break;
+            case COMPARE:
+                sp--;
+                stack[sp - 1] = ExpressionCompare::compare(
+                        static_cast<ExpressionCompare::CmpOp>(instruction.arg),
+                        stack[sp - 1],
+                        stack[sp]);
+                break;
+            case TO_BOOL:
+                stack[sp - 1] = Value(stack[sp - 1].coerceToBool());
+                break;
+            case NOT:
+                stack[sp - 1] = Value(!stack[sp - 1].coerceToBool());
+                break;
+
+            case JUMP:
+                pc = instruction.arg;
+                break;
+            case JUMP_IF_FALSE:
+                sp--;
+                if (!stack[sp].coerceToBool())
+                    pc = instruction.arg;
+                break;
+            case AND_TEST:
+                sp--;
+                if (!stack[sp].coerceToBool()) {
+                    stack[sp++] = Value(false);
+                    pc = instruction.arg;
+                }
+                break;
+            case OR_TEST:
+                sp--;
+                if (stack[sp].coerceToBool()) {
+                    stack[sp++] = Value(true);
+                    pc = instruction.arg;
+                }
+                break;
+            }
+        }
+
+        dassert(sp == 1);
+        return stack[0];
+    }
+
+    /* ------------------------- ExpressionCompiled ----------------------------- */
+
+    ExpressionCompiled::ExpressionCompiled(const intrusive_ptr<Expression>& original)
+        : _original(original) {
+        _original->compile(&_program);
+    }
+
+    void ExpressionCompiled::addDependencies(set<string>& deps, vector<string>* path) const {
+        _original->addDependencies(deps, path);
+    }
+
+    Value ExpressionCompiled::evaluateInternal(Variables* vars) const {
+        return _program.run(vars);
+    }
+
+    void ExpressionCompiled::compile(ExpressionProgram* program) const {
+        _original->compile(program);
+    }
+
+    Value ExpressionCompiled::serialize(bool explain) const {
+        return _original->serialize(explain);
+    }
+}
@@ -0,0 +1,158 @@
+/**
+ * Copyright (C) 2014 MongoDB Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, the copyright holders give permission to link the
+ * code of portions of this program with the OpenSSL library under certain
+ * conditions as described in each individual source file and distribute
+ * linked combinations including the program with the OpenSSL library. You
+ * must comply with the GNU Affero General Public License in all respects
+ * for all of the code used other than as permitted herein. If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so. If you do not
+ * wish to do so, delete this exception statement from your version. If you
+ * delete this exception statement from all source files in the program,
+ * then also delete it in the license file.
+ */
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pipeline/expression.h"
+
+namespace mongo {
+
+    /**
+     * A flattened form of an Expression tree, evaluated by a loop over an instruction array
+     * instead of one virtual evaluateInternal() call per tree node.
+     *
+     * Operands are kept on a small fixed-size value stack.  Field paths and constants are leaves
+     * of the program; any operator without a compile() override becomes a single PUSH_EVAL of its
+     * whole subtree, so compiling never changes what an expression computes, only how many calls
+     * and intermediate Values it takes.  $add and $multiply keep their running totals in the
+     * same ExpressionAdd::Total / ExpressionMultiply::Product the tree form uses, and short-circuit
+     * operators ($and, $or, $cond, nullish $add/$multiply operands) jump over the operands they
+     * would not have evaluated.
+     *
+     * Programs are built with the Expression::compile() overrides in expression.cpp.
+     */
+    class ExpressionProgram {
+    public:
+        enum OpCode {
+            PUSH_CONSTANT,     // push _constants[arg]
+            PUSH_FIELD_PATH,   // push the value of the ExpressionFieldPath _expressions[arg]
+            PUSH_EVAL,         // push _expressions[arg]->evaluateInternal()
+            SUM_BEGIN,         // start a new $add total
+            SUM_ADD,           // pop into the total; if nullish drop it, push null, jump to arg
+            SUM_END,           // drop the total and push its value
+            PRODUCT_BEGIN,     // start a new $multiply product
+            PRODUCT_MULTIPLY,  // pop into the product; if nullish drop it, push null, jump to arg
+            PRODUCT_END,       // drop the product and push its value
+            SUBTRACT,          // pop rhs and lhs, push lhs - rhs
+            COMPARE,           // pop rhs and lhs, push the ExpressionCompare::CmpOp arg result
+            TO_BOOL,           // replace the top with its coerceToBool()
+            NOT,               // replace the top with !coerceToBool()
+            JUMP,              // jump to arg
+            JUMP_IF_FALSE,     // pop; jump to arg if it coerces to false
+            AND_TEST,          // pop; if it coerces to false push false and jump to arg
+            OR_TEST,           // pop; if it coerces to true push true and jump to arg
+        };
+
+        /// Deepest value stack a program may use; deeper expressions are left uncompiled.
+        static const int kMaxStackDepth = 8;
+
+        /// Deepest nesting of $add (or of $multiply) a program may use.
+        static const int kMaxAccumulatorDepth = 2;
+
+        /**
+         * Returns an expression computing the same thing as 'expr' using compiled programs, or
+         * 'expr' itself if compiling would not help.  ExpressionObjects have their fields compiled
+         * in place.  Controlled by the internalAggregationCompileExpressions server parameter.
+         */
+        static intrusive_ptr<Expression> compile(const intrusive_ptr<Expression>& expr);
+
+        ExpressionProgram();
+
+        Value run(Variables* vars) const;
+
+        /// Number of instructions emitted so far.
+        size_t size() const { return _code.size(); }
+
+        /// False once the program has outgrown kMaxStackDepth or kMaxAccumulatorDepth.
+        bool ok() const { return _ok; }
+
+        //
+        // Emitters used by the Expression::compile() overrides
+        //
+
+        void pushConstant(const Value& value);
+        void pushFieldPath(const ExpressionFieldPath* expr);
+        void pushEval(const Expression* expr);
+
+        /// Emit an instruction that does not jump.
+        void emit(OpCode op, unsigned arg = 0);
+
+        /// Emit a jump whose target is set by a later bind() of the returned label.
+        size_t emitJump(OpCode op);
+
+        /// Point the jump 'label' at the next instruction to be emitted.
+        void bind(size_t label);
+
+    private:
+        struct Instruction {
+            OpCode op;
+            unsigned arg;
+        };
+
+        // Stack depths on the path where a pending jump is taken, restored at its target.
+        struct Label {
+            size_t instruction;
+            int depth;
+            int sumDepth;
+            int productDepth;
+        };
+
+        void adjustDepth(int values, int sums, int products);
+
+        vector<Instruction> _code;
+        vector<Value> _constants;
+        // Not owned: the compiled tree is kept alive by the ExpressionCompiled that runs us.
+        vector<const Expression*> _expressions;
+        vector<Label> _labels;
+
+        int _depth;
+        int _sumDepth;
+        int _productDepth;
+        bool _ok;
+    };
+
+    /// Runs an ExpressionProgram in place of the tree it was compiled from.
+    class ExpressionCompiled : public Expression {
+    public:
+        // virtuals from Expression
+        virtual void addDependencies(set<string>& deps, vector<string>* path=NULL) const;
+        virtual Value evaluateInternal(Variables* vars) const;
+        virtual void compile(ExpressionProgram* program) const;
+        virtual Value serialize(bool explain) const;
+
+        ExpressionCompiled(const intrusive_ptr<Expression>& original);
+
+        const ExpressionProgram& getProgram() const { return _program; }
+
+    private:
+        const intrusive_ptr<Expression> _original;
+        ExpressionProgram _program;
+    };
+}
@@ -41,10 +41,15 @@
 #include "mongo/db/pipeline/document_source.h"
 #include "mongo/db/pipeline/expression.h"
 #include "mongo/db/pipeline/expression_context.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/util/mongoutils/str.h"
 
 namespace mongo {
 
+    // Allocate the Documents and Values of each pipeline from a BlockArena rather than
+    // individually from the heap.
+    MONGO_EXPORT_SERVER_PARAMETER(internalAggregationUseArena, bool, true);
+
     const char Pipeline::commandName[] = "aggregate";
     const char Pipeline::pipelineName[] = "pipeline";
     const char Pipeline::explainName[] = "explain";
@@ -54,7 +59,8 @@ namespace mongo {
 
     Pipeline::Pipeline(const intrusive_ptr<ExpressionContext> &pTheCtx):
         explain(false),
-        pCtx(pTheCtx) {
+        pCtx(pTheCtx),
+        arena(internalAggregationUseArena ? new BlockArena() : NULL) {
     }
 
 
@@ -460,6 +466,7 @@ namespace mongo {
         // the array in which the aggregation results reside
         // cant use subArrayStart() due to error handling
         BSONArrayBuilder resultArray;
+        BlockArena::Scope arenaScope(getArena());
         DocumentSource* finalSource = sources.back().get();
         while (boost::optional<Document> next = finalSource->getNext()) {
             // add the document to the result set
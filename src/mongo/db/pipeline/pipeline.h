@@ -28,11 +28,13 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
 #include <deque>
 
 #include "mongo/pch.h"
 
 #include "mongo/db/pipeline/value.h"
+#include "mongo/util/block_arena.h"
 #include "mongo/util/intrusive_counter.h"
 #include "mongo/util/timer.h"
 
@@ -127,6 +129,13 @@ namespace mongo {
         /// Returns true if this pipeline only uses features that work in mongos.
         bool canRunInMongos() const;
 
+        /**
+         * The arena that Documents and Values created while running this pipeline should come
+         * from, or NULL if arena allocation is disabled. Install it with BlockArena::Scope
+         * around anything that pulls documents through the pipeline.
+         */
+        BlockArena* getArena() const { return arena.get(); }
+
         /**
          * Write the pipeline's operators to a vector<Value>, with the
          * explain flag true (for DocumentSource::serializeToArray()).
@@ -175,5 +184,6 @@ namespace mongo {
         bool explain;
 
         boost::intrusive_ptr<ExpressionContext> pCtx;
+        boost::scoped_ptr<BlockArena> arena;
     };
 } // namespace mongo
@@ -33,6 +33,7 @@
 #include "bson/bsontypes.h"
 #include "bson/bsonmisc.h"
 #include "bson/oid.h"
+#include "util/block_arena.h"
 #include "util/intrusive_counter.h"
 #include "mongo/bson/optime.h"
 
@@ -48,6 +49,8 @@ namespace mongo {
     public:
         RCVector() {}
         RCVector(const vector<Value>& v) :vec(v) {}
+        void* operator new(size_t bytes) { return BlockArena::allocate(bytes); }
+        void operator delete(void* ptr) { BlockArena::free(ptr); }
         vector<Value> vec;
     };
 
@@ -99,7 +99,7 @@ namespace mongo {
         boost::scoped_ptr<PlanExecutor> _exec;
 
         // Owned here. If non-NULL, then this plan executor is capable
-        // of executing a backup plan in the case of a blocking sort.
+        // of executing a backup plan in the case of a blocking stage.
         std::auto_ptr<PlanExecutor> _backupPlan;
 
         // Owned here. If non-NULL, contains the query solution corresponding
@@ -357,6 +357,9 @@ namespace mongo {
             for (size_t i = 0; i < spec->mapAfterChild.size(); ++i) {
                 bob.appendNumber(string(stream() << "mapAfterChild_" << i), spec->mapAfterChild[i]);
             }
+            bob.appendNumber("filterRejects", spec->filterRejects);
+            bob.appendNumber("memUsage", spec->memUsage);
+            bob.appendNumber("memLimit", spec->memLimit);
         }
         else if (STAGE_AND_SORTED == stats.stageType) {
             AndSortedStats* spec = static_cast<AndSortedStats*>(stats.specific.get());
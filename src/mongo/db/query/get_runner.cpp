@@ -164,11 +164,14 @@ namespace mongo {
             IndexCatalog::IndexIterator ii = collection->getIndexCatalog()->getIndexIterator( false );
             while ( ii.more() ) {
                 const IndexDescriptor* desc = ii.next();
+                const MatchExpression* filterExpr =
+                    collection->getIndexCatalog()->getFilterExpression(desc);
                 plannerParams.indices.push_back(IndexEntry(desc->keyPattern(),
                                                            desc->isMultikey(),
                                                            desc->isSparse(),
                                                            desc->indexName(),
-                                                           desc->infoObj()));
+                                                           desc->infoObj(),
+                                                           filterExpr));
             }
         }
 
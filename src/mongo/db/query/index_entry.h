@@ -31,6 +31,7 @@
 #include <string>
 
 #include "mongo/db/jsobj.h"
+#include "mongo/db/matcher/expression.h"
 
 namespace mongo {
 
@@ -42,12 +43,14 @@ namespace mongo {
                    bool mk = false,
                    bool sp = false,
                    const string& n = "default_name",
-                   const BSONObj& io = BSONObj())
+                   const BSONObj& io = BSONObj(),
+                   const MatchExpression* fe = NULL)
             : keyPattern(kp),
               multikey(mk),
               sparse(sp),
               name(n),
-              infoObj(io) { }
+              infoObj(io),
+              filterExpr(fe) { }
 
         BSONObj keyPattern;
 
@@ -60,6 +63,10 @@ namespace mongo {
         // Geo indices have extra parameters.  We need those available to plan correctly.
         BSONObj infoObj;
 
+        // Partial indices only hold the documents matching this filter, and can only be used by
+        // queries which imply it.  NULL for other indices.  Not owned here.
+        const MatchExpression* filterExpr;
+
         std::string toString() const {
             mongoutils::str::stream ss;
             ss << "kp: "  << keyPattern.toString();
@@ -72,6 +79,10 @@ namespace mongo {
                 ss << " sparse";
             }
 
+            if (NULL != filterExpr) {
+                ss << " partial";
+            }
+
             if (!infoObj.isEmpty()) {
                 ss << " io: " << infoObj.toString();
             }
@@ -296,7 +296,7 @@ namespace mongo {
         }
 
         if (NULL != _backupSolution && Runner::RUNNER_ADVANCED == state) {
-            QLOG() << "Best plan had a blocking sort, became unblocked, deleting backup plan\n";
+            QLOG() << "Best plan had a blocking stage, became unblocked, deleting backup plan\n";
             delete _backupSolution;
             delete _backupPlan;
             _backupSolution = NULL;
@@ -332,10 +332,10 @@ namespace mongo {
         QLOG() << "Winning solution:\n" << _bestSolution->toString() << endl;
 
         size_t backupChild = bestChild;
-        if (_bestSolution->hasSortStage && (0 == _alreadyProduced.size())) {
-            QLOG() << "Winner has blocked sort, looking for backup plan...\n";
+        if (_bestSolution->hasBlockingStage() && (0 == _alreadyProduced.size())) {
+            QLOG() << "Winner has blocking stage, looking for backup plan...\n";
             for (size_t i = 0; i < _candidates.size(); ++i) {
-                if (!_candidates[i].solution->hasSortStage) {
+                if (!_candidates[i].solution->hasBlockingStage()) {
                     QLOG() << "Candidate " << i << " is backup child\n";
                     backupChild = i;
                     _backupSolution = _candidates[i].solution;
@@ -187,7 +187,7 @@ namespace mongo {
         std::vector<SolutionCacheData*> plannerData;
 
         // An index into plannerData indicating the SolutionCacheData which should be
-        // used to produce a backup solution in the case of a blocking sort.
+        // used to produce a backup solution in the case of a blocking stage.
         boost::optional<size_t> backupSoln;
 
         // Key used to provide feedback on the entry.
@@ -237,7 +237,7 @@ namespace mongo {
         std::vector<SolutionCacheData*> plannerData;
 
         // An index into plannerData indicating the SolutionCacheData which should be
-        // used to produce a backup solution in the case of a blocking sort.
+        // used to produce a backup solution in the case of a blocking stage.
         boost::optional<size_t> backupSoln;
 
         // XXX: Replace with copy of canonical query?
@@ -44,6 +44,21 @@ namespace mongo {
     //
 
     namespace {
+        /**
+         * Returns true if 'root' or any node below it is a 'type' stage.
+         */
+        bool hasStage(const QuerySolutionNode* root, StageType type) {
+            if (type == root->getType()) {
+                return true;
+            }
+            for (size_t i = 0; i < root->children.size(); ++i) {
+                if (hasStage(root->children[i], type)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
         /**
          * Walk the tree 'root' and output all leaf nodes into 'leafNodes'.
          */
@@ -505,6 +520,7 @@ namespace mongo {
             solnRoot = limit;
         }
 
+        soln->hasAndHashStage = hasStage(solnRoot, STAGE_AND_HASH);
         soln->root.reset(solnRoot);
         return soln.release();
     }
@@ -34,6 +34,7 @@
 #include "mongo/db/geo/hash.h"
 #include "mongo/db/matcher/expression_array.h"
 #include "mongo/db/matcher/expression_geo.h"
+#include "mongo/db/matcher/expression_leaf.h"
 #include "mongo/db/matcher/expression_text.h"
 #include "mongo/db/query/indexability.h"
 #include "mongo/db/query/index_tag.h"
@@ -264,4 +265,159 @@ namespace mongo {
         }
     }
 
+    /**
+     * Can range predicates over 'e' be compared by value?  Null and undefined also match missing
+     * fields, MinKey and MaxKey match every type, and arrays are never range compared.
+     */
+    static bool isOrderedValue(const BSONElement& e) {
+        switch (e.type()) {
+        case jstNULL:
+        case Undefined:
+        case MinKey:
+        case MaxKey:
+        case Array:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    static bool isComparison(MatchExpression::MatchType type) {
+        return MatchExpression::EQ == type || MatchExpression::LT == type
+            || MatchExpression::LTE == type || MatchExpression::GT == type
+            || MatchExpression::GTE == type;
+    }
+
+    /**
+     * Does every element matching the leaf 'query' also match the leaf 'filter'?  Both must be
+     * over the same path, so a document matching 'query' matches 'filter' through the same
+     * element.
+     */
+    static bool leafImplies(const MatchExpression* query, const MatchExpression* filter) {
+        if (query->path() != filter->path()) {
+            return false;
+        }
+
+        const MatchExpression::MatchType qt = query->matchType();
+        const MatchExpression::MatchType ft = filter->matchType();
+
+        if (MatchExpression::TYPE_OPERATOR == qt) {
+            if (MatchExpression::TYPE_OPERATOR == ft) {
+                return static_cast<const TypeMatchExpression*>(query)->getData()
+                    == static_cast<const TypeMatchExpression*>(filter)->getData();
+            }
+            // Only elements that are present have a type.
+            return MatchExpression::EXISTS == ft;
+        }
+
+        if (MatchExpression::EXISTS == qt) {
+            return MatchExpression::EXISTS == ft;
+        }
+
+        if (!isComparison(qt)) {
+            return false;
+        }
+
+        const BSONElement& qv = static_cast<const ComparisonMatchExpression*>(query)->getData();
+
+        if (MatchExpression::EXISTS == ft) {
+            // A missing field only matches null and the MinKey/MaxKey ranges.
+            return isOrderedValue(qv);
+        }
+
+        // Comparisons see through numeric types, so {a: 1} doesn't imply {a: {$type: 16}}.
+        if (!isComparison(ft)) {
+            return false;
+        }
+
+        const BSONElement& fv = static_cast<const ComparisonMatchExpression*>(filter)->getData();
+
+        if (MatchExpression::EQ == qt && MatchExpression::EQ == ft) {
+            return 0 == qv.woCompare(fv, false);
+        }
+
+        // Comparisons only match values of the rhs's canonical type, so beyond here both
+        // predicates must be over the same well ordered type.
+        if (!isOrderedValue(qv) || !isOrderedValue(fv)
+            || qv.canonicalType() != fv.canonicalType()) {
+            return false;
+        }
+
+        const int cmp = compareElementValues(qv, fv);
+
+        switch (ft) {
+        case MatchExpression::EQ:
+            // Only an equality pins the value down.
+            return false;
+        case MatchExpression::LT:
+            return (MatchExpression::EQ == qt && cmp < 0)
+                || (MatchExpression::LT == qt && cmp <= 0)
+                || (MatchExpression::LTE == qt && cmp < 0);
+        case MatchExpression::LTE:
+            return (MatchExpression::EQ == qt || MatchExpression::LT == qt
+                    || MatchExpression::LTE == qt) && cmp <= 0;
+        case MatchExpression::GT:
+            return (MatchExpression::EQ == qt && cmp > 0)
+                || (MatchExpression::GT == qt && cmp >= 0)
+                || (MatchExpression::GTE == qt && cmp > 0);
+        case MatchExpression::GTE:
+            return (MatchExpression::EQ == qt || MatchExpression::GT == qt
+                    || MatchExpression::GTE == qt) && cmp >= 0;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * Appends the leaves of the tree of ANDs rooted at 'node'.  Anything other than an AND is a
+     * leaf here.
+     */
+    static void flattenAnd(const MatchExpression* node, vector<const MatchExpression*>* out) {
+        if (MatchExpression::AND == node->matchType()) {
+            for (size_t i = 0; i < node->numChildren(); ++i) {
+                flattenAnd(node->getChild(i), out);
+            }
+        }
+        else {
+            out->push_back(node);
+        }
+    }
+
+    // static
+    bool QueryPlannerIXSelect::queryImpliesFilter(const MatchExpression* query,
+                                                  const MatchExpression* filter) {
+        vector<const MatchExpression*> queryLeaves;
+        flattenAnd(query, &queryLeaves);
+        vector<const MatchExpression*> filterLeaves;
+        flattenAnd(filter, &filterLeaves);
+
+        // Each conjunct of the filter must follow from some conjunct of the query.
+        for (size_t i = 0; i < filterLeaves.size(); ++i) {
+            bool implied = false;
+            for (size_t j = 0; j < queryLeaves.size() && !implied; ++j) {
+                implied = leafImplies(queryLeaves[j], filterLeaves[i]);
+            }
+            if (!implied) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // static
+    void QueryPlannerIXSelect::stripUnusablePartialIndices(const MatchExpression* query,
+                                                           vector<IndexEntry>* indices) {
+        for (size_t i = 0; i < indices->size(); /* advanced in loop */) {
+            const IndexEntry& index = (*indices)[i];
+            if (NULL != index.filterExpr && !queryImpliesFilter(query, index.filterExpr)) {
+                QLOG() << "partial index " << index.toString()
+                       << " is not usable, query does not imply its filter" << endl;
+                indices->erase(indices->begin() + i);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+
 }  // namespace mongo
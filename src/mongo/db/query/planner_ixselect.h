@@ -86,6 +86,21 @@ namespace mongo {
         static void rateIndices(MatchExpression* node,
                                 string prefix,
                                 const vector<IndexEntry>& indices);
+
+        /**
+         * Return true if every document matching 'query' is sure to match 'filter'.  Only
+         * top-level conjunctions of EQ, LT, LTE, GT, GTE, $exists and $type predicates are
+         * reasoned about, so false may just mean the implication couldn't be proven.
+         */
+        static bool queryImpliesFilter(const MatchExpression* query,
+                                       const MatchExpression* filter);
+
+        /**
+         * Remove the partial indices in 'indices' whose filter 'query' does not imply.  A partial
+         * index is missing the documents outside its filter so can't be used for such queries.
+         */
+        static void stripUnusablePartialIndices(const MatchExpression* query,
+                                                vector<IndexEntry>* indices);
     };
 
 }  // namespace mongo
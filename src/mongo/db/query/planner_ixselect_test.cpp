@@ -266,4 +266,55 @@ namespace {
         testRateIndicesTaggedNodePaths("{a: {$all: [{$elemMatch: {b: {$ne: 1}}}]}}", "", "");
     }
 
+    /**
+     * Checks QueryPlannerIXSelect::queryImpliesFilter() on a query and a partial index filter.
+     */
+    void testImplies(const char* query, const char* filter, bool expected) {
+        BSONObj queryObj = fromjson(query);
+        BSONObj filterObj = fromjson(filter);
+        auto_ptr<MatchExpression> queryExpr(parseMatchExpression(queryObj));
+        auto_ptr<MatchExpression> filterExpr(parseMatchExpression(filterObj));
+        if (expected != QueryPlannerIXSelect::queryImpliesFilter(queryExpr.get(),
+                                                                  filterExpr.get())) {
+            mongoutils::str::stream ss;
+            ss << "queryImpliesFilter(query=" << query << ", filter=" << filter
+               << ") should be " << (expected ? "true" : "false");
+            FAIL(ss);
+        }
+    }
+
+    TEST(QueryPlannerIXSelectTest, QueryImpliesFilterEquality) {
+        testImplies("{a: 1}", "{a: 1}", true);
+        testImplies("{a: 1.0}", "{a: 1}", true);
+        testImplies("{a: 1, b: 2}", "{a: 1}", true);
+        testImplies("{a: 2}", "{a: 1}", false);
+        testImplies("{b: 1}", "{a: 1}", false);
+        testImplies("{a: 1}", "{a: 1, b: 2}", false);
+        testImplies("{a: {$gt: 0, $lt: 2}}", "{a: 1}", false);
+        testImplies("{$or: [{a: 1}, {a: 1}]}", "{a: 1}", false);
+    }
+
+    TEST(QueryPlannerIXSelectTest, QueryImpliesFilterRanges) {
+        testImplies("{a: 5}", "{a: {$gt: 1}}", true);
+        testImplies("{a: 5}", "{a: {$lte: 5}}", true);
+        testImplies("{a: 5}", "{a: {$lt: 5}}", false);
+        testImplies("{a: {$gt: 5}}", "{a: {$gt: 5}}", true);
+        testImplies("{a: {$gte: 5}}", "{a: {$gt: 5}}", false);
+        testImplies("{a: {$gte: 6}}", "{a: {$gt: 5}}", true);
+        testImplies("{a: {$lt: 3}}", "{a: {$lte: 3}}", true);
+        testImplies("{a: {$lt: 3}}", "{a: {$gt: 0}}", false);
+        testImplies("{a: {$gt: 'x'}}", "{a: {$gt: 5}}", false);
+        testImplies("{a: null}", "{a: {$lte: null}}", false);
+    }
+
+    TEST(QueryPlannerIXSelectTest, QueryImpliesFilterExistsAndType) {
+        testImplies("{a: 1}", "{a: {$exists: true}}", true);
+        testImplies("{a: {$gt: 1}}", "{a: {$exists: true}}", true);
+        testImplies("{a: {$type: 2}}", "{a: {$exists: true}}", true);
+        testImplies("{a: null}", "{a: {$exists: true}}", false);
+        testImplies("{a: {$gt: {$minKey: 1}}}", "{a: {$exists: true}}", false);
+        testImplies("{a: {$type: 2}}", "{a: {$type: 2}}", true);
+        testImplies("{a: 1}", "{a: {$type: 16}}", false);
+    }
+
 }  // namespace
@@ -161,6 +161,25 @@ namespace mongo {
         return !sortIt.more();
     }
 
+    /**
+     * A partial index is missing every document outside its filter, so it may only be used by
+     * queries that imply the filter.  Returns 'params' if there are no partial indices to check,
+     * otherwise a copy in 'scratch' without the ones 'query' can't use.
+     */
+    static const QueryPlannerParams& paramsForQuery(const CanonicalQuery& query,
+                                                    const QueryPlannerParams& params,
+                                                    QueryPlannerParams* scratch) {
+        for (size_t i = 0; i < params.indices.size(); ++i) {
+            if (NULL != params.indices[i].filterExpr) {
+                *scratch = params;
+                QueryPlannerIXSelect::stripUnusablePartialIndices(query.root(),
+                                                                  &scratch->indices);
+                return *scratch;
+            }
+        }
+        return params;
+    }
+
     Status QueryPlanner::cacheDataFromTaggedTree(const MatchExpression* const taggedTree,
                                                  const vector<IndexEntry>& relevantIndices,
                                                  PlanCacheIndexTree** out) {
@@ -258,7 +277,7 @@ namespace mongo {
 
     // static
     Status QueryPlanner::planFromCache(const CanonicalQuery& query,
-                                       const QueryPlannerParams& params,
+                                       const QueryPlannerParams& allParams,
                                        SolutionCacheData* cacheData,
                                        QuerySolution** out) {
         if (NULL == cacheData) {
@@ -266,7 +285,22 @@ namespace mongo {
                           "planner data does not exist in the cached solution");
         }
 
+        // The cache is keyed on the shape of the query, so the plan may use a partial index
+        // whose filter these particular values don't imply.
+        QueryPlannerParams scratch;
+        const QueryPlannerParams& params = paramsForQuery(query, allParams, &scratch);
+
         if (SolutionCacheData::WHOLE_IXSCAN_SOLN == cacheData->solnType) {
+            bool indexUsable = false;
+            for (size_t i = 0; i < params.indices.size() && !indexUsable; ++i) {
+                const BSONObj& cachedKeyPattern = cacheData->tree->entry->keyPattern;
+                indexUsable = params.indices[i].keyPattern.equal(cachedKeyPattern);
+            }
+            if (!indexUsable) {
+                return Status(ErrorCodes::BadValue,
+                              "plan cache error: cached index can't be used for this query");
+            }
+
             // The solution can be constructed by a scan over the entire index.
             QuerySolution* soln = buildWholeIXSoln(*cacheData->tree->entry,
                 query, params, cacheData->wholeIXSolnDir);
@@ -379,9 +413,12 @@ namespace mongo {
 
     // static
     Status QueryPlanner::plan(const CanonicalQuery& query,
-                              const QueryPlannerParams& params,
+                              const QueryPlannerParams& allParams,
                               std::vector<QuerySolution*>* out) {
 
+        QueryPlannerParams scratch;
+        const QueryPlannerParams& params = paramsForQuery(query, allParams, &scratch);
+
         QLOG() << "=============================\n"
                << "Beginning planning, options = " << optionString(params.options) << endl
                << "Canonical query:\n" << query.toString() << endl
@@ -495,6 +532,11 @@ namespace mongo {
             }
 
             if (hintIndexNumber == numeric_limits<size_t>::max()) {
+                if (params.indices.size() != allParams.indices.size()) {
+                    return Status(ErrorCodes::BadValue,
+                                  "bad hint, or hinted a partial index whose filter the query "
+                                  "does not imply");
+                }
                 return Status(ErrorCodes::BadValue, "bad hint");
             }
         }
@@ -32,7 +32,9 @@
 
 #include "mongo/db/query/query_planner_test_lib.h"
 
+#include <list>
 #include <ostream>
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/json.h"
 #include "mongo/db/matcher/expression_parser.h"
@@ -80,6 +82,15 @@ namespace {
                                                 "note_to_self_dont_break_build"));
         }
 
+        void addPartialIndex(BSONObj keyPattern, const BSONObj& filter) {
+            filterObjs.push_back(filter.getOwned());
+            StatusWithMatchExpression parsed = MatchExpressionParser::parse(filterObjs.back());
+            ASSERT_OK(parsed.getStatus());
+            filterExprs.mutableVector().push_back(parsed.getValue());
+            params.indices.push_back(IndexEntry(keyPattern, false, false, "partial",
+                                                BSONObj(), parsed.getValue()));
+        }
+
         //
         // Execute planner.
         //
@@ -287,6 +298,10 @@ namespace {
         CanonicalQuery* cq;
         QueryPlannerParams params;
         vector<QuerySolution*> solns;
+
+        // Partial index filters, and the objects they point into.
+        std::list<BSONObj> filterObjs;
+        OwnedPointerVector<MatchExpression> filterExprs;
     };
 
     //
@@ -1480,6 +1495,59 @@ namespace {
                                 "{filter: null, pattern: {a: 1}}}}}");
     }
 
+    //
+    // Partial indices
+    //
+
+    TEST_F(QueryPlannerTest, PartialIndexUsedWhenQueryImpliesFilter) {
+        addPartialIndex(fromjson("{a: 1}"), fromjson("{status: 'pending'}"));
+        runQuery(fromjson("{a: {$gt: 5}, status: 'pending'}"));
+
+        assertNumSolutions(2U);
+        assertSolutionExists("{cscan: {dir: 1}}");
+        assertSolutionExists("{fetch: {filter: {status: 'pending'}, node: {ixscan: "
+                                "{pattern: {a: 1}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, PartialIndexIgnoredWhenQueryDoesNotImplyFilter) {
+        addPartialIndex(fromjson("{a: 1}"), fromjson("{status: 'pending'}"));
+        runQuery(fromjson("{a: {$gt: 5}, status: 'done'}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{cscan: {dir: 1}}");
+    }
+
+    TEST_F(QueryPlannerTest, PartialIndexRangeFilter) {
+        addPartialIndex(fromjson("{a: 1}"), fromjson("{b: {$gt: 10}}"));
+        runQuery(fromjson("{a: 1, b: {$gte: 20}}"));
+
+        assertNumSolutions(2U);
+        assertSolutionExists("{cscan: {dir: 1}}");
+        assertSolutionExists("{fetch: {filter: {b: {$gte: 20}}, node: {ixscan: "
+                                "{pattern: {a: 1}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, PartialIndexRangeFilterNotImplied) {
+        addPartialIndex(fromjson("{a: 1}"), fromjson("{b: {$gt: 10}}"));
+        runQuery(fromjson("{a: 1, b: {$gte: 10}}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{cscan: {dir: 1}}");
+    }
+
+    TEST_F(QueryPlannerTest, PartialIndexIgnoredForSort) {
+        addPartialIndex(fromjson("{a: 1}"), fromjson("{a: {$exists: true}}"));
+        runQuerySortProj(BSONObj(), fromjson("{a: 1}"), BSONObj());
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{sort: {pattern: {a: 1}, limit: 0, node: {cscan: {dir: 1}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, PartialIndexHintRejectedWhenQueryDoesNotImplyFilter) {
+        addPartialIndex(fromjson("{a: 1}"), fromjson("{b: 1}"));
+        runInvalidQueryHint(fromjson("{a: 1}"), fromjson("{a: 1}"));
+    }
+
     //
     // Regex
     //
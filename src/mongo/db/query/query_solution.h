@@ -155,7 +155,7 @@ namespace mongo {
      * of stages.
      */
     struct QuerySolution {
-        QuerySolution() : hasSortStage(false) { }
+        QuerySolution() : hasSortStage(false), hasAndHashStage(false) { }
 
         // Owned here.
         scoped_ptr<QuerySolutionNode> root;
@@ -169,6 +169,16 @@ namespace mongo {
         // so we use that index (if it exists) to provide a sort.
         bool hasSortStage;
 
+        // An AND_HASH buffers all but its last child before it returns anything, and fails if
+        // that outgrows its memory limit.
+        bool hasAndHashStage;
+
+        /**
+         * True if the plan may read a lot of data before its first result and can fail while
+         * doing so.  The runners keep a backup plan without blocking stages for these.
+         */
+        bool hasBlockingStage() const { return hasSortStage || hasAndHashStage; }
+
         // Owned here. Used by the plan cache.
         boost::scoped_ptr<SolutionCacheData> cacheData;
 
@@ -76,6 +76,19 @@ namespace replset {
     static int bufferMaxSizeGauge = 256*1024*1024;
     static ServerStatusMetricField<int> displayBufferMaxSize( "repl.buffer.maxSizeBytes",
                                                                 &bufferMaxSizeGauge );
+    //The getmores sent before the previous batch had been queued
+    static Counter64 pipelinedGetmoreStats;
+    static ServerStatusMetricField<Counter64> displayPipelinedGetmores(
+                                                    "repl.network.pipelinedGetmores",
+                                                    &pipelinedGetmoreStats );
+    //The number and time of waits by the fetcher for room in a full buffer
+    static TimerStats bufferFullStats;
+    static ServerStatusMetricField<TimerStats> displayBufferFull( "repl.buffer.fetcherWaits",
+                                                                  &bufferFullStats );
+    //The number and time of waits by the applier for ops to arrive in an empty buffer
+    static TimerStats bufferEmptyStats;
+    static ServerStatusMetricField<TimerStats> displayBufferEmpty( "repl.buffer.applierWaits",
+                                                                   &bufferEmptyStats );
 
 
     BackgroundSyncInterface::~BackgroundSyncInterface() {}
@@ -361,6 +374,10 @@ namespace replset {
             return;
         }
 
+        // True when the getMore for the next batch has already been sent.  If we return with
+        // one outstanding, the reply is discarded along with the connection.
+        bool moreRequested = false;
+
         while (!inShutdown()) {
             if (!r.moreInCurrentBatch()) {
                 // Check some things periodically
@@ -368,7 +385,7 @@ namespace replset {
                 // current cursor batch)
 
                 int bs = r.currentBatchMessageSize();
-                if( bs > 0 && bs < BatchIsSmallish ) {
+                if( !moreRequested && bs > 0 && bs < BatchIsSmallish ) {
                     // on a very low latency network, if we don't wait a little, we'll be 
                     // getting ops to write almost one at a time.  this will both be expensive
                     // for the upstream server as well as potentially defeating our parallel 
@@ -399,10 +416,16 @@ namespace replset {
                 {
                     //record time for each getmore
                     TimerHolder batchTimer(&getmoreReplStats);
-                    
-                    // This calls receiveMore() on the oplogreader cursor.
-                    // It can wait up to five seconds for more data.
-                    r.more();
+
+                    // Either of these can wait up to five seconds for more data.
+                    if (moreRequested) {
+                        moreRequested = false;
+                        r.receiveMore();
+                    }
+                    else {
+                        // This calls receiveMore() on the oplogreader cursor.
+                        r.more();
+                    }
                 }
                 networkByteStats.increment(r.currentBatchMessageSize());
 
@@ -429,9 +452,23 @@ namespace replset {
             }
 
             // At this point, we are guaranteed to have at least one thing to read out
-            // of the oplogreader cursor.
-            BSONObj o = r.nextSafe().getOwned();
-            opsReadStats.increment();
+            // of the oplogreader cursor.  Take the whole batch.
+            std::vector<BSONObj> ops;
+            size_t batchBytes = 0;
+            while (r.moreInCurrentBatch()) {
+                BSONObj o = r.nextSafe().getOwned();
+                batchBytes += getSize(o);
+                ops.push_back(o);
+            }
+            opsReadStats.increment(ops.size());
+
+            // A big batch means the sync source probably has more ready.  Ask for it now, so
+            // the round trip overlaps with waiting for room in the buffer.  Small batches
+            // mean we're caught up, and are handled by the sleep above instead.
+            if (r.currentBatchMessageSize() >= BatchIsSmallish && r.sendMore()) {
+                moreRequested = true;
+                pipelinedGetmoreStats.increment();
+            }
 
             {
                 boost::unique_lock<boost::mutex> lock(_mutex);
@@ -441,15 +478,19 @@ namespace replset {
             OCCASIONALLY {
                 LOG(2) << "bgsync buffer has " << _buffer.size() << " bytes" << rsLog;
             }
-            // the blocking queue will wait (forever) until there's room for us to push
-            _buffer.push(o);
-            bufferCountGauge.increment();
-            bufferSizeGauge.increment(getSize(o));
+            // the blocking queue will wait (forever) until there's room for the whole batch.
+            // whether it had to is only known under the queue's lock, so ask it afterwards.
+            Timer fullTimer;
+            if (_buffer.pushAll(ops)) {
+                bufferFullStats.record(fullTimer);
+            }
+            bufferCountGauge.increment(ops.size());
+            bufferSizeGauge.increment(batchBytes);
 
             {
                 boost::unique_lock<boost::mutex> lock(_mutex);
-                _lastH = o["h"].numberLong();
-                _lastOpTimeFetched = o["ts"]._opTime();
+                _lastH = ops.back()["h"].numberLong();
+                _lastOpTimeFetched = ops.back()["ts"]._opTime();
             }
         }
     }
@@ -481,6 +522,7 @@ namespace replset {
     }
 
     void BackgroundSync::waitForMore() {
+        TimerHolder emptyTimer(&bufferEmptyStats);
         BSONObj op;
         // Block for one second before timing out.
         // Ignore the value of the op we peeked at.
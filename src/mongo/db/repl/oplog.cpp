@@ -653,6 +653,7 @@ namespace mongo {
                 o,
                 fieldO2.isABSONObj() ? &o2 : NULL,
                 !fieldB.eoo() ? &valueB : NULL );
+        logOpForDbHash(opType, ns, o, fieldO2.isABSONObj() ? &o2 : NULL, NULL, false);
         return failedUpdate;
     }
 }
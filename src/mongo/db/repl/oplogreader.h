@@ -130,6 +130,24 @@ namespace mongo {
             return cursor->more();
         }
 
+        /**
+         * Sends the getMore for the next batch without waiting for the reply, so it travels
+         * while the current batch is handled.  Returns false, sending nothing, if the cursor is
+         * dead.  When true, receiveMore() must be called once the current batch is consumed.
+         */
+        bool sendMore() {
+            uassert( 17392, "Doesn't have cursor for reading oplog", cursor.get() );
+            if ( cursor->isDead() )
+                return false;
+            cursor->sendMore();
+            return true;
+        }
+
+        void receiveMore() {
+            uassert( 17393, "Doesn't have cursor for reading oplog", cursor.get() );
+            cursor->receiveMore();
+        }
+
         bool moreInCurrentBatch() {
             uassert( 15911, "Doesn't have cursor for reading oplog", cursor.get() );
             return cursor->moreInCurrentBatch();
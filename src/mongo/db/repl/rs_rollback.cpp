@@ -33,6 +33,7 @@
 #include "mongo/db/auth/authorization_manager_global.h"
 #include "mongo/db/client.h"
 #include "mongo/db/cloner.h"
+#include "mongo/db/commands/dbhash.h"
 #include "mongo/db/dbhelpers.h"
 #include "mongo/db/ops/update.h"
 #include "mongo/db/ops/update_request.h"
@@ -200,6 +201,11 @@ namespace mongo {
                          o["usePowerOf2Sizes"].type() == Bool ) {
                         log() << "replSet not rolling back change of usePowerOf2Sizes: " << o;
                     }
+                    else if ( o.nFields() == 2 &&
+                              o["compressRecords"].type() == Bool ) {
+                        // either kind of record can be read whatever the flag says
+                        log() << "replSet not rolling back change of compressRecords: " << o;
+                    }
                     else {
                         log() << "replSet error cannot rollback a collMod command: " << o;
                         throw rsfatal();
@@ -613,6 +619,9 @@ namespace mongo {
             warn = true;
         }
 
+        // none of the fixups above went through logOp
+        wipeDbHashCache("");
+
         /* reset cached lastoptimewritten and h value */
         loadLastOpTimeWritten();
 
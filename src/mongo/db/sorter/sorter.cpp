@@ -405,7 +405,7 @@ namespace mongo {
                 _memUsed += key.memUsageForSorter();
                 _memUsed += val.memUsageForSorter();
 
-                if (_memUsed > _opts.maxMemoryUsageBytes)
+                if (_opts.memoryLimitExceeded(_memUsed))
                     spill();
             }
 
@@ -567,7 +567,7 @@ namespace mongo {
                     if (_data.size() == _opts.limit)
                         std::make_heap(_data.begin(), _data.end(), less);
 
-                    if (_memUsed > _opts.maxMemoryUsageBytes)
+                    if (_opts.memoryLimitExceeded(_memUsed))
                         spill();
 
                     return;
@@ -590,7 +590,7 @@ namespace mongo {
                 _data.back() = contender;
                 std::push_heap(_data.begin(), _data.end(), less);
 
-                if (_memUsed > _opts.maxMemoryUsageBytes)
+                if (_opts.memoryLimitExceeded(_memUsed))
                     spill();
             }
 
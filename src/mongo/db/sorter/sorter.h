@@ -98,11 +98,15 @@ namespace mongo {
         bool extSortAllowed; /// If false, uassert if more mem needed than allowed.
         std::string tempDir; /// Directory to directly place files in.
                              /// Must be explicitly set if extSortAllowed is true.
+        size_t (*extraMemoryUsage)(); /// Memory held for the sorted data that memUsageForSorter()
+                                      /// doesn't see, counted against maxMemoryUsageBytes.
+                                      /// Optional.
 
         SortOptions()
             : limit(0)
             , maxMemoryUsageBytes(64*1024*1024)
             , extSortAllowed(false)
+            , extraMemoryUsage(NULL)
         {}
 
         /// Fluent API to support expressions like SortOptions().Limit(1000).ExtSortAllowed(true)
@@ -126,6 +130,17 @@ namespace mongo {
             tempDir = newTempDir;
             return *this;
         }
+
+        SortOptions& ExtraMemoryUsage(size_t (*newExtraMemoryUsage)()) {
+            extraMemoryUsage = newExtraMemoryUsage;
+            return *this;
+        }
+
+        bool memoryLimitExceeded(size_t memUsed) const {
+            if (extraMemoryUsage)
+                memUsed += extraMemoryUsage();
+            return memUsed > maxMemoryUsageBytes;
+        }
     };
 
     /// This is the output from the sorting framework
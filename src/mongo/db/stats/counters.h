@@ -30,54 +30,68 @@
 #pragma once
 
 #include "mongo/pch.h"
+#include "mongo/base/counter.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/util/net/message.h"
 #include "mongo/util/processinfo.h"
-#include "mongo/util/concurrency/spin_lock.h"
 #include "mongo/db/pdfile.h"
 
 namespace mongo {
 
     /**
      * for storing operation counters
-     * note: not thread safe.  ok with that for speed
+     * counters are striped per thread, so incrementing them doesn't contend across cores;
+     * reading sums the stripes
      */
     class OpCounters {
     public:
 
         OpCounters();
-        void incInsertInWriteLock(int n) { _insert.x += n; }
-        void gotInsert() { _insert++; }
-        void gotQuery() { _query++; }
-        void gotUpdate() { _update++; }
-        void gotDelete() { _delete++; }
-        void gotGetMore() { _getmore++; }
-        void gotCommand() { _command++; }
+        void incInsertInWriteLock(int n) { _insert.increment(n); }
+        void gotInsert() { _insert.increment(); }
+        void gotQuery() { _query.increment(); }
+        void gotUpdate() { _update.increment(); }
+        void gotDelete() { _delete.increment(); }
+        void gotGetMore() { _getmore.increment(); }
+        void gotCommand() { _command.increment(); }
 
         void gotOp( int op , bool isCommand );
 
         BSONObj getObj() const;
         
         // thse are used by snmp, and other things, do not remove
-        const AtomicUInt * getInsert() const { return &_insert; }
-        const AtomicUInt * getQuery() const { return &_query; }
-        const AtomicUInt * getUpdate() const { return &_update; }
-        const AtomicUInt * getDelete() const { return &_delete; }
-        const AtomicUInt * getGetMore() const { return &_getmore; }
-        const AtomicUInt * getCommand() const { return &_command; }
+        // each call sums the stripes into the AtomicUInt returned, which stays valid as long as
+        // the OpCounters does
+        const AtomicUInt * getInsert() const { return _view( _insert, &_insertView ); }
+        const AtomicUInt * getQuery() const { return _view( _query, &_queryView ); }
+        const AtomicUInt * getUpdate() const { return _view( _update, &_updateView ); }
+        const AtomicUInt * getDelete() const { return _view( _delete, &_deleteView ); }
+        const AtomicUInt * getGetMore() const { return _view( _getmore, &_getmoreView ); }
+        const AtomicUInt * getCommand() const { return _view( _command, &_commandView ); }
 
 
     private:
         void _checkWrap();
+
+        static const AtomicUInt * _view( const StripedCounter64& counter, AtomicUInt* view ) {
+            view->set( static_cast<unsigned>( counter.get() ) );
+            return view;
+        }
         
-        // todo: there will be a lot of cache line contention on these.  need to do something 
-        //       else eventually.
-        AtomicUInt _insert;
-        AtomicUInt _query;
-        AtomicUInt _update;
-        AtomicUInt _delete;
-        AtomicUInt _getmore;
-        AtomicUInt _command;
+        StripedCounter64 _insert;
+        StripedCounter64 _query;
+        StripedCounter64 _update;
+        StripedCounter64 _delete;
+        StripedCounter64 _getmore;
+        StripedCounter64 _command;
+
+        // what the get*() accessors above point to
+        mutable AtomicUInt _insertView;
+        mutable AtomicUInt _queryView;
+        mutable AtomicUInt _updateView;
+        mutable AtomicUInt _deleteView;
+        mutable AtomicUInt _getmoreView;
+        mutable AtomicUInt _commandView;
     };
 
     extern OpCounters globalOpCounters;
@@ -85,17 +99,12 @@ namespace mongo {
 
     class NetworkCounter {
     public:
-        NetworkCounter() : _bytesIn(0), _bytesOut(0), _requests(0), _overflows(0) {}
         void hit( long long bytesIn , long long bytesOut );
         void append( BSONObjBuilder& b );
     private:
-        long long _bytesIn;
-        long long _bytesOut;
-        long long _requests;
-
-        long long _overflows;
-
-        SpinLock _lock;
+        StripedCounter64 _bytesIn;
+        StripedCounter64 _bytesOut;
+        StripedCounter64 _requests;
     };
 
     extern NetworkCounter networkCounter;
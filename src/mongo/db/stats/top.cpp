@@ -60,21 +60,34 @@ namespace mongo {
 
     }
 
+    void Top::CollectionData::add( const CollectionData& other ) {
+        total.add( other.total );
+        readLock.add( other.readLock );
+        writeLock.add( other.writeLock );
+        queries.add( other.queries );
+        getmore.add( other.getmore );
+        insert.add( other.insert );
+        update.add( other.update );
+        remove.add( other.remove );
+        commands.add( other.commands );
+    }
+
     void Top::record( const StringData& ns , int op , int lockType , long long micros , bool command ) {
         if ( ns[0] == '?' )
             return;
 
         //cout << "record: " << ns << "\t" << op << "\t" << command << endl;
-        SimpleMutex::scoped_lock lk(_lock);
+        Shard& shard = _myShard();
+        SimpleMutex::scoped_lock lk(shard.lock);
 
-        if ( ( command || op == dbQuery ) && ns == _lastDropped ) {
-            _lastDropped = "";
+        if ( ( command || op == dbQuery ) && ns == shard.lastDropped ) {
+            shard.lastDropped = "";
             return;
         }
 
-        CollectionData& coll = _usage[ns];
+        CollectionData& coll = shard.usage[ns];
         _record( coll , op , lockType , micros , command );
-        _record( _global , op , lockType , micros , command );
+        _record( shard.global , op , lockType , micros , command );
     }
 
     void Top::_record( CollectionData& c , int op , int lockType , long long micros , bool command ) {
@@ -120,19 +133,41 @@ namespace mongo {
     }
 
     void Top::collectionDropped( const StringData& ns ) {
-        SimpleMutex::scoped_lock lk(_lock);
-        _usage.erase(ns);
-        _lastDropped = ns.toString();
+        Shard& mine = _myShard();
+        for ( size_t i = 0; i < kShards; i++ ) {
+            Shard& shard = _shards[i];
+            SimpleMutex::scoped_lock lk(shard.lock);
+            shard.usage.erase(ns);
+            if ( &shard == &mine )
+                shard.lastDropped = ns.toString();
+        }
     }
 
     void Top::cloneMap(Top::UsageMap& out) const {
-        SimpleMutex::scoped_lock lk(_lock);
-        out = _usage;
+        out = UsageMap();
+        for ( size_t i = 0; i < kShards; i++ ) {
+            const Shard& shard = _shards[i];
+            SimpleMutex::scoped_lock lk(shard.lock);
+            for ( UsageMap::const_iterator it = shard.usage.begin(); it != shard.usage.end(); ++it ) {
+                out[it->first].add( it->second );
+            }
+        }
+    }
+
+    Top::CollectionData Top::getGlobalData() const {
+        CollectionData total;
+        for ( size_t i = 0; i < kShards; i++ ) {
+            const Shard& shard = _shards[i];
+            SimpleMutex::scoped_lock lk(shard.lock);
+            total.add( shard.global );
+        }
+        return total;
     }
 
     void Top::append( BSONObjBuilder& b ) {
-        SimpleMutex::scoped_lock lk( _lock );
-        _appendToUsageMap( b , _usage );
+        UsageMap merged;
+        cloneMap( merged );
+        _appendToUsageMap( b , merged );
     }
 
     void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const {
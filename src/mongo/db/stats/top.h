@@ -19,6 +19,7 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include "mongo/base/counter.h"
 #include "mongo/util/concurrency/mutex.h"
 #include "mongo/util/string_map.h"
 
@@ -30,7 +31,7 @@ namespace mongo {
     class Top {
 
     public:
-        Top() : _lock("Top") { }
+        Top() { }
 
         struct UsageData {
             UsageData() : time(0) , count(0) {}
@@ -42,6 +43,11 @@ namespace mongo {
                 count++;
                 time += micros;
             }
+
+            void add( const UsageData& other ) {
+                count += other.count;
+                time += other.time;
+            }
         };
 
         struct CollectionData {
@@ -62,6 +68,8 @@ namespace mongo {
             UsageData update;
             UsageData remove;
             UsageData commands;
+
+            void add( const CollectionData& other );
         };
 
         typedef StringMap<CollectionData> UsageMap;
@@ -70,7 +78,7 @@ namespace mongo {
         void record( const StringData& ns , int op , int lockType , long long micros , bool command );
         void append( BSONObjBuilder& b );
         void cloneMap(UsageMap& out) const;
-        CollectionData getGlobalData() const { return _global; }
+        CollectionData getGlobalData() const;
         void collectionDropped( const StringData& ns );
 
     public: // static stuff
@@ -81,10 +89,24 @@ namespace mongo {
         void _appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ) const;
         void _record( CollectionData& c , int op , int lockType , long long micros , bool command );
 
-        mutable SimpleMutex _lock;
-        CollectionData _global;
-        UsageMap _usage;
-        string _lastDropped;
+        /**
+         * record() runs at the end of every operation, so rather than one mutex and map the
+         * usage data is split into shards picked by the recording thread.  Readers merge them.
+         * A collection's data can be spread over every shard.
+         */
+        struct Shard {
+            Shard() : lock("Top") { }
+            mutable SimpleMutex lock;
+            CollectionData global;
+            UsageMap usage;
+            string lastDropped; // only the dropping thread's shard remembers it
+        };
+
+        static const size_t kShards = 16;
+
+        Shard& _myShard() { return _shards[StripedCounter64::threadStripe() % kShards]; }
+
+        Shard _shards[kShards];
     };
 
 } // namespace mongo
@@ -37,6 +37,7 @@
 #include "mongo/db/d_concurrency.h"
 #include "mongo/db/dur.h"
 #include "mongo/db/lockstate.h"
+#include "mongo/db/storage/ephemeral_storage.h"
 #include "mongo/util/file_allocator.h"
 
 namespace mongo {
@@ -116,6 +117,11 @@ namespace mongo {
         return Status::OK();
     }
 
+    DataFile::~DataFile() {
+        if ( _ephemeralLength )
+            EphemeralStorage::release( _mb );
+    }
+
     void DataFile::open( const char *filename, int minSize, bool preallocateOnly ) {
         long size = defaultSize( filename );
         while ( size < minSize ) {
@@ -151,7 +157,24 @@ namespace mongo {
         header()->init(fileNo, size, filename);
     }
 
+    void DataFile::openEphemeral( int minSize ) {
+        verify( _mb == 0 );
+
+        // sized as with smallfiles, so maxEphemeralStorageMB isn't spent on empty space
+        int size = ( 16 * 1024 * 1024 ) << std::min( fileNo, 4 );
+        while ( size < minSize && size <= maxSize() / 2 )
+            size *= 2;
+        if ( size < minSize )
+            size = maxSize();
+
+        _mb = EphemeralStorage::allocate( size );
+        _ephemeralLength = size;
+        header()->init(fileNo, size, "");
+    }
+
     void DataFile::flush( bool sync ) {
+        if ( _ephemeralLength )
+            return;
         mmf.flush( sync );
     }
 
@@ -195,7 +218,8 @@ namespace mongo {
                 }
             }
 
-            getDur().createdFile(filename, filelength);
+            if ( !EphemeralStorage::contains( this ) )
+                getDur().createdFile(filename, filelength);
             verify( HeaderSize == 8192 );
             DataFileHeader *h = getDur().writing(this);
             h->fileLength = filelength;
@@ -86,7 +86,8 @@ namespace mongo {
         friend class BasicCursor;
         friend class ExtentManager;
     public:
-        DataFile(int fn) : _mb(0), fileNo(fn) { }
+        DataFile(int fn) : _mb(0), _ephemeralLength(0), fileNo(fn) { }
+        ~DataFile();
 
         /** @return true if found and opened. if uninitialized (prealloc only) does not open. */
         Status openExisting( const char *filename );
@@ -94,11 +95,16 @@ namespace mongo {
         /** creates if DNE */
         void open(const char *filename, int requestedDataSize = 0, bool preallocateOnly = false);
 
+        /** like open(), but in memory from EphemeralStorage instead of a file */
+        void openEphemeral( int requestedDataSize );
+
         DiskLoc allocExtentArea( int size );
 
         DataFileHeader *getHeader() { return header(); }
         HANDLE getFd() { return mmf.getFd(); }
-        unsigned long long length() const { return mmf.length(); }
+        unsigned long long length() const {
+            return _ephemeralLength ? _ephemeralLength : mmf.length();
+        }
 
         /* return max size an extent may be */
         static int maxSize();
@@ -118,6 +124,7 @@ namespace mongo {
 
         DurableMappedFile mmf;
         void *_mb; // the memory mapped view
+        unsigned long long _ephemeralLength; // nonzero if _mb is from EphemeralStorage
         int fileNo;
     };
 
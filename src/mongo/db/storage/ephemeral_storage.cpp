@@ -0,0 +1,187 @@
+// ephemeral_storage.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/storage/ephemeral_storage.h"
+
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#include "mongo/db/server_parameters.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(ephemeralDatabases, std::vector<std::string>,
+                                          std::vector<std::string>());
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(maxEphemeralStorageMB, int, 1024);
+
+    namespace {
+
+        // There are few regions, one per data file or .ns file of an ephemeral database, so
+        // contains() simply looks at them all.  It does so without a lock, as it is called for
+        // every write intent: writers bump regionsVersion to an odd number while they change
+        // the table and back to even when done, and a reader that sees it change tries again.
+        const unsigned kMaxRegions = 4096;
+
+        struct Region {
+            AtomicUInt64 begin; // 0 if the slot is free
+            AtomicUInt64 end;
+        };
+
+        SimpleMutex regionsMutex( "ephemeralRegions" );
+        Region regions[kMaxRegions];
+        AtomicUInt32 regionSlots;       // slots ever used, free ones among them
+        AtomicUInt32 regionsVersion;
+        size_t regionBytes = 0;         // guarded by regionsMutex
+
+        // lets contains() skip the scan on servers without ephemeral databases
+        AtomicUInt32 numRegions;
+
+        unsigned long long address( const void* p ) {
+            return reinterpret_cast<uintptr_t>( p );
+        }
+
+        /** Finds a free slot, or the slot holding 'begin'.  Caller holds regionsMutex. */
+        Region* findSlot( unsigned long long begin ) {
+            for ( unsigned i = 0; i < regionSlots.load(); i++ ) {
+                if ( regions[i].begin.load() == begin )
+                    return &regions[i];
+            }
+            if ( begin == 0 && regionSlots.load() < kMaxRegions )
+                return &regions[regionSlots.fetchAndAdd( 1 )];
+            return NULL;
+        }
+
+    }
+
+    bool EphemeralStorage::isEphemeralDatabase( const StringData& dbname ) {
+        if ( dbname == "local" || dbname == "admin" || dbname == "config" )
+            return false;
+        for ( size_t i = 0; i < ephemeralDatabases.size(); i++ ) {
+            if ( dbname == ephemeralDatabases[i] )
+                return true;
+        }
+        return false;
+    }
+
+    void* EphemeralStorage::allocate( size_t len ) {
+        SimpleMutex::scoped_lock lk( regionsMutex );
+
+        const size_t limit = static_cast<size_t>( maxEphemeralStorageMB ) * 1024 * 1024;
+        uassert( 17398,
+                 mongoutils::str::stream() << "ephemeral storage full, maxEphemeralStorageMB is "
+                                           << maxEphemeralStorageMB,
+                 regionBytes + len <= limit );
+
+        Region* slot = findSlot( 0 );
+        uassert( 17411, "too many ephemeral storage regions", slot );
+
+#if defined(_WIN32)
+        void* p = VirtualAlloc( 0, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+        uassert( 17410, "can't allocate ephemeral storage", p != 0 );
+#else
+        void* p = mmap( 0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE,
+                        -1, 0 );
+        uassert( 17399, "can't allocate ephemeral storage", p != MAP_FAILED );
+#endif
+
+        regionsVersion.fetchAndAdd( 1 );
+        slot->end.store( address( p ) + len );
+        slot->begin.store( address( p ) );
+        regionsVersion.fetchAndAdd( 1 );
+
+        regionBytes += len;
+        numRegions.addAndFetch( 1 );
+        return p;
+    }
+
+    void EphemeralStorage::release( void* p ) {
+        SimpleMutex::scoped_lock lk( regionsMutex );
+
+        Region* slot = findSlot( address( p ) );
+        verify( slot );
+        const size_t len = slot->end.load() - slot->begin.load();
+
+        regionsVersion.fetchAndAdd( 1 );
+        slot->begin.store( 0 );
+        slot->end.store( 0 );
+        regionsVersion.fetchAndAdd( 1 );
+
+#if defined(_WIN32)
+        VirtualFree( p, 0, MEM_RELEASE );
+#else
+        munmap( p, len );
+#endif
+
+        regionBytes -= len;
+        numRegions.subtractAndFetch( 1 );
+    }
+
+    bool EphemeralStorage::contains( const void* p ) {
+        if ( numRegions.load() == 0 )
+            return false;
+
+        const unsigned long long c = address( p );
+        while ( true ) {
+            const unsigned version = regionsVersion.load();
+            if ( version & 1 )
+                continue; // a writer is part way through
+
+            bool found = false;
+            const unsigned slots = regionSlots.load();
+            for ( unsigned i = 0; i < slots && !found; i++ ) {
+                const unsigned long long begin = regions[i].begin.load();
+                found = begin != 0 && c >= begin && c < regions[i].end.load();
+            }
+
+            if ( regionsVersion.load() == version )
+                return found;
+        }
+    }
+
+    bool EphemeralStorage::enabled() {
+        return !ephemeralDatabases.empty();
+    }
+
+    size_t EphemeralStorage::bytesInUse() {
+        SimpleMutex::scoped_lock lk( regionsMutex );
+        return regionBytes;
+    }
+
+}
@@ -0,0 +1,75 @@
+// ephemeral_storage.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include "mongo/base/string_data.h"
+
+namespace mongo {
+
+    /**
+     * Anonymous memory standing in for the data files and .ns file of ephemeral databases,
+     * those named in the ephemeralDatabases server parameter.  Nothing in it is preallocated,
+     * journaled, flushed or written to disk, and an ephemeral database is empty again once it
+     * is closed or the server restarts.
+     *
+     * All ephemeral memory together is capped by maxEphemeralStorageMB.  Growing past that
+     * fails the write as a full disk would; capped collections are the way to have old
+     * documents evicted instead.
+     */
+    class EphemeralStorage {
+    public:
+        /** local, admin and config are never ephemeral */
+        static bool isEphemeralDatabase( const StringData& dbname );
+
+        /**
+         * @return 'len' bytes of zeroed memory, committed as it is first touched.
+         * uasserts if that would go over maxEphemeralStorageMB.
+         */
+        static void* allocate( size_t len );
+
+        /** @param p from allocate() */
+        static void release( void* p );
+
+        /**
+         * @return true if 'p' points into memory from allocate(), which needs no write
+         * intents.  Takes no lock, and is cheap while there are no ephemeral databases.
+         */
+        static bool contains( const void* p );
+
+        /** @return true if any database is configured to be ephemeral */
+        static bool enabled();
+
+        static size_t bytesInUse();
+    };
+
+}
@@ -40,6 +40,7 @@
 #include "mongo/db/storage/extent_manager.h"
 
 #include "mongo/db/pdfile.h"
+#include "mongo/db/storage/ephemeral_storage.h"
 
 namespace mongo {
 
@@ -50,7 +51,8 @@ namespace mongo {
         : _dbname( dbname.toString() ),
           _path( path.toString() ),
           _freeListDetails( freeListDetails ),
-          _directoryPerDB( directoryPerDB ) {
+          _directoryPerDB( directoryPerDB ),
+          _ephemeral( EphemeralStorage::isEphemeralDatabase( dbname ) ) {
     }
 
     ExtentManager::~ExtentManager() {
@@ -78,6 +80,11 @@ namespace mongo {
     Status ExtentManager::init() {
         verify( _files.size() == 0 );
 
+        if ( _ephemeral ) {
+            // nothing survives a close
+            return Status::OK();
+        }
+
         for ( int n = 0; n < DiskLoc::MaxFiles; n++ ) {
             boost::filesystem::path fullName = fileName( n );
             if ( !boost::filesystem::exists( fullName ) )
@@ -128,6 +135,9 @@ namespace mongo {
                 log() << "getFile(): n=" << n << endl;
             }
         }
+        if ( preallocateOnly && _ephemeral )
+            return 0;
+
         DataFile* p = 0;
         if ( !preallocateOnly ) {
             while ( n >= (int) _files.size() ) {
@@ -153,7 +163,10 @@ namespace mongo {
             if ( sizeNeeded + DataFileHeader::HeaderSize > minSize )
                 minSize = sizeNeeded + DataFileHeader::HeaderSize;
             try {
-                p->open( fullNameString.c_str(), minSize, preallocateOnly );
+                if ( _ephemeral )
+                    p->openEphemeral( minSize );
+                else
+                    p->open( fullNameString.c_str(), minSize, preallocateOnly );
             }
             catch ( AssertionException& ) {
                 delete p;
@@ -183,6 +196,11 @@ namespace mongo {
 
     long long ExtentManager::fileSize() const {
         long long size=0;
+        if ( _ephemeral ) {
+            for ( size_t n = 0; n < _files.size(); n++ )
+                size += _files[n]->length();
+            return size;
+        }
         for ( int n = 0; boost::filesystem::exists( fileName(n) ); n++)
             size += boost::filesystem::file_size( fileName(n) );
         return size;
@@ -126,6 +126,9 @@ namespace mongo {
 
         void printFreeList() const;
 
+        /** the files are in memory only, see EphemeralStorage */
+        bool isEphemeral() const { return _ephemeral; }
+
         bool hasFreeList() const { return _freeListDetails != NULL; }
 
         /**
@@ -185,6 +188,7 @@ namespace mongo {
         std::string _path; // i.e. "/data/db"
         NamespaceDetails* _freeListDetails;
         bool _directoryPerDB;
+        bool _ephemeral;
 
         // must be in the dbLock when touching this (and write locked when writing to of course)
         // however during Database object construction we aren't, which is ok as it isn't yet visible
@@ -40,6 +40,7 @@
 #include "mongo/db/pdfile.h"
 #include "mongo/platform/bits.h"
 #include "mongo/platform/unordered_set.h"
+#include "mongo/util/compress.h"
 #include "mongo/util/net/listen.h"
 #include "mongo/util/processinfo.h"
 #include "mongo/util/stack_introspect.h"
@@ -543,6 +544,25 @@ namespace mongo {
         return BSONObj::make(rec()->accessed());
     }
 
+    BSONObj Record::uncompressedObj() const {
+        const CompressedHeader* h = compressedHeader();
+        const char* compressed = reinterpret_cast<const char*>( h + 1 );
+
+        size_t length;
+        massert( 17394, "compressed record is corrupt",
+                 uncompressedLength( compressed, h->compressedSize, &length ) &&
+                 length == static_cast<size_t>( h->uncompressedSize ) );
+
+        BSONObj::Holder* holder =
+            static_cast<BSONObj::Holder*>( malloc( sizeof(unsigned) + length ) );
+        if ( !rawUncompress( compressed, h->compressedSize, holder->data ) ) {
+            free( holder );
+            msgasserted( 17395, "compressed record is corrupt" );
+        }
+        holder->zero();
+        return BSONObj( holder );
+    }
+
     void Record::_accessing() const {
         if ( likelyInPhysicalMemory() )
             return;
@@ -88,6 +88,42 @@ namespace mongo {
         };
         NP* np() { return (NP*) &_nextOfs; }
 
+        // ---------------------
+        // compression
+        // ---------------------
+
+        /**
+         * The data of a record in a collection with Flag_CompressRecords may be a snappy
+         * compressed document behind this header instead of the document itself.  BSONObj::make
+         * reads either kind.
+         */
+        struct CompressedHeader {
+            int marker;             // CompressedMarker, which no BSON object size can be
+            int compressedSize;     // bytes of snappy data after the header
+            int uncompressedSize;   // objsize() of the document
+
+            int storedSize() const { return sizeof(CompressedHeader) + compressedSize; }
+        };
+        enum { CompressedMarker = -0x5a5a0001 };
+
+        bool isCompressed() const {
+            return *reinterpret_cast<const int*>( data() ) == CompressedMarker;
+        }
+
+        const CompressedHeader* compressedHeader() const {
+            return reinterpret_cast<const CompressedHeader*>( data() );
+        }
+
+        /** @return how much smaller the data is than the document it holds, 0 if uncompressed */
+        int compressionSavings() const {
+            if ( !isCompressed() )
+                return 0;
+            return compressedHeader()->uncompressedSize - compressedHeader()->storedSize();
+        }
+
+        /** @return the document in this compressed record, uncompressed into a buffer it owns */
+        BSONObj uncompressedObj() const;
+
         // ---------------------
         // memory cache
         // ---------------------
@@ -53,6 +53,7 @@ namespace mongo {
 
     BOOST_STATIC_ASSERT( Record::HeaderSize == 16 );
     BOOST_STATIC_ASSERT( Record::HeaderSize + BtreeData_V1::BucketSize == 8192 );
+    BOOST_STATIC_ASSERT( Record::HeaderSize + BtreeData_V2::BucketSize == 8192 );
 
     NOINLINE_DECL void checkFailed(unsigned line) {
         static time_t last;
@@ -314,6 +315,173 @@ namespace mongo {
         return ofs;
     }
 
+    /* prefix compression: the generic versions are for buckets storing whole keys, V2
+       stores them without the prefix they share.  See BtreeData_V2. */
+
+    template< class V >
+    int BucketBasics<V>::_prefixBytes() const {
+        return 0;
+    }
+
+    template<>
+    int BucketBasics<V2>::_prefixBytes() const {
+        return this->prefixSize;
+    }
+
+    template< class V >
+    int BucketBasics<V>::_storedSize(const Key& key) const {
+        return key.dataSize();
+    }
+
+    template<>
+    int BucketBasics<V2>::_storedSize(const Key& key) const {
+        return key.dataSize() - this->prefixSize;
+    }
+
+    template< class V >
+    const char* BucketBasics<V>::_storedData(const Key& key) const {
+        return key.data();
+    }
+
+    template<>
+    const char* BucketBasics<V2>::_storedData(const Key& key) const {
+        dassert( memcmp(key.data(), this->data + this->prefixOfs, this->prefixSize) == 0 );
+        return key.data() + this->prefixSize;
+    }
+
+    template< class V >
+    int BucketBasics<V>::_prefixSizeFor(const Key& key, int *fields) const {
+        return -1;
+    }
+
+    template<>
+    int BucketBasics<V2>::_prefixSizeFor(const Key& key, int *fields) const {
+        if ( this->n == 0 ) {
+            // the first key sets the prefix: all of it but its last field
+            int size = key.commonPrefixSize(key, V2::KeyMax, fields);
+            if ( size == this->prefixSize &&
+                 memcmp(key.data(), this->data + this->prefixOfs, size) == 0 ) {
+                return -1;
+            }
+            return size;
+        }
+        if ( this->prefixSize == 0 ) {
+            return -1;
+        }
+        KeyV1 prefix(this->data + this->prefixOfs);
+        int size = prefix.commonPrefixSize(key, this->prefixSize, fields);
+        return size == this->prefixSize ? -1 : size;
+    }
+
+    /** never called, as _prefixSizeFor() always returns -1 */
+    template< class V >
+    bool BucketBasics<V>::_fitsWithPrefix(int prefixSize, const Key& key) const {
+        verify(false);
+        return false;
+    }
+
+    template<>
+    bool BucketBasics<V2>::_fitsWithPrefix(int prefixSize, const Key& key) const {
+        int grow = this->prefixSize - prefixSize;
+        int size = key.dataSize() + sizeof(_KeyNode);
+        for ( int j = 0; j < this->n; j++ ) {
+            size += _keySize(k(j).keyDataOfs()) + grow + sizeof(_KeyNode);
+        }
+        return size <= totalDataSize();
+    }
+
+    /** never called, as _prefixSizeFor() always returns -1 */
+    template< class V >
+    void BucketBasics<V>::_setPrefix(const char *prefix, int prefixSize, int prefixFields) {
+        verify(false);
+    }
+
+    /**
+     * Rewrites the body with the new prefix on top followed by the keys.  A shorter prefix
+     * must be the start of the old one, which moves its end onto every key; a longer one
+     * must be the old one extended by bytes every key starts with, which come off them.
+     */
+    template<>
+    void BucketBasics<V2>::_setPrefix(const char *prefix, int prefixSize, int prefixFields) {
+        assertWritable();
+
+        int tdz = totalDataSize();
+        int keyNodesSize = this->n * sizeof(_KeyNode);
+        char temp[V2::BucketSize];
+        int ofs = tdz - prefixSize;
+        memcpy(temp + ofs, prefix, prefixSize);
+        int newPrefixOfs = ofs;
+
+        const char *oldPrefix = this->data + this->prefixOfs;
+        int oldSize = this->prefixSize;
+        for ( int j = 0; j < this->n; j++ ) {
+            short ofsold = k(j).keyDataOfs();
+            int sz = _keySize(ofsold);
+            if ( prefixSize <= oldSize ) {
+                int moved = oldSize - prefixSize;
+                ofs -= moved + sz;
+                verify( ofs >= keyNodesSize );
+                memcpy(temp + ofs, oldPrefix + prefixSize, moved);
+                memcpy(temp + ofs + moved, dataAt(ofsold), sz);
+            }
+            else {
+                int cut = prefixSize - oldSize;
+                dassert( cut < sz );
+                ofs -= sz - cut;
+                verify( ofs >= keyNodesSize );
+                memcpy(temp + ofs, dataAt(ofsold) + cut, sz - cut);
+            }
+            k(j).setKeyDataOfsSavingUse( ofs );
+        }
+        int dataUsed = tdz - ofs;
+        memcpy(this->data + ofs, temp + ofs, dataUsed);
+
+        this->topSize = dataUsed;
+        this->emptySize = tdz - dataUsed - keyNodesSize;
+        this->prefixOfs = newPrefixOfs;
+        this->prefixSize = prefixSize;
+        this->prefixFields = prefixFields;
+        setPacked();
+    }
+
+    template< class V >
+    int BucketBasics<V>::_comparePrefix(const Key& key, const Ordering &order, int *tailOfs) const {
+        *tailOfs = 0;
+        return 0;
+    }
+
+    template<>
+    int BucketBasics<V2>::_comparePrefix(const Key& key, const Ordering &order, int *tailOfs) const {
+        if ( this->prefixSize == 0 ) {
+            *tailOfs = 0;
+            return 0;
+        }
+        if ( !key.isCompactFormat() ) {
+            // can't be split into fields; _compareTail() puts the keys back together instead
+            *tailOfs = -1;
+            return 0;
+        }
+        return key.comparePrefix(this->data + this->prefixOfs, this->prefixSize, order, tailOfs);
+    }
+
+    template< class V >
+    int BucketBasics<V>::_compareTail(const Key& key, int tailOfs, int i, const Ordering &order) const {
+        return key.woCompare(keyNode(i).key, order);
+    }
+
+    template<>
+    int BucketBasics<V2>::_compareTail(const Key& key, int tailOfs, int i, const Ordering &order) const {
+        short ofs = k(i).keyDataOfs();
+        if ( this->prefixSize == 0 ) {
+            return key.woCompare(KeyV1(this->data + ofs), order);
+        }
+        if ( tailOfs < 0 ) {
+            return key.woCompare(_keyAt(ofs), order);
+        }
+        return KeyV1(key.data() + tailOfs).woCompareTail(KeyV1(this->data + ofs), order,
+                                                        this->prefixFields);
+    }
+
     template< class V >
     void BucketBasics<V>::_delKeyAtPos(int keypos, bool mayEmpty) {
         // TODO This should be keypos < n
@@ -339,7 +507,7 @@ namespace mongo {
         KeyNode kn = keyNode(this->n-1);
         recLoc = kn.recordLoc;
         key.assign(kn.key);
-        int keysize = kn.key.dataSize();
+        int keysize = _keySize(k(this->n-1).keyDataOfs());
 
         massert( 10283 , "rchild not null in btree popBack()", this->nextChild.isNull());
 
@@ -357,7 +525,15 @@ namespace mongo {
     /** add a key.  must be > all existing.  be careful to set next ptr right. */
     template< class V >
     bool BucketBasics<V>::_pushBack(const DiskLoc recordLoc, const Key& key, const Ordering &order, const DiskLoc prevChild) {
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int prefixFields;
+        int prefixSize = _prefixSizeFor(key, &prefixFields);
+        if ( prefixSize >= 0 ) {
+            if ( !_fitsWithPrefix(prefixSize, key) )
+                return false;
+            _setPrefix(key.data(), prefixSize, prefixFields);
+        }
+        int keySize = _storedSize(key);
+        int bytesNeeded = keySize + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize )
             return false;
         verify( bytesNeeded <= this->emptySize );
@@ -375,10 +551,10 @@ namespace mongo {
         _KeyNode& kn = k(this->n++);
         kn.prevChildBucket = prevChild;
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs( (short) _alloc(key.dataSize()) );
+        kn.setKeyDataOfs( (short) _alloc(keySize) );
         short ofs = kn.keyDataOfs();
         char *p = dataAt(ofs);
-        memcpy(p, key.data(), key.dataSize());
+        memcpy(p, _storedData(key), keySize);
 
         return true;
     }
@@ -395,11 +571,29 @@ namespace mongo {
     bool BucketBasics<V>::basicInsert(const DiskLoc thisLoc, int &keypos, const DiskLoc recordLoc, const Key& key, const Ordering &order) const {
         check( this->n < 1024 );
         check( keypos >= 0 && keypos <= this->n );
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
-        if ( bytesNeeded > this->emptySize ) {
-            _pack(thisLoc, order, keypos);
-            if ( bytesNeeded > this->emptySize )
+        int keySize;
+        int bytesNeeded;
+        // packing can lengthen the prefix past what key shares, so after a pack the prefix
+        // and the key's stored size are worked out again
+        for ( bool packed = false; ; packed = true ) {
+            int prefixFields;
+            int prefixSize = _prefixSizeFor(key, &prefixFields);
+            if ( prefixSize >= 0 ) {
+                // the bucket's prefix has to be cut back for key to share it
+                if ( !_fitsWithPrefix(prefixSize, key) ) {
+                    if ( !packed )
+                        _pack(thisLoc, order, keypos);
+                    return false;
+                }
+                thisLoc.btreemod<V>()->_setPrefix(key.data(), prefixSize, prefixFields);
+            }
+            keySize = _storedSize(key);
+            bytesNeeded = keySize + sizeof(_KeyNode);
+            if ( bytesNeeded <= this->emptySize )
+                break;
+            if ( packed )
                 return false;
+            _pack(thisLoc, order, keypos);
         }
 
         BucketBasics *b;
@@ -427,10 +621,10 @@ namespace mongo {
         _KeyNode& kn = b->k(keypos);
         kn.prevChildBucket.Null();
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs((short) b->_alloc(key.dataSize()) );
+        kn.setKeyDataOfs((short) b->_alloc(keySize) );
         char *p = b->dataAt(kn.keyDataOfs());
-        getDur().declareWriteIntent(p, key.dataSize());
-        memcpy(p, key.data(), key.dataSize());
+        getDur().declareWriteIntent(p, keySize);
+        memcpy(p, _storedData(key), keySize);
         return true;
     }
 
@@ -453,7 +647,10 @@ namespace mongo {
             if ( mayDropKey( j, refPos ) ) {
                 continue;
             }
-            size += keyNode( j ).key.dataSize() + sizeof( _KeyNode );
+            size += _keySize( k( j ).keyDataOfs() ) + sizeof( _KeyNode );
+        }
+        if ( size > 0 ) {
+            size += _prefixBytes();
         }
         return size;
     }
@@ -501,7 +698,7 @@ namespace mongo {
                 k( i ) = k( j );
             }
             short ofsold = k(i).keyDataOfs();
-            int sz = keyNode(i).key.dataSize();
+            int sz = _keySize(ofsold);
             ofs -= sz;
             this->topSize += sz;
             memcpy(temp+ofs, dataAt(ofsold), sz);
@@ -529,6 +726,59 @@ namespace mongo {
         assertValid( order );
     }
 
+    /** drops keys as the generic version does, then makes the prefix as long as it can be */
+    template<>
+    void BucketBasics<V2>::_packReadyForMod( const Ordering &order, int &refPos ) {
+        assertWritable();
+
+        if ( this->flags & Packed )
+            return;
+
+        int i = 0;
+        for ( int j = 0; j < this->n; j++ ) {
+            if( mayDropKey( j, refPos ) ) {
+                continue; // key is unused and has no children - drop it
+            }
+            if( i != j ) {
+                if ( refPos == j ) {
+                    refPos = i; // i < j so j will never be refPos again
+                }
+                k( i ) = k( j );
+            }
+            ++i;
+        }
+        if ( refPos == this->n ) {
+            refPos = i;
+        }
+        this->n = i;
+
+        // every key starts with the prefix, so the longest prefix is the current one plus
+        // whatever the stored keys have in common
+        char prefix[V2::KeyMax];
+        int prefixSize = 0;
+        int prefixFields = 0;
+        if ( this->n > 0 ) {
+            prefixSize = this->prefixSize;
+            prefixFields = this->prefixFields;
+            memcpy(prefix, this->data + this->prefixOfs, prefixSize);
+
+            KeyV1 first(dataAt(k(0).keyDataOfs()));
+            int moreFields;
+            int more = first.commonPrefixSize(first, V2::KeyMax - prefixSize, &moreFields);
+            for ( int j = 1; j < this->n && more > 0; j++ ) {
+                more = first.commonPrefixSize(KeyV1(dataAt(k(j).keyDataOfs())), more, &moreFields);
+            }
+            if ( more > 0 ) {
+                memcpy(prefix + prefixSize, first.data(), more);
+                prefixSize += more;
+                prefixFields += moreFields;
+            }
+        }
+        _setPrefix(prefix, prefixSize, prefixFields);
+
+        assertValid( order );
+    }
+
     template< class V >
     inline void BucketBasics<V>::truncateTo(int N, const Ordering &order, int &refPos) {
         verify( Lock::somethingWriteLocked() );
@@ -565,7 +815,7 @@ namespace mongo {
         // TODO I think we only want to do the 90% split on the rhs node of the tree.
         int rightSizeLimit = ( this->topSize + sizeof( _KeyNode ) * this->n ) / ( keypos == this->n ? 10 : 2 );
         for( int i = this->n - 1; i > -1; --i ) {
-            rightSize += keyNode( i ).key.dataSize() + sizeof( _KeyNode );
+            rightSize += _keySize( k( i ).keyDataOfs() ) + sizeof( _KeyNode );
             if ( rightSize > rightSizeLimit ) {
                 split = i;
                 break;
@@ -597,10 +847,11 @@ namespace mongo {
         _KeyNode &kn = k( i );
         kn.recordLoc = recordLoc;
         kn.prevChildBucket = prevChildBucket;
-        short ofs = (short) _alloc( key.dataSize() );
+        int keySize = _storedSize( key );
+        short ofs = (short) _alloc( keySize );
         kn.setKeyDataOfs( ofs );
         char *p = dataAt( ofs );
-        memcpy( p, key.data(), key.dataSize() );
+        memcpy( p, _storedData( key ), keySize );
     }
 
     template< class V >
@@ -768,6 +1019,16 @@ namespace mongo {
         recordLoc = rl;
         globalIndexCounters->btree( reinterpret_cast<const char*>(this) );
 
+        // compare with the prefix shared by every key first, if the bucket has one
+        int tailOfs;
+        {
+            int x = this->_comparePrefix(key, btreeState->ordering(), &tailOfs);
+            if ( x ) {
+                pos = x < 0 ? 0 : this->n;
+                return false;
+            }
+        }
+
         // binary search for this key
         bool dupsChecked = false;
         int l=0;
@@ -777,8 +1038,8 @@ namespace mongo {
             m = h;
         }
         while ( l <= h ) {
-            KeyNode M = this->keyNode(m);
-            int x = key.woCompare(M.key, btreeState->ordering());
+            const _KeyNode& M = k(m);
+            int x = this->_compareTail(key, tailOfs, m, btreeState->ordering());
             if ( x == 0 ) {
                 if( assertIfDup ) {
                     if( k(m).isUnused() ) {
@@ -1005,6 +1266,43 @@ namespace mongo {
         return true;
     }
 
+    /**
+     * With prefix compression the merged bucket's prefix is what the left child's prefix has
+     * in common with the separator and the right child's keys, or longer, so size the merge
+     * with that.  l is only packed, which may lengthen its prefix, by doMergeChildren().
+     */
+    template<>
+    bool BtreeBucket<V2>::canMergeChildren( const DiskLoc &thisLoc, int leftIndex ) const {
+        verify( leftIndex >= 0 && leftIndex < this->n );
+        DiskLoc leftNodeLoc = this->childForPos( leftIndex );
+        DiskLoc rightNodeLoc = this->childForPos( leftIndex + 1 );
+        if ( leftNodeLoc.isNull() || rightNodeLoc.isNull() ) {
+            return false;
+        }
+        const BtreeBucket *l = leftNodeLoc.btree<V2>();
+        const BtreeBucket *r = rightNodeLoc.btree<V2>();
+        KeyV2 separator = keyNode( leftIndex ).key;
+
+        // an empty l takes its prefix from the separator, see _prefixSizeFor()
+        KeyV1 prefix( l->n ? l->data + l->prefixOfs : separator.data() );
+        int fields;
+        int prefixSize = prefix.commonPrefixSize( separator, l->n ? int( l->prefixSize ) : V2::KeyMax,
+                                                  &fields );
+        for( int i = 0; i < r->n && prefixSize > 0; ++i ) {
+            prefixSize = prefix.commonPrefixSize( r->keyNode( i ).key, prefixSize, &fields );
+        }
+
+        int KNS = sizeof( _KeyNode );
+        int size = separator.dataSize() + KNS;
+        for( int i = 0; i < l->n; ++i ) {
+            size += l->_keySize( l->k( i ).keyDataOfs() ) + l->prefixSize - prefixSize + KNS;
+        }
+        for( int i = 0; i < r->n; ++i ) {
+            size += r->_keySize( r->k( i ).keyDataOfs() ) + r->prefixSize - prefixSize + KNS;
+        }
+        return this->headerSize() + size <= V2::BucketSize;
+    }
+
     /**
      * This implementation must respect the meaning and value of lowWaterMark.
      * Also see comments in splitPos().
@@ -1226,6 +1524,144 @@ namespace mongo {
         }
     }
 
+    namespace {
+        /** A key copied out of a bucket, with the record and child that go with it. */
+        struct KeyCopy {
+            DiskLoc recordLoc;
+            DiskLoc prevChildBucket;
+            int ofs; // in the copy buffer
+        };
+
+        void copyKey( vector<KeyCopy> &copies, BufBuilder &buf, const DiskLoc &recordLoc,
+                      const DiskLoc &prevChildBucket, const KeyV1 &key ) {
+            KeyCopy c;
+            c.recordLoc = recordLoc;
+            c.prevChildBucket = prevChildBucket;
+            c.ofs = buf.len();
+            buf.appendBuf( key.data(), key.dataSize() );
+            copies.push_back( c );
+        }
+
+        /** @return the prefix shared by copies [from, to) */
+        int copiesPrefix( const vector<KeyCopy> &copies, const char *buf, int from, int to,
+                          int *fields ) {
+            KeyV1 first( buf + copies[from].ofs );
+            int size = first.commonPrefixSize( first, V2::KeyMax, fields );
+            for( int i = from + 1; i < to && size > 0; ++i ) {
+                size = first.commonPrefixSize( KeyV1( buf + copies[i].ofs ), size, fields );
+            }
+            return size;
+        }
+    }
+
+    /**
+     * With prefix compression the space a key takes depends on the bucket holding it, so the
+     * keys can't be moved over one at a time as above.  Instead both children are rebuilt
+     * from a copy of their keys and the separator, split where both fit and the larger is
+     * smallest.  If that is where they are split already nothing changes, and the bucket may
+     * stay under lowWaterMark.
+     */
+    template<>
+    void BtreeBucket<V2>::doBalanceChildren( IndexCatalogEntry* btreeState,
+                                             const DiskLoc thisLoc,
+                                             int leftIndex ) {
+        DiskLoc lchild = this->childForPos( leftIndex );
+        DiskLoc rchild = this->childForPos( leftIndex + 1 );
+        int zeropos = 0;
+        BtreeBucket *l = lchild.btreemod<V2>();
+        l->_packReadyForMod( btreeState->ordering(), zeropos );
+        BtreeBucket *r = rchild.btreemod<V2>();
+        r->_packReadyForMod( btreeState->ordering(), zeropos );
+
+        vector<KeyCopy> copies;
+        BufBuilder buf;
+        for( int i = 0; i < l->n; ++i ) {
+            KeyNode kn = l->keyNode( i );
+            copyKey( copies, buf, kn.recordLoc, kn.prevChildBucket, kn.key );
+        }
+        {
+            KeyNode kn = keyNode( leftIndex );
+            copyKey( copies, buf, kn.recordLoc, l->nextChild, kn.key );
+        }
+        for( int i = 0; i < r->n; ++i ) {
+            KeyNode kn = r->keyNode( i );
+            copyKey( copies, buf, kn.recordLoc, kn.prevChildBucket, kn.key );
+        }
+        const char *keys = buf.buf();
+        int N = copies.size();
+        int KNS = sizeof( _KeyNode );
+
+        // leftSize[s] and rightSize[s] are the bodies of the children if copies[s] is the
+        // new separator: the prefix once, then the rest of each key.
+        vector<int> leftSize( N, 0 );
+        vector<int> rightSize( N, 0 );
+        {
+            KeyV1 first( keys + copies[0].ofs );
+            int fields;
+            int prefix = first.commonPrefixSize( first, V2::KeyMax, &fields );
+            int sum = 0;
+            for( int s = 1; s < N; ++s ) {
+                KeyV1 key( keys + copies[s - 1].ofs );
+                prefix = first.commonPrefixSize( key, prefix, &fields );
+                sum += key.dataSize() + KNS;
+                leftSize[s] = sum - ( s - 1 ) * prefix;
+            }
+        }
+        {
+            KeyV1 last( keys + copies[N - 1].ofs );
+            int fields;
+            int prefix = last.commonPrefixSize( last, V2::KeyMax, &fields );
+            int sum = 0;
+            for( int s = N - 2; s >= 0; --s ) {
+                KeyV1 key( keys + copies[s + 1].ofs );
+                prefix = last.commonPrefixSize( key, prefix, &fields );
+                sum += key.dataSize() + KNS;
+                rightSize[s] = sum - ( N - 2 - s ) * prefix;
+            }
+        }
+
+        int split = -1;
+        int splitLarger = 0;
+        for( int s = 1; s <= N - 2; ++s ) {
+            if ( leftSize[s] > this->bodySize() || rightSize[s] > this->bodySize() ) {
+                continue;
+            }
+            int larger = max( leftSize[s], rightSize[s] );
+            if ( split == -1 || larger < splitLarger ) {
+                split = s;
+                splitLarger = larger;
+            }
+        }
+        if ( split == -1 || split == l->n ) {
+            return;
+        }
+
+        DiskLoc rNext = r->nextChild;
+        BtreeBucket *children[] = { l, r };
+        int from[] = { 0, split + 1 };
+        int to[] = { split, N };
+        for( int c = 0; c < 2; ++c ) {
+            BtreeBucket *b = children[c];
+            b->n = 0;
+            b->topSize = 0;
+            b->emptySize = b->totalDataSize();
+            int fields;
+            int prefixSize = copiesPrefix( copies, keys, from[c], to[c], &fields );
+            b->_setPrefix( keys + copies[from[c]].ofs, prefixSize, fields );
+            for( int i = from[c]; i < to[c]; ++i ) {
+                b->pushBack( copies[i].recordLoc, KeyV2( keys + copies[i].ofs ),
+                             btreeState->ordering(), copies[i].prevChildBucket );
+            }
+        }
+        l->nextChild = copies[split].prevChildBucket;
+        r->nextChild = rNext;
+        l->fixParentPtrs( lchild );
+        r->fixParentPtrs( rchild );
+
+        setInternalKey( btreeState, thisLoc, leftIndex, copies[split].recordLoc,
+                        KeyV2( keys + copies[split].ofs ), lchild, rchild );
+    }
+
     template< class V >
     bool BtreeBucket<V>::mayBalanceWithNeighbors(IndexCatalogEntry* btreeState,
                                                  const DiskLoc thisLoc ) {
@@ -1947,8 +2383,10 @@ namespace mongo {
 
     template class BucketBasics<V0>;
     template class BucketBasics<V1>;
+    template class BucketBasics<V2>;
     template class BtreeBucket<V0>;
     template class BtreeBucket<V1>;
+    template class BtreeBucket<V2>;
     template struct __KeyNode<DiskLoc>;
     template struct __KeyNode<DiskLoc56Bit>;
 
@@ -315,8 +315,62 @@ namespace mongo {
         void _init() { }
     };
 
+    /**
+     * Same as BtreeData_V1, but the leading key fields that every key in the bucket has in
+     * common are stored once, as the bucket's prefix, and each key is stored without them.
+     * The prefix is cut on a field boundary and never includes a key's last field, so what
+     * is stored of each key is itself a valid KeyV1 holding the remaining fields.  Keys in
+     * BSON format share no prefix.
+     *
+     * The prefix lives in the top region with the keys and is allocated before them.
+     */
+    class BtreeData_V2 {
+    public:
+        typedef DiskLoc56Bit Loc;
+        typedef __KeyNode<Loc> _KeyNode;
+        typedef KeyV2 Key;
+        typedef KeyV2 KeyOwned;
+        enum { BucketSize = 8192-16 }; // leave room for Record header
+        static const int KeyMax = 1024;
+        // A sentinel value sometimes used to identify a deallocated bucket.
+        static const unsigned short INVALID_N_SENTINEL = 0xffff;
+    protected:
+        /** Parent bucket of this bucket, which isNull() for the root bucket. */
+        Loc parent;
+        /** Given that there are n keys, this is the n index child. */
+        Loc nextChild;
+
+        unsigned short flags;
+
+        /** basicInsert() assumes the next three members are consecutive and in this order: */
+
+        /** Size of the empty region. */
+        unsigned short emptySize;
+        /** Size used for bson storage, including storage of old keys and the prefix. */
+        unsigned short topSize;
+        /* Number of keys in the bucket. */
+        unsigned short n;
+
+        /** Offset within the body of the prefix shared by every key. */
+        unsigned short prefixOfs;
+        /** Size of the prefix, 0 if the keys are stored whole. */
+        unsigned short prefixSize;
+        /** Number of key fields in the prefix. */
+        unsigned short prefixFields;
+
+        /* Beginning of the bucket's body */
+        char data[4];
+
+        void _init() {
+            prefixOfs = 0;
+            prefixSize = 0;
+            prefixFields = 0;
+        }
+    };
+
     typedef BtreeData_V0 V0;
     typedef BtreeData_V1 V1;
+    typedef BtreeData_V2 V2;
 
     /**
      * This class adds functionality to BtreeData for managing a single bucket.
@@ -540,6 +594,40 @@ namespace mongo {
          * Postconditions: The top region is decreased
          */
         void _unalloc(int bytes);
+        /*
+         * Hooks for versions that store keys prefix compressed, see BtreeData_V2.  The
+         * versions here are for buckets that store every key whole.
+         */
+
+        /** @return the key whose stored data is at 'ofs' */
+        Key _keyAt( short ofs ) const { return Key( this->data + ofs ); }
+        /** @return the size of the stored data at 'ofs' */
+        int _keySize( short ofs ) const { return _keyAt( ofs ).dataSize(); }
+        /** @return bytes used by the prefix */
+        int _prefixBytes() const;
+        /** @return the bytes of 'key' stored in this bucket, which 'key' must fit */
+        int _storedSize( const Key& key ) const;
+        const char* _storedData( const Key& key ) const;
+        /**
+         * @return -1 if 'key' can be stored with the bucket's prefix, or else the size of the
+         *  prefix it can be stored with, setting '*fields' to its number of fields.
+         */
+        int _prefixSizeFor( const Key& key, int* fields ) const;
+        /** @return true if the keys and 'key' fit when stored with a prefix of 'prefixSize' */
+        bool _fitsWithPrefix( int prefixSize, const Key& key ) const;
+        /**
+         * Preconditions: every key starts with 'prefix', and they fit when stored without it.
+         * Postconditions: the keys are stored without 'prefix' and the bucket is packed.
+         */
+        void _setPrefix( const char* prefix, int prefixSize, int prefixFields );
+        /**
+         * Compares the leading fields of 'key' with the bucket's prefix.  When they are equal,
+         * sets '*tailOfs' for _compareTail().
+         */
+        int _comparePrefix( const Key& key, const Ordering& order, int* tailOfs ) const;
+        /** Compares 'key', whose prefix compared equal, with the i-indexed key. */
+        int _compareTail( const Key& key, int tailOfs, int i, const Ordering& order ) const;
+
         /**
          * Preconditions: 'N' <= n
          * Postconditions:
@@ -963,7 +1051,7 @@ namespace mongo {
         Key keyAt(int i) const {
             if( i >= this->n ) 
                 return Key();
-            return Key(this->data + k(i).keyDataOfs());
+            return this->_keyAt(k(i).keyDataOfs());
         }
     protected:
 
@@ -1070,9 +1158,19 @@ namespace mongo {
     template< class V >
     BucketBasics<V>::KeyNode::KeyNode(const BucketBasics<V>& bb, const _KeyNode &k) :
         prevChildBucket(k.prevChildBucket),
-        recordLoc(k.recordLoc), key(bb.data+k.keyDataOfs())
+        recordLoc(k.recordLoc), key(bb._keyAt(k.keyDataOfs()))
     { }
 
+    template<>
+    inline KeyV2 BucketBasics<V2>::_keyAt( short ofs ) const {
+        return KeyV2( this->data + this->prefixOfs, this->prefixSize, this->data + ofs );
+    }
+
+    template<>
+    inline int BucketBasics<V2>::_keySize( short ofs ) const {
+        return KeyV1( this->data + ofs ).dataSize();
+    }
+
     template< class V >
     const BtreeBucket<V> * DiskLoc::btree() const {
         verify( _a != -1 );
@@ -533,14 +533,9 @@ namespace mongo {
         return L.woCompare(R, order, /*considerfieldname*/false);
     }
 
-    int KeyV1::woCompare(const KeyV1& right, const Ordering &order) const {
-        const unsigned char *l = _keyData;
-        const unsigned char *r = right._keyData;
-
-        if( (*l|*r) == IsBSON ) // only can do this if cNOTUSED maintained
-            return compareHybrid(right, order);
-
-        unsigned mask = 1;
+    /** compares compact format fields, 'mask' being the ordering bit of the first of them */
+    static int compareFields(const unsigned char *l, const unsigned char *r,
+                             const Ordering &order, unsigned mask) {
         while( 1 ) { 
             char lval = *l; 
             char rval = *r;
@@ -567,6 +562,47 @@ namespace mongo {
         return 0;
     }
 
+    int KeyV1::woCompare(const KeyV1& right, const Ordering &order) const {
+        const unsigned char *l = _keyData;
+        const unsigned char *r = right._keyData;
+
+        if( (*l|*r) == IsBSON ) // only can do this if cNOTUSED maintained
+            return compareHybrid(right, order);
+
+        return compareFields(l, r, order, 1);
+    }
+
+    int KeyV1::woCompareTail(const KeyV1& right, const Ordering &order, int skipFields) const {
+        dassert( isCompactFormat() && right.isCompactFormat() );
+        // Ordering only has bits for the first 32 fields, as with the shift in compareFields
+        unsigned mask = skipFields < 32 ? 1U << skipFields : 0;
+        return compareFields(_keyData, right._keyData, order, mask);
+    }
+
+    int KeyV1::comparePrefix(const char *prefix, int prefixSize, const Ordering &order,
+                             int *tailOfs) const {
+        dassert( isCompactFormat() );
+        const unsigned char *l = _keyData;
+        const unsigned char *r = (const unsigned char *) prefix;
+        const unsigned char *end = r + prefixSize;
+        unsigned mask = 1;
+        while( r < end ) {
+            char lval = *l;
+            int x = compare(l, r); // updates l and r pointers
+            if( x ) {
+                if( order.descending(mask) )
+                    x = -x;
+                return x;
+            }
+            // every field of the prefix is followed by more, so a key ending here is smaller
+            if( (lval & cHASMORE) == 0 )
+                return -1;
+            mask <<= 1;
+        }
+        *tailOfs = l - _keyData;
+        return 0;
+    }
+
     static unsigned sizes[] = {
         0,
         1, //cminkey=1,
@@ -616,6 +652,69 @@ namespace mongo {
         return p - _keyData;
     }
 
+    int KeyV1::commonPrefixSize(const KeyV1& right, int maxSize, int *fields) const {
+        *fields = 0;
+        if( !isCompactFormat() || !right.isCompactFormat() )
+            return 0;
+
+        const unsigned char *l = _keyData;
+        const unsigned char *r = right._keyData;
+        int size = 0;
+        while( size < maxSize && (*l & cHASMORE) && *l == *r ) {
+            unsigned z = sizeOfElement(l);
+            if( size + (int) z > maxSize || z != sizeOfElement(r) || memcmp(l, r, z) )
+                break;
+            size += z;
+            l += z;
+            r += z;
+            ++*fields;
+        }
+        return size;
+    }
+
+    KeyV2::KeyV2(const char *prefix, int prefixSize, const char *tail) : _owned(false), _heap(0) {
+        if( prefixSize == 0 ) {
+            _keyData = (const unsigned char *) tail;
+            return;
+        }
+        _own(prefix, prefixSize, tail, KeyV1(tail).dataSize());
+    }
+
+    KeyV2::KeyV2(const BSONObj& obj) : _owned(false), _heap(0) {
+        KeyV1Owned k(obj);
+        _own(k.data(), k.dataSize(), 0, 0);
+    }
+
+    KeyV2::KeyV2(const KeyV2& rhs) : KeyV1(), _owned(false), _heap(0) {
+        assign(rhs);
+    }
+
+    void KeyV2::assign(const KeyV2& rhs) {
+        if( &rhs == this )
+            return;
+        if( !rhs._owned ) {
+            _keyData = rhs._keyData;
+            _owned = false;
+            return;
+        }
+        _own(rhs.data(), rhs.dataSize(), 0, 0);
+    }
+
+    void KeyV2::_own(const char *a, int aSize, const char *b, int bSize) {
+        int size = aSize + bSize;
+        char *buf = _inline;
+        if( size > InlineSize ) {
+            buf = new char[size];
+        }
+        memcpy(buf, a, aSize);
+        memcpy(buf + aSize, b, bSize);
+        delete[] _heap;
+        _heap = buf == _inline ? 0 : buf;
+        _keyData = (const unsigned char *) buf;
+        _owned = true;
+        dassert( dataSize() == size );
+    }
+
     bool KeyV1::woEqual(const KeyV1& right) const {
         const unsigned char *l = _keyData;
         const unsigned char *r = right._keyData;
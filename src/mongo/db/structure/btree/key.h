@@ -39,6 +39,8 @@ namespace mongo {
         KeyBson is a legacy wrapper implementation for old BSONObj style keys for v:0 indexes.
 
         KeyV1 is the new implementation.
+
+        KeyV2 is KeyV1 for v:2 indexes, which keep their keys prefix compressed.
     */
     class KeyBson /* "KeyV0" */ { 
     public:
@@ -99,6 +101,29 @@ namespace mongo {
         bool isCompactFormat() const { return *_keyData != IsBSON; }
 
         bool isValid() const { return _keyData > (const unsigned char*)1; }
+
+        /**
+         * @return the size of the longest run of whole leading fields this key shares
+         * bytewise with 'right', never including the last field of either key, and looking
+         * at no more than 'maxSize' bytes.  '*fields' is set to the number of fields in the
+         * run.  0 if either key is in BSON format.
+         */
+        int commonPrefixSize(const KeyV1& right, int maxSize, int* fields) const;
+
+        /**
+         * Compares the leading fields of this key, which must be in compact format, with
+         * 'prefix': the first 'prefixSize' bytes of a compact format key, ending on a field
+         * boundary before its last field.  When they are equal '*tailOfs' is set to the
+         * offset in this key of the fields that follow.
+         */
+        int comparePrefix(const char* prefix, int prefixSize, const Ordering& order,
+                          int* tailOfs) const;
+
+        /**
+         * woCompare() for the remainders of two compact format keys whose first 'skipFields'
+         * fields are equal.  'order' still describes the whole key.
+         */
+        int woCompareTail(const KeyV1& right, const Ordering& order, int skipFields) const;
     protected:
         enum { IsBSON = 0xff };
         const unsigned char *_keyData;
@@ -127,4 +152,39 @@ namespace mongo {
         void traditional(const BSONObj& obj); // store as traditional bson not as compact format
     };
 
+    /**
+     * Key class for BtreeData_V2, whose buckets store their keys without the prefix they
+     * all share.  The key data is in KeyV1 format.  A key read from a bucket with a prefix
+     * is put back together in a buffer of its own, so unlike KeyV1 it stays valid when the
+     * bucket changes; one from a bucket without a prefix points into the bucket as KeyV1
+     * does.
+     */
+    class KeyV2 : public KeyV1 {
+        void operator=(const KeyV2&);
+    public:
+        KeyV2() : _owned(false), _heap(0) { }
+
+        /** points at 'keyData', which must be in KeyV1 format, as KeyV1 does */
+        explicit KeyV2(const char* keyData) : KeyV1(keyData), _owned(false), _heap(0) { }
+
+        /** the key made of the 'prefixSize' bytes at 'prefix' and the key data at 'tail' */
+        KeyV2(const char* prefix, int prefixSize, const char* tail);
+
+        /** translates 'obj' to KeyV1 format, see KeyV1Owned */
+        explicit KeyV2(const BSONObj& obj);
+
+        KeyV2(const KeyV2& rhs);
+        ~KeyV2() { delete[] _heap; }
+
+        void assign(const KeyV2& rhs);
+
+    private:
+        void _own(const char* a, int aSize, const char* b, int bSize);
+
+        enum { InlineSize = 128 };
+        bool _owned;
+        char* _heap;
+        char _inline[InlineSize];
+    };
+
 };
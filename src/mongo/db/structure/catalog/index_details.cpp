@@ -74,6 +74,11 @@ namespace mongo {
             return false;
         }
 
+        const BSONObj existingFilter = info.obj().getObjectField("partialFilterExpression");
+        if ( !existingFilter.equal( newSpec.getObjectField("partialFilterExpression") ) ) {
+            return false;
+        }
+
         // Note: { _id: 1 } or { _id: -1 } implies unique: true.
         if ( !isIdIndex() &&
              unique() != newSpec["unique"].trueValue() ) {
@@ -87,6 +87,7 @@ namespace mongo {
         _reservedA = 0;
         _extraOffset = 0;
         _indexBuildsInProgress = 0;
+        _compressionSavings = 0;
         memset(_reserved, 0, sizeof(_reserved));
     }
 
@@ -575,6 +576,12 @@ namespace mongo {
         Stats* s = getDur().writing( &_stats );
         s->datasize = dataSize;
         s->nrecords = numRecords;
+        if ( _compressionSavings )
+            *getDur().writing( &_compressionSavings ) = 0;
+    }
+
+    void NamespaceDetails::incrementCompressionSavings( long long bytes ) {
+        *getDur().writing( &_compressionSavings ) += bytes;
     }
 
 
@@ -728,6 +735,28 @@ namespace mongo {
         }
     }
 
+    int NamespaceDetails::orphanDeletedRecordsInExtents( const set<DiskLoc>& extents ) {
+        int n = 0;
+        for ( int i = 0; i < Buckets; i++ ) {
+            DiskLoc* prev = &_deletedList[i];
+            DiskLoc cur = *prev;
+            while ( !cur.isNull() ) {
+                DeletedRecord* r = cur.drec();
+                DiskLoc next = r->nextDeleted();
+                if ( extents.count( r->myExtentLoc( cur ) ) ) {
+                    *getDur().writing( prev ) = next;
+                    r->nextDeleted().writing().setInvalid(); // defensive.
+                    n++;
+                }
+                else {
+                    prev = &r->nextDeleted();
+                }
+                cur = next;
+            }
+        }
+        return n;
+    }
+
     int NamespaceDetails::_catalogFindIndexByName(const StringData& name,
                                                   bool includeBackgroundInProgress) {
         IndexIterator i = ii(includeBackgroundInProgress);
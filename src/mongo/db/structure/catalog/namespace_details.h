@@ -119,7 +119,10 @@ namespace mongo {
         int _indexBuildsInProgress;            // Number of indexes currently being built
 
         int _userFlags;
-        char _reserved[72];
+
+        // ofs 424
+        long long _compressionSavings;         // sum of Record::compressionSavings() over the records
+        char _reserved[64];
         /*-------- end data 496 bytes */
     public:
         explicit NamespaceDetails( const DiskLoc &loc, bool _capped );
@@ -199,9 +202,18 @@ namespace mongo {
         void incrementStats( long long dataSizeIncrement,
                              long long numRecordsIncrement );
 
+        /** also resets the compression savings, as the records are being counted afresh */
         void setStats( long long dataSizeIncrement,
                        long long numRecordsIncrement );
 
+        /**
+         * the size the documents would take uncompressed: dataSize() plus what compressing
+         * records saved.  equal to dataSize() unless Flag_CompressRecords has been set.
+         */
+        long long logicalDataSize() const { return _stats.datasize + _compressionSavings; }
+
+        void incrementCompressionSavings( long long bytes );
+
 
         bool isCapped() const { return _isCapped; }
         long long maxCappedDocs() const;
@@ -215,6 +227,14 @@ namespace mongo {
 
         void orphanDeletedList();
 
+        /**
+         * Unlinks every deleted record that lives in one of 'extents' from the deleted lists,
+         * so nothing more gets allocated there.  The space is only reclaimed when the extent
+         * itself is freed, or is put back on the lists by the caller.
+         * @return the number of deleted records orphaned
+         */
+        int orphanDeletedRecordsInExtents( const set<DiskLoc>& extents );
+
         /**
          * @param max in and out, will be adjusted
          * @return if the value is valid at all
@@ -254,7 +274,8 @@ namespace mongo {
         };
 
         enum UserFlags {
-            Flag_UsePowerOf2Sizes = 1 << 0
+            Flag_UsePowerOf2Sizes = 1 << 0,
+            Flag_CompressRecords = 1 << 1 // store new documents snappy compressed when it pays
         };
 
         IndexDetails& idx(int idxNo, bool missingExpected = false );
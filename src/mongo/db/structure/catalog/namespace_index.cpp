@@ -32,6 +32,7 @@
 
 #include <boost/filesystem/operations.hpp>
 
+#include "mongo/db/storage/ephemeral_storage.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 
 
@@ -87,7 +88,20 @@ namespace mongo {
         }
     }
 
+    NamespaceIndex::NamespaceIndex(const std::string &dir, const std::string &database) :
+        _ht( 0 ), _dir( dir ), _database( database ),
+        _ephemeral( EphemeralStorage::isEphemeralDatabase( database ) ),
+        _ephemeralView( 0 ), _ephemeralLength( 0 ) {
+    }
+
+    NamespaceIndex::~NamespaceIndex() {
+        if ( _ephemeralView )
+            EphemeralStorage::release( _ephemeralView );
+    }
+
     bool NamespaceIndex::exists() const {
+        if ( _ephemeral )
+            return _ht == 0;
         return !boost::filesystem::exists(path());
     }
 
@@ -145,7 +159,14 @@ namespace mongo {
         boost::filesystem::path nsPath = path();
         string pathString = nsPath.string();
         void *p = 0;
-        if ( boost::filesystem::exists(nsPath) ) {
+        if ( _ephemeral ) {
+            massert(17400, "bad storageGlobalParams.lenForNewNsFiles",
+                    storageGlobalParams.lenForNewNsFiles >= 1024*1024);
+            len = storageGlobalParams.lenForNewNsFiles;
+            p = _ephemeralView = EphemeralStorage::allocate( len );
+            _ephemeralLength = len;
+        }
+        else if ( boost::filesystem::exists(nsPath) ) {
             if( _f.open(pathString, true) ) {
                 len = _f.length();
                 if ( len % (1024*1024) != 0 ) {
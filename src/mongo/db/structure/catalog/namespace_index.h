@@ -46,8 +46,8 @@ namespace mongo {
     */
     class NamespaceIndex {
     public:
-        NamespaceIndex(const std::string &dir, const std::string &database) :
-            _ht( 0 ), _dir( dir ), _database( database ) {}
+        NamespaceIndex(const std::string &dir, const std::string &database);
+        ~NamespaceIndex();
 
         /* returns true if new db will be created if we init lazily */
         bool exists() const;
@@ -72,7 +72,9 @@ namespace mongo {
 
         boost::filesystem::path path() const;
 
-        unsigned long long fileLength() const { return _f.length(); }
+        unsigned long long fileLength() const {
+            return _ephemeralView ? _ephemeralLength : _f.length();
+        }
 
     private:
         void _init();
@@ -82,6 +84,10 @@ namespace mongo {
         HashTable<Namespace,NamespaceDetails> *_ht;
         std::string _dir;
         std::string _database;
+
+        bool _ephemeral;
+        void* _ephemeralView; // instead of _f's when _ephemeral
+        unsigned long long _ephemeralLength;
     };
 
 }
@@ -30,6 +30,8 @@
 
 #include "mongo/db/catalog/collection.h"
 
+#include <algorithm>
+
 #include "mongo/base/counter.h"
 #include "mongo/base/owned_pointer_map.h"
 #include "mongo/db/clientcursor.h"
@@ -42,6 +44,7 @@
 #include "mongo/db/storage/extent.h"
 #include "mongo/db/storage/extent_manager.h"
 #include "mongo/db/structure/collection_iterator.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/util/touch_pages.h"
 
 namespace mongo {
@@ -74,6 +77,36 @@ namespace mongo {
         size_t _allocationSize;
     };
 
+    /**
+     * @return the allocation size, with header, for the compacted copy of 'recOld'
+     */
+    static unsigned compactAllocationSize( NamespaceDetails* d,
+                                           const Record* recOld,
+                                           unsigned docSize,
+                                           const CompactOptions* compactOptions ) {
+        unsigned lenWHdr = docSize + Record::HeaderSize;
+        unsigned lenWPadding = lenWHdr;
+
+        switch( compactOptions->paddingMode ) {
+        case CompactOptions::NONE:
+            if ( d->isUserFlagSet(NamespaceDetails::Flag_UsePowerOf2Sizes) )
+                lenWPadding = d->quantizePowerOf2AllocationSpace(lenWPadding);
+            break;
+        case CompactOptions::PRESERVE:
+            // if we are preserving the padding, the record should not change size
+            lenWPadding = recOld->lengthWithHeaders();
+            break;
+        case CompactOptions::MANUAL:
+            lenWPadding = compactOptions->computeRecordSize(lenWPadding);
+            if (lenWPadding < lenWHdr || lenWPadding > BSONObjMaxUserSize / 2 ) {
+                lenWPadding = lenWHdr;
+            }
+            break;
+        }
+
+        return lenWPadding;
+    }
+
     void Collection::_compactExtent(const DiskLoc diskloc, int extentNumber,
                                     vector<IndexAccessMethod*>& indexesToInsertTo,
                                     const CompactOptions* compactOptions, CompactStats* stats ) {
@@ -125,25 +158,8 @@ namespace mongo {
                         oldObjSize += docSize;
                         oldObjSizeWithPadding += recOld->netLength();
 
-                        unsigned lenWHdr = docSize + Record::HeaderSize;
-                        unsigned lenWPadding = lenWHdr;
-
-                        switch( compactOptions->paddingMode ) {
-                        case CompactOptions::NONE:
-                            if ( details()->isUserFlagSet(NamespaceDetails::Flag_UsePowerOf2Sizes) )
-                                lenWPadding = details()->quantizePowerOf2AllocationSpace(lenWPadding);
-                            break;
-                        case CompactOptions::PRESERVE:
-                            // if we are preserving the padding, the record should not change size
-                            lenWPadding = recOld->lengthWithHeaders();
-                            break;
-                        case CompactOptions::MANUAL:
-                            lenWPadding = compactOptions->computeRecordSize(lenWPadding);
-                            if (lenWPadding < lenWHdr || lenWPadding > BSONObjMaxUserSize / 2 ) {
-                                lenWPadding = lenWHdr;
-                            }
-                            break;
-                        }
+                        unsigned lenWPadding = compactAllocationSize( details(), recOld, docSize,
+                                                                      compactOptions );
 
                         CompactDocWriter writer( objOld, lenWPadding );
                         StatusWith<DiskLoc> status = _recordStore.insertRecord( &writer, 0 );
@@ -346,5 +362,161 @@ namespace mongo {
         return StatusWith<CompactStats>( stats );
     }
 
+    namespace {
+        /** The extents an online compaction drains: everything before 'stopExtent'. */
+        set<DiskLoc> extentsToDrain( NamespaceDetails* d, const DiskLoc& stopExtent ) {
+            set<DiskLoc> extents;
+            for ( DiskLoc L = d->firstExtent(); !L.isNull() && L != stopExtent;
+                  L = L.ext()->xnext ) {
+                extents.insert( L );
+            }
+            return extents;
+        }
+    }
+
+    StatusWith<CompactStepStats> Collection::compactStep( const CompactOptions* compactOptions,
+                                                          const DiskLoc& stopExtent,
+                                                          long long maxBytes ) {
+
+        if ( isCapped() )
+            return StatusWith<CompactStepStats>( ErrorCodes::BadValue,
+                                                 "cannot compact capped collection" );
+
+        if ( _indexCatalog.numIndexesInProgress() )
+            return StatusWith<CompactStepStats>( ErrorCodes::BadValue,
+                                                 "cannot compact when indexes in progress" );
+
+        NamespaceDetails* d = details();
+        CompactStepStats stats;
+
+        const DiskLoc diskloc = d->firstExtent();
+        if ( diskloc.isNull() || diskloc == stopExtent || diskloc == d->lastExtent() ) {
+            _recordStore.setDrainingExtents( set<DiskLoc>() );
+            stats.done = true;
+            return StatusWith<CompactStepStats>( stats );
+        }
+
+        Extent *e = diskloc.ext();
+        e->assertOk();
+        verify( e->validates(diskloc) );
+
+        // take the space in the extents still to be drained off the deleted lists, so that
+        // none of the moves below land in an extent that would only have to be drained again.
+        // that needs a pass over every list, so it is done on the first step only; after that
+        // the record store orphans whatever is deleted from these extents between steps.  if
+        // the collection was reloaded in between, the record store forgot, and it's redone.
+        const set<DiskLoc> draining = extentsToDrain( d, stopExtent );
+        if ( _recordStore.drainingExtents() != draining ) {
+            d->orphanDeletedRecordsInExtents( draining );
+            _recordStore.setDrainingExtents( draining );
+        }
+
+        DiskLoc L = e->firstRecord;
+        while ( !L.isNull() && stats.bytesMoved < maxBytes ) {
+            Record *recOld = L.rec();
+            DiskLoc next = getExtentManager()->getNextRecordInExtent(L);
+            BSONObj objOld = BSONObj::make(recOld);
+
+            if ( compactOptions->validateDocuments && !objOld.valid() ) {
+                // the offline path drops corrupt documents, but here the document is still
+                // in the indexes, so leave it to an offline compact or repair
+                return StatusWith<CompactStepStats>( ErrorCodes::InvalidBSON,
+                                                     str::stream() << "corrupt document at "
+                                                     << L.toString()
+                                                     << ", use an offline compact or repair" );
+            }
+
+            unsigned lenWPadding = compactAllocationSize( d, recOld, objOld.objsize(),
+                                                          compactOptions );
+            CompactDocWriter writer( objOld, lenWPadding );
+            StatusWith<DiskLoc> status = _recordStore.insertRecord( &writer, 0 );
+            if ( !status.isOK() )
+                return StatusWith<CompactStepStats>( status.getStatus() );
+            const DiskLoc newLoc = status.getValue();
+            verify( !draining.count( DiskLoc( newLoc.a(),
+                                              _recordStore.recordFor( newLoc )->extentOfs() ) ) );
+
+            // same sequence as a moving update: cursors let go of the old location, then the
+            // index entries are repointed, then the old copy is unlinked
+            ClientCursor::invalidateDocument( _ns.ns(), d, L, INVALIDATION_DELETION );
+            _indexCatalog.unindexRecord( objOld, L, true );
+            _indexCatalog.indexRecord( objOld, newLoc );
+            _recordStore.orphanRecord( L );
+
+            stats.recordsMoved++;
+            stats.bytesMoved += objOld.objsize();
+            L = next;
+
+            getDur().commitIfNeeded();
+        }
+
+        if ( e->firstRecord.isNull() ) {
+            log() << "compact freeing extent " << diskloc << " for namespace " << _ns;
+            verify( d->firstExtent() == diskloc );
+            DiskLoc newFirst = e->xnext;
+            d->firstExtent().writing() = newFirst;
+            newFirst.ext()->xprev.writing().Null();
+            getDur().writing(e)->markEmpty();
+            getExtentManager()->freeExtents( diskloc, diskloc );
+            set<DiskLoc> stillDraining = draining;
+            stillDraining.erase( diskloc );
+            _recordStore.setDrainingExtents( stillDraining );
+            stats.extentFreed = true;
+        }
+
+        _infoCache.notifyOfWriteOp();
+        getDur().commitIfNeeded();
+
+        return StatusWith<CompactStepStats>( stats );
+    }
+
+
+    int Collection::abandonCompactSteps( const DiskLoc& stopExtent ) {
+        NamespaceDetails* d = details();
+        const set<DiskLoc> draining = extentsToDrain( d, stopExtent );
+
+        // the space is rebuilt from the records left in the extents below, so none of it may
+        // still be on the lists.  deletes between steps were orphaned, but if the collection
+        // was reloaded since the last step they weren't, so take it all off first.
+        d->orphanDeletedRecordsInExtents( draining );
+        _recordStore.setDrainingExtents( set<DiskLoc>() );
+
+        int n = 0;
+        for ( set<DiskLoc>::const_iterator i = draining.begin(); i != draining.end(); ++i ) {
+            const DiskLoc extentLoc = *i;
+            Extent* e = extentLoc.ext();
+
+            // records in an extent aren't chained in offset order
+            vector< pair<int, int> > records; // offset, lengthWithHeaders
+            for ( DiskLoc L = e->firstRecord; !L.isNull();
+                  L = getExtentManager()->getNextRecordInExtent( L ) ) {
+                records.push_back( make_pair( L.getOfs(), L.rec()->lengthWithHeaders() ) );
+            }
+            std::sort( records.begin(), records.end() );
+
+            const int end = extentLoc.getOfs() + e->length;
+            int ofs = extentLoc.getOfs() + Extent::HeaderSize();
+            for ( size_t j = 0; j <= records.size(); j++ ) {
+                const int holeEnd = j < records.size() ? records[j].first : end;
+                const int len = holeEnd - ofs;
+                // as in allocation, anything smaller is left to its neighbour
+                if ( len >= 24 ) {
+                    DiskLoc holeLoc( extentLoc.a(), ofs );
+                    DeletedRecord* hole = getDur().writing( holeLoc.drec() );
+                    hole->lengthWithHeaders() = len;
+                    hole->extentOfs() = extentLoc.getOfs();
+                    hole->nextDeleted().Null();
+                    d->addDeletedRec( holeLoc.drec(), holeLoc );
+                    n++;
+                }
+                if ( j < records.size() )
+                    ofs = records[j].first + records[j].second;
+            }
+            getDur().commitIfNeeded();
+        }
+
+        _infoCache.notifyOfWriteOp();
+        return n;
+    }
 
 }
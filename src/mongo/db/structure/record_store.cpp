@@ -32,6 +32,7 @@
 
 #include "mongo/db/storage/extent.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/util/compress.h"
 
 
 #include "mongo/db/pdfile.h" // XXX-ERH
@@ -56,7 +57,67 @@ namespace mongo {
         return _extentManager->recordFor( loc );
     }
 
+    namespace {
+        // Smaller documents rarely compress by enough to pay for the header.
+        const int kMinCompressedRecordSize = 128;
+    }
+
+    bool RecordStore::compressRecord( const char* data, int len, std::string* out ) const {
+        if ( len < kMinCompressedRecordSize ||
+             !_details->isUserFlagSet( NamespaceDetails::Flag_CompressRecords ) ||
+             _details->isCapped() ||
+             _isSystemIndexes )
+            return false;
+
+        Record::CompressedHeader header;
+        header.marker = Record::CompressedMarker;
+        header.uncompressedSize = len;
+
+        std::string compressed;
+        header.compressedSize = static_cast<int>( compress( data, len, &compressed ) );
+
+        // not worth a decompression on every read unless it saves an eighth
+        if ( header.storedSize() > len - len / 8 )
+            return false;
+
+        out->reserve( header.storedSize() );
+        out->assign( reinterpret_cast<const char*>( &header ), sizeof(header) );
+        out->append( compressed );
+        return true;
+    }
+
+    int RecordStore::overwriteRecord( const DiskLoc& loc, const char* data, int len ) {
+        Record* r = recordFor( loc );
+        fassert( 17396, r->netLength() >= len );
+
+        int oldSavings = r->compressionSavings();
+        memcpy( getDur().writingPtr( r->data(), len ), data, len );
+        int newSavings = r->compressionSavings();
+
+        if ( newSavings != oldSavings )
+            _details->incrementCompressionSavings( newSavings - oldSavings );
+        return len;
+    }
+
     StatusWith<DiskLoc> RecordStore::insertRecord( const DocWriter* doc, int quotaMax ) {
+        if ( _details->isUserFlagSet( NamespaceDetails::Flag_CompressRecords ) ) {
+            // the writer may pad beyond the document; keep that padding around the compressed
+            // data rather than compressing it
+            std::string buf( doc->documentSize(), '\0' );
+            doc->writeDocument( &buf[0] );
+            int len = *reinterpret_cast<const int*>( buf.data() );
+            int padding = static_cast<int>( buf.size() ) - len;
+
+            std::string compressed;
+            if ( compressRecord( buf.data(), len, &compressed ) ) {
+                int storedLen = static_cast<int>( compressed.size() );
+                int lenWHdr = storedLen + padding + Record::HeaderSize;
+                if ( doc->addPadding() )
+                    lenWHdr = _details->getRecordAllocationSize( lenWHdr );
+                return _insertRecord( compressed.data(), storedLen, len, lenWHdr, quotaMax );
+            }
+        }
+
         int lenWHdr = doc->documentSize() + Record::HeaderSize;
         if ( doc->addPadding() )
             lenWHdr = _details->getRecordAllocationSize( lenWHdr );
@@ -80,9 +141,21 @@ namespace mongo {
 
 
     StatusWith<DiskLoc> RecordStore::insertRecord( const char* data, int len, int quotaMax ) {
+        std::string compressed;
+        int logicalLen = len;
+        if ( compressRecord( data, len, &compressed ) ) {
+            data = compressed.data();
+            len = static_cast<int>( compressed.size() );
+        }
+
         int lenWHdr = _details->getRecordAllocationSize( len + Record::HeaderSize );
         fassert( 17208, lenWHdr >= ( len + Record::HeaderSize ) );
 
+        return _insertRecord( data, len, logicalLen, lenWHdr, quotaMax );
+    }
+
+    StatusWith<DiskLoc> RecordStore::_insertRecord( const char* data, int len, int logicalLen,
+                                                    int lenWHdr, int quotaMax ) {
         StatusWith<DiskLoc> loc = allocRecord( lenWHdr, quotaMax );
         if ( !loc.isOK() )
             return loc;
@@ -97,6 +170,8 @@ namespace mongo {
         addRecordToRecListInExtent(r, loc.getValue()); // XXX move code here from pdfile
 
         _details->incrementStats( r->netLength(), 1 );
+        if ( logicalLen != len )
+            _details->incrementCompressionSavings( logicalLen - len );
 
         return loc;
     }
@@ -144,7 +219,7 @@ namespace mongo {
         return StatusWith<DiskLoc>( ErrorCodes::InternalError, "cannot allocate space" );
     }
 
-    void RecordStore::deleteRecord( const DiskLoc& dl ) {
+    Record* RecordStore::_unlinkRecord( const DiskLoc& dl ) {
 
         Record* todelete = recordFor( dl );
 
@@ -180,10 +255,29 @@ namespace mongo {
             }
         }
 
+        _details->incrementStats( -1 * todelete->netLength(), -1 );
+        if ( int savings = todelete->compressionSavings() )
+            _details->incrementCompressionSavings( -savings );
+
+        return todelete;
+    }
+
+    void RecordStore::orphanRecord( const DiskLoc& dl ) {
+        _unlinkRecord( dl );
+    }
+
+    void RecordStore::deleteRecord( const DiskLoc& dl ) {
+
+        Record* todelete = _unlinkRecord( dl );
+
+        if ( !_drainingExtents.empty() &&
+             _drainingExtents.count( DiskLoc( dl.a(), todelete->extentOfs() ) ) ) {
+            // an online compaction will free this extent, or put the space back if it stops
+            return;
+        }
+
         /* add to the free list */
         {
-            _details->incrementStats( -1 * todelete->netLength(), -1 );
-
             if ( _isSystemIndexes ) {
                 /* temp: if in system.indexes, don't reuse, and zero out: we want to be
                    careful until validated more, as IndexDetails has pointers
@@ -30,6 +30,9 @@
 
 #pragma once
 
+#include <set>
+#include <string>
+
 #include "mongo/db/diskloc.h"
 
 namespace mongo {
@@ -52,18 +55,57 @@ namespace mongo {
 
         void deleteRecord( const DiskLoc& dl );
 
+        /**
+         * Like deleteRecord, but the space is not put on the deleted lists.  Used when the
+         * whole extent holding 'dl' is about to be freed.
+         */
+        void orphanRecord( const DiskLoc& dl );
+
+        /**
+         * While an online compaction drains 'extents', deleteRecord() orphans the records it
+         * deletes from them instead of putting the space back on the deleted lists, so the
+         * lists never have to be searched for it again.  Pass an empty set when done.
+         */
+        void setDrainingExtents( const std::set<DiskLoc>& extents ) { _drainingExtents = extents; }
+        const std::set<DiskLoc>& drainingExtents() const { return _drainingExtents; }
+
         StatusWith<DiskLoc> insertRecord( const char* data, int len, int quotaMax );
 
         StatusWith<DiskLoc> insertRecord( const DocWriter* doc, int quotaMax );
 
+        /**
+         * If the collection compresses records and it pays for this document, sets 'out' to
+         * the data of a compressed record holding the 'len' bytes at 'data'.
+         * @return false, leaving 'out' alone, if the document should be stored as it is
+         */
+        bool compressRecord( const char* data, int len, std::string* out ) const;
+
+        /**
+         * Replaces the data of the record at 'loc' with the 'len' bytes at 'data', which must
+         * fit.  'data' may be compressed, see compressRecord().
+         * @return the number of bytes written
+         */
+        int overwriteRecord( const DiskLoc& loc, const char* data, int len );
+
     protected:
         StatusWith<DiskLoc> allocRecord( int lengthWithHeaders, int quotaMax );
 
     private:
+        /**
+         * stores the 'len' bytes at 'data' in a new record of 'lenWHdr' bytes.  'logicalLen'
+         * is the size of the document they hold, which differs if they are compressed.
+         */
+        StatusWith<DiskLoc> _insertRecord( const char* data, int len, int logicalLen,
+                                           int lenWHdr, int quotaMax );
+
+        /** removes 'dl' from its extent's record chain and from the collection stats */
+        Record* _unlinkRecord( const DiskLoc& dl );
+
         std::string _ns;
         NamespaceDetails* _details;
         ExtentManager* _extentManager;
         bool _isSystemIndexes;
+        std::set<DiskLoc> _drainingExtents;
     };
 
 }
@@ -27,6 +27,7 @@
  */
 
 #include "mongo/base/counter.h"
+#include "mongo/db/admission_control.h"
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/repl/is_master.h"
@@ -113,6 +114,9 @@ namespace mongo {
         // We assume all options have been validated earlier, if not, programming error
         dassert( validateWriteConcern( writeConcern ).isOK() );
 
+        // Waiting on the journal or on secondaries doesn't need an admission ticket
+        AdmissionReleaser releaser;
+
         // Next handle blocking on disk
 
         Timer syncTimer;
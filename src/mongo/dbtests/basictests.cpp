@@ -31,6 +31,8 @@
 
 #include "mongo/pch.h"
 
+#include <boost/thread/thread.hpp>
+
 #include "mongo/db/db.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/util/array.h"
@@ -505,6 +507,47 @@ namespace BasicTests {
         }
     };
 
+    class QueuePushAllTest {
+    public:
+        void run() {
+            BlockingQueue<int> q( 10 );
+            vector<int> batch;
+            for ( int i = 0; i < 5; i++ )
+                batch.push_back( i );
+
+            ASSERT( !q.pushAll( batch ) );
+            ASSERT_EQUALS( 5, q.count() );
+
+            // Bigger than the whole queue: goes in once the queue is empty.
+            q.clear();
+            batch.resize( 20, 7 );
+            ASSERT( !q.pushAll( batch ) );
+            ASSERT_EQUALS( 20, q.count() );
+
+            for ( int i = 0; i < 5; i++ )
+                ASSERT_EQUALS( i, q.blockingPop() );
+            int x;
+            ASSERT( q.tryPop( x ) );
+            ASSERT_EQUALS( 7, x );
+
+            // No room: waits for a consumer, and says so.
+            q.clear();
+            batch.resize( 8 );
+            q.pushAll( batch );
+            boost::thread consumer( boost::bind( &QueuePushAllTest::drainLater, &q ) );
+            batch.resize( 5 );
+            ASSERT( q.pushAll( batch ) );
+            consumer.join();
+            ASSERT_EQUALS( 5, q.count() );
+        }
+    private:
+        static void drainLater( BlockingQueue<int>* q ) {
+            sleepmillis( 100 );
+            for ( int i = 0; i < 8; i++ )
+                q->blockingPop();
+        }
+    };
+
     class StrTests {
     public:
 
@@ -588,6 +631,7 @@ namespace BasicTests {
             add< IsValidUTF8Test >();
 
             add< QueueTest >();
+            add< QueuePushAllTest >();
 
             add< StrTests >();
 
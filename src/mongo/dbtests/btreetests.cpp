@@ -62,4 +62,18 @@ namespace BtreeTests1 {
 #include "mongo/dbtests/btreetests.inl"
 }
 
+#undef BtreeBucket
+#undef btree
+#undef btreemod
+#define BtreeBucket BtreeBucket<V2>
+#define btree btree<V2>
+#define btreemod btreemod<V2>
+#undef testName
+#define testName "btree2"
+#undef BTVERSION
+#define BTVERSION 2
+namespace BtreeTests2 {
+#include "mongo/dbtests/btreetests.inl"
+}
+
 #endif
@@ -28,7 +28,14 @@
 
 #include "mongo/pch.h"
 
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/commands/dbhash.h"
 #include "mongo/db/d_concurrency.h"
+#include "mongo/db/dbhelpers.h"
+#include "mongo/db/index/index_access_method.h"
+#include "mongo/db/ops/delete.h"
+#include "mongo/db/repl/replication_server_status.h"
 #include "mongo/dbtests/dbtests.h"
 
 using namespace mongo;
@@ -96,6 +103,257 @@ namespace CommandTests {
         };
     }
 
+    namespace DBHash {
+        struct Base {
+            Base() {
+                db.dropDatabase(dbname());
+                for ( int i = 0; i < 20000; i++ ) {
+                    db.insert(ns("a"), BSON("_id" << i << "x" << i));
+                    db.insert(ns("b"), BSON("_id" << i << "y" << -i));
+                }
+            }
+            ~Base() {
+                db.dropDatabase(dbname());
+            }
+
+            const char* dbname() { return "unittests_dbhash"; }
+            string ns(const char* coll) { return string(dbname()) + "." + coll; }
+
+            BSONObj dbhash(const BSONObj& options) {
+                BSONObjBuilder cmd;
+                cmd.append("dbhash", 1);
+                cmd.appendElements(options);
+                BSONObj result;
+                ASSERT( db.runCommand(dbname(), cmd.obj(), result) );
+                return result;
+            }
+
+            DBDirectClient db;
+        };
+
+        /** Hashing collections on worker threads gives the same answer as the serial path. */
+        struct ParallelMatchesSerial : Base {
+            void run() {
+                BSONObj serial = dbhash(BSONObj());
+                BSONObj parallel = dbhash(BSON("parallel" << true));
+                ASSERT_EQUALS( serial["md5"].String(), parallel["md5"].String() );
+                ASSERT_EQUALS( serial["collections"].Obj(), parallel["collections"].Obj() );
+
+                BSONObj murmur = dbhash(BSON("hashAlgorithm" << "murmur3" <<
+                                             "parallel" << true));
+                BSONObj serialMurmur = dbhash(BSON("hashAlgorithm" << "murmur3"));
+                ASSERT_EQUALS( murmur["md5"].String(), serialMurmur["md5"].String() );
+                ASSERT_NOT_EQUALS( murmur["md5"].String(), serial["md5"].String() );
+                ASSERT_EQUALS( "murmur3", murmur["hashAlgorithm"].String() );
+            }
+        };
+
+        struct BadAlgorithm : Base {
+            void run() {
+                BSONObj result;
+                ASSERT( !db.runCommand(dbname(), BSON("dbhash" << 1 << "hashAlgorithm" << "sha1"),
+                                       result) );
+            }
+        };
+
+        /**
+         * Repeated incremental hashes only rehash the ranges touched since the last call, and
+         * always agree with a hash computed from nothing.
+         */
+        struct IncrementalReusesRanges : Base {
+            void run() {
+                BSONObj options = BSON("incremental" << true);
+
+                BSONObj first = dbhash(options);
+                ASSERT_EQUALS( 0, first["incremental"]["rangesReused"].numberLong() );
+                long long numRanges = first["incremental"]["rangesRehashed"].numberLong();
+                ASSERT( numRanges > 2 );
+
+                BSONObj again = dbhash(options);
+                ASSERT_EQUALS( first["md5"].String(), again["md5"].String() );
+                ASSERT_EQUALS( 0, again["incremental"]["rangesRehashed"].numberLong() );
+                ASSERT_EQUALS( numRanges, again["incremental"]["rangesReused"].numberLong() );
+
+                db.update(ns("a"), BSON("_id" << 5000), BSON("$set" << BSON("x" << "changed")));
+                db.remove(ns("b"), BSON("_id" << 12345));
+                db.insert(ns("b"), BSON("_id" << 30000));
+
+                BSONObj changed = dbhash(options);
+                ASSERT_NOT_EQUALS( first["md5"].String(), changed["md5"].String() );
+                ASSERT( changed["incremental"]["rangesReused"].numberLong() > 0 );
+                ASSERT( changed["incremental"]["rangesRehashed"].numberLong() < numRanges );
+
+                wipeDbHashCache(dbname());
+                BSONObj fresh = dbhash(options);
+                ASSERT_EQUALS( changed["md5"].String(), fresh["md5"].String() );
+                ASSERT_EQUALS( 0, fresh["incremental"]["rangesReused"].numberLong() );
+            }
+        };
+
+        /** Dropping a collection forgets its ranges. */
+        struct IncrementalDrop : Base {
+            void run() {
+                BSONObj options = BSON("incremental" << true);
+                dbhash(options);
+
+                db.dropCollection(ns("b"));
+                db.insert(ns("b"), BSON("_id" << 1));
+
+                BSONObj result = dbhash(options);
+                wipeDbHashCache(dbname());
+                ASSERT_EQUALS( dbhash(options)["md5"].String(), result["md5"].String() );
+            }
+        };
+
+        /** Writes that skip logOp still mark their ranges for a rehash. */
+        struct IncrementalUnloggedWrites : Base {
+            void run() {
+                BSONObj options = BSON("incremental" << true);
+                BSONObj first = dbhash(options);
+
+                {
+                    Client::WriteContext ctx(ns("a"));
+                    deleteObjects(ns("a"), BSON("_id" << 7), true, false /*logop*/);
+                }
+                {
+                    Client::WriteContext ctx(ns("b"));
+                    Helpers::putSingletonGod(ns("b").c_str(), BSON("y" << "changed"),
+                                             false /*logTheOp*/);
+                }
+
+                BSONObj changed = dbhash(options);
+                ASSERT_NOT_EQUALS( first["md5"].String(), changed["md5"].String() );
+                ASSERT( changed["incremental"]["rangesReused"].numberLong() > 0 );
+
+                wipeDbHashCache(dbname());
+                ASSERT_EQUALS( dbhash(options)["md5"].String(), changed["md5"].String() );
+            }
+        };
+    }
+
+    namespace Validate {
+        struct Base {
+            Base() {
+                db.dropCollection(ns());
+                db.ensureIndex(ns(), BSON("a" << 1));
+                db.ensureIndex(ns(), BSON("tags" << 1));
+                db.insert("unittests.system.indexes",
+                          BSON("ns" << ns() << "key" << BSON("b" << -1) << "name" << "b_partial" <<
+                               "partialFilterExpression" << BSON("b" << GT << 5)));
+                for ( int i = 0; i < 20000; i++ ) {
+                    db.insert(ns(), BSON("_id" << i << "a" << i % 100 << "b" << i % 10 <<
+                                         "tags" << BSON_ARRAY(i << i + 1) <<
+                                         "pad" << string(100, 'x')));
+                }
+            }
+            ~Base() {
+                db.dropCollection(ns());
+            }
+
+            const char* ns() { return "unittests.validate"; }
+
+            BSONObj validate() {
+                BSONObj result;
+                db.runCommand("unittests", BSON("validate" << "validate" << "full" << true),
+                              result);
+                return result;
+            }
+
+            DBDirectClient db;
+        };
+
+        /** The extent scans add up to the whole collection and agree with every index. */
+        struct Full : Base {
+            void run() {
+                BSONObj result = validate();
+                ASSERT( result["valid"].trueValue() );
+                ASSERT_EQUALS( 0, result["errors"].Obj().nFields() );
+                ASSERT( result["extentCount"].numberInt() > 1 );
+                ASSERT_EQUALS( 20000, result["objectsFound"].numberLong() );
+                ASSERT_EQUALS( 40000,
+                               result["keysPerIndex"]["unittests.validate.$tags_1"].numberLong() );
+                ASSERT_EQUALS( 8000,
+                               result["keysPerIndex"]["unittests.validate.$b_partial"].numberLong() );
+            }
+        };
+
+        /** An index missing the entry for one document fails the cross check. */
+        struct MissingIndexEntry : Base {
+            void run() {
+                {
+                    Client::WriteContext ctx(ns());
+                    Collection* collection = ctx.ctx().db()->getCollection(ns());
+                    IndexCatalog* catalog = collection->getIndexCatalog();
+                    IndexDescriptor* descriptor = catalog->findIndexByKeyPattern(BSON("a" << 1));
+                    ASSERT( descriptor );
+
+                    DiskLoc loc = Helpers::findOne(ns(), BSON("_id" << 1234), true);
+                    ASSERT( !loc.isNull() );
+                    int64_t numDeleted = 0;
+                    ASSERT_OK( catalog->getIndex(descriptor)->remove(collection->docFor(loc), loc,
+                                                                     InsertDeleteOptions(),
+                                                                     &numDeleted) );
+                    ASSERT_EQUALS( 1, numDeleted );
+                }
+
+                BSONObj result = validate();
+                ASSERT( !result["valid"].trueValue() );
+                ASSERT_EQUALS( 1, result["errors"].Obj().nFields() );
+            }
+        };
+
+        /** A key too large to index is left out, and that alone only earns a warning. */
+        struct KeyTooLarge : Base {
+            void run() {
+                {
+                    Client::WriteContext ctx(ns());
+                    Collection* collection = ctx.ctx().db()->getCollection(ns());
+
+                    // Only a primary refuses the document; anyone else indexes what fits.
+                    replSettings.slave = SimpleSlave;
+                    StatusWith<DiskLoc> loc = collection->insertDocument(
+                        BSON("_id" << -1 << "a" << string(2000, 'a') << "b" << 1), false);
+                    replSettings.slave = NotSlave;
+                    ASSERT_OK( loc.getStatus() );
+                }
+
+                BSONObj result = validate();
+                ASSERT( result["valid"].trueValue() );
+                ASSERT_EQUALS( 0, result["errors"].Obj().nFields() );
+                ASSERT_EQUALS( 1, result["warnings"].Obj().nFields() );
+            }
+        };
+    }
+
+    namespace ServerStatus {
+        /** opcounters are numbers, and go up with the operations they count. */
+        struct OpCounters {
+            void run() {
+                DBDirectClient db;
+                BSONObj before = opcounters(db);
+                const char* fields[] = { "insert", "query", "update", "delete", "getmore",
+                                         "command" };
+                for ( size_t i = 0; i < sizeof( fields ) / sizeof( fields[0] ); i++ ) {
+                    ASSERT( before[fields[i]].isNumber() );
+                }
+
+                db.insert("unittests.opcounters", BSON("_id" << 1));
+                db.findOne("unittests.opcounters", BSONObj());
+                BSONObj after = opcounters(db);
+                ASSERT( after["insert"].numberLong() > before["insert"].numberLong() );
+                ASSERT( after["query"].numberLong() > before["query"].numberLong() );
+                ASSERT( after["command"].numberLong() > before["command"].numberLong() );
+                db.dropCollection("unittests.opcounters");
+            }
+
+            BSONObj opcounters(DBDirectClient& db) {
+                BSONObj result;
+                ASSERT( db.runCommand("admin", BSON("serverStatus" << 1), result) );
+                return result["opcounters"].Obj().getOwned();
+            }
+        };
+    }
+
     class All : public Suite {
     public:
         All() : Suite( "commands" ) {
@@ -104,6 +362,15 @@ namespace CommandTests {
         void setupTests() {
             add< FileMD5::Type0 >();
             add< FileMD5::Type2 >();
+            add< DBHash::ParallelMatchesSerial >();
+            add< DBHash::BadAlgorithm >();
+            add< DBHash::IncrementalReusesRanges >();
+            add< DBHash::IncrementalDrop >();
+            add< DBHash::IncrementalUnloggedWrites >();
+            add< Validate::Full >();
+            add< Validate::MissingIndexEntry >();
+            add< Validate::KeyTooLarge >();
+            add< ServerStatus::OpCounters >();
         }
 
     } all;
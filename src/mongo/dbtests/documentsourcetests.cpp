@@ -38,6 +38,7 @@
 #include "mongo/db/query/get_runner.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/dbtests/dbtests.h"
+#include "mongo/util/block_arena.h"
 
 namespace DocumentSourceTests {
 
@@ -1873,6 +1874,87 @@ namespace DocumentSourceTests {
         };
     } // namespace DocumentSourceMatch
 
+    namespace ArenaAllocation {
+
+        using mongo::DocumentSourceGroup;
+        using mongo::DocumentSourceProject;
+
+        /**
+         * Runs the same $project/$group with and without a BlockArena installed, checks that
+         * the results match and logs heap allocations and ns per input document for both.
+         */
+        class ProjectGroup : public DocumentSourceCursor::Base {
+        public:
+            void run() {
+                for (int i = 0; i < nDocs; ++i) {
+                    client.insert(ns, BSON("_id" << i
+                                           << "tenant" << (i % 50)
+                                           << "user" << BSON("name" << "user" << "id" << i)
+                                           << "tags" << BSON_ARRAY("x" << "y" << "z")
+                                           << "n" << i * 1.5));
+                }
+
+                long long heapMicros;
+                const BSONObj heapResults = runPipeline(&heapMicros);
+
+                BlockArena arena;
+                long long arenaMicros;
+                BSONObj arenaResults;
+                {
+                    BlockArena::Scope arenaScope(&arena);
+                    arenaResults = runPipeline(&arenaMicros);
+                }
+
+                ASSERT_EQUALS(heapResults, arenaResults);
+                ASSERT_GREATER_THAN(arena.stats().allocations, nDocs);
+
+                // Without an arena every allocate() the arena served would have been a malloc.
+                const BlockArena::Stats& stats = arena.stats();
+                unittest::log() << "$project/$group over " << nDocs << " documents:";
+                unittest::log() << "  heap:  " << stats.allocations << " allocations, "
+                                << heapMicros * 1000 / nDocs << " ns/doc";
+                unittest::log() << "  arena: "
+                                << stats.blocksAllocated + stats.largeAllocations
+                                << " allocations (" << stats.blocksReused << " block reuses), "
+                                << arenaMicros * 1000 / nDocs << " ns/doc";
+            }
+
+        private:
+            static const int nDocs = 20000;
+
+            BSONObj runPipeline(long long* micros) {
+                createSource();
+
+                BSONObj projectSpec = fromjson("{$project: {tenant: 1, name: '$user.name',"
+                                                          " tags: 1, total: {$add: ['$n', 1]}}}");
+                intrusive_ptr<DocumentSource> project =
+                        DocumentSourceProject::createFromBson(projectSpec.firstElement(), ctx());
+                project->setSource(source());
+
+                BSONObj groupSpec = fromjson("{$group: {_id: '$tenant', total: {$sum: '$total'},"
+                                                        " names: {$addToSet: '$name'}}}");
+                intrusive_ptr<DocumentSource> group =
+                        DocumentSourceGroup::createFromBson(groupSpec.firstElement(), ctx());
+                group->setSource(project.get());
+
+                // Group output order is unspecified, so collect results in sorted order.
+                BSONObjSet results;
+                Timer t;
+                while (boost::optional<Document> next = group->getNext()) {
+                    results.insert(next->toBson());
+                }
+                *micros = t.micros();
+
+                BSONArrayBuilder out;
+                for (BSONObjSet::const_iterator it = results.begin(); it != results.end(); ++it) {
+                    out.append(*it);
+                }
+                return out.arr();
+            }
+        };
+
+    } // namespace ArenaAllocation
+
     class All : public Suite {
     public:
         All() : Suite( "documentsource" ) {
@@ -1979,6 +2061,8 @@ namespace DocumentSourceTests {
 
             add<DocumentSourceMatch::RedactSafePortion>();
             add<DocumentSourceMatch::Coalesce>();
+
+            add<ArenaAllocation::ProjectGroup>();
         }
     } myall;
 
@@ -126,6 +126,26 @@ namespace DocumentTests {
             }
         };
 
+        /** Get Document values by name with a precomputed hash. */
+        class GetValueWithHash {
+        public:
+            void run() {
+                // Small enough to be scanned linearly.
+                Document small = fromBson( BSON( "a" << 1 << "b" << 2 ) );
+                // Large enough to use the hash table.
+                Document large = fromBson( BSON( "a" << 1 << "b" << 2 << "c" << 3 << "d" << 4
+                                                 << "e" << 5 << "f" << 6 << "g" << 7 ) );
+                const char* names[] = { "a", "b", "c", "d", "e", "f", "g", "h", "" };
+                for ( size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i ) {
+                    const unsigned hash = DocumentStorage::hashKey( names[i] );
+                    ASSERT_EQUALS( small[names[i]], small.getField( names[i], hash ) );
+                    ASSERT_EQUALS( large[names[i]], large.getField( names[i], hash ) );
+                }
+                ASSERT( large.getField( "h", DocumentStorage::hashKey( "h" ) ).missing() );
+                ASSERT_EQUALS( 7, large.getField( "g", DocumentStorage::hashKey( "g" ) ).getInt() );
+            }
+        };
+
         /** Get Document fields. */
         class SetField {
         public:
@@ -1419,6 +1439,7 @@ namespace DocumentTests {
             add<Document::CreateFromBsonObj>();
             add<Document::AddField>();
             add<Document::GetValue>();
+            add<Document::GetValueWithHash>();
             add<Document::SetField>();
             add<Document::Compare>();
             add<Document::CompareNamedNull>();
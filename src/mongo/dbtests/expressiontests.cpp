@@ -32,6 +32,7 @@
 
 #include "mongo/db/pipeline/document.h"
 #include "mongo/db/pipeline/expression.h"
+#include "mongo/db/pipeline/expression_program.h"
 #include "mongo/dbtests/dbtests.h"
 
 namespace ExpressionTests {
@@ -878,6 +879,236 @@ namespace ExpressionTests {
         };
         
     } // namespace Compare
+
+    namespace Compiled {
+
+        static intrusive_ptr<Expression> parse( const BSONObj& spec ) {
+            BSONObj specObject = BSON( "" << spec );
+            VariablesIdGenerator idGenerator;
+            VariablesParseState vps( &idGenerator );
+            return Expression::parseOperand( specObject.firstElement(), vps );
+        }
+
+        /** The result of evaluating 'expression' on 'doc', or the code of the error it raised. */
+        static BSONObj evaluateOrError( const intrusive_ptr<Expression>& expression,
+                                        const Document& doc ) {
+            try {
+                return toBson( expression->evaluate( doc ) );
+            }
+            catch ( const UserException& e ) {
+                return BSON( "error" << e.getCode() );
+            }
+        }
+
+        static vector<Document> documents() {
+            vector<Document> docs;
+            docs.push_back( fromBson( BSON( "a" << 1 << "b" << 2 << "z" << 0 << "s" << "str"
+                                            << "n" << BSONNULL << "d" << Date_t( 1000 ) ) ) );
+            docs.push_back( fromBson( BSON( "a" << 5 << "b" << 2.5 << "z" << 1 << "s" << "t"
+                                            << "n" << BSONNULL << "d" << Date_t( 5000 )
+                                            << "arr" << BSON_ARRAY( BSON( "x" << 1 ) ) ) ) );
+            docs.push_back( fromBson( BSON( "a" << 3LL << "b" << -1 << "z" << true ) ) );
+            docs.push_back( fromBson( BSONObj() ) );
+            return docs;
+        }
+
+        /**
+         * Every spec evaluates to the same value, or fails with the same error, compiled as it
+         * does as a tree, optimized or not.
+         */
+        class SameResults {
+        public:
+            void run() {
+                const vector<Document> docs = documents();
+                vector<BSONObj> specs;
+                specs.push_back( fromjson( "{$add:['$a','$b',1]}" ) );
+                specs.push_back( fromjson( "{$add:['$a',{$multiply:['$b',2]}]}" ) );
+                specs.push_back( fromjson( "{$add:['$d','$a']}" ) );
+                specs.push_back( fromjson( "{$add:['$d','$d']}" ) );
+                specs.push_back( fromjson( "{$add:['$a','$s']}" ) );
+                // a nullish operand makes $add null without evaluating the operands after it
+                specs.push_back( fromjson( "{$add:['$n',{$add:['$s',1]}]}" ) );
+                specs.push_back( fromjson( "{$add:['$a',{$add:['$n','$s']},{$add:['$s',1]}]}" ) );
+                specs.push_back( fromjson( "{$multiply:['$a','$b']}" ) );
+                specs.push_back( fromjson( "{$multiply:['$missing',{$multiply:['$s',1]}]}" ) );
+                specs.push_back( fromjson( "{$multiply:['$arr.x',1]}" ) );
+                specs.push_back( fromjson( "{$subtract:['$a','$b']}" ) );
+                specs.push_back( fromjson( "{$subtract:['$d','$a']}" ) );
+                specs.push_back( fromjson( "{$subtract:['$d','$d']}" ) );
+                specs.push_back( fromjson( "{$subtract:['$a','$s']}" ) );
+                specs.push_back( fromjson( "{$cmp:['$a','$b']}" ) );
+                specs.push_back( fromjson( "{$gte:[{$add:['$a',1]},'$b']}" ) );
+                specs.push_back( fromjson( "{$ne:['$a',{$const:5}]}" ) );
+                specs.push_back( fromjson( "{$cond:[{$gt:['$a',2]},'$b',{$subtract:['$a','$b']}]}" ) );
+                specs.push_back( fromjson( "{$cond:['$z',{$add:['$s',1]},'$a']}" ) );
+                specs.push_back( fromjson( "{$cond:[{$not:['$z']},{$concat:['$s','x']},'$a']}" ) );
+                specs.push_back( fromjson( "{$and:[]}" ) );
+                specs.push_back( fromjson( "{$and:['$a',{$lt:['$b',5]}]}" ) );
+                specs.push_back( fromjson( "{$and:['$z',{$add:['$s',1]}]}" ) );
+                specs.push_back( fromjson( "{$or:[]}" ) );
+                specs.push_back( fromjson( "{$or:['$z',{$eq:['$a',5]}]}" ) );
+                specs.push_back( fromjson( "{$or:['$a',{$add:['$s',1]}]}" ) );
+                specs.push_back( fromjson( "{$not:[{$or:['$z','$missing']}]}" ) );
+                // deeper than the program's stacks allow, so left as a tree unless optimized
+                specs.push_back( fromjson( "{$add:[1,{$add:[2,{$add:[3,{$multiply:['$a',"
+                                           "{$multiply:['$b',{$multiply:['$a',2]}]}]}]}]}]}" ) );
+
+                for ( size_t i = 0; i < specs.size(); ++i ) {
+                    intrusive_ptr<Expression> tree = parse( specs[i] );
+                    intrusive_ptr<Expression> compiled = ExpressionProgram::compile( parse( specs[i] ) );
+                    intrusive_ptr<Expression> optimized =
+                            ExpressionProgram::compile( parse( specs[i] )->optimize() );
+
+                    ASSERT_EQUALS( expressionToBson( tree ), expressionToBson( compiled ) );
+                    for ( size_t j = 0; j < docs.size(); ++j ) {
+                        const BSONObj expected = evaluateOrError( tree, docs[j] );
+                        assertBinaryEqual( expected, evaluateOrError( compiled, docs[j] ) );
+                        assertBinaryEqual( expected, evaluateOrError( optimized, docs[j] ) );
+                    }
+                }
+            }
+        };
+
+        /** Operators with compile() overrides are laid out inline, in a single program. */
+        class CompilesOperands {
+        public:
+            void run() {
+                intrusive_ptr<Expression> expression = ExpressionProgram::compile(
+                        parse( fromjson( "{$cond:[{$gt:['$a',2]},'$b',"
+                                         "{$subtract:['$a',{$multiply:['$b',2]}]}]}" ) ) );
+                ExpressionCompiled* compiled = dynamic_cast<ExpressionCompiled*>( expression.get() );
+                ASSERT( compiled );
+                // a 2 $gt, jump-if-false, b, jump, a, begin, b *, 2 *, end, $subtract
+                ASSERT_EQUALS( 14U, compiled->getProgram().size() );
+                assertBinaryEqual( BSON( "" << 2 ), toBson( expression->evaluate(
+                        fromBson( BSON( "a" << 3 << "b" << 2 ) ) ) ) );
+                assertBinaryEqual( BSON( "" << -3 ), toBson( expression->evaluate(
+                        fromBson( BSON( "a" << 1 << "b" << 2 ) ) ) ) );
+            }
+        };
+
+        /** Expressions compiling to one instruction, or too deep for the stacks, stay trees. */
+        class LeftUncompiled {
+        public:
+            void run() {
+                intrusive_ptr<Expression> fieldPath = ExpressionFieldPath::create( "a" );
+                ASSERT( ExpressionProgram::compile( fieldPath ) == fieldPath );
+
+                intrusive_ptr<Expression> concat = parse( fromjson( "{$concat:['$s','$s']}" ) );
+                ASSERT( ExpressionProgram::compile( concat ) == concat );
+
+                intrusive_ptr<Expression> deep = parse( fromjson(
+                        "{$add:[1,{$add:[2,{$add:[3,'$a']}]}]}" ) );
+                ASSERT( ExpressionProgram::compile( deep ) == deep );
+
+                intrusive_ptr<Expression> compiled =
+                        ExpressionProgram::compile( parse( fromjson( "{$add:['$a',1]}" ) ) );
+                ASSERT( ExpressionProgram::compile( compiled ) == compiled );
+            }
+        };
+
+        static intrusive_ptr<ExpressionObject> parseProjection( const BSONObj& spec ) {
+            Expression::ObjectCtx objectCtx( Expression::ObjectCtx::DOCUMENT_OK
+                                             | Expression::ObjectCtx::TOP_LEVEL
+                                             | Expression::ObjectCtx::INCLUSION_OK );
+            VariablesIdGenerator idGenerator;
+            VariablesParseState vps( &idGenerator );
+            return dynamic_pointer_cast<ExpressionObject>(
+                    Expression::parseObject( spec, &objectCtx, vps ) );
+        }
+
+        /**
+         * Fields of an ExpressionObject are compiled in place, and nested objects stay
+         * ExpressionObjects so they still merge into the matching input subdocuments.
+         */
+        class ObjectFields {
+        public:
+            void run() {
+                BSONObj spec = fromjson( "{sum:{$add:['$a','$b']},"
+                                         "sub:{keep:true,prod:{$multiply:['$a','$b']}}}" );
+                intrusive_ptr<ExpressionObject> tree = parseProjection( spec );
+                intrusive_ptr<ExpressionObject> compiled = parseProjection( spec );
+                ASSERT( tree );
+                ASSERT( compiled );
+                ASSERT( ExpressionProgram::compile( compiled ) == compiled );
+
+                Document doc = fromBson( BSON( "a" << 2 << "b" << 3 << "sub" << BSON(
+                        "keep" << 1 << "drop" << 2 ) ) );
+                Variables treeVars( 0, doc );
+                Variables compiledVars( 0, doc );
+                MutableDocument treeOut;
+                tree->addToDocument( treeOut, doc, &treeVars );
+                MutableDocument compiledOut;
+                compiled->addToDocument( compiledOut, doc, &compiledVars );
+                const Document out = compiledOut.freeze();
+                assertBinaryEqual( toBson( treeOut.freeze() ), toBson( out ) );
+                ASSERT_EQUALS( 5, out["sum"].getInt() );
+                ASSERT_EQUALS( 6, out["sub"].getDocument()["prod"].getInt() );
+                ASSERT_EQUALS( 1, out["sub"].getDocument()["keep"].getInt() );
+                ASSERT( out["sub"].getDocument()["drop"].missing() );
+                ASSERT_EQUALS( expressionToBson( tree ), expressionToBson( compiled ) );
+            }
+        };
+
+        /**
+         * Evaluates $project style computed fields over many documents as expression trees
+         * (before) and as compiled programs (after).
+         */
+        class Benchmark {
+        public:
+            void run() {
+                const int nDocs = 1000;
+                const int nPasses = 100;
+
+                vector<Document> docs;
+                for ( int i = 0; i < nDocs; ++i ) {
+                    docs.push_back( fromBson( BSON( "_id" << i << "price" << ( i % 97 )
+                                                    << "qty" << ( i % 7 ) << "discount" << 0.5
+                                                    << "tax" << ( i % 3 ) << "kind" << "x" ) ) );
+                }
+
+                vector<BSONObj> specs;
+                specs.push_back( fromjson( "{$subtract:[{$multiply:['$price','$qty']},"
+                                           "{$multiply:['$price','$discount']}]}" ) );
+                specs.push_back( fromjson( "{$cond:[{$and:[{$gt:['$qty',3]},"
+                                           "{$lt:['$price',50]}]},'$tax',{$add:['$tax',1]}]}" ) );
+                specs.push_back( fromjson( "{$add:['$price','$qty','$tax',1]}" ) );
+
+                for ( size_t s = 0; s < specs.size(); ++s ) {
+                    intrusive_ptr<Expression> tree = parse( specs[s] )->optimize();
+                    intrusive_ptr<Expression> compiled =
+                            ExpressionProgram::compile( parse( specs[s] )->optimize() );
+                    ASSERT( dynamic_cast<ExpressionCompiled*>( compiled.get() ) );
+
+                    double beforeSum = 0;
+                    Timer beforeTimer;
+                    for ( int pass = 0; pass < nPasses; ++pass ) {
+                        for ( int i = 0; i < nDocs; ++i ) {
+                            beforeSum += tree->evaluate( docs[i] ).coerceToDouble();
+                        }
+                    }
+                    const long long beforeMicros = beforeTimer.micros();
+
+                    double afterSum = 0;
+                    Timer afterTimer;
+                    for ( int pass = 0; pass < nPasses; ++pass ) {
+                        for ( int i = 0; i < nDocs; ++i ) {
+                            afterSum += compiled->evaluate( docs[i] ).coerceToDouble();
+                        }
+                    }
+                    const long long afterMicros = afterTimer.micros();
+
+                    ASSERT_EQUALS( beforeSum, afterSum );
+
+                    const long long nEvals = static_cast<long long>( nDocs ) * nPasses;
+                    unittest::log() << specs[s] << " over " << nEvals << " documents: "
+                                    << beforeMicros * 1000 / nEvals << " ns/doc before (tree), "
+                                    << afterMicros * 1000 / nEvals << " ns/doc after (compiled)";
+                }
+            }
+        };
+
+    } // namespace Compiled
     
     namespace Constant {
 
@@ -1169,6 +1400,108 @@ namespace ExpressionTests {
             }
         };
 
+        /** Nested field lookups in documents large enough to use their field hash table. */
+        class NestedInWideDocuments {
+        public:
+            void run() {
+                intrusive_ptr<Expression> expression = ExpressionFieldPath::create( "e.f" );
+                BSONObj inner = BSON( "a" << 1 << "b" << 2 << "c" << 3 << "d" << 4 << "f" << 5 );
+                BSONObj outer = BSON( "a" << 1 << "b" << 2 << "c" << 3 << "d" << 4 << "e" << inner );
+                assertBinaryEqual( fromjson( "{'':5}" ),
+                                   toBson( expression->evaluate( fromBson( outer ) ) ) );
+
+                intrusive_ptr<Expression> missing = ExpressionFieldPath::create( "e.g" );
+                assertBinaryEqual( fromjson( "{}" ),
+                                   toBson( missing->evaluate( fromBson( outer ) ) ) );
+            }
+        };
+
+        /**
+         * How ExpressionFieldPath walked a path before it resolved the field name hashes at parse
+         * time: every level looks its field up by name, hashing the name again for each document.
+         */
+        static Value evaluatePathByName( const mongo::FieldPath& path, size_t index,
+                                         const Document& input ) {
+            const Value val = input[ path.getFieldName( index ) ];
+            if ( index == path.getPathLength() - 1 )
+                return val;
+
+            switch ( val.getType() ) {
+            case mongo::Object:
+                return evaluatePathByName( path, index + 1, val.getDocument() );
+            case mongo::Array: {
+                vector<Value> result;
+                const vector<Value>& array = val.getArray();
+                for ( size_t i = 0; i < array.size(); i++ ) {
+                    if ( array[i].getType() != mongo::Object )
+                        continue;
+                    const Value nested =
+                            evaluatePathByName( path, index + 1, array[i].getDocument() );
+                    if ( !nested.missing() )
+                        result.push_back( nested );
+                }
+                return Value::consume( result );
+            }
+            default:
+                return Value();
+            }
+        }
+
+        /**
+         * Evaluates a nested field path over many documents both the old way (evaluatePathByName)
+         * and with ExpressionFieldPath's resolved hashes.  The documents are wide enough at both
+         * levels that DocumentStorage uses its hash table, so the difference is the name hashing.
+         */
+        class Benchmark {
+        public:
+            void run() {
+                const int nDocs = 1000;
+                const int nPasses = 200;
+
+                vector<Document> docs;
+                for ( int i = 0; i < nDocs; ++i ) {
+                    BSONObj user = BSON( "first" << "a" << "last" << "b" << "age" << i
+                                         << "city" << "c" << "tenant" << ( i % 10 ) );
+                    docs.push_back( fromBson( BSON( "_id" << i << "ts" << i << "kind" << "x"
+                                                    << "size" << i << "user" << user ) ) );
+                }
+
+                const mongo::FieldPath path( "CURRENT.user.tenant" );
+                intrusive_ptr<Expression> expression =
+                        ExpressionFieldPath::create( "user.tenant" );
+
+                for ( int i = 0; i < nDocs; ++i ) {
+                    assertBinaryEqual( toBson( evaluatePathByName( path, 1, docs[i] ) ),
+                                       toBson( expression->evaluate( docs[i] ) ) );
+                }
+
+                long long beforeSum = 0;
+                Timer beforeTimer;
+                for ( int pass = 0; pass < nPasses; ++pass ) {
+                    for ( int i = 0; i < nDocs; ++i ) {
+                        beforeSum += evaluatePathByName( path, 1, docs[i] ).getInt();
+                    }
+                }
+                const long long beforeMicros = beforeTimer.micros();
+
+                long long afterSum = 0;
+                Timer afterTimer;
+                for ( int pass = 0; pass < nPasses; ++pass ) {
+                    for ( int i = 0; i < nDocs; ++i ) {
+                        afterSum += expression->evaluate( docs[i] ).getInt();
+                    }
+                }
+                const long long afterMicros = afterTimer.micros();
+
+                ASSERT_EQUALS( beforeSum, afterSum );
+
+                const long long nEvals = static_cast<long long>( nDocs ) * nPasses;
+                unittest::log() << "$user.tenant over " << nEvals << " documents: "
+                                << beforeMicros * 1000 / nEvals << " ns/doc before (by name), "
+                                << afterMicros * 1000 / nEvals << " ns/doc after (resolved hashes)";
+            }
+        };
+
         /** Add to a BSONObj. */
         class AddToBsonObj {
         public:
@@ -3525,6 +3858,12 @@ namespace ExpressionTests {
             add<Compare::OptimizeGte>();
             add<Compare::OptimizeGteReverse>();
 
+            add<Compiled::SameResults>();
+            add<Compiled::CompilesOperands>();
+            add<Compiled::LeftUncompiled>();
+            add<Compiled::ObjectFields>();
+            add<Compiled::Benchmark>();
+
             add<Constant::Create>();
             add<Constant::CreateFromBsonElement>();
             add<Constant::Optimize>();
@@ -3551,6 +3890,8 @@ namespace ExpressionTests {
             add<FieldPath::NestedWithinArray>();
             add<FieldPath::MultipleArrayValues>();
             add<FieldPath::ExpandNestedArrays>();
+            add<FieldPath::NestedInWideDocuments>();
+            add<FieldPath::Benchmark>();
             add<FieldPath::AddToBsonObj>();
             add<FieldPath::AddToBsonArray>();
 
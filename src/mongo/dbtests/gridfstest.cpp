@@ -32,9 +32,14 @@
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/util/assert_util.h"
 
+using mongo::BSONObj;
 using mongo::DBDirectClient;
+using mongo::GridFile;
+using mongo::GridFileBuilder;
 using mongo::GridFS;
 using mongo::MsgAssertionException;
+using mongo::UserException;
+using mongo::gridfs_offset;
 
 namespace {
     DBDirectClient _client;
@@ -53,6 +58,143 @@ namespace {
         virtual ~SetChunkSizeTest() {}
     };
 
+    class SetPipelineDepthTest {
+    public:
+        virtual void run() {
+            GridFS grid( _client, "gridtest" );
+            grid.setPipelineDepth( 3 );
+
+            ASSERT_EQUALS( 3U, grid.getPipelineDepth() );
+            ASSERT_THROWS( grid.setPipelineDepth( 0 ), MsgAssertionException );
+            ASSERT_EQUALS( 3U, grid.getPipelineDepth() );
+        }
+
+        virtual ~SetPipelineDepthTest() {}
+    };
+
+    /** Base for tests storing a file of 'size' bytes in 5 byte chunks, 3 chunks per batch. */
+    class StoredFileBase {
+    public:
+        StoredFileBase() : _grid( _client, "gridtest" ) {
+            _client.dropCollection( "gridtest.fs.files" );
+            _client.dropCollection( "gridtest.fs.chunks" );
+            _grid.setChunkSize( 5 );
+            _grid.setPipelineDepth( 3 );
+        }
+
+        virtual ~StoredFileBase() {}
+
+    protected:
+        static std::string contents( size_t size ) {
+            std::string data;
+            for ( size_t i = 0; i < size; i++ )
+                data += char( 'a' + i % 26 );
+            return data;
+        }
+
+        std::string readRange( const GridFile& file, gridfs_offset offset,
+                               gridfs_offset length ) {
+            std::ostringstream out;
+            gridfs_offset written = file.writeRange( out, offset, length );
+            ASSERT_EQUALS( written, out.str().size() );
+            return out.str();
+        }
+
+        GridFS _grid;
+    };
+
+    class StoreAndReadBack : public StoredFileBase {
+    public:
+        void run() {
+            const std::string data = contents( 23 );
+            BSONObj fileObj = _grid.storeFile( data.c_str(), data.size(), "letters" );
+
+            GridFile file = _grid.findFile( "letters" );
+            ASSERT( file.exists() );
+            ASSERT_EQUALS( 23U, file.getContentLength() );
+            ASSERT_EQUALS( 5, file.getNumChunks() );
+            ASSERT_EQUALS( 5U, _client.count( "gridtest.fs.chunks" ) );
+
+            std::ostringstream out;
+            ASSERT_EQUALS( 23U, file.write( out ) );
+            ASSERT_EQUALS( data, out.str() );
+
+            // The MD5 computed while storing matches what the server computes.
+            BSONObj res;
+            ASSERT( _client.runCommand( "gridtest",
+                                        BSON( "filemd5" << fileObj["_id"] << "root" << "fs" ),
+                                        res ) );
+            ASSERT_EQUALS( res["md5"].str(), file.getMD5() );
+        }
+    };
+
+    class BuilderSplitsUnalignedAppends : public StoredFileBase {
+    public:
+        void run() {
+            const std::string data = contents( 41 );
+            GridFileBuilder builder( &_grid );
+            size_t pos = 0;
+            for ( size_t piece = 1; pos < data.size(); piece++ ) {
+                size_t len = std::min( piece, data.size() - pos );
+                builder.appendChunk( data.c_str() + pos, len );
+                pos += len;
+            }
+            BSONObj fileObj = builder.buildFile( "pieces", "text/plain" );
+            ASSERT_THROWS( builder.appendChunk( "x", 1 ), UserException );
+
+            GridFile file = _grid.findFile( "pieces" );
+            ASSERT_EQUALS( "text/plain", file.getContentType() );
+            ASSERT_EQUALS( data, readRange( file, 0, 41 ) );
+            ASSERT_EQUALS( fileObj["md5"].str(), file.getMD5() );
+        }
+    };
+
+    class RangeReads : public StoredFileBase {
+    public:
+        void run() {
+            const std::string data = contents( 23 );
+            _grid.storeFile( data.c_str(), data.size(), "letters" );
+            GridFile file = _grid.findFile( "letters" );
+
+            ASSERT_EQUALS( data.substr( 0, 5 ), readRange( file, 0, 5 ) );
+            ASSERT_EQUALS( data.substr( 3, 4 ), readRange( file, 3, 4 ) );
+            ASSERT_EQUALS( data.substr( 4, 12 ), readRange( file, 4, 12 ) );
+            ASSERT_EQUALS( data.substr( 20 ), readRange( file, 20, 100 ) );
+            ASSERT_EQUALS( "", readRange( file, 23, 1 ) );
+            ASSERT_EQUALS( "", readRange( file, 7, 0 ) );
+        }
+    };
+
+    class RangeReadMissingChunk : public StoredFileBase {
+    public:
+        void run() {
+            const std::string data = contents( 23 );
+            BSONObj fileObj = _grid.storeFile( data.c_str(), data.size(), "letters" );
+            _client.remove( "gridtest.fs.chunks",
+                            BSON( "files_id" << fileObj["_id"] << "n" << 2 ) );
+            GridFile file = _grid.findFile( "letters" );
+
+            ASSERT_EQUALS( data.substr( 0, 10 ), readRange( file, 0, 10 ) );
+            std::ostringstream out;
+            ASSERT_THROWS( file.writeRange( out, 8, 5 ), UserException );
+        }
+    };
+
+    /** A batch that fails is reported even when later batches succeed. */
+    class EarlyBatchFailure : public StoredFileBase {
+    public:
+        void run() {
+            // The file's second chunk, in the first of its three batches, collides with this.
+            _client.ensureIndex( "gridtest.fs.chunks", BSON( "n" << 1 ), /*unique=*/true );
+            _client.insert( "gridtest.fs.chunks", BSON( "files_id" << 0 << "n" << 1 ) );
+
+            const std::string data = contents( 40 );
+            ASSERT_THROWS( _grid.storeFile( data.c_str(), data.size(), "letters" ),
+                           UserException );
+            ASSERT( !_grid.findFile( "letters" ).exists() );
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "gridfs" ) {
@@ -60,6 +202,12 @@ namespace {
 
         void setupTests() {
             add< SetChunkSizeTest >();
+            add< SetPipelineDepthTest >();
+            add< StoreAndReadBack >();
+            add< BuilderSplitsUnalignedAppends >();
+            add< RangeReads >();
+            add< RangeReadMissingChunk >();
+            add< EarlyBatchFailure >();
         }
     } myall;
 }
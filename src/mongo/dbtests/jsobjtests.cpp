@@ -893,6 +893,56 @@ namespace JsobjTests {
             }
         };
 
+        /** A KeyV2 split into a shared prefix and a tail compares as the whole KeyV1 key. */
+        struct KeyV2Prefix {
+            void run() {
+                Ordering o = Ordering::make( BSON( "a" << 1 << "b" << -1 << "c" << 1 ) );
+                KeyV1Owned a( BSON( "" << "abc" << "" << 5 << "" << 1 ) );
+                KeyV1Owned b( BSON( "" << "abc" << "" << 5 << "" << 2 ) );
+                KeyV1Owned c( BSON( "" << "abc" << "" << 7 << "" << 0 ) );
+                KeyV1Owned d( BSON( "" << "abd" << "" << 5 << "" << 1 ) );
+
+                int fields;
+                int size = a.commonPrefixSize( b, a.dataSize(), &fields );
+                ASSERT_EQUALS( 2, fields );
+                ASSERT( size > 0 && size < a.dataSize() );
+                int firstSize = a.commonPrefixSize( c, a.dataSize(), &fields );
+                ASSERT_EQUALS( 1, fields );
+                ASSERT( firstSize > 0 && firstSize < size );
+                ASSERT_EQUALS( firstSize, a.commonPrefixSize( b, size - 1, &fields ) );
+                ASSERT_EQUALS( 1, fields );
+                ASSERT_EQUALS( 0, a.commonPrefixSize( d, a.dataSize(), &fields ) );
+                // never the last field, even of equal keys
+                ASSERT_EQUALS( size, a.commonPrefixSize( a, a.dataSize(), &fields ) );
+                ASSERT_EQUALS( 2, fields );
+
+                const char* prefix = a.data();
+                KeyV2 tailOfB( prefix, size, b.data() + size );
+                ASSERT( tailOfB.woEqual( b ) );
+                ASSERT_EQUALS( b.toBson(), tailOfB.toBson() );
+
+                // a copy must not point into the original
+                KeyV2* heapKey = new KeyV2( prefix, size, b.data() + size );
+                KeyV2 copy( *heapKey );
+                delete heapKey;
+                ASSERT( copy.woEqual( b ) );
+
+                int tailOfs;
+                ASSERT_EQUALS( 0, b.comparePrefix( prefix, size, o, &tailOfs ) );
+                ASSERT_EQUALS( size, tailOfs );
+                KeyV1 tailA( a.data() + size );
+                KeyV1 tailB( b.data() + size );
+                ASSERT( tailA.woCompareTail( tailB, o, 2 ) < 0 );
+                ASSERT( tailB.woCompareTail( tailA, o, 2 ) > 0 );
+                ASSERT_EQUALS( 0, tailA.woCompareTail( tailA, o, 2 ) );
+                // descending on b
+                ASSERT( c.comparePrefix( prefix, size, o, &tailOfs ) < 0 );
+                ASSERT( d.comparePrefix( prefix, size, o, &tailOfs ) > 0 );
+                KeyV1Owned shortKey( BSON( "" << "abc" ) );
+                ASSERT( shortKey.comparePrefix( prefix, size, o, &tailOfs ) < 0 );
+            }
+        };
+
         namespace Validation {
 
             class Base {
@@ -2153,6 +2203,7 @@ namespace JsobjTests {
             add< BSONObjTests::GetField >();
             add< BSONObjTests::ToStringRecursionDepth >();
             add< BSONObjTests::StringWithNull >();
+            add< BSONObjTests::KeyV2Prefix >();
 
             add< BSONObjTests::Validation::BadType >();
             add< BSONObjTests::Validation::EooBeforeEnd >();
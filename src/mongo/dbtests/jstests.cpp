@@ -302,6 +302,55 @@ namespace JSTests {
         }
     };
 
+    /** Lazily wrapped objects go back to BSON without decoding what JavaScript didn't change. */
+    class LazyObjectRoundTrip {
+    public:
+        void run() {
+            auto_ptr<Scope> s( globalScriptEngine->newScope() );
+
+            BSONObjBuilder b;
+            b.append( "_id", 1 );
+            b.appendSymbol( "sym", "x" );
+            b.append( "sub", BSON( "a" << 1 << "b" << BSON( "c" << 2 ) ) );
+            b.append( "n", 3 );
+            BSONObj o = b.obj();
+
+            // Reading into subobjects leaves the original BSON, symbols included.
+            BSONObj out = returnThis( s.get(), "var t = this.sub.b.c + this.n; return this;", o );
+            ASSERT_EQUALS( o, out );
+            ASSERT_EQUALS( Symbol, out["sym"].type() );
+
+            // A change in a subobject is seen through its parent.
+            out = returnThis( s.get(), "this.sub.b.c = 5; return this;", o );
+            ASSERT_EQUALS( 5, out.getFieldDotted( "sub.b.c" ).number() );
+            ASSERT_EQUALS( 1, out.getFieldDotted( "sub.a" ).number() );
+            ASSERT_EQUALS( Symbol, out["sym"].type() );
+            ASSERT_EQUALS( "_id,sym,sub,n", fieldList( out ) );
+
+            // Deleted fields disappear and added ones go last.
+            out = returnThis( s.get(), "delete this.n; this.extra = 4; return this;", o );
+            ASSERT_EQUALS( "_id,sym,sub,extra", fieldList( out ) );
+            ASSERT_EQUALS( Symbol, out["sym"].type() );
+            ASSERT_EQUALS( 4, out["extra"].number() );
+        }
+    private:
+        static BSONObj returnThis( Scope* s, const char* code, const BSONObj& recv ) {
+            BSONObj empty;
+            ScriptingFunction f = s->createFunction( code );
+            ASSERT_EQUALS( 0, s->invoke( f, &empty, &recv ) );
+            return s->getObject( "__returnValue" );
+        }
+        static string fieldList( const BSONObj& obj ) {
+            string names;
+            BSONForEach( e, obj ) {
+                if ( !names.empty() )
+                    names += ",";
+                names += e.fieldName();
+            }
+            return names;
+        }
+    };
+
     class JSOIDTests {
     public:
         void run() {
@@ -2031,6 +2080,7 @@ namespace JSTests {
 
             add< ObjectMapping >();
             add< ObjectDecoding >();
+            add< LazyObjectRoundTrip >();
             add< JSOIDTests >();
             add< SetImplicit >();
             add< ObjectModReadonlyTests >();
@@ -32,6 +32,7 @@
 
 #include <boost/filesystem/operations.hpp>
 
+#include "mongo/db/dur_commitjob.h"
 #include "mongo/db/storage/durable_mapped_file.h"
 #include "mongo/util/timer.h"
 #include "mongo/dbtests/dbtests.h"
@@ -118,11 +119,64 @@ namespace MMapTests {
         }
     };
 
+    /** write intents are merged into disjoint ranges as they are noted */
+    class WriteIntentMerging {
+    public:
+        void run() {
+            char buf[1000];
+            dur::WriteIntentRanges ranges;
+
+            ASSERT_EQUALS( 0U, ranges.add( buf + 100, 10 ) );
+            ASSERT_EQUALS( 0U, ranges.add( buf + 200, 10 ) );
+            ASSERT_EQUALS( 2U, ranges.size() );
+            ASSERT_EQUALS( 20U, ranges.bytes() );
+
+            // contained and duplicate regions change nothing
+            ASSERT_EQUALS( 1U, ranges.add( buf + 102, 4 ) );
+            ASSERT_EQUALS( 1U, ranges.add( buf + 100, 10 ) );
+            ASSERT_EQUALS( 2U, ranges.size() );
+            ASSERT_EQUALS( 20U, ranges.bytes() );
+
+            // adjacent on either side extends a range
+            ASSERT_EQUALS( 1U, ranges.add( buf + 110, 5 ) );
+            ASSERT_EQUALS( 1U, ranges.add( buf + 195, 5 ) );
+            ASSERT_EQUALS( 2U, ranges.size() );
+            ASSERT_EQUALS( 30U, ranges.bytes() );
+
+            // one region bridging both leaves a single range, and counts both
+            ASSERT_EQUALS( 2U, ranges.add( buf + 90, 150 ) );
+            ASSERT_EQUALS( 1U, ranges.size() );
+            ASSERT_EQUALS( 150U, ranges.bytes() );
+
+            // as does one overlapping the end of a range and bridging to the next
+            ASSERT_EQUALS( 0U, ranges.add( buf + 300, 10 ) );
+            ASSERT_EQUALS( 0U, ranges.add( buf + 320, 10 ) );
+            ASSERT_EQUALS( 0U, ranges.add( buf + 340, 10 ) );
+            ASSERT_EQUALS( 3U, ranges.add( buf + 305, 40 ) );
+            ASSERT_EQUALS( 2U, ranges.size() );
+            ASSERT_EQUALS( 200U, ranges.bytes() );
+
+            ASSERT_EQUALS( 0U, ranges.add( buf + 500, 1 ) );
+            dur::WriteIntentRanges::const_iterator i = ranges.begin();
+            ASSERT( i->first == buf + 90 && i->second == buf + 240 );
+            ++i;
+            ASSERT( i->first == buf + 300 && i->second == buf + 350 );
+            ++i;
+            ASSERT( i->first == buf + 500 && i->second == buf + 501 );
+            ASSERT( ++i == ranges.end() );
+
+            ranges.clear();
+            ASSERT( ranges.empty() );
+            ASSERT_EQUALS( 0U, ranges.bytes() );
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "mmap" ) {}
         void setupTests() {
             add< LeakTest >();
+            add< WriteIntentMerging >();
         }
     } myall;
 
@@ -97,6 +97,10 @@ namespace NamespaceTests {
                 _keyGen->getKeys(obj, &out);
             }
 
+            void setArrayFastPath(bool enabled) {
+                _keyGen->setArrayFastPath(enabled);
+            }
+
             virtual BSONObj key() const {
                 BSONObjBuilder k;
                 k.append( "a", 1 );
@@ -953,6 +957,94 @@ namespace NamespaceTests {
             BSONObj key() const { return BSON( "a.0.b.0" << 1 ); }
         };
         
+        /** Terminal array members become sorted, deduplicated keys. */
+        class TerminalArrayDuplicates : public Base {
+        public:
+            void run() {
+                create();
+
+                BSONObjSet keys;
+                getKeysFromObject( fromjson( "{a:5,b:[3,1,3,[2],2,1]}" ), keys );
+                checkSize( 4, keys );
+                BSONObjSet::const_iterator i = keys.begin();
+                ASSERT_EQUALS( fromjson( "{'':5,'':1}" ), *i++ );
+                ASSERT_EQUALS( fromjson( "{'':5,'':2}" ), *i++ );
+                ASSERT_EQUALS( fromjson( "{'':5,'':3}" ), *i++ );
+                ASSERT_EQUALS( fromjson( "{'':5,'':[2]}" ), *i++ );
+            }
+        protected:
+            BSONObj key() const { return aAndB(); }
+        };
+
+        /** Keys from several terminal arrays under one parent array are merged. */
+        class TerminalArraysInSubobjects : public Base {
+        public:
+            void run() {
+                create();
+
+                BSONObjSet keys;
+                getKeysFromObject( fromjson( "{a:[{b:[4,2]},{b:[3,2,1]}]}" ), keys );
+                checkSize( 4, keys );
+                BSONObjSet::const_iterator i = keys.begin();
+                for ( int expected = 1; expected <= 4; ++expected, ++i ) {
+                    ASSERT_EQUALS( BSON( "" << expected ), *i );
+                }
+            }
+        protected:
+            BSONObj key() const { return aDotB(); }
+        };
+
+        /** Of members giving equal keys, like 1 and 1.0, the first one's key is kept. */
+        class EqualKeysKeepFirstMember : public Base {
+        public:
+            void run() {
+                create();
+
+                BSONObjSet keys;
+                getKeysFromObject( BSON( "a" << BSON_ARRAY( 1 << 1.0 << 2.0 << 2 ) ), keys );
+                checkSize( 2, keys );
+                BSONObjSet::const_iterator i = keys.begin();
+                ASSERT_EQUALS( NumberInt, ( i++ )->firstElement().type() );
+                ASSERT_EQUALS( NumberDouble, ( i++ )->firstElement().type() );
+            }
+        };
+
+        /** Building array keys directly gives exactly the keys recursing per member does. */
+        class ArrayFastPathMatchesRecursion : public Base {
+        public:
+            void run() {
+                const char* docs[] = {
+                    "{a:[{b:3,c:1},{b:1},{c:2},5,{b:[2,3]}],x:1}",
+                    "{a:[{b:1},{b:1.0},{b:{c:1}},{c:1.0},{c:1}]}",
+                    "{a:[[{b:1}],{b:2},{c:[]}],x:'y'}",
+                    "{a:[{d:1},7]}",
+                    "{a:[{b:{c:1}},{b:null}]}",
+                    "{a:{b:[1,{c:2}],c:3}}",
+                    "{a:[{b:[]},{b:2}]}",
+                };
+                for ( int sparse = 0; sparse < 2; ++sparse ) {
+                    for ( size_t d = 0; d < sizeof( docs ) / sizeof( docs[0] ); ++d ) {
+                        BSONObj doc = fromjson( docs[d] );
+                        create( sparse );
+                        BSONObjSet direct;
+                        getKeysFromObject( doc, direct );
+                        setArrayFastPath( false );
+                        BSONObjSet recursive;
+                        getKeysFromObject( doc, recursive );
+
+                        ASSERT_EQUALS( recursive.size(), direct.size() );
+                        BSONObjSet::const_iterator i = direct.begin();
+                        BSONObjSet::const_iterator j = recursive.begin();
+                        for ( ; i != direct.end(); ++i, ++j ) {
+                            ASSERT( i->binaryEqual( *j ) );
+                        }
+                    }
+                }
+            }
+        protected:
+            BSONObj key() const { return BSON( "a.b" << 1 << "a.c" << 1 << "x" << 1 ); }
+        };
+
         // also test numeric string field names
         
     } // namespace IndexDetailsTests
@@ -1787,6 +1879,10 @@ namespace NamespaceTests {
             add< IndexDetailsTests::MissingField >();
             add< IndexDetailsTests::SubobjectMissing >();
             add< IndexDetailsTests::CompoundMissing >();
+            add< IndexDetailsTests::TerminalArrayDuplicates >();
+            add< IndexDetailsTests::TerminalArraysInSubobjects >();
+            add< IndexDetailsTests::EqualKeysKeepFirstMember >();
+            add< IndexDetailsTests::ArrayFastPathMatchesRecursion >();
             add< NamespaceDetailsTests::Create >();
             add< NamespaceDetailsTests::SingleAlloc >();
             add< NamespaceDetailsTests::Realloc >();
@@ -346,6 +346,134 @@ namespace OplogStartTests {
         virtual int tsGte() const { return 0; }
      };
 
+    /**
+     * With enough extents, OplogStart binary searches them up front instead of hopping.
+     *
+     * Collection structure, one document per extent with two empty extents mixed in:
+     *
+     * [ {_id: 0} ] [ {_id: 1} ] [<empty>] [ {_id: 2} ] ... [<empty>] ... [ {_id: 11} ]
+     */
+    class OplogStartExtentSearchBase : public SizedExtentHopBase {
+    public:
+        void run() {
+            buildCollection();
+
+            setupFromQuery(BSON( "ts" << BSON( "$gte" << tsGte() )));
+            work();
+        }
+
+    protected:
+        virtual void work() = 0;
+
+        virtual int numDocs() const { return 12; }
+        virtual int numHops() const { return 0; }
+        virtual BSONArray extentSizes() const {
+            BSONArrayBuilder sizes;
+            for (int i = 0; i < numDocs(); ++i) {
+                if (i == 2 || i == 7) {
+                    sizes.append(tooSmall());
+                }
+                sizes.append(fitsOne());
+            }
+            return sizes.arr();
+        }
+    };
+
+    /** The start is in an older extent: found without scanning. */
+    class OplogStartExtentSearchFindsOlderExtent : public OplogStartExtentSearchBase {
+        virtual int tsGte() const { return 5; }
+        virtual void work() {
+            WorkingSetID id;
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::ADVANCED);
+            ASSERT(_stage->didExtentSearch());
+            ASSERT(!_stage->isBackwardsScanning());
+            assertWorkingSetMemberHasId(id, 4);
+        }
+    };
+
+    /** Everything matches: read from the beginning. */
+    class OplogStartExtentSearchEOF : public OplogStartExtentSearchBase {
+        virtual int tsGte() const { return 0; }
+        virtual void work() {
+            WorkingSetID id;
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::IS_EOF);
+            ASSERT(_stage->didExtentSearch());
+        }
+    };
+
+    /** The start is in the newest extent: scan backwards for it as usual. */
+    class OplogStartExtentSearchNewestExtent : public OplogStartExtentSearchBase {
+        virtual int tsGte() const { return 12; }
+        virtual void work() {
+            WorkingSetID id;
+            // collection scan needs to be initialized
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::NEED_TIME);
+            ASSERT(_stage->didExtentSearch());
+            ASSERT(_stage->isBackwardsScanning());
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::ADVANCED);
+            assertWorkingSetMemberHasId(id, 11);
+        }
+    };
+
+    /**
+     * The extent search once the oplog has wrapped: the oldest data is in the extent after
+     * capExtent, and the newest is at capFirstNewRecord.
+     *
+     * Collection structure, one document per extent, after inserting {_id: 0} to {_id: 16}:
+     *
+     * [ {_id: 12} ] ... [ {_id: 16} ] [ {_id: 5} ] ... [ {_id: 11} ]
+     *                    ^ capExtent
+     */
+    class OplogStartExtentSearchWrapped : public SizedExtentHopBase {
+    public:
+        void run() {
+            buildCollection();
+            ASSERT(nsdetails(ns())->capLooped());
+            ASSERT_EQUALS(12U, client()->count(ns()));
+
+            // the start is before the wrap point, or after it
+            assertStartsAt(8, 7);
+            assertStartsAt(14, 13);
+            assertStartsAt(6, 5);
+            // just before capFirstNewRecord
+            assertStartsAt(16, 15);
+
+            // even the oldest document, in the extent after capExtent, matches
+            WorkingSetID id;
+            setupFromQuery(BSON( "ts" << BSON( "$gte" << 5 )));
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::IS_EOF);
+            ASSERT(_stage->didExtentSearch());
+
+            // nothing matches: scan backwards from the newest document
+            setupFromQuery(BSON( "ts" << BSON( "$gte" << 17 )));
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::NEED_TIME);
+            ASSERT(_stage->didExtentSearch());
+            ASSERT(_stage->isBackwardsScanning());
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::ADVANCED);
+            assertWorkingSetMemberHasId(id, 16);
+        }
+
+    private:
+        void assertStartsAt(int tsGte, int expectedId) {
+            WorkingSetID id;
+            setupFromQuery(BSON( "ts" << BSON( "$gte" << tsGte )));
+            ASSERT_EQUALS(_stage->work(&id), PlanStage::ADVANCED);
+            ASSERT(_stage->didExtentSearch());
+            ASSERT(!_stage->isBackwardsScanning());
+            assertWorkingSetMemberHasId(id, expectedId);
+        }
+
+        virtual int numDocs() const { return 17; }
+        virtual int numHops() const { return 0; }
+        virtual BSONArray extentSizes() const {
+            BSONArrayBuilder sizes;
+            for (int i = 0; i < 12; ++i) {
+                sizes.append(fitsOne());
+            }
+            return sizes.arr();
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite("oplogstart") { }
@@ -361,6 +489,10 @@ namespace OplogStartTests {
             add< OplogStartOneFullExtent >();
             add< OplogStartFirstExtentEmpty >();
             add< OplogStartEOF >();
+            add< OplogStartExtentSearchFindsOlderExtent >();
+            add< OplogStartExtentSearchEOF >();
+            add< OplogStartExtentSearchNewestExtent >();
+            add< OplogStartExtentSearchWrapped >();
         }
     } oplogStart;
 
@@ -31,11 +31,19 @@
 
 #include "mongo/pch.h"
 
+#include <boost/filesystem/operations.hpp>
+
 #include "mongo/db/db.h"
+#include "mongo/db/dbhelpers.h"
 #include "mongo/db/json.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/ops/insert.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/db/curop.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/ephemeral_storage.h"
+#include "mongo/db/storage/extent.h"
+#include "mongo/db/structure/catalog/namespace_details.h"
 #include "mongo/dbtests/dbtests.h"
 
 namespace PdfileTests {
@@ -102,6 +110,107 @@ namespace PdfileTests {
         };
     } // namespace Insert
 
+    namespace Update {
+        class Base {
+        public:
+            Base() : _context( ns() ) {
+                _collection = _context.db()->getOrCreateCollection( ns() );
+                Helpers::ensureIndex( ns(), BSON( "x" << 1 ), false, "x_1" );
+            }
+            virtual ~Base() {
+                if ( !nsdetails( ns() ) )
+                    return;
+                _context.db()->dropCollection( ns() );
+            }
+        protected:
+            static const char *ns() {
+                return "unittests.pdfiletests.Update";
+            }
+            /** Where the x_1 index says the document with 'x' is, or a null DiskLoc. */
+            static DiskLoc indexedLoc( int x ) {
+                return Helpers::findOne( ns(), BSON( "x" << x ), true );
+            }
+            static BSONObj doc( int x, const string& s ) {
+                return BSON( "_id" << 1 << "x" << x << "s" << s );
+            }
+
+            Lock::GlobalWrite lk_;
+            Client::Context _context;
+            Collection* _collection;
+        };
+
+        /**
+         * Updates that stay in the record are rewritten where they are, and skip the indexes when
+         * the caller says no indexed field changed.
+         */
+        class InPlace : public Base {
+        public:
+            void run() {
+                StatusWith<DiskLoc> loc = _collection->insertDocument( doc( 1, string( 200, 'a' ) ),
+                                                                       true );
+                ASSERT( loc.isOK() );
+
+                // shrink, then grow again within the record, changing only the tail
+                const BSONObj shrunk = doc( 1, string( 100, 'a' ) );
+                OpDebug debug;
+                StatusWith<DiskLoc> updated = _collection->updateDocument( loc.getValue(), shrunk,
+                                                                           true, &debug, false );
+                ASSERT( updated.isOK() );
+                ASSERT_EQUALS( loc.getValue(), updated.getValue() );
+                ASSERT_EQUALS( 0, debug.keyUpdates );
+                ASSERT_EQUALS( shrunk, _collection->docFor( loc.getValue() ) );
+
+                const BSONObj grown = doc( 1, string( 150, 'a' ) + "b" );
+                debug.reset();
+                updated = _collection->updateDocument( loc.getValue(), grown, true, &debug, false );
+                ASSERT( updated.isOK() );
+                ASSERT_EQUALS( loc.getValue(), updated.getValue() );
+                ASSERT_EQUALS( 0, debug.keyUpdates );
+                ASSERT_EQUALS( -1, debug.nmoved );
+                ASSERT_EQUALS( grown, _collection->docFor( loc.getValue() ) );
+                ASSERT_EQUALS( loc.getValue(), indexedLoc( 1 ) );
+
+                // an indexed field that changes is still maintained
+                const BSONObj reindexed = doc( 2, string( 150, 'a' ) + "b" );
+                debug.reset();
+                updated = _collection->updateDocument( loc.getValue(), reindexed, true, &debug, true );
+                ASSERT( updated.isOK() );
+                ASSERT_EQUALS( loc.getValue(), updated.getValue() );
+                ASSERT_EQUALS( 1, debug.keyUpdates );
+                ASSERT_EQUALS( reindexed, _collection->docFor( loc.getValue() ) );
+                ASSERT( indexedLoc( 1 ).isNull() );
+                ASSERT_EQUALS( loc.getValue(), indexedLoc( 2 ) );
+            }
+        };
+
+        /**
+         * A document that outgrows its record moves, and every index follows it even when no
+         * indexed field changed.
+         */
+        class GrowsAndMoves : public Base {
+        public:
+            void run() {
+                StatusWith<DiskLoc> loc = _collection->insertDocument( doc( 1, "a" ), true );
+                ASSERT( loc.isOK() );
+                // something after it, so the record can't just be extended
+                ASSERT( _collection->insertDocument( BSON( "_id" << 2 << "x" << 2 ), true ).isOK() );
+
+                const BSONObj grown = doc( 1, string( 4000, 'a' ) );
+                OpDebug debug;
+                StatusWith<DiskLoc> updated = _collection->updateDocument( loc.getValue(), grown,
+                                                                           true, &debug, false );
+                ASSERT( updated.isOK() );
+                ASSERT( loc.getValue() != updated.getValue() );
+                ASSERT_EQUALS( 1, debug.nmoved );
+                ASSERT_EQUALS( grown, _collection->docFor( updated.getValue() ) );
+                ASSERT_EQUALS( 2U, _collection->numRecords() );
+                ASSERT_EQUALS( updated.getValue(), indexedLoc( 1 ) );
+                ASSERT_EQUALS( updated.getValue(),
+                               Helpers::findOne( ns(), BSON( "_id" << 1 ), true ) );
+            }
+        };
+    } // namespace Update
+
     class ExtentSizing {
     public:
         struct SmallFilesControl {
@@ -157,6 +266,258 @@ namespace PdfileTests {
         }
     };
 
+    class OnlineCompact {
+    public:
+        OnlineCompact() : _context( ns() ) {
+        }
+        ~OnlineCompact() {
+            if ( !nsdetails( ns() ) )
+                return;
+            _context.db()->dropCollection( ns() );
+        }
+        void run() {
+            Collection* collection = _context.db()->getOrCreateCollection( ns() );
+            Helpers::ensureIndex( ns(), BSON( "x" << 1 ), false, "x_1" );
+
+            string filler( 1000, 'a' );
+            vector<DiskLoc> locs;
+            for ( int i = 0; i < 400; i++ ) {
+                StatusWith<DiskLoc> dl =
+                    collection->insertDocument( BSON( "_id" << i << "x" << i << "s" << filler ),
+                                                true );
+                ASSERT( dl.isOK() );
+                locs.push_back( dl.getValue() );
+            }
+            for ( int i = 0; i < 400; i += 2 ) {
+                collection->deleteDocument( locs[i] );
+            }
+
+            NamespaceDetails* d = collection->details();
+            vector<DiskLoc> oldExtents;
+            for ( DiskLoc L = d->firstExtent(); !L.isNull(); L = L.ext()->xnext )
+                oldExtents.push_back( L );
+            ASSERT( oldExtents.size() > 2 );
+
+            CompactOptions options;
+            DiskLoc stopExtent = d->lastExtent();
+            int extentsFreed = 0;
+            while ( true ) {
+                // small steps, so extents take several to drain
+                StatusWith<CompactStepStats> step = collection->compactStep( &options,
+                                                                             stopExtent,
+                                                                             8 * 1024 );
+                ASSERT( step.isOK() );
+                if ( step.getValue().done )
+                    break;
+                if ( step.getValue().extentFreed )
+                    extentsFreed++;
+            }
+
+            ASSERT_EQUALS( static_cast<int>( oldExtents.size() ) - 1, extentsFreed );
+            ASSERT_EQUALS( stopExtent, d->firstExtent() );
+            ASSERT( d->firstExtent().ext()->xprev.isNull() );
+            ASSERT_EQUALS( 200U, collection->numRecords() );
+
+            // every surviving document is still reachable through the secondary index
+            for ( int i = 0; i < 400; i++ ) {
+                DiskLoc loc = Helpers::findOne( ns(), BSON( "x" << i ), true );
+                ASSERT_EQUALS( i % 2 == 1, !loc.isNull() );
+                if ( !loc.isNull() )
+                    ASSERT_EQUALS( i, loc.obj()["_id"].numberInt() );
+            }
+        }
+    private:
+        static const char *ns() {
+            return "unittests.pdfiletests.OnlineCompact";
+        }
+
+        Lock::GlobalWrite lk_;
+        Client::Context _context;
+    };
+
+    // Stops an online compaction part way and checks that all the free space in the extents it
+    // was draining, including space deleted between steps, goes back on the deleted lists
+    class OnlineCompactAbandoned {
+    public:
+        OnlineCompactAbandoned() : _context( ns() ) {
+        }
+        ~OnlineCompactAbandoned() {
+            if ( !nsdetails( ns() ) )
+                return;
+            _context.db()->dropCollection( ns() );
+        }
+        void run() {
+            Collection* collection = _context.db()->getOrCreateCollection( ns() );
+
+            string filler( 1000, 'a' );
+            vector<DiskLoc> locs;
+            for ( int i = 0; i < 400; i++ ) {
+                StatusWith<DiskLoc> dl =
+                    collection->insertDocument( BSON( "_id" << i << "s" << filler ), true );
+                ASSERT( dl.isOK() );
+                locs.push_back( dl.getValue() );
+            }
+            for ( int i = 0; i < 400; i += 2 ) {
+                collection->deleteDocument( locs[i] );
+            }
+
+            NamespaceDetails* d = collection->details();
+            DiskLoc stopExtent = d->lastExtent();
+            ASSERT( d->firstExtent() != stopExtent );
+
+            CompactOptions options;
+            for ( int i = 0; i < 3; i++ ) {
+                StatusWith<CompactStepStats> step = collection->compactStep( &options,
+                                                                             stopExtent,
+                                                                             8 * 1024 );
+                ASSERT( step.isOK() );
+                ASSERT( !step.getValue().done );
+            }
+
+            // the moves landed past the extents being drained, whose space is now unlisted
+            set<DiskLoc> draining;
+            for ( DiskLoc L = d->firstExtent(); L != stopExtent; L = L.ext()->xnext )
+                draining.insert( L );
+            ASSERT_EQUALS( 0, listedBytes( d, draining ) );
+
+            // and a document deleted from them between steps doesn't put any back
+            DiskLoc victim;
+            for ( set<DiskLoc>::const_iterator i = draining.begin();
+                  victim.isNull() && i != draining.end(); ++i ) {
+                victim = i->ext()->firstRecord;
+            }
+            ASSERT( !victim.isNull() );
+            collection->deleteDocument( victim );
+            ASSERT_EQUALS( 0, listedBytes( d, draining ) );
+
+            ASSERT( collection->abandonCompactSteps( stopExtent ) > 0 );
+
+            long long unused = 0;
+            for ( set<DiskLoc>::const_iterator i = draining.begin(); i != draining.end(); ++i ) {
+                Extent* e = i->ext();
+                unused += e->length - Extent::HeaderSize();
+                for ( DiskLoc L = e->firstRecord; !L.isNull(); ) {
+                    unused -= L.rec()->lengthWithHeaders();
+                    L = L == e->lastRecord ? DiskLoc() : L.rec()->getNext( L );
+                }
+            }
+            ASSERT( unused > 0 );
+            ASSERT_EQUALS( unused, listedBytes( d, draining ) );
+            ASSERT_EQUALS( 199U, collection->numRecords() );
+        }
+    private:
+        /** bytes on the deleted lists that lie in one of 'extents' */
+        static long long listedBytes( NamespaceDetails* d, const set<DiskLoc>& extents ) {
+            long long n = 0;
+            for ( int i = 0; i < Buckets; i++ ) {
+                for ( DiskLoc L = d->deletedListEntry( i ); !L.isNull();
+                      L = L.drec()->nextDeleted() ) {
+                    if ( extents.count( L.drec()->myExtentLoc( L ) ) )
+                        n += L.drec()->lengthWithHeaders();
+                }
+            }
+            return n;
+        }
+
+        static const char *ns() {
+            return "unittests.pdfiletests.OnlineCompactAbandoned";
+        }
+
+        Lock::GlobalWrite lk_;
+        Client::Context _context;
+    };
+
+    class CompressedRecords {
+    public:
+        CompressedRecords() : _context( ns() ) {
+        }
+        ~CompressedRecords() {
+            if ( !nsdetails( ns() ) )
+                return;
+            _context.db()->dropCollection( ns() );
+        }
+        void run() {
+            Collection* collection = _context.db()->getOrCreateCollection( ns() );
+            NamespaceDetails* d = collection->details();
+            d->setUserFlag( NamespaceDetails::Flag_CompressRecords );
+
+            // repetitive enough to compress, and a small one that is not worth it
+            BSONObj big = BSON( "_id" << 1 << "s" << string( 2000, 'a' ) );
+            BSONObj small = BSON( "_id" << 2 );
+            StatusWith<DiskLoc> bigLoc = collection->insertDocument( big, true );
+            StatusWith<DiskLoc> smallLoc = collection->insertDocument( small, true );
+            ASSERT( bigLoc.isOK() );
+            ASSERT( smallLoc.isOK() );
+
+            ASSERT( bigLoc.getValue().rec()->isCompressed() );
+            ASSERT( !smallLoc.getValue().rec()->isCompressed() );
+            ASSERT_EQUALS( big, bigLoc.getValue().obj() );
+            ASSERT_EQUALS( small, smallLoc.getValue().obj() );
+            ASSERT( d->logicalDataSize() > d->dataSize() + 1500 );
+
+            // a shrinking update is made where it is, still compressed
+            BSONObj updated = BSON( "_id" << 1 << "s" << string( 1500, 'a' ) );
+            StatusWith<DiskLoc> updatedLoc = collection->updateDocument( bigLoc.getValue(),
+                                                                         updated, true, NULL );
+            ASSERT( updatedLoc.isOK() );
+            ASSERT_EQUALS( bigLoc.getValue(), updatedLoc.getValue() );
+            ASSERT_EQUALS( updated, updatedLoc.getValue().obj() );
+            ASSERT( updatedLoc.getValue().rec()->isCompressed() );
+
+            // and readable after compression is turned off
+            d->clearUserFlag( NamespaceDetails::Flag_CompressRecords );
+            ASSERT_EQUALS( updated, collection->docFor( bigLoc.getValue() ) );
+
+            collection->deleteDocument( bigLoc.getValue() );
+            ASSERT_EQUALS( d->dataSize(), d->logicalDataSize() );
+        }
+    private:
+        static const char *ns() {
+            return "unittests.pdfiletests.CompressedRecords";
+        }
+
+        Lock::GlobalWrite lk_;
+        Client::Context _context;
+    };
+
+    class EphemeralDatabase {
+    public:
+        EphemeralDatabase() {
+            _param = ServerParameterSet::getGlobal()->getMap().find( "ephemeralDatabases" )->second;
+            ASSERT_OK( _param->setFromString( dbName() ) );
+        }
+        ~EphemeralDatabase() {
+            _param->setFromString( "" );
+        }
+        void run() {
+            size_t before = EphemeralStorage::bytesInUse();
+            {
+                Lock::GlobalWrite lk;
+                Client::Context ctx( ns() );
+                ASSERT( ctx.db()->getExtentManager().isEphemeral() );
+
+                Collection* collection = ctx.db()->getOrCreateCollection( ns() );
+                StatusWith<DiskLoc> loc = collection->insertDocument( BSON( "_id" << 1 ), true );
+                ASSERT( loc.isOK() );
+                ASSERT( EphemeralStorage::contains( loc.getValue().rec() ) );
+                ASSERT( EphemeralStorage::bytesInUse() > before );
+                ASSERT( !boost::filesystem::exists( ctx.db()->namespaceIndex().path() ) );
+                ASSERT_EQUALS( 1, ctx.db()->getExtentManager().numFiles() );
+
+                dropDatabase( dbName() );
+            }
+            ASSERT_EQUALS( before, EphemeralStorage::bytesInUse() );
+        }
+    private:
+        static const char *dbName() {
+            return "unittests_ephemeral";
+        }
+        static const char *ns() {
+            return "unittests_ephemeral.pdfiletests";
+        }
+        ServerParameter* _param;
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "pdfile" ) {}
@@ -164,7 +525,13 @@ namespace PdfileTests {
         void setupTests() {
             add< Insert::InsertNoId >();
             add< Insert::UpdateDate >();
+            add< Update::InPlace >();
+            add< Update::GrowsAndMoves >();
             add< ExtentSizing >();
+            add< OnlineCompact >();
+            add< OnlineCompactAbandoned >();
+            add< CompressedRecords >();
+            add< EphemeralDatabase >();
         }
     } myall;
 
@@ -40,8 +40,11 @@
 #include <boost/thread/thread.hpp>
 #include <fstream>
 
+#include "mongo/bson/bson_validate.h"
+#include "mongo/client/gridfs.h"
 #include "mongo/db/db.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/index/btree_key_generator.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/json.h"
 #include "mongo/db/structure/btree/key.h"
@@ -49,6 +52,7 @@
 #include "mongo/db/taskqueue.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/dbtests/framework_options.h"
+#include "mongo/scripting/engine.h"
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/qlock.h"
@@ -486,6 +490,40 @@ namespace PerfTests {
         }
     };
 
+    /** validateBSON over an insert-shaped document, as objcheck does for every one received */
+    class BSONValidate : public NonDurTest {
+    public:
+        int n;
+        bo b;
+        string name() { return "BSONValidate"; }
+        BSONValidate() {
+            n = 0;
+            BSONObjBuilder bb;
+            bb.append( "_id" , OID::gen() );
+            bb.append( "userId" , 12345678 );
+            bb.append( "name" , "some user name" );
+            bb.append( "email" , "someone@example.com" );
+            bb.appendDate( "created" , Date_t( 1390000000000ULL ) );
+            bb.append( "active" , true );
+            bb.append( "score" , 3.25 );
+            bb.append( "address" , BSON( "street" << "123 Main Street" << "city" << "New York"
+                                         << "zip" << "10001" << "geo" << BSON_ARRAY( -73.9 << 40.7 ) ) );
+            BSONArrayBuilder tags( bb.subarrayStart( "tags" ) );
+            for ( int i = 0; i < 10; i++ )
+                tags.append( "tag" + BSONObjBuilder::numStr( i ) );
+            tags.done();
+            BSONArrayBuilder events( bb.subarrayStart( "events" ) );
+            for ( int i = 0; i < 10; i++ )
+                events.append( BSON( "type" << "click" << "ts" << (long long)i << "count" << i ) );
+            events.done();
+            b = bb.obj();
+        }
+        void timed() {
+            if ( validateBSON( b.objdata(), b.objsize() ).isOK() )
+                n++;
+        }
+    };
+
     class KeyTest : public B {
     public:
         KeyV1Owned a,b,c;
@@ -1104,6 +1142,191 @@ namespace PerfTests {
         }
     };
 
+    /**
+     * inserts into a compound index whose keys share long leading fields, the case prefix
+     * compressed v:2 buckets are for.  compare the v1 and v2 runs for speed and index size.
+     */
+    template <int V>
+    class CompoundPrefixInsert : public B {
+        unsigned long long _n;
+    public:
+        CompoundPrefixInsert() : _n(0) { }
+        string name() { return V == 1 ? "compound-prefix-inserts-v1" : "compound-prefix-inserts-v2"; }
+        void prep() {
+            client().ensureIndex(ns(), BSON("tenant"<<1<<"day"<<1<<"seq"<<1),
+                                 false, "", false, false, V);
+        }
+        void timed() {
+            _n++;
+            char tenant[64];
+            sprintf(tenant, "tenant-%016llu.example.com", _n / 20000);
+            client().insert(ns(), BSON("tenant" << tenant << "day" << (long long)(_n / 500)
+                                       << "seq" << (long long) _n));
+        }
+        void post() {
+            BSONObj info;
+            string coll = string(ns()).substr(strlen("perftest."));
+            if( client().runCommand("perftest", BSON("collStats" << coll), info) && _n )
+                cout << "      index bytes/key: " << info["totalIndexSize"].numberLong() / _n
+                     << " (" << _n << " keys)" << endl;
+        }
+    };
+
+    /** stores and reads back a 4MB GridFS file in 64KB chunks, 'Depth' chunks per round trip */
+    template <unsigned Depth>
+    class GridFSStoreRead : public B {
+        string _data;
+    public:
+        GridFSStoreRead() : _data(4 * 1024 * 1024, 'g') { }
+        string name() {
+            return str::stream() << "gridfs-store-read-depth" << Depth;
+        }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            client().dropCollection(string(ns()) + ".files");
+            client().dropCollection(string(ns()) + ".chunks");
+        }
+        void timed() {
+            GridFS grid(client(), "perftest", name());
+            grid.setChunkSize(64 * 1024);
+            grid.setPipelineDepth(Depth);
+            BSONObj file = grid.storeFile(_data.c_str(), _data.size(), "bench");
+            std::ostringstream out;
+            grid.findFile(BSON("_id" << file["_id"])).write(out);
+            verify(out.str().size() == _data.size());
+        }
+        void post() {
+            prep();
+        }
+    };
+
+    /**
+     * generates keys for one document with a 500 element array (a quarter of them duplicates) on
+     * a { a : 1, tags : 1 } index, or on { a : 1, 'tags.t' : 1 } when the members are Embedded in
+     * subobjects.  Recursive turns off the direct array path, for comparison.  keys/sec is the
+     * reported rate times the keys per document printed afterwards.
+     */
+    template <bool Embedded, bool Recursive>
+    class KeyGenArray : public B {
+        BSONObj _pattern;
+        BSONObj _doc;
+        scoped_ptr<BtreeKeyGenerator> _keyGen;
+        size_t _nKeys;
+    public:
+        KeyGenArray() : _nKeys(0) { }
+        string name() {
+            string name = Embedded ? "keygen-array500-subobj" : "keygen-array500";
+            return Recursive ? name + "-recursive" : name;
+        }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            _pattern = Embedded ? BSON("a" << 1 << "tags.t" << 1) : BSON("a" << 1 << "tags" << 1);
+            vector<const char*> fieldNames;
+            vector<BSONElement> fixed;
+            BSONObjIterator i(_pattern);
+            while (i.more()) {
+                fieldNames.push_back(i.next().fieldName());
+                fixed.push_back(BSONElement());
+            }
+            _keyGen.reset(new BtreeKeyGeneratorV1(fieldNames, fixed, false));
+            _keyGen->setArrayFastPath(!Recursive);
+
+            BSONArrayBuilder tags;
+            for (int n = 0; n < 500; ++n) {
+                string tag = str::stream() << "tag" << n % 375;
+                if (Embedded)
+                    tags.append(BSON("t" << tag));
+                else
+                    tags.append(tag);
+            }
+            _doc = BSON("_id" << 1 << "a" << 7 << "tags" << tags.arr());
+        }
+        void timed() {
+            BSONObjSet keys;
+            _keyGen->getKeys(_doc, &keys);
+            _nKeys = keys.size();
+        }
+        void post() {
+            verify(_nKeys == 375);
+            cout << "      keys/doc: " << _nKeys << endl;
+        }
+    };
+
+    /** runs a map function emitting once per tag over a document with 20 tags */
+    class JsMapEmit : public B {
+        scoped_ptr<Scope> _scope;
+        ScriptingFunction _map;
+        BSONObj _doc;
+        BSONObj _empty;
+    public:
+        string name() { return "js-map-emit"; }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            _scope.reset(globalScriptEngine->newScope());
+            _scope->invokeSafe("emitted = 0; emit = function(k, v) { emitted++; }", 0, 0);
+            _map = _scope->createFunction(
+                    "for (var i = 0; i < this.tags.length; i++) {"
+                    "    emit(this.tags[i], { count : 1, user : this.user.name });"
+                    "}");
+            BSONArrayBuilder tags;
+            for (int i = 0; i < 20; i++)
+                tags.append(str::stream() << "tag" << i);
+            _doc = BSON("_id" << 1 << "user" << BSON("name" << "u" << "age" << 30)
+                        << "text" << string(200, 't') << "tags" << tags.arr());
+        }
+        void timed() {
+            _scope->invoke(_map, &_empty, &_doc);
+        }
+    };
+
+    /**
+     * reduces 50 values into one and then runs a finalize that reads the result but returns it
+     * unchanged, converting both results back to BSON as mapReduce does
+     */
+    class JsReduceFinalize : public B {
+        scoped_ptr<Scope> _scope;
+        ScriptingFunction _reduce;
+        ScriptingFunction _finalize;
+        BSONObj _reduceArgs;
+        BSONObj _finalizeArgs;
+    public:
+        string name() { return "js-reduce-finalize"; }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        void prep() {
+            _scope.reset(globalScriptEngine->newScope());
+            _reduce = _scope->createFunction(
+                    "function(k, vals) {"
+                    "    var r = { count : 0, stats : { min : vals[0].stats.min } };"
+                    "    for (var i = 0; i < vals.length; i++) {"
+                    "        r.count += vals[i].count;"
+                    "        r.stats.min = Math.min(r.stats.min, vals[i].stats.min);"
+                    "    }"
+                    "    return r;"
+                    "}");
+            _finalize = _scope->createFunction(
+                    "function(k, v) { if (v.stats.min < 0) v.negative = true; return v; }");
+            BSONArrayBuilder vals;
+            for (int i = 0; i < 50; i++)
+                vals.append(BSON("count" << 1 << "stats" << BSON("min" << i)));
+            _reduceArgs = BSON("0" << "key" << "1" << vals.arr());
+            _finalizeArgs = BSON("0" << "key" << "1" << BSON("count" << 50 << "stats"
+                                 << BSON("min" << 0 << "max" << 49) << "note" << string(100, 'n')));
+        }
+        void timed() {
+            _scope->invoke(_reduce, &_reduceArgs, 0);
+            BSONObjBuilder reduced;
+            _scope->append(reduced, "1", "__returnValue");
+
+            _scope->invoke(_finalize, &_finalizeArgs, 0);
+            BSONObjBuilder finalized;
+            _scope->append(finalized, "value", "__returnValue");
+        }
+    };
+
     /** upserts about 32k records and then keeps updating them
         2 indexes
     */
@@ -1423,11 +1646,22 @@ namespace PerfTests {
                 add< BSONIter >();
                 add< BSONGetFields1 >();
                 add< BSONGetFields2 >();
+                add< BSONValidate >();
                 //add< TaskQueueTest >();
                 add< InsertDup >();
                 add< Insert1 >();
                 add< InsertRandom >();
                 add< MoreIndexes<InsertRandom> >();
+                add< CompoundPrefixInsert<1> >();
+                add< CompoundPrefixInsert<2> >();
+                add< GridFSStoreRead<1> >();
+                add< GridFSStoreRead<16> >();
+                add< KeyGenArray<false, false> >();
+                add< KeyGenArray<false, true> >();
+                add< KeyGenArray<true, false> >();
+                add< KeyGenArray<true, true> >();
+                add< JsMapEmit >();
+                add< JsReduceFinalize >();
                 add< Update1 >();
                 add< MoreIndexes<Update1> >();
                 add< InsertBig >();
@@ -27,6 +27,7 @@
  */
 
 #include "mongo/db/catalog/database.h"
+#include "mongo/db/exec/and_hash.h"
 #include "mongo/db/exec/collection_scan.h"
 #include "mongo/db/exec/fetch.h"
 #include "mongo/db/exec/index_scan.h"
@@ -151,12 +152,72 @@ namespace QueryMultiPlanRunner {
         }
     };
 
+    // A winning hash intersection that outgrows its memory limit after the ranking period fails
+    // before producing anything.  The runner must switch to the backup plan rather than error.
+    class MPRAndHashFallsBackToBackup : public MultiPlanRunnerBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+
+            const int N = 5000;
+            for (int i = 0; i < N; ++i) {
+                insert(BSON("foo" << i));
+            }
+
+            CollectionScanParams csparams;
+            csparams.ns = ns();
+            csparams.direction = CollectionScanParams::FORWARD;
+
+            // Plan 0: AND_HASH of two collection scans.  The ranking works only hash the first
+            // hundred or so documents, well under the limit; hashing all of them is not.
+            auto_ptr<WorkingSet> firstWs(new WorkingSet());
+            auto_ptr<AndHashStage> ah(new AndHashStage(firstWs.get(), NULL, 64 * 1024));
+            ah->addChild(new CollectionScan(csparams, firstWs.get(), NULL));
+            ah->addChild(new CollectionScan(csparams, firstWs.get(), NULL));
+            QuerySolution* firstSoln = createQuerySolution();
+            firstSoln->hasAndHashStage = true;
+
+            // Plan 1: CollScan with a matcher that matches nothing during ranking, so the two
+            // plans tie and the first one wins.
+            BSONObj filterObj = BSON("foo" << BSON("$gte" << N - 1000));
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            verify(swme.isOK());
+            auto_ptr<MatchExpression> filter(swme.getValue());
+            auto_ptr<WorkingSet> secondWs(new WorkingSet());
+            auto_ptr<PlanStage> secondRoot(new CollectionScan(csparams, secondWs.get(),
+                                                              filter.get()));
+
+            CanonicalQuery* cq = NULL;
+            verify(CanonicalQuery::canonicalize(ns(), filterObj, &cq).isOK());
+            verify(NULL != cq);
+            MultiPlanRunner mpr(cq);
+            mpr.addPlan(firstSoln, ah.release(), firstWs.release());
+            mpr.addPlan(createQuerySolution(), secondRoot.release(), secondWs.release());
+
+            size_t best;
+            ASSERT(mpr.pickBestPlan(&best));
+            ASSERT_EQUALS(size_t(0), best);
+
+            int results = 0;
+            BSONObj obj;
+            Runner::RunnerState state;
+            while (Runner::RUNNER_ADVANCED == (state = mpr.getNext(&obj, NULL))) {
+                ASSERT_GREATER_THAN_OR_EQUALS(obj["foo"].numberInt(), N - 1000);
+                ++results;
+            }
+
+            ASSERT_EQUALS(Runner::RUNNER_EOF, state);
+            ASSERT_EQUALS(1000, results);
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "query_multi_plan_runner" ) { }
 
         void setupTests() {
             add<MPRCollectionScanVsHighlySelectiveIXScan>();
+            add<MPRAndHashFallsBackToBackup>();
         }
     }  queryMultiPlanRunnerAll;
 
@@ -303,6 +303,56 @@ namespace QueryStageAnd {
         }
     };
 
+    // An AND whose first child produces more than the hash table may hold fails rather than
+    // buffering everything.
+    class QueryStageAndHashTooLarge : public QueryStageAndBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+            Database* db = ctx.ctx().db();
+            Collection* coll = db->getCollection(ns());
+            if (!coll) {
+                coll = db->createCollection(ns());
+            }
+
+            for (int i = 0; i < 50; ++i) {
+                insert(BSON("foo" << i << "bar" << i));
+            }
+
+            addIndex(BSON("foo" << 1));
+            addIndex(BSON("bar" << 1));
+
+            WorkingSet ws;
+            // Room for a handful of WSMs only.
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, 2048));
+
+            // Foo >= 0
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 0);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            ah->addChild(new IndexScan(params, &ws, NULL));
+
+            // Bar >= 0
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            ah->addChild(new IndexScan(params, &ws, NULL));
+
+            PlanStage::StageState status = PlanStage::NEED_TIME;
+            for (int i = 0; i < 100 && PlanStage::NEED_TIME == status; ++i) {
+                WorkingSetID id;
+                status = ah->work(&id);
+            }
+            ASSERT_EQUALS(PlanStage::FAILURE, status);
+
+            scoped_ptr<PlanStageStats> stats(ah->getStats());
+            AndHashStats* spec = static_cast<AndHashStats*>(stats->specific.get());
+            ASSERT_GREATER_THAN(spec->memUsage, spec->memLimit);
+        }
+    };
+
     // An AND that scans data but returns nothing.
     class QueryStageAndHashProducesNothing : public QueryStageAndBase {
     public:
@@ -775,6 +825,7 @@ namespace QueryStageAnd {
             add<QueryStageAndHashInvalidation>();
             add<QueryStageAndHashThreeLeaf>();
             add<QueryStageAndHashWithNothing>();
+            add<QueryStageAndHashTooLarge>();
             add<QueryStageAndHashProducesNothing>();
             add<QueryStageAndHashWithMatcher>();
             add<QueryStageAndSortedInvalidation>();
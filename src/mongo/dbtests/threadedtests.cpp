@@ -34,7 +34,9 @@
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
+#include "mongo/base/counter.h"
 #include "mongo/bson/util/atomic_int.h"
+#include "mongo/db/catalog/database_holder.h"
 #include "mongo/db/d_concurrency.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/platform/atomic_word.h"
@@ -339,6 +341,33 @@ namespace ThreadedTests {
         }
     };
 
+    /**
+     * Every thread hammers one counter; checks the total and reports the cost per increment,
+     * to compare a single shared word against per thread stripes.
+     */
+    template <typename CounterType>
+    class CounterContention : public ThreadedTest<16> {
+        static const int iterations = 1000000;
+        CounterType target;
+        Timer t;
+
+        virtual void setup() {
+            t.reset();
+        }
+        virtual void subthread(int) {
+            for(int i=0; i < iterations; i++) {
+                target.increment();
+            }
+        }
+        virtual void validate() {
+            long long micros = t.micros();
+            ASSERT_EQUALS(target.get(), (long long)nthreads * iterations);
+            cout << typeid(CounterType).name() << " " << nthreads << " threads: "
+                 << ( micros * 1000.0 ) / ( (double)nthreads * iterations )
+                 << "ns per increment" << endl;
+        }
+    };
+
     class MVarTest : public ThreadedTest<> {
         static const int iterations = 10000;
         MVar<int> target;
@@ -981,6 +1010,150 @@ namespace ThreadedTests {
 
     };
 
+    // Many threads resolving the same Database and Collection, as every operation does; reports
+    // the cost of a lookup
+    class CatalogLookups : public ThreadedTest<16> {
+        static const int iterations = 200000;
+        Timer t;
+
+        static const char* ns() { return "unittests.threadedtests_catalog"; }
+
+        virtual void setup() {
+            Client::WriteContext ctx( ns() );
+            Database* db = ctx.ctx().db();
+            if ( !db->getCollection( ns() ) )
+                db->createCollection( ns() );
+            t.reset();
+        }
+        virtual void subthread(int x) {
+            string threadName = ( str::stream() << "catalogLookups" << x );
+            Client::initThread( threadName.c_str() );
+            {
+                Lock::DBRead lk( ns() );
+                for ( int i = 0; i < iterations; i++ ) {
+                    Database* db = dbHolder().get( ns(), storageGlobalParams.dbpath );
+                    ASSERT( db );
+                    ASSERT( db->getCollection( ns() ) );
+                }
+            }
+            cc().shutdown();
+        }
+        virtual void validate() {
+            long long micros = t.micros();
+            cout << "catalog lookups " << nthreads << " threads: "
+                 << ( micros * 1000.0 ) / ( (double)nthreads * iterations )
+                 << "ns per lookup" << endl;
+
+            Client::WriteContext ctx( ns() );
+            ctx.ctx().db()->dropCollection( ns() );
+        }
+    };
+
+    // Checks that PriorityTicketHolder hands tickets to the priority queue first, then to
+    // normal waiters in the order they arrived
+    class PriorityTicketHolderOrder {
+    public:
+        PriorityTicketHolderOrder() : _orderMutex( "order" ) {}
+
+        void run() {
+            PriorityTicketHolder holder( 1 );
+            ASSERT( holder.tryAcquire() );
+
+            boost::thread a( boost::bind( &PriorityTicketHolderOrder::enter, this, &holder,
+                                          PriorityTicketHolder::NORMAL, 1 ) );
+            waitForQueued( holder, 1 );
+            boost::thread b( boost::bind( &PriorityTicketHolderOrder::enter, this, &holder,
+                                          PriorityTicketHolder::NORMAL, 2 ) );
+            waitForQueued( holder, 2 );
+            boost::thread c( boost::bind( &PriorityTicketHolderOrder::enter, this, &holder,
+                                          PriorityTicketHolder::HIGH, 3 ) );
+            waitForQueued( holder, 3 );
+
+            holder.release();
+            a.join();
+            b.join();
+            c.join();
+
+            ASSERT_EQUALS( 3U, _order.size() );
+            ASSERT_EQUALS( 3, _order[0] );
+            ASSERT_EQUALS( 1, _order[1] );
+            ASSERT_EQUALS( 2, _order[2] );
+
+            PriorityTicketHolder::Stats stats = holder.getStats();
+            ASSERT_EQUALS( 0, stats.used );
+            ASSERT_EQUALS( 2, stats.waits[PriorityTicketHolder::NORMAL] );
+            ASSERT_EQUALS( 1, stats.waits[PriorityTicketHolder::HIGH] );
+
+            // growing the pool lets queued waiters in without a release
+            ASSERT( holder.tryAcquire() );
+            boost::thread d( boost::bind( &PriorityTicketHolder::waitForTicket, &holder,
+                                          PriorityTicketHolder::NORMAL ) );
+            waitForQueued( holder, 1 );
+            holder.resize( 2 );
+            d.join();
+            ASSERT_EQUALS( 2, holder.getStats().used );
+        }
+
+    private:
+        void enter( PriorityTicketHolder* holder, PriorityTicketHolder::Priority priority, int id ) {
+            holder->waitForTicket( priority );
+            {
+                scoped_lock lk( _orderMutex );
+                _order.push_back( id );
+            }
+            holder->release();
+        }
+
+        static void waitForQueued( const PriorityTicketHolder& holder, int n ) {
+            for ( ;; ) {
+                PriorityTicketHolder::Stats stats = holder.getStats();
+                if ( stats.queued[PriorityTicketHolder::NORMAL] +
+                     stats.queued[PriorityTicketHolder::HIGH] == n )
+                    return;
+                sleepmillis( 1 );
+            }
+        }
+
+        mongo::mutex _orderMutex;
+        vector<int> _order;
+    };
+
+    // Checks that tickets reserved for the priority queue can't be taken by normal waiters
+    class PriorityTicketHolderReserved {
+    public:
+        void run() {
+            PriorityTicketHolder holder( 2 );
+            holder.setReserved( 1 );
+            ASSERT( holder.tryAcquire() );
+            ASSERT( !holder.tryAcquire() );
+
+            boost::thread normal( boost::bind( &PriorityTicketHolder::waitForTicket, &holder,
+                                               PriorityTicketHolder::NORMAL ) );
+            while ( holder.getStats().queued[PriorityTicketHolder::NORMAL] != 1 )
+                sleepmillis( 1 );
+
+            // the reserved ticket is still there for a priority waiter, without queueing
+            holder.waitForTicket( PriorityTicketHolder::HIGH );
+            ASSERT_EQUALS( 2, holder.getStats().used );
+            ASSERT_EQUALS( 0, holder.getStats().waits[PriorityTicketHolder::HIGH] );
+
+            // giving back the reserved ticket doesn't let the normal waiter in
+            holder.release();
+            ASSERT_EQUALS( 1, holder.getStats().queued[PriorityTicketHolder::NORMAL] );
+
+            holder.release();
+            normal.join();
+            ASSERT_EQUALS( 1, holder.getStats().used );
+            holder.release();
+
+            // a pool can't be reserved entirely
+            PriorityTicketHolder small( 1 );
+            small.setReserved( 1 );
+            ASSERT( small.tryAcquire() );
+            small.release();
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "threading" ) { }
@@ -1005,6 +1178,8 @@ namespace ThreadedTests {
             add< IsAtomicUIntAtomic >();
             add< IsAtomicWordAtomic<AtomicUInt32> >();
             add< IsAtomicWordAtomic<AtomicUInt64> >();
+            add< CounterContention<Counter64> >();
+            add< CounterContention<StripedCounter64> >();
             add< MVarTest >();
             add< ThreadPoolTest >();
             add< LockTest >();
@@ -1017,6 +1192,9 @@ namespace ThreadedTests {
 
             add< MongoMutexTest >();
             add< TicketHolderWaits >();
+            add< PriorityTicketHolderOrder >();
+            add< PriorityTicketHolderReserved >();
+            add< CatalogLookups >();
         }
     } myall;
 }
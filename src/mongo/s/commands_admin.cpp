@@ -550,7 +550,7 @@ namespace mongo {
                 //    is "useful" for the proposed key.  A "useful" index is defined as follows
                 //    Useful Index:
                 //         i. contains proposedKey as a prefix
-                //         ii. is not sparse
+                //         ii. is not sparse or partial
                 //         iii. contains no null values
                 //         iv. is not multikey (maybe lift this restriction later)
                 //         v. if a hashed index, has default seed (lift this restriction later)
@@ -601,7 +601,9 @@ namespace mongo {
                     allIndexes.append( idx );
                     BSONObj currentKey = idx["key"].embeddedObject();
                     // Check 2.i. and 2.ii.
-                    if ( ! idx["sparse"].trueValue() && proposedKey.isPrefixOf( currentKey ) ) {
+                    if ( ! idx["sparse"].trueValue()
+                         && idx["partialFilterExpression"].eoo()
+                         && proposedKey.isPrefixOf( currentKey ) ) {
 
                         // We can't currently use hashed indexes with a non-default hash seed
                         // Check v.
@@ -47,6 +47,7 @@
 #include "mongo/db/max_time.h"
 #include "mongo/util/concurrency/task.h"
 #include "mongo/util/net/listen.h"
+#include "mongo/util/time_support.h"
 
 namespace mongo {
     const int ShardedClientCursor::INIT_REPLY_BUFFER_SIZE = 32768;
@@ -174,31 +175,78 @@ namespace mongo {
         return sr->nextInt64();
     }
 
+    namespace {
+        // Two clock reads around an uncontended lock can differ by a microsecond on their own.
+        const unsigned long long kContendedWaitMicros = 2;
+    }
+
+    /** Locks a stripe, recording the acquisition and any time spent waiting for it. */
+    class CursorCache::StripeLock : boost::noncopyable {
+    public:
+        explicit StripeLock( Stripe& stripe )
+            : _start( curTimeMicros64() ),
+              _lk( stripe.mutex ) {
+            unsigned long long waited = curTimeMicros64() - _start;
+            stripe.acquisitions++;
+            if ( waited >= kContendedWaitMicros ) {
+                stripe.contended++;
+                stripe.waitMicros += waited;
+            }
+        }
+    private:
+        unsigned long long _start;
+        scoped_lock _lk;
+    };
+
+    CursorCache::Stripe::Stripe()
+        : mutex( "CursorCacheStripe" ),
+          shardedTotal( 0 ),
+          acquisitions( 0 ),
+          contended( 0 ),
+          waitMicros( 0 ) {
+    }
+
     CursorCache::CursorCache()
-        :_mutex( "CursorCache" ),
-         _random( getCCRandomSeed() ),
-         _shardedTotal(0) {
+        :_randomMutex( "CursorCacheRandom" ),
+         _random( getCCRandomSeed() ) {
     }
 
     CursorCache::~CursorCache() {
         // TODO: delete old cursors?
+        size_t sharded = 0;
+        size_t refs = 0;
+        for ( int s = 0; s < kNumStripes; s++ ) {
+            verify( _stripes[s].refs.size() == _stripes[s].refsNS.size() );
+            sharded += _stripes[s].cursors.size();
+            refs += _stripes[s].refs.size();
+        }
+
         bool print = logger::globalLogDomain()->shouldLog(logger::LogSeverity::Debug(1));
-        if ( _cursors.size() || _refs.size() )
+        if ( sharded || refs )
             print = true;
-        verify(_refs.size() == _refsNS.size());
-        
+
         if ( print ) 
             log() << " CursorCache at shutdown - "
-                  << " sharded: " << _cursors.size()
-                  << " passthrough: " << _refs.size()
+                  << " sharded: " << sharded
+                  << " passthrough: " << refs
                   << endl;
     }
 
+    CursorCache::Stripe& CursorCache::_stripeFor( long long id ) const {
+        // The low word of a mongos id is random, but passthrough ids come from the shards, so
+        // fold the halves together rather than trusting either one.
+        unsigned long long x = static_cast<unsigned long long>( id );
+        x ^= x >> 32;
+        x ^= x >> 16;
+        return _stripes[ x % kNumStripes ];
+    }
+
     ShardedClientCursorPtr CursorCache::get( long long id ) const {
         LOG(_myLogLevel) << "CursorCache::get id: " << id << endl;
-        scoped_lock lk( _mutex );
-        MapSharded::const_iterator i = _cursors.find( id );
-        if ( i == _cursors.end() ) {
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        MapSharded::const_iterator i = stripe.cursors.find( id );
+        if ( i == stripe.cursors.end() ) {
             OCCASIONALLY log() << "Sharded CursorCache missing cursor id: " << id << endl;
             return ShardedClientCursorPtr();
         }
@@ -208,9 +256,10 @@ namespace mongo {
 
     int CursorCache::getMaxTimeMS( long long id ) const {
         verify( id );
-        scoped_lock lk( _mutex );
-        MapShardedInt::const_iterator i = _cursorsMaxTimeMS.find( id );
-        return ( i != _cursorsMaxTimeMS.end() ) ? i->second : 0;
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        MapShardedInt::const_iterator i = stripe.cursorsMaxTimeMS.find( id );
+        return ( i != stripe.cursorsMaxTimeMS.end() ) ? i->second : 0;
     }
 
     void CursorCache::store( ShardedClientCursorPtr cursor, int maxTimeMS ) {
@@ -222,10 +271,11 @@ namespace mongo {
         verify( maxTimeMS == kMaxTimeCursorTimeLimitExpired
                 || maxTimeMS == kMaxTimeCursorNoTimeLimit
                 || maxTimeMS > 0 );
-        scoped_lock lk( _mutex );
-        _cursorsMaxTimeMS[cursor->getId()] = maxTimeMS;
-        _cursors[cursor->getId()] = cursor;
-        _shardedTotal++;
+        Stripe& stripe = _stripeFor( cursor->getId() );
+        StripeLock lk( stripe );
+        stripe.cursorsMaxTimeMS[cursor->getId()] = maxTimeMS;
+        stripe.cursors[cursor->getId()] = cursor;
+        stripe.shardedTotal++;
     }
 
     void CursorCache::updateMaxTimeMS( long long id, int maxTimeMS ) {
@@ -233,53 +283,67 @@ namespace mongo {
         verify( maxTimeMS == kMaxTimeCursorTimeLimitExpired
                 || maxTimeMS == kMaxTimeCursorNoTimeLimit
                 || maxTimeMS > 0 );
-        scoped_lock lk( _mutex );
-        _cursorsMaxTimeMS[id] = maxTimeMS;
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        stripe.cursorsMaxTimeMS[id] = maxTimeMS;
     }
 
     void CursorCache::remove( long long id ) {
         verify( id );
-        scoped_lock lk( _mutex );
-        _cursorsMaxTimeMS.erase( id );
-        _cursors.erase( id );
+        // Destroying a cursor can talk to the shards, so let it go after unlocking.
+        ShardedClientCursorPtr doomed;
+        {
+            Stripe& stripe = _stripeFor( id );
+            StripeLock lk( stripe );
+            stripe.cursorsMaxTimeMS.erase( id );
+            MapSharded::iterator i = stripe.cursors.find( id );
+            if ( i != stripe.cursors.end() ) {
+                doomed = i->second;
+                stripe.cursors.erase( i );
+            }
+        }
     }
     
     void CursorCache::removeRef( long long id ) {
         verify( id );
-        scoped_lock lk( _mutex );
-        _refs.erase( id );
-        _refsNS.erase( id );
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        stripe.refs.erase( id );
+        stripe.refsNS.erase( id );
     }
 
     void CursorCache::storeRef(const std::string& server, long long id, const std::string& ns) {
         LOG(_myLogLevel) << "CursorCache::storeRef server: " << server << " id: " << id << endl;
         verify( id );
-        scoped_lock lk( _mutex );
-        _refs[id] = server;
-        _refsNS[id] = ns;
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        stripe.refs[id] = server;
+        stripe.refsNS[id] = ns;
     }
 
     string CursorCache::getRef( long long id ) const {
         verify( id );
-        scoped_lock lk( _mutex );
-        MapNormal::const_iterator i = _refs.find( id );
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        MapNormal::const_iterator i = stripe.refs.find( id );
 
-        LOG(_myLogLevel) << "CursorCache::getRef id: " << id << " out: " << ( i == _refs.end() ? " NONE " : i->second ) << endl;
+        LOG(_myLogLevel) << "CursorCache::getRef id: " << id << " out: " << ( i == stripe.refs.end() ? " NONE " : i->second ) << endl;
 
-        if ( i == _refs.end() )
+        if ( i == stripe.refs.end() )
             return "";
         return i->second;
     }
 
     std::string CursorCache::getRefNS(long long id) const {
         verify(id);
-        scoped_lock lk(_mutex);
-        MapNormal::const_iterator i = _refsNS.find(id);
+        Stripe& stripe = _stripeFor( id );
+        StripeLock lk( stripe );
+        MapNormal::const_iterator i = stripe.refsNS.find(id);
 
         LOG(_myLogLevel) << "CursorCache::getRefNs id: " << id
-                << " out: " << ( i == _refsNS.end() ? " NONE " : i->second ) << std::endl;
+                << " out: " << ( i == stripe.refsNS.end() ? " NONE " : i->second ) << std::endl;
 
-        if ( i == _refsNS.end() )
+        if ( i == stripe.refsNS.end() )
             return "";
         return i->second;
     }
@@ -287,10 +351,12 @@ namespace mongo {
 
     long long CursorCache::genId() {
         while ( true ) {
-            scoped_lock lk( _mutex );
-
-            long long x = Listener::getElapsedTimeMillis() << 32;
-            x |= _random.nextInt32();
+            long long x;
+            {
+                scoped_lock lk( _randomMutex );
+                x = Listener::getElapsedTimeMillis() << 32;
+                x |= _random.nextInt32();
+            }
 
             if ( x == 0 )
                 continue;
@@ -298,12 +364,15 @@ namespace mongo {
             if ( x < 0 )
                 x *= -1;
 
-            MapSharded::iterator i = _cursors.find( x );
-            if ( i != _cursors.end() )
+            Stripe& stripe = _stripeFor( x );
+            StripeLock lk( stripe );
+
+            MapSharded::iterator i = stripe.cursors.find( x );
+            if ( i != stripe.cursors.end() )
                 continue;
 
-            MapNormal::iterator j = _refs.find( x );
-            if ( j != _refs.end() )
+            MapNormal::iterator j = stripe.refs.find( x );
+            if ( j != stripe.refs.end() )
                 continue;
 
             return x;
@@ -336,11 +405,13 @@ namespace mongo {
             }
 
             string server;
+            ShardedClientCursorPtr doomed; // destroyed after the stripe is unlocked
             {
-                scoped_lock lk( _mutex );
+                Stripe& stripe = _stripeFor( id );
+                StripeLock lk( stripe );
 
-                MapSharded::iterator i = _cursors.find( id );
-                if ( i != _cursors.end() ) {
+                MapSharded::iterator i = stripe.cursors.find( id );
+                if ( i != stripe.cursors.end() ) {
                     const bool isAuthorized = authSession->isAuthorizedForActionsOnNamespace(
                             NamespaceString(i->second->getNS()), ActionType::killCursors);
                     audit::logKillCursorsAuthzCheck(
@@ -349,19 +420,20 @@ namespace mongo {
                             id,
                             isAuthorized ? ErrorCodes::OK : ErrorCodes::Unauthorized);
                     if (isAuthorized) {
-                        _cursorsMaxTimeMS.erase( i->second->getId() );
-                        _cursors.erase( i );
+                        stripe.cursorsMaxTimeMS.erase( i->second->getId() );
+                        doomed = i->second;
+                        stripe.cursors.erase( i );
                     }
                     continue;
                 }
 
-                MapNormal::iterator refsIt = _refs.find(id);
-                MapNormal::iterator refsNSIt = _refsNS.find(id);
-                if (refsIt == _refs.end()) {
+                MapNormal::iterator refsIt = stripe.refs.find(id);
+                MapNormal::iterator refsNSIt = stripe.refsNS.find(id);
+                if (refsIt == stripe.refs.end()) {
                     warning() << "can't find cursor: " << id << endl;
                     continue;
                 }
-                verify(refsNSIt != _refsNS.end());
+                verify(refsNSIt != stripe.refsNS.end());
                 const bool isAuthorized = authSession->isAuthorizedForActionsOnNamespace(
                         NamespaceString(refsNSIt->second), ActionType::killCursors);
                 audit::logKillCursorsAuthzCheck(
@@ -373,8 +445,8 @@ namespace mongo {
                     continue;
                 }
                 server = refsIt->second;
-                _refs.erase(refsIt);
-                _refsNS.erase(refsNSIt);
+                stripe.refs.erase(refsIt);
+                stripe.refsNS.erase(refsNSIt);
             }
 
             LOG(_myLogLevel) << "CursorCache::found gotKillCursors id: " << id << " server: " << server << endl;
@@ -387,28 +459,55 @@ namespace mongo {
     }
 
     void CursorCache::appendInfo( BSONObjBuilder& result ) const {
-        scoped_lock lk( _mutex );
-        result.append( "sharded" , (int)_cursors.size() );
-        result.appendNumber( "shardedEver" , _shardedTotal );
-        result.append( "refs" , (int)_refs.size() );
-        result.append( "totalOpen" , (int)(_cursors.size() + _refs.size() ) );
+        long long sharded = 0;
+        long long shardedEver = 0;
+        long long refs = 0;
+        BSONArrayBuilder stripes;
+        for ( int s = 0; s < kNumStripes; s++ ) {
+            Stripe& stripe = _stripes[s];
+            StripeLock lk( stripe );
+            sharded += stripe.cursors.size();
+            shardedEver += stripe.shardedTotal;
+            refs += stripe.refs.size();
+
+            BSONObjBuilder b( stripes.subobjStart() );
+            b.append( "sharded" , (int)stripe.cursors.size() );
+            b.append( "refs" , (int)stripe.refs.size() );
+            b.appendNumber( "acquisitions" , stripe.acquisitions );
+            b.appendNumber( "contended" , stripe.contended );
+            b.appendNumber( "waitMicros" , stripe.waitMicros );
+            b.done();
+        }
+
+        result.append( "sharded" , (int)sharded );
+        result.appendNumber( "shardedEver" , shardedEver );
+        result.append( "refs" , (int)refs );
+        result.append( "totalOpen" , (int)( sharded + refs ) );
+        result.append( "stripes" , stripes.arr() );
     }
 
     void CursorCache::doTimeouts() {
         long long now = Listener::getElapsedTimeMillis();
-        scoped_lock lk( _mutex );
-        for ( MapSharded::iterator i=_cursors.begin(); i!=_cursors.end(); ++i ) {
-            // Note: cursors with no timeout will always have an idleTime of 0
-            long long idleFor = i->second->idleTime( now );
-            if ( idleFor < TIMEOUT ) {
-                continue;
+        for ( int s = 0; s < kNumStripes; s++ ) {
+            // Destroying a cursor can talk to the shards, so let them go after unlocking.
+            vector<ShardedClientCursorPtr> doomed;
+            {
+                Stripe& stripe = _stripes[s];
+                StripeLock lk( stripe );
+                MapSharded::iterator i = stripe.cursors.begin();
+                while ( i != stripe.cursors.end() ) {
+                    // Note: cursors with no timeout will always have an idleTime of 0
+                    long long idleFor = i->second->idleTime( now );
+                    if ( idleFor < TIMEOUT ) {
+                        ++i;
+                        continue;
+                    }
+                    log() << "killing old cursor " << i->second->getId() << " idle for: " << idleFor << "ms" << endl; // TODO: make LOG(1)
+                    stripe.cursorsMaxTimeMS.erase( i->first );
+                    doomed.push_back( i->second );
+                    stripe.cursors.erase( i++ );
+                }
             }
-            log() << "killing old cursor " << i->second->getId() << " idle for: " << idleFor << "ms" << endl; // TODO: make LOG(1)
-            _cursorsMaxTimeMS.erase( i->second->getId() );
-            _cursors.erase( i );
-            i = _cursors.begin(); // possible 2nd entry will get skipped, will get on next pass
-            if ( i == _cursors.end() )
-                break;
         }
     }
 
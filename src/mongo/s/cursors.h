@@ -133,29 +133,53 @@ namespace mongo {
 
         long long genId();
 
+        /** Kills idle sharded cursors, locking one stripe at a time. */
         void doTimeouts();
         void startTimeoutThread();
     private:
-        mutable mongo::mutex _mutex;
+        class StripeLock;
 
-        PseudoRandom _random;
+        /**
+         * Cursors are spread over stripes by id so that getMores, stores and kills for
+         * different cursors don't all queue on one mutex.
+         */
+        struct Stripe {
+            Stripe();
 
-        // Maps sharded cursor ID to ShardedClientCursorPtr.
-        MapSharded _cursors;
+            mongo::mutex mutex;
 
-        // Maps sharded cursor ID to remaining max time.  Value can be any of:
-        // - the constant "kMaxTimeCursorNoTimeLimit", or
-        // - the constant "kMaxTimeCursorTimeLimitExpired", or
-        // - a positive integer representing milliseconds of remaining time
-        MapShardedInt _cursorsMaxTimeMS;
+            // Maps sharded cursor ID to ShardedClientCursorPtr.
+            MapSharded cursors;
 
-        // Maps passthrough cursor ID to shard name.
-        MapNormal _refs;
+            // Maps sharded cursor ID to remaining max time.  Value can be any of:
+            // - the constant "kMaxTimeCursorNoTimeLimit", or
+            // - the constant "kMaxTimeCursorTimeLimitExpired", or
+            // - a positive integer representing milliseconds of remaining time
+            MapShardedInt cursorsMaxTimeMS;
 
-        // Maps passthrough cursor ID to namespace.
-        MapNormal _refsNS;
-        
-        long long _shardedTotal;
+            // Maps passthrough cursor ID to shard name.
+            MapNormal refs;
+
+            // Maps passthrough cursor ID to namespace.
+            MapNormal refsNS;
+
+            long long shardedTotal;
+
+            // Lock statistics for cursorInfo, only touched with the mutex held.
+            long long acquisitions;
+            long long contended;
+            long long waitMicros;
+        };
+
+        static const int kNumStripes = 16;
+
+        Stripe& _stripeFor( long long id ) const;
+
+        mutable Stripe _stripes[kNumStripes];
+
+        // Guards _random, which genId uses before it knows which stripe to look in.
+        mongo::mutex _randomMutex;
+        PseudoRandom _random;
 
         static const int _myLogLevel;
     };
@@ -30,6 +30,8 @@
 
 #include "mongo/s/version_manager.h"
 
+#include "mongo/base/counter.h"
+#include "mongo/db/commands/server_status.h"
 #include "mongo/s/chunk.h"
 #include "mongo/s/chunk_version.h"
 #include "mongo/s/config.h"
@@ -43,23 +45,54 @@ namespace mongo {
     // Global version manager
     VersionManager versionManager;
 
+    // setShardVersion commands sent by checkShardVersion, and those skipped because the
+    // connection already had the version for the namespace
+    static Counter64 setShardVersionSent;
+    static ServerStatusMetricField<Counter64> displaySetShardVersionSent(
+                                                    "sharding.setShardVersion.sent",
+                                                    &setShardVersionSent );
+    static Counter64 setShardVersionAvoided;
+    static ServerStatusMetricField<Counter64> displaySetShardVersionAvoided(
+                                                    "sharding.setShardVersion.avoided",
+                                                    &setShardVersionAvoided );
+
     // when running in sharded mode, use chunk shard version control
     struct ConnectionShardStatus {
 
         typedef unsigned long long S;
 
+        // what the connection was last told about a namespace
+        struct NSStatus {
+            NSStatus() : sequence( 0 ), versionSent( false ) {}
+
+            // the ChunkManager sequence number the connection is up to date with
+            S sequence;
+            // the version last set on the connection, if versionSent
+            ChunkVersion version;
+            bool versionSent;
+        };
+
         ConnectionShardStatus()
             : _mutex( "ConnectionShardStatus" ) {
         }
 
-        S getSequence( DBClientBase * conn , const string& ns ) {
+        NSStatus getStatus( DBClientBase * conn , const string& ns ) {
             scoped_lock lk( _mutex );
             return _map[conn->getConnectionId()][ns];
         }
 
         void setSequence( DBClientBase * conn , const string& ns , const S& s ) {
             scoped_lock lk( _mutex );
-            _map[conn->getConnectionId()][ns] = s;
+            _map[conn->getConnectionId()][ns].sequence = s;
+        }
+
+        void setVersion( DBClientBase * conn , const string& ns , const S& s ,
+                         const ChunkVersion& version ) {
+            scoped_lock lk( _mutex );
+            NSStatus& status = _map[conn->getConnectionId()][ns];
+            status.sequence = s;
+            status.version = version;
+            status.versionSent = true;
         }
 
         void reset( DBClientBase * conn ) {
@@ -70,8 +103,8 @@ namespace mongo {
         // protects _map
         mongo::mutex _mutex;
 
-        // a map from a connection into ChunkManager's sequence number for each namespace
-        map<unsigned long long, map<string,unsigned long long> > _map;
+        // a map from a connection into what it was last told for each namespace
+        map<unsigned long long, map<string,NSStatus> > _map;
 
     } connectionShardStatus;
 
@@ -247,7 +280,8 @@ namespace mongo {
 
         // has the ChunkManager been reloaded since the last time we updated the connection-level version?
         // (ie., last time we issued the setShardVersions below)
-        unsigned long long sequenceNumber = connectionShardStatus.getSequence(conn,ns);
+        ConnectionShardStatus::NSStatus status = connectionShardStatus.getStatus(conn,ns);
+        unsigned long long sequenceNumber = status.sequence;
         if ( sequenceNumber == officialSequenceNumber ) {
             return false;
         }
@@ -258,6 +292,19 @@ namespace mongo {
             version = manager->getVersion( Shard::make( conn->getServerAddress() ) );
         }
 
+        // A reload caused by chunk changes on other shards leaves this shard's version alone,
+        // and the connection already has it.  Authoritative calls come from stale config
+        // handling and always go to the shard.
+        if ( ! authoritative && status.versionSent && version.isSet() &&
+             status.version.isEquivalentTo( version ) &&
+             status.version.epoch() == version.epoch() ) {
+            LOG(3) << "connection to " << conn->getServerAddress() << " already has version "
+                   << version << " for " << ns << ", not resending" << endl;
+            connectionShardStatus.setSequence( conn , ns , officialSequenceNumber );
+            setShardVersionAvoided.increment();
+            return false;
+        }
+
         if( ! version.isSet() ){
             LOG(0) << "resetting shard version of " << ns << " on " << conn->getServerAddress() << ", " <<
                       ( ! isSharded ? "no longer sharded" :
@@ -274,10 +321,11 @@ namespace mongo {
         const string versionableServerAddress(conn->getServerAddress());
 
         BSONObj result;
+        setShardVersionSent.increment();
         if ( setShardVersion( *conn , ns , version , manager , authoritative , result ) ) {
             // success!
             LOG(1) << "      setShardVersion success: " << result << endl;
-            connectionShardStatus.setSequence( conn , ns , officialSequenceNumber );
+            connectionShardStatus.setVersion( conn , ns , officialSequenceNumber , version );
             return true;
         }
 
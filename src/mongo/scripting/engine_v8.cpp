@@ -93,6 +93,64 @@ namespace mongo {
         bsonHolderTracker.track(p, holder);
     }
 
+    BSONElement BSONHolder::getField(const StringData& name) {
+        // A few lookups are cheaper as scans than building the index.
+        static const int kLookupsBeforeIndex = 4;
+
+        if (_fieldIndex.empty()) {
+            if (++_lookups <= kLookupsBeforeIndex)
+                return _obj.getField(name);
+            BSONForEach(elem, _obj) {
+                // insert() keeps the first of any duplicate names, as getField() would.
+                _fieldIndex.insert(make_pair(elem.fieldNameStringData(), elem));
+            }
+        }
+        unordered_map<StringData, BSONElement, StringData::Hasher>::const_iterator it =
+            _fieldIndex.find(name);
+        return it == _fieldIndex.end() ? BSONElement() : it->second;
+    }
+
+    /**
+     * Called after handing out the value of a field.  Lazy subobjects record their own changes
+     * and are checked when the base object is converted back, but arrays and DBRefs are plain
+     * JavaScript objects that may get modified without the base object knowing, so the base
+     * has to be marked as modified and some optim is lost.
+     */
+    static void markHolderForSubobject(V8Scope* scope, BSONHolder* holder,
+                                       const BSONElement& elmt, const v8::Handle<v8::Value>& val) {
+        if (elmt.type() == mongo::Array ||
+            (elmt.type() == mongo::Object && !scope->LazyBsonFT()->HasInstance(val))) {
+            holder->_modified = true;
+        }
+    }
+
+    /**
+     * True if the lazy object 'obj' or any lazy subobject handed out from it has been changed
+     * since it was wrapped.
+     */
+    static bool lazyBsonModified(V8Scope* scope, const v8::Handle<v8::Object>& obj,
+                                 BSONHolder* holder) {
+        if (holder->_modified)
+            return true;
+
+        v8::Handle<v8::Object> realObject = unwrapObject(scope, obj);
+        if (realObject.IsEmpty())
+            return true;
+
+        v8::Handle<v8::Array> fields = realObject->GetOwnPropertyNames();
+        const uint32_t len = fields->Length();
+        for (uint32_t i = 0; i < len; ++i) {
+            v8::Handle<v8::Value> value = realObject->Get(fields->Get(i));
+            if (!value->IsObject())
+                continue;
+            v8::Handle<v8::Object> child = value->ToObject();
+            BSONHolder* childHolder = unwrapHolder(scope, child);
+            if (childHolder && lazyBsonModified(scope, child, childHolder))
+                return true;
+        }
+        return false;
+    }
+
     static v8::Handle<v8::Value> namedGet(v8::Local<v8::String> name,
                                           const v8::AccessorInfo& info) {
         v8::HandleScope handle_scope;
@@ -106,28 +164,26 @@ namespace mongo {
                 return handle_scope.Close(realObject->Get(name));
             }
 
-            string key = toSTLString(name);
             BSONHolder* holder = unwrapHolder(scope, info.Holder());
-            if (!holder || holder->_removed.count(key))
+            if (!holder)
                 return handle_scope.Close(v8::Handle<v8::Value>());
 
-            BSONObj obj = holder->_obj;
-            BSONElement elmt = obj.getField(key.c_str());
+            V8String key(name);
+            if (holder->isRemoved(key))
+                return handle_scope.Close(v8::Handle<v8::Value>());
+
+            BSONElement elmt = holder->getField(key);
             if (elmt.eoo())
                 return handle_scope.Close(v8::Handle<v8::Value>());
 
             val = scope->mongoToV8Element(elmt, holder->_readOnly);
 
-            if (obj.objsize() > 128 || val->IsObject()) {
+            if (holder->_obj.objsize() > 128 || val->IsObject()) {
                 // Only cache if expected to help (large BSON) or is required due to js semantics
                 realObject->Set(name, val);
             }
 
-            if (elmt.type() == mongo::Object || elmt.type() == mongo::Array) {
-              // if accessing a subobject, it may get modified and base obj would not know
-              // have to set base as modified, which means some optim is lost
-              holder->_modified = true;
-            }
+            markHolderForSubobject(scope, holder, elmt, val);
         }
         catch (const DBException &dbEx) {
             return v8AssertionException(dbEx.toString());
@@ -226,21 +282,16 @@ namespace mongo {
 
             BSONHolder* holder = unwrapHolder(scope, info.Holder());
             if (!holder) return v8::Handle<v8::Value>();
-            if (holder->_removed.count(key))
+            if (holder->isRemoved(key))
                 return handle_scope.Close(v8::Handle<v8::Value>());
 
-            BSONObj obj = holder->_obj;
-            BSONElement elmt = obj.getField(key);
+            BSONElement elmt = holder->getField(key);
             if (elmt.eoo())
                 return handle_scope.Close(v8::Handle<v8::Value>());
             val = scope->mongoToV8Element(elmt, holder->_readOnly);
             realObject->Set(index, val);
 
-            if (elmt.type() == mongo::Object || elmt.type() == mongo::Array) {
-                // if accessing a subobject, it may get modified and base obj would not know
-                // have to set base as modified, which means some optim is lost
-                holder->_modified = true;
-            }
+            markHolderForSubobject(scope, holder, elmt, val);
         }
         catch (const DBException &dbEx) {
             return v8AssertionException(dbEx.toString());
@@ -1651,9 +1702,12 @@ namespace mongo {
         if (LazyBsonFT()->HasInstance(o)) {
             originalBSON = unwrapBSONObj(this, o);
             BSONHolder* holder = unwrapHolder(this, o);
-            if (holder && !holder->_modified) {
-                // object was not modified, use bson as is
-                return originalBSON;
+            if (holder) {
+                if (!lazyBsonModified(this, o, holder)) {
+                    // object was not modified, use bson as is
+                    return originalBSON;
+                }
+                return lazyBsonToMongo(holder, o, depth);
             }
         }
 
@@ -1688,6 +1742,63 @@ namespace mongo {
         return b.obj(); // Would give an uglier error than above for oversized objects.
     }
 
+    BSONObj V8Scope::lazyBsonToMongo(BSONHolder* holder, v8::Handle<v8::Object> o, int depth) {
+        v8::Handle<v8::Object> realObject = unwrapObject(this, o);
+        uassert(17409, "lazy BSON object is missing its property store", !realObject.IsEmpty());
+
+        BSONObjBuilder b(holder->_obj.objsize());
+        unordered_set<StringData, StringData::Hasher> added;
+
+        // The _id field of top-level objects goes first, as in v8ToMongo.
+        const bool idFirst = (depth == 0);
+        if (idFirst) {
+            v8::Handle<v8::String> idName = strLitToV8("_id");
+            if (realObject->HasOwnProperty(idName)) {
+                v8ToMongoElement(b, "_id", realObject->Get(idName), 0, &holder->_obj);
+            }
+            else if (!holder->isRemoved("_id")) {
+                BSONElement id = holder->getField("_id");
+                if (!id.eoo())
+                    b.append(id);
+            }
+        }
+
+        // Original fields keep their order.  Those JavaScript never stored a value for are
+        // unchanged and go across as raw BSON.
+        BSONForEach(elem, holder->_obj) {
+            StringData name = elem.fieldNameStringData();
+            if ((idFirst && name == "_id") || holder->isRemoved(name) || !added.insert(name).second)
+                continue;
+
+            v8::Handle<v8::String> v8Name = v8StringData(name);
+            if (realObject->HasOwnProperty(v8Name))
+                v8ToMongoElement(b, name, realObject->Get(v8Name), depth + 1, &holder->_obj);
+            else
+                b.append(elem);
+        }
+
+        // Then any fields added from JavaScript.
+        v8::Local<v8::Array> names = realObject->GetOwnPropertyNames();
+        for (unsigned int i = 0; i < names->Length(); i++) {
+            v8::Local<v8::String> name = names->Get(i)->ToString();
+            if (idFirst && name->StrictEquals(strLitToV8("_id")))
+                continue;
+
+            V8String sname(name);
+            if (added.count(sname))
+                continue;
+            v8ToMongoElement(b, sname, realObject->Get(name), depth + 1, &holder->_obj);
+        }
+
+        const int sizeWithEOO = b.len() + 1/*EOO*/ - 4/*BSONObj::Holder ref count*/;
+        uassert(17415, str::stream() << "Converting from JavaScript to BSON failed: "
+                                     << "Object size " << sizeWithEOO << " exceeds limit of "
+                                     << BSONObjMaxUserSize << " bytes.",
+                sizeWithEOO <= BSONObjMaxUserSize);
+
+        return b.obj();
+    }
+
     // --- random utils ----
 
     static logger::MessageLogDomain* jsPrintLogDomain;
@@ -262,6 +262,12 @@ namespace mongo {
                               v8::Handle<v8::Object> obj);
         OID v8ToMongoObjectID(v8::Handle<v8::Object> obj);
 
+        /**
+         * Converts a modified lazy BSON object back to BSON.  Fields that JavaScript never
+         * replaced are copied from the original BSON rather than decoded and re-encoded.
+         */
+        BSONObj lazyBsonToMongo(BSONHolder* holder, v8::Handle<v8::Object> obj, int depth);
+
         v8::Local<v8::Value> newId(const OID& id);
 
         /**
@@ -524,7 +530,8 @@ namespace mongo {
         explicit BSONHolder(BSONObj obj) :
             _scope(NULL),
             _obj(obj.getOwned()),
-            _modified(false) {
+            _modified(false),
+            _lookups(0) {
             // give hint v8's GC
             v8::V8::AdjustAmountOfExternalAllocatedMemory(_obj.objsize());
         }
@@ -533,11 +540,27 @@ namespace mongo {
                 // if v8 is still up, send hint to GC
                 v8::V8::AdjustAmountOfExternalAllocatedMemory(-_obj.objsize());
         }
+
+        /**
+         * Finds the first field called 'name' in _obj.  Objects that are looked into repeatedly
+         * get a name index so later lookups don't scan the fields.
+         */
+        BSONElement getField(const StringData& name);
+
+        bool isRemoved(const StringData& name) const {
+            return !_removed.empty() && _removed.count(name.toString());
+        }
+
         V8Scope* _scope;
         BSONObj _obj;
+        // set when a field of this object is written or deleted, or when a subobject or array
+        // that can't report its own changes is handed out
         bool _modified;
         bool _readOnly;
         set<string> _removed;
+    private:
+        int _lookups;
+        unordered_map<StringData, BSONElement, StringData::Hasher> _fieldIndex;
     };
 
     /**
@@ -0,0 +1,221 @@
+/**
+ * Copyright (C) 2014 MongoDB Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, the copyright holders give permission to link the
+ * code of portions of this program with the OpenSSL library under certain
+ * conditions as described in each individual source file and distribute
+ * linked combinations including the program with the OpenSSL library. You
+ * must comply with the GNU Affero General Public License in all respects
+ * for all of the code used other than as permitted herein. If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so. If you do not
+ * wish to do so, delete this exception statement from your version. If you
+ * delete this exception statement from all source files in the program,
+ * then also delete it in the license file.
+ */
+
+#include "mongo/util/block_arena.h"
+
+#include <boost/thread/tss.hpp>
+#include <cstdlib>
+#include <new>
+
+#include "mongo/platform/cstdint.h"
+
+namespace mongo {
+
+    /**
+     * Byte counts for an arena and all of its blocks.  'refs' is one for the arena plus one per
+     * block still alive, as blocks can outlive the arena.
+     */
+    struct BlockArena::Usage {
+        explicit Usage( size_t size ) : blockSize( size ) {
+            refs.store( 1 );
+        }
+
+        const size_t blockSize;
+        AtomicUInt32 refs;
+        AtomicInt64 blockBytes; // in blocks still alive
+        AtomicInt64 liveBytes;  // handed out from them and not yet freed, headers included
+    };
+
+    /**
+     * Blocks are laid out as [Block][Header|data][Header|data]...  'live' counts the allocations
+     * still pointing into the block plus one reference held by the arena while the block is
+     * its current one.
+     */
+    struct BlockArena::Block {
+        AtomicUInt32 live;
+        uint32_t padding; // keeps data 8-byte aligned
+        Usage* usage;
+
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    namespace {
+
+        /**
+         * Precedes every allocation.  'blockOffset' is how far back from the header its block
+         * starts, 0 meaning the memory came from malloc; 'bytes' is what the allocation took
+         * out of the block, header included.
+         */
+        struct Header {
+            uint32_t blockOffset;
+            uint32_t bytes;
+        };
+
+        inline size_t alignUp( size_t bytes ) {
+            return ( bytes + 7 ) & ~size_t( 7 );
+        }
+
+        void* mallocWithHeader( size_t bytes ) {
+            Header* header = static_cast<Header*>( std::malloc( sizeof(Header) + bytes ) );
+            if ( !header )
+                throw std::bad_alloc();
+            header->blockOffset = 0;
+            header->bytes = 0;
+            return header + 1;
+        }
+
+        // The arena is not owned by the thread, so nothing is done on thread exit.
+        void noCleanup( BlockArena* ) {}
+
+        boost::thread_specific_ptr<BlockArena> currentArena( noCleanup );
+
+    } // namespace
+
+    BlockArena::BlockArena( size_t blockSize )
+        : _blockSize( alignUp( blockSize ) )
+        , _usage( new Usage( _blockSize ) )
+        , _current( NULL )
+        , _next( NULL )
+        , _end( NULL ) {
+    }
+
+    BlockArena::~BlockArena() {
+        if ( _current )
+            _releaseBlock( _current );
+        _releaseUsage( _usage );
+    }
+
+    void* BlockArena::allocate( size_t bytes ) {
+        BlockArena* arena = currentArena.get();
+        if ( arena )
+            return arena->_allocate( bytes );
+        return mallocWithHeader( bytes );
+    }
+
+    void BlockArena::free( void* ptr ) {
+        if ( !ptr )
+            return;
+
+        Header* header = static_cast<Header*>( ptr ) - 1;
+        if ( header->blockOffset ) {
+            Block* block = reinterpret_cast<Block*>( reinterpret_cast<char*>( header ) -
+                                                     header->blockOffset );
+            block->usage->liveBytes.fetchAndSubtract( header->bytes );
+            _releaseBlock( block );
+        }
+        else {
+            std::free( header );
+        }
+    }
+
+    BlockArena* BlockArena::current() {
+        return currentArena.get();
+    }
+
+    size_t BlockArena::overheadBytes() const {
+        long long overhead = _usage->blockBytes.load() - _usage->liveBytes.load();
+        return overhead > 0 ? static_cast<size_t>( overhead ) : 0;
+    }
+
+    size_t BlockArena::currentOverheadBytes() {
+        BlockArena* arena = currentArena.get();
+        return arena ? arena->overheadBytes() : 0;
+    }
+
+    void* BlockArena::_allocate( size_t bytes ) {
+        _stats.allocations++;
+
+        const size_t needed = sizeof(Header) + alignUp( bytes );
+
+        // Anything larger than a quarter block would waste too much of the block's tail.
+        if ( needed > _blockSize / 4 ) {
+            _stats.largeAllocations++;
+            return mallocWithHeader( bytes );
+        }
+
+        if ( _current && _current->live.load() == 1 && _next != _current->data() ) {
+            // Everything handed out from this block has been freed (typically the previous
+            // batch of documents), so start over at the beginning.
+            _next = _current->data();
+            _stats.blocksReused++;
+        }
+
+        if ( !_current || static_cast<size_t>( _end - _next ) < needed )
+            _newBlock();
+
+        Header* header = reinterpret_cast<Header*>( _next );
+        header->blockOffset = static_cast<uint32_t>( _next - reinterpret_cast<char*>( _current ) );
+        header->bytes = static_cast<uint32_t>( needed );
+        _current->live.fetchAndAdd( 1 );
+        _usage->liveBytes.fetchAndAdd( needed );
+        _next += needed;
+        return header + 1;
+    }
+
+    void BlockArena::_newBlock() {
+        void* mem = std::malloc( sizeof(Block) + _blockSize );
+        if ( !mem )
+            throw std::bad_alloc();
+
+        if ( _current )
+            _releaseBlock( _current );
+
+        _current = new (mem) Block();
+        _current->live.store( 1 ); // the arena's own reference
+        _current->usage = _usage;
+        _usage->refs.fetchAndAdd( 1 );
+        _usage->blockBytes.fetchAndAdd( _blockSize );
+        _next = _current->data();
+        _end = _next + _blockSize;
+        _stats.blocksAllocated++;
+    }
+
+    void BlockArena::_releaseBlock( Block* block ) {
+        if ( block->live.subtractAndFetch( 1 ) == 0 ) {
+            Usage* usage = block->usage;
+            usage->blockBytes.fetchAndSubtract( usage->blockSize );
+            std::free( block );
+            _releaseUsage( usage );
+        }
+    }
+
+    void BlockArena::_releaseUsage( Usage* usage ) {
+        if ( usage->refs.subtractAndFetch( 1 ) == 0 )
+            delete usage;
+    }
+
+    BlockArena::Scope::Scope( BlockArena* arena )
+        : _prev( currentArena.get() ) {
+        currentArena.reset( arena );
+    }
+
+    BlockArena::Scope::~Scope() {
+        currentArena.reset( _prev );
+    }
+
+} // namespace mongo
@@ -0,0 +1,134 @@
+/**
+ * Copyright (C) 2014 MongoDB Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, the copyright holders give permission to link the
+ * code of portions of this program with the OpenSSL library under certain
+ * conditions as described in each individual source file and distribute
+ * linked combinations including the program with the OpenSSL library. You
+ * must comply with the GNU Affero General Public License in all respects
+ * for all of the code used other than as permitted herein. If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so. If you do not
+ * wish to do so, delete this exception statement from your version. If you
+ * delete this exception statement from all source files in the program,
+ * then also delete it in the license file.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+    /**
+     * A bump pointer allocator for the many small, short lived, reference counted objects an
+     * aggregation pipeline creates per input document (DocumentStorage and its buffer, RCString,
+     * RCVector).
+     *
+     * Memory is carved out of large blocks.  Each block counts its live allocations and is
+     * released when the last one goes away, so a batch of documents that is dropped as a whole
+     * gives its memory back in one step.  Objects which outlive their batch (for example ones
+     * held by $group or $sort) simply keep their block alive; they are never invalidated.  The
+     * rest of such a block is dead weight which the objects' own sizes don't show, so anything
+     * enforcing a memory limit on them must add in overheadBytes().
+     * Frees may happen on any thread, and after the arena itself has been destroyed.
+     *
+     * Use is opt-in: an arena is installed for the current thread with BlockArena::Scope, and
+     * allocate() falls back to malloc when none is installed.  Everything returned by
+     * allocate() must be released with BlockArena::free().
+     *
+     * An arena must only be allocated from by one thread at a time.
+     */
+    class BlockArena {
+        MONGO_DISALLOW_COPYING(BlockArena);
+    public:
+        struct Stats {
+            Stats() : allocations(0), blocksAllocated(0), blocksReused(0), largeAllocations(0) {}
+
+            long long allocations;      // total calls to allocate() served by this arena
+            long long blocksAllocated;  // blocks obtained from malloc
+            long long blocksReused;     // times the current block was found empty and rewound
+            long long largeAllocations; // requests too big for a block, passed to malloc
+        };
+
+        explicit BlockArena( size_t blockSize = kDefaultBlockSize );
+        ~BlockArena();
+
+        /**
+         * Allocates 'bytes' bytes, 8-byte aligned, from the arena installed on this thread or
+         * from malloc if there is none.
+         */
+        static void* allocate( size_t bytes );
+
+        /**
+         * Releases memory obtained from allocate().  NULL is ignored.
+         */
+        static void free( void* ptr );
+
+        /**
+         * The arena installed on this thread, or NULL.
+         */
+        static BlockArena* current();
+
+        /**
+         * Installs 'arena' (may be NULL) as the current arena for the lifetime of the Scope.
+         */
+        class Scope {
+            MONGO_DISALLOW_COPYING(Scope);
+        public:
+            explicit Scope( BlockArena* arena );
+            ~Scope();
+        private:
+            BlockArena* _prev;
+        };
+
+        const Stats& stats() const { return _stats; }
+
+        /**
+         * Bytes held in this arena's blocks that no live allocation is using: the unused end of
+         * the current block, and whatever has been freed around long lived objects which are
+         * keeping an otherwise dead block alive.  Includes blocks still alive after the arena
+         * moved on from them.
+         */
+        size_t overheadBytes() const;
+
+        /**
+         * overheadBytes() of the arena installed on this thread, or 0 if there is none.
+         */
+        static size_t currentOverheadBytes();
+
+        static const size_t kDefaultBlockSize = 64 * 1024;
+
+    private:
+        struct Block;
+        struct Usage;
+
+        void* _allocate( size_t bytes );
+        void _newBlock();
+        static void _releaseBlock( Block* block );
+        static void _releaseUsage( Usage* usage );
+
+        const size_t _blockSize;
+        Usage* _usage; // shared with our blocks, which may outlive us
+        Block* _current;
+        char* _next;
+        char* _end;
+        Stats _stats;
+    };
+
+} // namespace mongo
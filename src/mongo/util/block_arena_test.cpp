@@ -0,0 +1,163 @@
+// block_arena_test.cpp
+
+/**
+ * Copyright (C) 2014 MongoDB Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, the copyright holders give permission to link the
+ * code of portions of this program with the OpenSSL library under certain
+ * conditions as described in each individual source file and distribute
+ * linked combinations including the program with the OpenSSL library. You
+ * must comply with the GNU Affero General Public License in all respects
+ * for all of the code used other than as permitted herein. If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so. If you do not
+ * wish to do so, delete this exception statement from your version. If you
+ * delete this exception statement from all source files in the program,
+ * then also delete it in the license file.
+ */
+
+#include "mongo/unittest/unittest.h"
+
+#include <cstring>
+#include <vector>
+
+#include "mongo/util/block_arena.h"
+
+namespace {
+    using namespace mongo;
+
+    TEST(BlockArenaTest, NoArenaUsesMalloc) {
+        ASSERT( !BlockArena::current() );
+        void* p = BlockArena::allocate( 100 );
+        ASSERT( p );
+        memset( p, 0xab, 100 );
+        BlockArena::free( p );
+        BlockArena::free( NULL );
+    }
+
+    TEST(BlockArenaTest, ScopeInstallsAndRestores) {
+        BlockArena outer;
+        BlockArena inner;
+        {
+            BlockArena::Scope outerScope( &outer );
+            ASSERT_EQUALS( &outer, BlockArena::current() );
+            {
+                BlockArena::Scope innerScope( &inner );
+                ASSERT_EQUALS( &inner, BlockArena::current() );
+            }
+            ASSERT_EQUALS( &outer, BlockArena::current() );
+        }
+        ASSERT( !BlockArena::current() );
+    }
+
+    TEST(BlockArenaTest, AllocationsAreAlignedAndDistinct) {
+        BlockArena arena;
+        BlockArena::Scope scope( &arena );
+
+        std::vector<char*> ptrs;
+        for ( int i = 1; i < 200; i++ ) {
+            char* p = static_cast<char*>( BlockArena::allocate( i ) );
+            ASSERT_EQUALS( 0U, reinterpret_cast<size_t>( p ) % 8 );
+            memset( p, i, i );
+            ptrs.push_back( p );
+        }
+        for ( int i = 1; i < 200; i++ ) {
+            ASSERT_EQUALS( char( i ), ptrs[i - 1][i - 1] );
+            BlockArena::free( ptrs[i - 1] );
+        }
+
+        ASSERT_EQUALS( 199, arena.stats().allocations );
+        ASSERT_EQUALS( 1, arena.stats().blocksAllocated );
+    }
+
+    TEST(BlockArenaTest, EmptyBlockIsReused) {
+        BlockArena arena( 4096 );
+        BlockArena::Scope scope( &arena );
+
+        for ( int batch = 0; batch < 10; batch++ ) {
+            std::vector<void*> ptrs;
+            for ( int i = 0; i < 50; i++ )
+                ptrs.push_back( BlockArena::allocate( 32 ) );
+            for ( size_t i = 0; i < ptrs.size(); i++ )
+                BlockArena::free( ptrs[i] );
+        }
+
+        ASSERT_EQUALS( 1, arena.stats().blocksAllocated );
+        ASSERT_EQUALS( 9, arena.stats().blocksReused );
+    }
+
+    TEST(BlockArenaTest, LargeAllocationsBypassBlocks) {
+        BlockArena arena( 4096 );
+        BlockArena::Scope scope( &arena );
+
+        void* p = BlockArena::allocate( 4096 );
+        memset( p, 0, 4096 );
+        ASSERT_EQUALS( 1, arena.stats().largeAllocations );
+        ASSERT_EQUALS( 0, arena.stats().blocksAllocated );
+        BlockArena::free( p );
+    }
+
+    TEST(BlockArenaTest, OverheadCountsPinnedBlocks) {
+        BlockArena arena( 4096 );
+        ASSERT_EQUALS( 0U, arena.overheadBytes() );
+        BlockArena::Scope scope( &arena );
+        ASSERT_EQUALS( 0U, BlockArena::currentOverheadBytes() );
+
+        // fill several blocks, then keep only one small allocation from each
+        std::vector<void*> ptrs;
+        for ( int i = 0; i < 1000; i++ )
+            ptrs.push_back( BlockArena::allocate( 24 ) );
+        const long long blocks = arena.stats().blocksAllocated;
+        ASSERT_GREATER_THAN( blocks, 4 );
+
+        std::vector<void*> kept;
+        const size_t perBlock = 4096 / 32;
+        for ( size_t i = 0; i < ptrs.size(); i++ ) {
+            if ( i % perBlock == 0 )
+                kept.push_back( ptrs[i] );
+            else
+                BlockArena::free( ptrs[i] );
+        }
+
+        // nearly all of every block is now dead weight held by 'kept'
+        ASSERT_GREATER_THAN( arena.overheadBytes(), size_t( ( blocks - 1 ) * 4000 ) );
+        ASSERT_EQUALS( arena.overheadBytes(), BlockArena::currentOverheadBytes() );
+
+        for ( size_t i = 0; i < kept.size(); i++ )
+            BlockArena::free( kept[i] );
+
+        // only the current block remains, and it is empty
+        ASSERT_EQUALS( 4096U, arena.overheadBytes() );
+    }
+
+    TEST(BlockArenaTest, AllocationsOutliveArena) {
+        std::vector<char*> ptrs;
+        {
+            BlockArena arena( 4096 );
+            BlockArena::Scope scope( &arena );
+            for ( int i = 0; i < 1000; i++ ) {
+                char* p = static_cast<char*>( BlockArena::allocate( 16 ) );
+                memset( p, 'x', 16 );
+                ptrs.push_back( p );
+            }
+            ASSERT_GREATER_THAN( arena.stats().blocksAllocated, 1 );
+        }
+        for ( size_t i = 0; i < ptrs.size(); i++ ) {
+            ASSERT_EQUALS( 'x', ptrs[i][15] );
+            BlockArena::free( ptrs[i] );
+        }
+    }
+
+} // namespace
@@ -0,0 +1,143 @@
+/*    Copyright 2014 MongoDB Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/util/concurrency/ticketholder.h"
+
+#include <algorithm>
+
+#include "mongo/util/timer.h"
+
+namespace mongo {
+
+    struct PriorityTicketHolder::Waiter {
+        Waiter() : granted( false ) { }
+        boost::condition_variable_any cond;
+        bool granted;
+    };
+
+    PriorityTicketHolder::PriorityTicketHolder( int outof )
+        : _outof( outof ),
+          _reserved( 0 ),
+          _used( 0 ),
+          _priorityStreak( 0 ),
+          _mutex( "PriorityTicketHolder" ) {
+        for ( int i = 0; i < 2; i++ ) {
+            _waits[i] = 0;
+            _waitMicros[i] = 0;
+        }
+    }
+
+    void PriorityTicketHolder::waitForTicket( Priority priority ) {
+        scoped_lock lk( _mutex );
+
+        // A HIGH arrival only queues behind other HIGH waiters: any NORMAL ones still queued
+        // can't use the ticket it would take.
+        if ( _hasFreeTicket( priority ) && _queues[priority].empty() &&
+             ( priority == HIGH || _queues[HIGH].empty() ) ) {
+            _used++;
+            return;
+        }
+
+        Timer t;
+        Waiter me;
+        _queues[priority].push_back( &me );
+        while ( !me.granted ) {
+            me.cond.wait( lk.boost() );
+        }
+
+        // _grantToWaiters() took the ticket on our behalf and dequeued us
+        _waits[priority]++;
+        _waitMicros[priority] += t.micros();
+    }
+
+    bool PriorityTicketHolder::tryAcquire() {
+        scoped_lock lk( _mutex );
+        if ( !_hasFreeTicket( NORMAL ) || !_queues[NORMAL].empty() || !_queues[HIGH].empty() )
+            return false;
+        _used++;
+        return true;
+    }
+
+    void PriorityTicketHolder::release() {
+        scoped_lock lk( _mutex );
+        _used--;
+        _grantToWaiters();
+    }
+
+    void PriorityTicketHolder::resize( int newSize ) {
+        scoped_lock lk( _mutex );
+        _outof = newSize;
+        _grantToWaiters();
+    }
+
+    void PriorityTicketHolder::setReserved( int reserved ) {
+        scoped_lock lk( _mutex );
+        _reserved = reserved;
+        _grantToWaiters();
+    }
+
+    PriorityTicketHolder::Stats PriorityTicketHolder::getStats() const {
+        scoped_lock lk( _mutex );
+        Stats stats;
+        stats.outof = _outof;
+        stats.used = _used;
+        for ( int i = 0; i < 2; i++ ) {
+            stats.queued[i] = _queues[i].size();
+            stats.waits[i] = _waits[i];
+            stats.waitMicros[i] = _waitMicros[i];
+        }
+        return stats;
+    }
+
+    bool PriorityTicketHolder::_hasFreeTicket( Priority priority ) const {
+        if ( _outof <= 0 )
+            return true;
+        int limit = _outof;
+        if ( priority == NORMAL )
+            limit -= std::min( _reserved, _outof - 1 );
+        return _used < limit;
+    }
+
+    void PriorityTicketHolder::_grantToWaiters() {
+        for ( ;; ) {
+            bool highReady = !_queues[HIGH].empty() && _hasFreeTicket( HIGH );
+            bool normalReady = !_queues[NORMAL].empty() && _hasFreeTicket( NORMAL );
+
+            std::deque<Waiter*>* queue;
+            if ( highReady && ( !normalReady || _priorityStreak < kMaxPriorityStreak ) ) {
+                queue = &_queues[HIGH];
+                // Only count grants that NORMAL waiters could have had.
+                if ( normalReady )
+                    _priorityStreak++;
+                else
+                    _priorityStreak = 0;
+            }
+            else if ( normalReady ) {
+                queue = &_queues[NORMAL];
+                _priorityStreak = 0;
+            }
+            else {
+                return;
+            }
+
+            Waiter* w = queue->front();
+            queue->pop_front();
+            _used++;
+            w->granted = true;
+            w->cond.notify_one();
+        }
+    }
+
+} // namespace mongo
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <boost/thread/condition_variable.hpp>
+#include <deque>
 #include <iostream>
 
 #include "mongo/util/concurrency/mutex.h"
@@ -123,4 +124,76 @@ namespace mongo {
     private:
         TicketHolder * _holder;
     };
+
+    /**
+     * A ticket pool for admission control.  Unlike TicketHolder, waiters are served strictly in
+     * arrival order: a released ticket is handed to the longest waiting thread, and a thread
+     * that arrives while others are queued has to queue behind them.
+     *
+     * There are two queues.  HIGH priority waiters are served before NORMAL ones, except that
+     * after kMaxPriorityStreak tickets in a row have gone to HIGH waiters while NORMAL ones
+     * were queued, the next goes to the NORMAL queue so it can't be starved outright.
+     *
+     * Some tickets can be reserved for HIGH waiters, so that a pool full of NORMAL work still
+     * has room for them.  At least one ticket is always left to NORMAL waiters.
+     *
+     * A size of 0 or less means unlimited, nobody waits.
+     */
+    class PriorityTicketHolder {
+    public:
+        enum Priority { NORMAL = 0, HIGH = 1 };
+
+        static const int kMaxPriorityStreak = 8;
+
+        struct Stats {
+            int outof;
+            int used;
+            int queued[2];          // indexed by Priority
+            long long waits[2];     // acquisitions that had to queue
+            long long waitMicros[2];
+        };
+
+        explicit PriorityTicketHolder( int outof );
+
+        /** Blocks until a ticket is available and it is this thread's turn. */
+        void waitForTicket( Priority priority );
+
+        /** Takes a ticket only if one is free and nobody is queued for it. */
+        bool tryAcquire();
+
+        void release();
+
+        /**
+         * Changes the pool size.  Shrinking below the number of tickets in use is allowed; new
+         * tickets are handed out once enough have been released.
+         */
+        void resize( int newSize );
+
+        /** Sets how many of the tickets only HIGH priority waiters may take. */
+        void setReserved( int reserved );
+
+        int outof() const { return _outof; }
+        int reserved() const { return _reserved; }
+
+        Stats getStats() const;
+
+    private:
+        struct Waiter;
+
+        /** Whether a waiter of the given priority could take a ticket now. */
+        bool _hasFreeTicket( Priority priority ) const;
+
+        /** Hands free tickets to queued waiters.  Caller holds _mutex. */
+        void _grantToWaiters();
+
+        int _outof;
+        int _reserved;
+        int _used;
+        int _priorityStreak;
+        std::deque<Waiter*> _queues[2];
+        long long _waits[2];
+        long long _waitMicros[2];
+        mutable mongo::mutex _mutex;
+    };
+
 }
@@ -32,6 +32,7 @@
 #include <boost/noncopyable.hpp>
 #include "mongo/platform/atomic_word.h"
 #include "mongo/base/string_data.h"
+#include "mongo/util/block_arena.h"
 
 namespace mongo {
 
@@ -122,13 +123,15 @@ namespace mongo {
 // ambiguous for some compilers
 #pragma warning(push)
 #pragma warning(disable : 4291) 
-        void operator delete (void* ptr) { free(ptr); }
+        void operator delete (void* ptr) { BlockArena::free(ptr); }
 #pragma warning(pop)
 
     private:
         // these can only be created by calling create()
         RCString() {};
-        void* operator new (size_t objSize, size_t realSize) { return malloc(realSize); }
+        void* operator new (size_t objSize, size_t realSize) {
+            return BlockArena::allocate(realSize);
+        }
 
         int _size; // does NOT include trailing NUL byte.
         // char[_size+1] array allocated past end of class
@@ -21,6 +21,7 @@
 
 #include <limits>
 #include <queue>
+#include <vector>
 
 #include <boost/thread/condition.hpp>
 
@@ -69,6 +70,34 @@ namespace mongo {
             _cvNoLongerEmpty.notify_one();
         }
 
+        /**
+         * Pushes all of 'items' as one unit, waiting until there is room for the whole batch.
+         * A batch bigger than the queue's max size waits for the queue to drain instead.
+         * @return true if it had to wait
+         */
+        bool pushAll(const std::vector<T>& items) {
+            if (items.empty())
+                return false;
+
+            size_t total = 0;
+            for (size_t i = 0; i < items.size(); ++i) {
+                total += _getSize(items[i]);
+            }
+
+            scoped_lock l( _lock );
+            bool waited = false;
+            while (!_queue.empty() && _currentSize + total >= _maxSize) {
+                waited = true;
+                _cvNoLongerFull.wait( l.boost() );
+            }
+            for (size_t i = 0; i < items.size(); ++i) {
+                _queue.push( items[i] );
+            }
+            _currentSize += total;
+            _cvNoLongerEmpty.notify_all();
+            return waited;
+        }
+
         bool empty() const {
             scoped_lock l( _lock );
             return _queue.empty();